@@ -11,10 +11,90 @@
 // number of pages to write to disk at once. in other words, output buffer size.
 #define FDB_DISK_WRITE_BUFFER_PAGES 128
 
+// number of threads to dump columns of a c-store table in parallel.
+#define FDB_DUMP_THREADS 4
+// total output buffer size (in pages) of all threads dumping c-store columns.
+#define FDB_DUMP_WRITE_BUFFER_PAGES (FDB_DISK_WRITE_BUFFER_PAGES * FDB_DUMP_THREADS)
+
+// number of threads to merge fractures of a BTree family (see FFamily::mergeFractures()). 0 to use all cores.
+#define FDB_MERGE_THREADS 0
+// min number of leaf pages merged by a thread. smaller merges use fewer threads.
+#define FDB_MERGE_MIN_PARTITION_PAGES 16
+// number of fence keys (first tuples of leaf pages) sampled from each fracture per thread
+// to split a merge into key ranges of about the same size.
+#define FDB_MERGE_FENCES_PER_PARTITION 8
+
+// number of merges run at the same time by background compaction (see FCompactionScheduler).
+#define FDB_COMPACTION_THREADS 1
+// interval in milliseconds to check families for fractures to merge.
+#define FDB_COMPACTION_INTERVAL_MS 1000
+// bytes per second read and written by background merges in total. 0 for no limit.
+#define FDB_COMPACTION_BYTES_PER_SEC 0
+// RAM in bytes consumed by each background merge (see FFamily::mergeFractures()).
+#define FDB_COMPACTION_MERGE_BUFFER (1 << 24)
+
+// number of sealed current fractures waiting to be dumped before inserts wait for the dump
+// (see FFamily::startIngest()). bounds the RAM used by sealed fractures.
+#define FDB_MAX_SEALED_FRACTURES 2
+// milliseconds before retrying a failed dump of a sealed fracture. doubled for each failure of the same fracture.
+#define FDB_DUMP_RETRY_MS 100
+// the longest wait in milliseconds between retries of a failed dump.
+#define FDB_DUMP_RETRY_MAX_MS 10000
+
+// RAM buffer in bytes of a write-ahead log (see FWriteAheadLog). twice of this is allocated.
+#define FDB_WAL_BUFFER_BYTES (1 << 22)
+// a write-ahead log commits (fsync) by itself when this many bytes are appended since the last commit.
+#define FDB_WAL_GROUP_COMMIT_BYTES (1 << 20)
+
+// number of threads to sort an unsorted on-memory BTree at finishInserts(). 0 to use all cores.
+#define FDB_SORT_THREADS 0
+// an on-memory BTree with fewer tuples than this is sorted in the calling thread.
+#define FDB_SORT_PARALLEL_MIN (1 << 16)
+// sorted runs (e.g., sorted batches) are merged instead of sorted if there are at most this many.
+#define FDB_SORT_MAX_MERGE_RUNS 256
+// keys sampled per thread to pick splitters of a parallel sort.
+#define FDB_SORT_SAMPLES_PER_THREAD 64
+
 // a btree will adds more level if the highest level has more than this number of pages.
 // note that our btree has more than one root pages ('root' in usual sense isn't needed).
 #define FDB_MAX_ROOT_PAGES 10
 
+// number of values read at once when a column is processed block by block
+// (e.g., compressed-domain aggregation). small enough to stay in L1/L2 cache.
+#define FDB_COLUMN_BLOCK_SIZE 4096
+
+// a selection (see FSelection) with at most this number of positions
+// is kept as a sorted position list rather than a bitmap.
+#define FDB_SELECTION_POSITIONS_MAX 1024
+
+// number of positions evaluated at once when a query narrows a selection by
+// predicates and then reads only the selected values (late materialization).
+#define FDB_SELECTION_SLICE_SIZE (FDB_COLUMN_BLOCK_SIZE * 64)
+
+// number of threads to scan a c-store projection in one query. 0 to use all cores.
+#define FDB_QUERY_THREADS 0
+// number of positions in a unit of work (morsel) of a parallel scan (see FParallelScan).
+// morsels begin at multiples of this value, so they never split a selection slice.
+#define FDB_MORSEL_SIZE FDB_SELECTION_SLICE_SIZE
+
+// max number of tuples in a batch passed between query operators (see foperator.h).
+// a batch of c-store positions is read as one block, so this can't exceed FDB_COLUMN_BLOCK_SIZE.
+#define FDB_VECTOR_SIZE FDB_COLUMN_BLOCK_SIZE
+
+// max number of possible groups (product of the domain sizes of group columns) to aggregate
+// in a dense array indexed by group values (see FAggregateOperator). a hash table otherwise.
+#define FDB_DENSE_GROUP_MAX (1 << 16)
+
+// max number of distinct values in a DICTIONARY_COMPRESSED column (32-bit codes beyond 2^16 entries).
+// the whole dictionary is kept in memory when reading/merging the column.
+// use SYMBOL_COMPRESSED for columns with more distinct values.
+#define FDB_DICTIONARY_MAX_ENTRIES (1 << 24)
+
+// number of values sampled to build the symbol table of a SYMBOL_COMPRESSED column,
+// and the number of rounds to refine the table (see FSymbolTable::build()).
+#define FDB_SYMBOL_SAMPLE_SIZE 16384
+#define FDB_SYMBOL_BUILD_ROUNDS 5
+
 // property file name for log4cxx
 // #define FDB_LOG4CXX_FILE "log4cxx.properties"
 
@@ -47,6 +127,7 @@ enum CompressionScheme {
   UNCOMPRESSED = 1,
   RLE_COMPRESSED = 2,
   DICTIONARY_COMPRESSED = 3,
+  SYMBOL_COMPRESSED = 4, // only for COLUMN_CHAR (see FSymbolTable)
 };
 inline const char *toCompressionSchemeName (CompressionScheme compression) {
   switch (compression) {
@@ -54,6 +135,7 @@ inline const char *toCompressionSchemeName (CompressionScheme compression) {
   case UNCOMPRESSED: return "UNCOMPRESSED";
   case RLE_COMPRESSED: return "RLE_COMPRESSED";
   case DICTIONARY_COMPRESSED: return "DICTIONARY_COMPRESSED";
+  case SYMBOL_COMPRESSED: return "SYMBOL_COMPRESSED";
   default: return "UNKNOWN";
   }
 }
@@ -0,0 +1,386 @@
+#include "fcompaction.h"
+#include "fengine.h"
+#include "ffamily.h"
+#include "../storage/fcstore.h"
+#include "../storage/ffile.h"
+#include "../storage/ffilesig.h"
+#include "../util/stopwatch.h"
+#include <algorithm>
+#include <cassert>
+#include <ctime>
+#include <glog/logging.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace fdb {
+
+// ==========================================================================
+//  Policies
+// ==========================================================================
+struct FractureStatBytesLess {
+  bool operator() (const FFractureStat &left, const FFractureStat &right) const {
+    return left.bytes < right.bytes;
+  }
+};
+
+FTieredCompactionPolicy::FTieredCompactionPolicy (int minMerge, int maxMerge, double sizeRatio)
+  : _minMerge(minMerge), _maxMerge(maxMerge), _sizeRatio(sizeRatio) {
+  assert (minMerge >= 2);
+  assert (maxMerge >= minMerge);
+  assert (sizeRatio >= 1.0);
+}
+bool FTieredCompactionPolicy::pick (const std::vector<FFractureStat> &fractures, int64_t /*now*/, std::vector<std::string> &picked) const {
+  std::vector<FFractureStat> sorted (fractures);
+  std::stable_sort (sorted.begin(), sorted.end(), FractureStatBytesLess());
+  // tiers are runs of sorted fractures within sizeRatio of the smallest in the run.
+  for (size_t begin = 0; begin < sorted.size();) {
+    size_t end = begin + 1;
+    while (end < sorted.size() && sorted[end].bytes <= std::max<int64_t> (sorted[begin].bytes, 1) * _sizeRatio) {
+      ++end;
+    }
+    if ((int) (end - begin) >= _minMerge) {
+      end = std::min (end, begin + _maxMerge);
+      for (size_t i = begin; i < end; ++i) {
+        picked.push_back (sorted[i].name);
+      }
+      return true;
+    }
+    begin = end;
+  }
+  return false;
+}
+
+FLeveledCompactionPolicy::FLeveledCompactionPolicy (int64_t baseBytes, int fanout, int level0Max)
+  : _baseBytes(baseBytes), _fanout(fanout), _level0Max(level0Max) {
+  assert (baseBytes > 0);
+  assert (fanout >= 2);
+  assert (level0Max >= 2);
+}
+int FLeveledCompactionPolicy::getLevel (int64_t bytes) const {
+  int level = 0;
+  for (int64_t levelBytes = _baseBytes; bytes > levelBytes; levelBytes *= _fanout) {
+    ++level;
+  }
+  return level;
+}
+bool FLeveledCompactionPolicy::pick (const std::vector<FFractureStat> &fractures, int64_t /*now*/, std::vector<std::string> &picked) const {
+  std::map<int, std::vector<std::string> > levels; // map<level, fractures>
+  for (size_t i = 0; i < fractures.size(); ++i) {
+    levels[getLevel(fractures[i].bytes)].push_back (fractures[i].name);
+  }
+  const std::vector<std::string> &level0 = levels[0];
+  if ((int) level0.size() >= _level0Max) {
+    picked = level0;
+    std::map<int, std::vector<std::string> >::const_iterator level1 = levels.find (1);
+    if (level1 != levels.end()) {
+      picked.insert (picked.end(), level1->second.begin(), level1->second.end());
+    }
+    return true;
+  }
+  for (std::map<int, std::vector<std::string> >::const_iterator it = levels.begin(); it != levels.end(); ++it) {
+    if (it->first > 0 && it->second.size() >= 2) {
+      picked = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+FTimeWindowCompactionPolicy::FTimeWindowCompactionPolicy (int64_t windowSeconds, int minMerge)
+  : _windowSeconds(windowSeconds), _minMerge(minMerge) {
+  assert (windowSeconds > 0);
+  assert (minMerge >= 2);
+}
+bool FTimeWindowCompactionPolicy::pick (const std::vector<FFractureStat> &fractures, int64_t now, std::vector<std::string> &picked) const {
+  std::map<int64_t, std::vector<std::string> > windows; // map<window, fractures>. oldest first
+  for (size_t i = 0; i < fractures.size(); ++i) {
+    windows[fractures[i].createdAt / _windowSeconds].push_back (fractures[i].name);
+  }
+  const int64_t currentWindow = now / _windowSeconds;
+  for (std::map<int64_t, std::vector<std::string> >::const_iterator it = windows.begin(); it != windows.end(); ++it) {
+    const size_t required = it->first < currentWindow ? 2 : _minMerge;
+    if (it->second.size() >= required) {
+      picked = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ==========================================================================
+//  Scheduler
+// ==========================================================================
+double FCompactionStats::getWriteAmplification () const {
+  if (bytesIngested == 0) {
+    return 0;
+  }
+  return (double) (bytesIngested + bytesWritten) / bytesIngested;
+}
+
+// microseconds since epoch
+int64_t nowMicros () {
+  static const boost::posix_time::ptime epoch (boost::gregorian::date(1970, 1, 1));
+  return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds();
+}
+
+// runs in a background thread until stopped.
+struct CompactionWorker {
+  CompactionWorker (FCompactionScheduler *scheduler_) : scheduler(scheduler_) {}
+  void operator()();
+  FCompactionScheduler *scheduler;
+};
+
+FCompactionScheduler::FCompactionScheduler (FEngine *engine)
+  : _engine(engine), _maxConcurrentMerges(FDB_COMPACTION_THREADS), _bytesPerSecond(FDB_COMPACTION_BYTES_PER_SEC),
+  _mergeBufferSize(FDB_COMPACTION_MERGE_BUFFER), _intervalMillis(FDB_COMPACTION_INTERVAL_MS), _ioAvailableAt(0), _stopping(false) {
+}
+FCompactionScheduler::~FCompactionScheduler () {
+  stop ();
+}
+
+void FCompactionScheduler::setPolicy (const std::string &family, boost::shared_ptr<FCompactionPolicy> policy) {
+  boost::mutex::scoped_lock lock(_mutex);
+  if (policy) {
+    _policies[family] = policy;
+  } else {
+    _policies.erase (family);
+  }
+}
+void FCompactionScheduler::setMaxConcurrentMerges (int merges) {
+  assert (merges > 0);
+  boost::mutex::scoped_lock lock(_mutex);
+  _maxConcurrentMerges = merges;
+}
+void FCompactionScheduler::setBytesPerSecond (int64_t bytesPerSecond) {
+  boost::mutex::scoped_lock lock(_mutex);
+  _bytesPerSecond = bytesPerSecond;
+}
+void FCompactionScheduler::setMergeBufferSize (long long mergeBufferSize) {
+  boost::mutex::scoped_lock lock(_mutex);
+  _mergeBufferSize = mergeBufferSize;
+}
+
+void FCompactionScheduler::start (int intervalMillis) {
+  boost::mutex::scoped_lock lock(_mutex);
+  if (_threads) {
+    LOG(ERROR) << "compaction is already running";
+    assert (false);
+    throw std::exception();
+  }
+  _intervalMillis = intervalMillis;
+  _stopping = false;
+  _threads = boost::shared_ptr<boost::thread_group>(new boost::thread_group());
+  for (int i = 0; i < _maxConcurrentMerges; ++i) {
+    _threads->create_thread (CompactionWorker(this));
+  }
+  LOG(INFO) << "started compaction with " << _maxConcurrentMerges << " threads";
+}
+void FCompactionScheduler::stop () {
+  boost::shared_ptr<boost::thread_group> threads;
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    if (!_threads) {
+      return;
+    }
+    threads = _threads;
+    _stopping = true;
+    _wakeup.notify_all();
+  }
+  threads->join_all();
+  boost::mutex::scoped_lock lock(_mutex);
+  _threads.reset();
+  LOG(INFO) << "stopped compaction";
+}
+bool FCompactionScheduler::isRunning () const {
+  boost::mutex::scoped_lock lock(_mutex);
+  return _threads.get() != NULL;
+}
+
+void CompactionWorker::operator()() {
+  scheduler->runWorker();
+}
+void FCompactionScheduler::runWorker () {
+  while (true) {
+    int merges = runOnce ();
+    boost::mutex::scoped_lock lock(_mutex);
+    if (_stopping) {
+      return;
+    }
+    if (merges == 0) {
+      _wakeup.timed_wait (lock, boost::posix_time::milliseconds(_intervalMillis));
+      if (_stopping) {
+        return;
+      }
+    }
+  }
+}
+
+int FCompactionScheduler::runOnce () {
+  std::vector<std::string> families;
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    for (std::map<std::string, boost::shared_ptr<FCompactionPolicy> >::const_iterator it = _policies.begin(); it != _policies.end(); ++it) {
+      families.push_back (it->first);
+    }
+  }
+  int merges = 0;
+  for (size_t i = 0; i < families.size(); ++i) {
+    {
+      boost::mutex::scoped_lock lock(_mutex);
+      if (_stopping) {
+        break;
+      }
+      if (_compacting.find (families[i]) != _compacting.end()) {
+        continue; // another thread is merging it
+      }
+      _compacting.insert (families[i]);
+    }
+    try {
+      if (compactFamily (families[i])) {
+        ++merges;
+      }
+    } catch (const std::exception &ex) {
+      // the fractures stay as they are. retried in the next check.
+      LOG(ERROR) << "failed to compact family " << families[i] << ": " << ex.what();
+    }
+    boost::mutex::scoped_lock lock(_mutex);
+    _compacting.erase (families[i]);
+  }
+  return merges;
+}
+
+bool FCompactionScheduler::compactFamily (const std::string &familyName) {
+  boost::shared_ptr<FCompactionPolicy> policy;
+  long long mergeBufferSize;
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    std::map<std::string, boost::shared_ptr<FCompactionPolicy> >::const_iterator it = _policies.find (familyName);
+    if (it == _policies.end()) {
+      return false;
+    }
+    policy = it->second;
+    mergeBufferSize = _mergeBufferSize;
+  }
+
+  // shares the family, so erasing it from the engine doesn't delete it during the merge
+  boost::shared_ptr<FFamily> family;
+  std::vector<std::string> picked;
+  int64_t bytesRead = 0;
+  {
+    boost::recursive_mutex::scoped_lock catalogLock (_engine->getCatalogMutex());
+    family = _engine->getSharedFractureFamily (familyName);
+    if (!family) {
+      return false;
+    }
+    std::vector<FFractureStat> fractures;
+    collectFractureStats (*family, *family->acquireSnapshot(), fractures);
+    {
+      boost::mutex::scoped_lock lock(_mutex);
+      FCompactionStats &stats = _stats[familyName];
+      std::set<std::string> &known = _knownFractures[familyName];
+      for (size_t i = 0; i < fractures.size(); ++i) {
+        if (known.insert (fractures[i].name).second) {
+          stats.bytesIngested += fractures[i].bytes;
+        }
+      }
+      stats.fractureCount = fractures.size();
+    }
+    if (!policy->pick (fractures, std::time(NULL), picked) || picked.size() < 2) {
+      return false;
+    }
+    for (size_t i = 0; i < fractures.size(); ++i) {
+      if (std::find (picked.begin(), picked.end(), fractures[i].name) != picked.end()) {
+        bytesRead += fractures[i].bytes;
+      }
+    }
+  }
+
+  // the output is about as large as the inputs
+  int64_t throttled = throttle (bytesRead * 2);
+  LOG(INFO) << "compaction (" << policy->getName() << ") merges " << picked.size() << " fractures (" << bytesRead << " bytes) of family " << familyName;
+  StopWatch watch;
+  watch.init();
+  std::string merged = family->mergeFractures (_engine, picked, true, mergeBufferSize);
+  watch.stop();
+
+  int64_t bytesWritten = 0;
+  size_t fractureCount;
+  {
+    FFractureSnapshotPtr snapshot = family->acquireSnapshot();
+    fractureCount = snapshot->fractures.size();
+    for (size_t i = 0; i < snapshot->fractures.size(); ++i) {
+      if (snapshot->fractures[i]->getName() == merged) {
+        bytesWritten = getFractureBytes (*family, snapshot->fractures[i]->getSignatures());
+      }
+    }
+  }
+  boost::mutex::scoped_lock lock(_mutex);
+  FCompactionStats &stats = _stats[familyName];
+  ++stats.merges;
+  stats.mergedFractures += picked.size();
+  stats.bytesRead += bytesRead;
+  stats.bytesWritten += bytesWritten;
+  stats.throttledMicros += throttled;
+  stats.fractureCount = fractureCount;
+  std::set<std::string> &known = _knownFractures[familyName];
+  for (size_t i = 0; i < picked.size(); ++i) {
+    known.erase (picked[i]);
+  }
+  known.insert (merged);
+  LOG(INFO) << "compaction of family " << familyName << " wrote " << merged << " in " << watch.getElapsed() << " microsec. "
+    << fractureCount << " fractures. write amplification=" << stats.getWriteAmplification();
+  return true;
+}
+
+int64_t FCompactionScheduler::throttle (int64_t bytes) {
+  boost::mutex::scoped_lock lock(_mutex);
+  if (_bytesPerSecond <= 0 || bytes <= 0) {
+    return 0;
+  }
+  const int64_t now = nowMicros();
+  const int64_t begin = std::max (now, _ioAvailableAt);
+  _ioAvailableAt = begin + (int64_t) ((double) bytes * 1000000 / _bytesPerSecond);
+  // wakes up early on stop(). the merge then runs, as the fractures are already picked.
+  while (!_stopping && nowMicros() < begin) {
+    _wakeup.timed_wait (lock, boost::posix_time::microseconds(begin - nowMicros()));
+  }
+  return std::max<int64_t> (0, std::min (nowMicros(), begin) - now);
+}
+
+void FCompactionScheduler::collectFractureStats (FFamily &family, const FFractureSnapshot &snapshot, std::vector<FFractureStat> &stats) const {
+  for (size_t i = 0; i < snapshot.fractures.size(); ++i) {
+    const FFractureFile &fracture = *snapshot.fractures[i];
+    FFractureStat stat;
+    stat.name = fracture.getName();
+    stat.bytes = getFractureBytes (family, fracture.getSignatures());
+    // the signature of the BTree file, or that of the first column (all columns have the same count)
+    stat.tupleCount = fracture.getSignatures()[0].totalTupleCount;
+    stat.createdAt = family.getOnDiskFractureTime(fracture.getName());
+    stats.push_back (stat);
+  }
+}
+
+int64_t FCompactionScheduler::getFractureBytes (FFamily &family, const std::vector<FFileSignature> &signatures) const {
+  if (!family.isCStore()) {
+    return (int64_t) signatures[0].pageCount * FDB_PAGE_SIZE;
+  }
+  std::vector<FCStoreColumn> columns = FCStoreUtil::getPhysicalDesignsOf(family.getTableType());
+  int64_t bytes = 0;
+  for (size_t j = 0; j < signatures.size(); ++j) {
+    if (FCStoreUtil::getColumnGroupOf(columns, j)[0] != j) {
+      continue; // a later member of a column group shares the file
+    }
+    bytes += (int64_t) signatures[j].pageCount * FDB_PAGE_SIZE;
+  }
+  return bytes;
+}
+
+FCompactionStats FCompactionScheduler::getStats (const std::string &family) const {
+  boost::mutex::scoped_lock lock(_mutex);
+  std::map<std::string, FCompactionStats>::const_iterator it = _stats.find (family);
+  if (it == _stats.end()) {
+    return FCompactionStats();
+  }
+  return it->second;
+}
+
+} // fdb
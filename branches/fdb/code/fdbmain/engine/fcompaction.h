@@ -0,0 +1,175 @@
+#ifndef ENGINE_FCOMPACTION_H
+#define ENGINE_FCOMPACTION_H
+
+#include "../configvalues.h"
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+namespace fdb {
+
+// Background compaction of fracture families.
+// Each family appends an on-disk fracture whenever its current fracture is saved, and a query
+// reads all of them (read amplification). FCompactionScheduler merges fractures of families
+// in background threads (see FFamily::mergeFractures()), picking which ones to merge by the
+// compaction policy of each family:
+//   FTieredCompactionPolicy: merges fractures of similar sizes (size-ratio). low write amplification.
+//   FLeveledCompactionPolicy: keeps one fracture per size level. low read amplification.
+//   FTimeWindowCompactionPolicy: merges fractures created in the same time window.
+// As every fracture covers the whole key space, a "level" or a "tier" is a set of whole
+// fractures, not of key-disjoint files.
+
+class FEngine;
+class FFamily;
+struct FFileSignature;
+struct FFractureSnapshot;
+struct CompactionWorker;
+
+// an on-disk fracture seen by compaction policies.
+struct FFractureStat {
+  FFractureStat () : bytes(0), tupleCount(0), createdAt(0) {}
+
+  std::string name; // as in FFamily::getOnDiskFractures()
+  int64_t bytes; // total size of the files of the fracture
+  int64_t tupleCount;
+  int64_t createdAt; // seconds since epoch (see FFamily::getOnDiskFractureTime())
+};
+
+class FCompactionPolicy {
+public:
+  virtual ~FCompactionPolicy() {}
+  // picks fractures to merge into one. fractures are in the order of FFamily::getOnDiskFractures()
+  // (oldest first). now is seconds since epoch. returns false if nothing should be merged now.
+  // called with the lock of the catalog, so it must be quick.
+  virtual bool pick (const std::vector<FFractureStat> &fractures, int64_t now, std::vector<std::string> &picked) const = 0;
+  virtual std::string getName () const = 0;
+};
+
+// size-tiered: fractures whose sizes are within sizeRatio of each other form a tier.
+// merges the tier of the smallest fractures having minMerge or more fractures
+// (at most maxMerge smallest ones). a fracture is rewritten about log_{minMerge}(data size) times.
+class FTieredCompactionPolicy : public FCompactionPolicy {
+public:
+  FTieredCompactionPolicy (int minMerge = 4, int maxMerge = 16, double sizeRatio = 2.0);
+  bool pick (const std::vector<FFractureStat> &fractures, int64_t now, std::vector<std::string> &picked) const;
+  std::string getName () const { return "tiered"; }
+private:
+  int _minMerge;
+  int _maxMerge;
+  double _sizeRatio;
+};
+
+// leveled: level 0 holds fractures up to baseBytes, and level L (>= 1) holds one fracture
+// up to baseBytes * fanout^L. when level 0 has level0Max fractures, they are merged
+// together with the fracture of level 1. a level having two or more fractures
+// (a merge outgrew its level) is merged into one. a query reads at most level0Max
+// fractures plus one per level, while each level is rewritten by merges from the level below.
+class FLeveledCompactionPolicy : public FCompactionPolicy {
+public:
+  FLeveledCompactionPolicy (int64_t baseBytes, int fanout = 10, int level0Max = 4);
+  bool pick (const std::vector<FFractureStat> &fractures, int64_t now, std::vector<std::string> &picked) const;
+  std::string getName () const { return "leveled"; }
+  int getLevel (int64_t bytes) const;
+private:
+  int64_t _baseBytes;
+  int _fanout;
+  int _level0Max;
+};
+
+// time-window: fractures created in the same window of windowSeconds are merged into one
+// after the window is closed. in the current window, they are merged when minMerge fractures exist.
+// a merged fracture takes the newest creation time of its inputs, so it stays in the window.
+// fractures of old windows are never rewritten again, which suits time-ordered ingest.
+class FTimeWindowCompactionPolicy : public FCompactionPolicy {
+public:
+  FTimeWindowCompactionPolicy (int64_t windowSeconds, int minMerge = 4);
+  bool pick (const std::vector<FFractureStat> &fractures, int64_t now, std::vector<std::string> &picked) const;
+  std::string getName () const { return "time-window"; }
+private:
+  int64_t _windowSeconds;
+  int _minMerge;
+};
+
+// metrics of background compaction for a family.
+struct FCompactionStats {
+  FCompactionStats () : merges(0), mergedFractures(0), bytesIngested(0), bytesRead(0), bytesWritten(0), throttledMicros(0), fractureCount(0) {}
+  // bytes written to disk per byte ingested: (ingested + written by merges) / ingested.
+  double getWriteAmplification () const;
+
+  int64_t merges;
+  int64_t mergedFractures; // input fractures of merges
+  int64_t bytesIngested; // bytes of fractures added by others (e.g., saved current fractures)
+  int64_t bytesRead; // bytes of input fractures of merges
+  int64_t bytesWritten; // bytes of merged fractures
+  int64_t throttledMicros; // time merges waited for the I/O budget
+  size_t fractureCount; // on-disk fractures when the family was checked last time
+};
+
+// merges fractures of families by their compaction policies, in background threads (start())
+// or in the calling thread (runOnce()). at most one merge runs on a family at a time, and at most
+// maxConcurrentMerges merges run at a time. merges are paced by an I/O budget: a merge starts only
+// after the budget of preceding merges (bytes read and written / bytesPerSecond) has elapsed,
+// so the average rate stays under the budget while each merge runs at full speed.
+// the catalog (signatures, fracture lists of families) is modified by merges with
+// FEngine::getCatalogMutex() locked. other threads modifying the catalog while
+// compaction runs in background (e.g., adding a fracture) must lock it too.
+// configurations are thread-safe, but take effect from the next merge.
+class FCompactionScheduler {
+public:
+  explicit FCompactionScheduler (FEngine *engine);
+  ~FCompactionScheduler (); // stops background threads
+
+  // sets the policy of the family. an empty pointer stops compaction of the family.
+  void setPolicy (const std::string &family, boost::shared_ptr<FCompactionPolicy> policy);
+  void setMaxConcurrentMerges (int merges); // takes effect at start()
+  void setBytesPerSecond (int64_t bytesPerSecond); // 0 for no limit
+  void setMergeBufferSize (long long mergeBufferSize);
+
+  // starts background threads checking families every intervalMillis (and right after a merge).
+  void start (int intervalMillis = FDB_COMPACTION_INTERVAL_MS);
+  // stops background threads after their current merges. does nothing if not started.
+  void stop ();
+  bool isRunning () const;
+
+  // checks every family with a policy once in the calling thread, and merges at most one
+  // set of fractures per family. returns the number of merges.
+  int runOnce ();
+
+  FCompactionStats getStats (const std::string &family) const;
+
+private:
+  friend struct CompactionWorker;
+  void runWorker ();
+  // returns true if merged.
+  bool compactFamily (const std::string &familyName);
+  // sleeps until the I/O budget allows the bytes. returns the slept time in microseconds.
+  int64_t throttle (int64_t bytes);
+  // with the catalog locked, so the fracture times are those of the snapshot.
+  void collectFractureStats (FFamily &family, const FFractureSnapshot &snapshot, std::vector<FFractureStat> &stats) const;
+  // total size of the files of a fracture, given its signatures (see FFractureFile::getSignatures()).
+  int64_t getFractureBytes (FFamily &family, const std::vector<FFileSignature> &signatures) const;
+
+  FEngine *_engine;
+  mutable boost::mutex _mutex; // protects the members below
+  boost::condition_variable _wakeup; // notified on stop()
+  std::map<std::string, boost::shared_ptr<FCompactionPolicy> > _policies;
+  std::map<std::string, FCompactionStats> _stats;
+  std::map<std::string, std::set<std::string> > _knownFractures; // fractures already counted in stats
+  std::set<std::string> _compacting; // families being merged
+  int _maxConcurrentMerges;
+  int64_t _bytesPerSecond;
+  long long _mergeBufferSize;
+  int _intervalMillis;
+  int64_t _ioAvailableAt; // microseconds when the I/O budget allows the next merge
+  bool _stopping;
+  boost::shared_ptr<boost::thread_group> _threads; // NULL if not running
+
+  FCompactionScheduler (const FCompactionScheduler &); // prohibit copying
+};
+
+} // fdb
+#endif // ENGINE_FCOMPACTION_H
@@ -1,8 +1,11 @@
 #include "fengine.h"
 #include "fengineimpl.h"
+#include "fcompaction.h"
 #include "ffamily.h"
 #include "../storage/fbtree.h"
 #include "../storage/fbufferpool.h"
+#include "../storage/fcstore.h"
+#include <glog/logging.h>
 
 namespace fdb {
 
@@ -11,6 +14,7 @@ namespace fdb {
 // ==========================================================================
 FEngine::FEngine (const std::string &dataFolder, const std::string &configFilePath, int bufferPageCount)
   : _impl (new FEngineImpl (dataFolder, configFilePath, bufferPageCount)) {
+  _impl->_compaction = boost::shared_ptr<FCompactionScheduler>(new FCompactionScheduler(this));
 }
 FEngine::~FEngine () {
   delete _impl;
@@ -29,16 +33,38 @@ bool FEngine::eraseMainMemoryTable (const std::string &name) {
 FFamily* FEngine::getFractureFamily (const std::string &name) {
   return _impl->getFractureFamily(name);
 }
+boost::shared_ptr<FFamily> FEngine::getSharedFractureFamily (const std::string &name) {
+  return _impl->getSharedFractureFamily(name);
+}
 FFamily* FEngine::createNewFractureFamily (const std::string &name, TableType type, bool cstore) {
-  return _impl->createNewFractureFamily(name, type, cstore);
+  return _impl->createNewFractureFamily(this, name, type, cstore);
 }
 bool FEngine::eraseFractureFamily (const std::string &name) {
   return _impl->eraseFractureFamily(name);
 }
 
+boost::shared_ptr<FReadOnlyCStore> FEngine::getReadOnlyCStore (TableType type, const std::string &filenamePrefix) {
+  return _impl->getReadOnlyCStore(type, filenamePrefix);
+}
+bool FEngine::invalidateReadOnlyCStore (const std::string &filenamePrefix) {
+  return _impl->invalidateReadOnlyCStore(filenamePrefix);
+}
+FDictionaryCache& FEngine::getDictionaryCache () {
+  return _impl->getDictionaryCache();
+}
+FCompactionScheduler& FEngine::getCompactionScheduler () {
+  return _impl->getCompactionScheduler();
+}
+boost::recursive_mutex& FEngine::getCatalogMutex () {
+  return _impl->getCatalogMutex();
+}
+
 FSignatureSet& FEngine::getSignatureSet () {
   return _impl->getSignatureSet ();
 }
+void FEngine::saveSignatureSet () {
+  _impl->saveSignatureSet ();
+}
 FBufferPool* FEngine::getBufferPool () {
   return _impl->getBufferPool ();
 }
@@ -54,20 +80,34 @@ FEngineImpl::FEngineImpl (const std::string &dataFolder, const std::string &conf
   _bufferpool = boost::shared_ptr<FBufferPool>(new FBufferPool(bufferPageCount)); // TODO read the config from file
 }
 FEngineImpl::~FEngineImpl () {
-  if (_signatures.isDirty()) {
-    _signatures.save (_configFilePath);
+  if (_compaction) {
+    _compaction->stop();
   }
+  // families finish dumping sealed fractures while the catalog is alive
+  _families.clear();
+  saveSignatureSet ();
 }
 
 FSignatureSet& FEngineImpl::getSignatureSet () {
   return _signatures;
 }
+void FEngineImpl::saveSignatureSet () {
+  if (_signatures.isDirty()) {
+    _signatures.save (_configFilePath);
+  }
+}
 FBufferPool* FEngineImpl::getBufferPool () {
   return _bufferpool.get();
 }
 const std::string& FEngineImpl::getDataFolder() const {
   return _dataFolder;
 }
+FCompactionScheduler& FEngineImpl::getCompactionScheduler () {
+  return *_compaction;
+}
+boost::recursive_mutex& FEngineImpl::getCatalogMutex () {
+  return _catalogMutex;
+}
 
 // =====================
 //  On memory table get/set
@@ -99,25 +139,95 @@ bool FEngineImpl::eraseMainMemoryTable (const std::string &name) {
 // =====================
 
 FFamily* FEngineImpl::getFractureFamily (const std::string &name) {
+  return getSharedFractureFamily(name).get();
+}
+boost::shared_ptr<FFamily> FEngineImpl::getSharedFractureFamily (const std::string &name) {
+  boost::recursive_mutex::scoped_lock catalogLock (_catalogMutex);
   std::map<std::string, boost::shared_ptr<FFamily> >::const_iterator it = _families.find (name);
   if (it == _families.end()) {
-    return NULL;
+    return boost::shared_ptr<FFamily>();
   } else {
-    return it->second.get();
+    return it->second;
   }
 }
-FFamily* FEngineImpl::createNewFractureFamily (const std::string &name, TableType type, bool cstore) {
+FFamily* FEngineImpl::createNewFractureFamily (FEngine *engine, const std::string &name, TableType type, bool cstore) {
+  boost::recursive_mutex::scoped_lock catalogLock (_catalogMutex);
   if (_families.find (name) != _families.end()) {
     assert (false);
     throw std::exception ();
   }
-  boost::shared_ptr<FFamily> family (new FFamily(name, type, cstore));
+  boost::shared_ptr<FFamily> family (new FFamily(engine, name, type, cstore));
   _families [name] = family;
   return family.get();
 }
 bool FEngineImpl::eraseFractureFamily (const std::string &name) {
-  size_t erased = _families.erase (name);
-  return erased > 0;
+  boost::shared_ptr<FFamily> erased; // deleted after unlocking, as it waits for its dumper locking the catalog
+  {
+    boost::recursive_mutex::scoped_lock catalogLock (_catalogMutex);
+    std::map<std::string, boost::shared_ptr<FFamily> >::iterator it = _families.find (name);
+    if (it == _families.end()) {
+      return false;
+    }
+    erased = it->second;
+    _families.erase (it);
+  }
+  return true;
+}
+
+// =====================
+//  C-Store projection catalog
+// =====================
+boost::shared_ptr<FReadOnlyCStore> FEngineImpl::getReadOnlyCStore (TableType type, const std::string &filenamePrefix) {
+  std::vector<FFileSignature> signatures;
+  {
+    boost::recursive_mutex::scoped_lock catalogLock (_catalogMutex); // dumps and merges modify the signatures
+    std::map<std::string, CachedReadOnlyCStore>::iterator it = _cstores.find (filenamePrefix);
+    if (it != _cstores.end() && it->second.signatureVersion != _signatures.getVersion()) {
+      // some file was added/removed. still valid if all column files are the same.
+      CachedReadOnlyCStore &cached = it->second;
+      std::vector<FCStoreColumn> columns = FCStoreUtil::getPhysicalDesignsOf(type);
+      bool valid = (columns.size() == cached.signatures.size());
+      bool addsSl = (_dataFolder.size() > 0 && _dataFolder[_dataFolder.size() - 1] != '/');
+      for (size_t i = 0; valid && i < columns.size(); ++i) {
+        std::string filepath = _dataFolder + (addsSl ? "/" : "") + filenamePrefix + "." + columns[i].getStorageName() + ".db";
+        valid = _signatures.existsFile(filepath) && _signatures.getFileSignature(filepath).fileId == cached.signatures[i].fileId;
+      }
+      if (valid) {
+        cached.signatureVersion = _signatures.getVersion();
+      } else {
+        VLOG(1) << "the cached c-store projection " << filenamePrefix << " is outdated. reopening..";
+        invalidateReadOnlyCStore (filenamePrefix);
+        it = _cstores.end();
+      }
+    }
+    if (it == _cstores.end()) {
+      CachedReadOnlyCStore cached;
+      cached.signatureVersion = _signatures.getVersion();
+      cached.signatures = _signatures.getCStoreFileSignatures(_dataFolder, FCStoreUtil::getPhysicalDesignsOf(type), filenamePrefix);
+      it = _cstores.insert (std::make_pair (filenamePrefix, cached)).first;
+      VLOG(1) << "resolved c-store projection " << filenamePrefix;
+    }
+    signatures = it->second.signatures;
+  }
+  // opened without the catalog lock, as the column files are read-only
+  return boost::shared_ptr<FReadOnlyCStore>(new FReadOnlyCStore(_bufferpool.get(), type, signatures, &_dictionaryCache));
+}
+bool FEngineImpl::invalidateReadOnlyCStore (const std::string &filenamePrefix) {
+  boost::recursive_mutex::scoped_lock catalogLock (_catalogMutex);
+  std::map<std::string, CachedReadOnlyCStore>::iterator it = _cstores.find (filenamePrefix);
+  if (it == _cstores.end()) {
+    return false;
+  }
+  // projections opened before keep their dictionaries (see FDictionaryCache::erase())
+  const std::vector<FFileSignature> &signatures = it->second.signatures;
+  for (size_t i = 0; i < signatures.size(); ++i) {
+    _dictionaryCache.erase(signatures[i].fileId);
+  }
+  _cstores.erase (it);
+  return true;
+}
+FDictionaryCache& FEngineImpl::getDictionaryCache () {
+  return _dictionaryCache;
 }
 
 } //fdb
@@ -4,6 +4,8 @@
 #include <string>
 #include <stdint.h>
 #include "../configvalues.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 
 namespace fdb {
 // the class that represents a database.
@@ -15,6 +17,9 @@ class FMainMemoryBTree;
 class FSignatureSet;
 class FBufferPool;
 class FFamily;
+class FReadOnlyCStore;
+class FDictionaryCache;
+class FCompactionScheduler;
 
 class FEngine {
 public:
@@ -32,12 +37,39 @@ public:
   bool eraseMainMemoryTable (const std::string &name);
   // no addTable() so far. pointer ownership is ambiguous.
 
-  // get/set of fracture families.
+  // get/set of fracture families. thread-safe (with the catalog mutex locked inside).
   FFamily* getFractureFamily (const std::string &name);
+  // same as above, but shares the ownership. a background task (e.g., a merge) holds this
+  // to keep the family alive even if eraseFractureFamily() is called meanwhile.
+  // returns an empty pointer if not found.
+  boost::shared_ptr<FFamily> getSharedFractureFamily (const std::string &name);
   FFamily* createNewFractureFamily (const std::string &name, TableType type, bool cstore);
   bool eraseFractureFamily (const std::string &name);
 
+  // catalog of c-store projections. thread-safe (with the catalog mutex locked inside).
+  // returns a new read-only c-store projection of the given file name prefix for one caller (e.g., a query).
+  // only immutable parts are shared: the column file signatures are resolved once and reused by
+  // following calls until the column files are changed (e.g., merged), and decoded dictionaries
+  // are shared through getDictionaryCache(). the column readers and their search ranges are the
+  // caller's own, and the projection stays readable even if invalidateReadOnlyCStore() is called.
+  boost::shared_ptr<FReadOnlyCStore> getReadOnlyCStore (TableType type, const std::string &filenamePrefix);
+  // forgets the cached signatures of the given prefix and the dictionaries of its files.
+  // returns true if they were cached.
+  bool invalidateReadOnlyCStore (const std::string &filenamePrefix);
+  // decoded dictionaries shared by all column readers of this engine.
+  FDictionaryCache& getDictionaryCache ();
+
+  // background merges of fracture families (see fcompaction.h). not started until start() is called.
+  FCompactionScheduler& getCompactionScheduler ();
+  // guards the catalog (the signature set and fracture lists of families) against background
+  // compaction and dumps of sealed fractures. a thread reading or modifying the catalog while
+  // they run must lock this.
+  boost::recursive_mutex& getCatalogMutex ();
+
+  // read or modify with getCatalogMutex() locked (see above).
   FSignatureSet& getSignatureSet ();
+  // saves the signature set to the config file if it's modified. it's also saved when this object is deleted.
+  void saveSignatureSet ();
   FBufferPool* getBufferPool ();
   const std::string& getDataFolder() const;
 
@@ -3,6 +3,7 @@
 
 #include "fengine.h"
 #include "../storage/ffile.h"
+#include "../storage/fcstore.h"
 #include <boost/shared_ptr.hpp>
 #include <map>
 #include <string>
@@ -11,6 +12,12 @@ namespace fdb {
 
 class FBufferPool;
 
+// an entry of c-store projection catalog.
+struct CachedReadOnlyCStore {
+  int64_t signatureVersion; // FSignatureSet::getVersion() when the signatures were validated
+  std::vector<FFileSignature> signatures; // of the column files, in the order of columns
+};
+
 // pimpl object of FEngine
 class FEngineImpl {
 public:
@@ -22,10 +29,19 @@ public:
   bool eraseMainMemoryTable (const std::string &name);
 
   FFamily* getFractureFamily (const std::string &name);
-  FFamily* createNewFractureFamily (const std::string &name, TableType type, bool cstore);
+  boost::shared_ptr<FFamily> getSharedFractureFamily (const std::string &name);
+  FFamily* createNewFractureFamily (FEngine *engine, const std::string &name, TableType type, bool cstore);
   bool eraseFractureFamily (const std::string &name);
 
+  boost::shared_ptr<FReadOnlyCStore> getReadOnlyCStore (TableType type, const std::string &filenamePrefix);
+  bool invalidateReadOnlyCStore (const std::string &filenamePrefix);
+  FDictionaryCache& getDictionaryCache ();
+
+  FCompactionScheduler& getCompactionScheduler ();
+  boost::recursive_mutex& getCatalogMutex ();
+
   FSignatureSet& getSignatureSet ();
+  void saveSignatureSet ();
   FBufferPool* getBufferPool ();
   const std::string& getDataFolder() const;
 
@@ -35,6 +51,11 @@ public:
   boost::shared_ptr<FBufferPool> _bufferpool;
   std::map<std::string, boost::shared_ptr<FMainMemoryBTree> > _onMemoryTables;
   std::map<std::string, boost::shared_ptr<FFamily> > _families;
+  std::map<std::string, CachedReadOnlyCStore> _cstores; // map<filename prefix, signatures of the projection>
+  FDictionaryCache _dictionaryCache;
+  boost::recursive_mutex _catalogMutex;
+  // declared last to be destructed (stopped) first, as its merges use the members above.
+  boost::shared_ptr<FCompactionScheduler> _compaction;
 };
 
 } //fdb
@@ -9,38 +9,50 @@
 #include "../storage/ffile.h"
 #include "../storage/ffilesig.h"
 #include "../storage/fkeycomp.h"
+#include "../storage/fmerge.h"
 #include "../storage/fpage.h"
 #include "../util/stopwatch.h"
 #include "../util/hashmap.h"
+#include "../ssb/ssb.h"
 #include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <cassert>
-#include <sstream>
+#include <ctime>
 #include <set>
+#include <sstream>
 
 #include <glog/logging.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
 
 namespace fdb {
 // ==========================================================================
 //  Proxies
 // ==========================================================================
-FFamily::FFamily (const std::string &name, TableType type, bool cstore) : _impl (new FFamilyImpl(name, type, cstore)) {
+FFamily::FFamily (FEngine *engine, const std::string &name, TableType type, bool cstore) : _impl (new FFamilyImpl(engine, name, type, cstore)) {
 }
 
 FFamily::~FFamily () {
   delete _impl;
 }
 
+FFractureSnapshotPtr FFamily::acquireSnapshot () const {
+  return _impl->acquireSnapshot();
+}
 const std::vector<std::string>& FFamily::getOnDiskFractures () const {
   return _impl->getOnDiskFractures();
 }
 void FFamily::addOnDiskFracture (const std::string &name) {
   _impl->addOnDiskFracture(name);
 }
-bool FFamily::eraseOnDiskFracture(const std::string &name) {
-  return _impl->eraseOnDiskFracture(name);
+bool FFamily::eraseOnDiskFracture(const std::string &name, bool deleteFiles) {
+  return _impl->eraseOnDiskFracture(name, deleteFiles);
+}
+int64_t FFamily::getOnDiskFractureTime (const std::string &name) const {
+  return _impl->getOnDiskFractureTime(name);
 }
 FMainMemoryBTree* FFamily::getCurrentFracture() {
   return _impl->getCurrentFracture();
@@ -48,6 +60,12 @@ FMainMemoryBTree* FFamily::getCurrentFracture() {
 void FFamily::setCurrentFracture(FMainMemoryBTree *fracture) {
   _impl->setCurrentFracture(fracture);
 }
+FMainMemoryCStore* FFamily::getCurrentCStoreFracture() {
+  return _impl->getCurrentCStoreFracture();
+}
+void FFamily::setCurrentCStoreFracture(FMainMemoryCStore *fracture) {
+  _impl->setCurrentCStoreFracture(fracture);
+}
 const std::string& FFamily::getName() const {
   return _impl->getName();
 }
@@ -57,10 +75,134 @@ TableType FFamily::getTableType () const {
 bool FFamily::isCStore () const {
   return _impl->isCStore ();
 }
-std::string FFamily::mergeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize) {
-  return _impl->mergeFractures (engine, fractureNames, deleteOldFractures, mergeBufferSize);
+void FFamily::startIngest (int64_t maxTuples, int64_t maxBytes, bool sortedBuffer, bool writeAheadLog) {
+  _impl->startIngest (maxTuples, maxBytes, sortedBuffer, writeAheadLog);
+}
+bool FFamily::isIngesting () const {
+  return _impl->_ingesting;
+}
+bool FFamily::insert (const void *key, const void *data) {
+  return _impl->insert (key, data);
+}
+bool FFamily::insertBatch (const void *data, int64_t count) {
+  return _impl->insertBatch (data, count);
+}
+void FFamily::commit () {
+  _impl->commit ();
+}
+void FFamily::flush () {
+  _impl->flush ();
+}
+size_t FFamily::getSealedFractureCount () const {
+  return _impl->getSealedFractureCount ();
+}
+FIngestStats FFamily::getIngestStats () const {
+  return _impl->getIngestStats ();
+}
+std::string FFamily::mergeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize, int threads) {
+  return _impl->mergeFractures (engine, fractureNames, deleteOldFractures, mergeBufferSize, threads);
+}
+
+
+// ==========================================================================
+//  Snapshots
+// ==========================================================================
+FFractureFile::FFractureFile (const std::string &name, const std::vector<FFileSignature> &signatures)
+  : _name(name), _signatures(signatures), _deleteFiles(false) {
+}
+FFractureFile::~FFractureFile () {
+  if (!_deleteFiles) {
+    return;
+  }
+  // columns in a column group share one file
+  std::vector<std::string> filepaths;
+  for (size_t i = 0; i < _signatures.size(); ++i) {
+    const std::string filepath = _signatures[i].getFilepath();
+    if (std::find (filepaths.begin(), filepaths.end(), filepath) != filepaths.end()) {
+      continue;
+    }
+    filepaths.push_back (filepath);
+    if (std::remove(filepath.c_str()) == 0) {
+      LOG(INFO) << "deleted existing file " << filepath << ".";
+    }
+  }
+}
+
+FFractureSnapshotPtr FFamilyImpl::acquireSnapshot () const {
+  boost::mutex::scoped_lock lock (_snapshotMutex);
+  return _snapshot;
+}
+
+void FFamilyImpl::publishSnapshot (const std::vector<std::string> &erased, bool deleteFiles, const std::string &added,
+  const boost::shared_ptr<FSealedFracture> &dumped) {
+  boost::shared_ptr<FFractureFile> addedFile;
+  if (added.size() > 0) {
+    std::vector<FFileSignature> signatures;
+    if (_cstore) {
+      signatures = _engine->getSignatureSet().getCStoreFileSignatures(_engine->getDataFolder(), FCStoreUtil::getPhysicalDesignsOf(_type), added);
+    } else {
+      signatures.push_back (_engine->getSignatureSet().getFileSignature(added));
+    }
+    addedFile = boost::shared_ptr<FFractureFile> (new FFractureFile(added, signatures));
+  }
+
+  boost::shared_ptr<FFractureSnapshot> next (new FFractureSnapshot());
+  FFractureSnapshotPtr previous; // released after unlocking, as it might delete files
+  boost::mutex::scoped_lock lock (_snapshotMutex);
+  previous = _snapshot;
+  next->version = previous->version + 1;
+  for (size_t i = 0; i < previous->fractures.size(); ++i) {
+    const boost::shared_ptr<FFractureFile> &file = previous->fractures[i];
+    if (std::find (erased.begin(), erased.end(), file->getName()) != erased.end()) {
+      file->retire (deleteFiles);
+    } else {
+      next->fractures.push_back (file);
+    }
+  }
+  if (addedFile) {
+    next->fractures.push_back (addedFile);
+  }
+  for (size_t i = 0; i < previous->sealed.size(); ++i) {
+    if (previous->sealed[i] != dumped) {
+      next->sealed.push_back (previous->sealed[i]);
+    }
+  }
+  next->current = previous->current;
+  next->currentCStore = previous->currentCStore;
+  _snapshot = next;
+}
+
+// for a current fracture set by setCurrentFracture(), which the family doesn't own.
+struct NotDeleting {
+  template <typename T>
+  void operator() (T *) const {}
+};
+template <typename T>
+boost::shared_ptr<T> shareCurrent (T *current, const boost::shared_ptr<T> &owned) {
+  if (current == NULL) {
+    return boost::shared_ptr<T>();
+  } else if (current == owned.get()) {
+    return owned;
+  } else {
+    return boost::shared_ptr<T>(current, NotDeleting());
+  }
 }
 
+void FFamilyImpl::publishCurrent (const boost::shared_ptr<FSealedFracture> &sealed) {
+  boost::shared_ptr<FFractureSnapshot> next (new FFractureSnapshot());
+  next->current = shareCurrent (_current, _ownedCurrent);
+  next->currentCStore = shareCurrent (_currentCStore, _ownedCurrentCStore);
+  FFractureSnapshotPtr previous; // released after unlocking
+  boost::mutex::scoped_lock lock (_snapshotMutex);
+  previous = _snapshot;
+  next->version = previous->version + 1;
+  next->fractures = previous->fractures;
+  next->sealed = previous->sealed;
+  if (sealed) {
+    next->sealed.push_back (sealed);
+  }
+  _snapshot = next;
+}
 
 // ==========================================================================
 //  Implementation General
@@ -68,26 +210,68 @@ std::string FFamily::mergeFractures (FEngine *engine, const std::vector<std::str
 const std::vector<std::string>& FFamilyImpl::getOnDiskFractures () const {
   return _fractures;
 }
-void FFamilyImpl::addOnDiskFracture (const std::string &name) {
+void FFamilyImpl::addOnDiskFracture (const std::string &name, const boost::shared_ptr<FSealedFracture> &dumped) {
   assert (std::find(_fractures.begin(), _fractures.end(), name) == _fractures.end());
   _fractures.push_back(name);
+  _fractureTimes[name] = std::time(NULL);
   ++_nextFractureId;
+  publishSnapshot (std::vector<std::string>(), false, name, dumped);
 }
-bool FFamilyImpl::eraseOnDiskFracture(const std::string &name) {
+bool FFamilyImpl::eraseOnDiskFracture(const std::string &name, bool deleteFiles) {
   std::vector<std::string>::iterator iter = std::find(_fractures.begin(), _fractures.end(), name);
   if (iter == _fractures.end()) {
     return false;
   } else {
+    // copied first, as name might refer to the erased element (e.g. getOnDiskFractures()[0])
+    const std::vector<std::string> erased (1, name);
     _fractures.erase (iter);
+    _fractureTimes.erase (erased[0]);
+    publishSnapshot (erased, deleteFiles, "");
     return true;
   }
 }
+int64_t FFamilyImpl::getOnDiskFractureTime (const std::string &name) const {
+  std::map<std::string, int64_t>::const_iterator it = _fractureTimes.find (name);
+  if (it == _fractureTimes.end()) {
+    return -1;
+  }
+  return it->second;
+}
+void FFamilyImpl::replaceMergedFractures (const std::vector<std::string> &fractureNames, const std::string &merged, bool deleteOldFractures) {
+  int64_t newest = -1;
+  for (size_t i = 0; i < fractureNames.size(); ++i) {
+    newest = std::max (newest, getOnDiskFractureTime(fractureNames[i]));
+    std::vector<std::string>::iterator iter = std::find(_fractures.begin(), _fractures.end(), fractureNames[i]);
+    if (iter == _fractures.end()) {
+      LOG (ERROR) << "The fracture '" << fractureNames[i] << "' doesn't exist in the family " << _name;
+      assert (false);
+      continue;
+    }
+    _fractures.erase (iter);
+    _fractureTimes.erase (fractureNames[i]);
+  }
+  assert (std::find(_fractures.begin(), _fractures.end(), merged) == _fractures.end());
+  _fractures.push_back(merged);
+  _fractureTimes[merged] = newest >= 0 ? newest : std::time(NULL);
+  ++_nextFractureId;
+  // queries see either all the inputs or the merged one, never both
+  publishSnapshot (fractureNames, deleteOldFractures, merged);
+}
 
 FMainMemoryBTree* FFamilyImpl::getCurrentFracture() {
   return _current;
 }
 void FFamilyImpl::setCurrentFracture(FMainMemoryBTree *fracture) {
   _current = fracture;
+  publishCurrent ();
+}
+FMainMemoryCStore* FFamilyImpl::getCurrentCStoreFracture() {
+  return _currentCStore;
+}
+void FFamilyImpl::setCurrentCStoreFracture(FMainMemoryCStore *fracture) {
+  assert (fracture == NULL || _cstore);
+  _currentCStore = fracture;
+  publishCurrent ();
 }
 const std::string& FFamilyImpl::getName() const {
   return _name;
@@ -99,11 +283,449 @@ bool FFamilyImpl::isCStore () const {
   return _cstore;
 }
 
-std::string FFamilyImpl::mergeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize) {
+// ==========================================================================
+//  Automatic Flush
+// ==========================================================================
+struct FractureDumper {
+  FractureDumper (FFamilyImpl *impl) : _impl(impl) {}
+  void operator()() {
+    _impl->runDumper();
+  }
+  FFamilyImpl *_impl;
+};
+
+FFamilyImpl::~FFamilyImpl () {
+  if (_dumper) {
+    {
+      boost::mutex::scoped_lock lock (_ingestMutex);
+      _dumperStopping = true;
+      _sealedChanged.notify_all();
+    }
+    _dumper->join(); // the dumper exits after dumping all sealed fractures
+  }
+}
+
+void FFamilyImpl::startIngest (int64_t maxTuples, int64_t maxBytes, bool sortedBuffer, bool writeAheadLog) {
+  if (_ingesting) {
+    LOG(ERROR) << "the family " << _name << " is already ingesting";
+    assert (false);
+    throw std::exception();
+  }
+  assert (maxTuples > 0);
+  assert (maxBytes >= 0);
+  _ingestMaxTuples = maxTuples;
+  _ingestMaxBytes = maxBytes;
+  _ingestSortedBuffer = sortedBuffer;
+  _ingestWriteAheadLog = writeAheadLog;
+
+  // logs left by a previous run. new logs take larger ids
+  std::map<int, std::string> oldLogs;
+  if (writeAheadLog) {
+    const std::string prefix = _name + ".wal.";
+    // logs whose fractures were dumped and registered. the run crashed before deleting them.
+    // they are never replayed again, and their ids are never reused as the catalog refers to them
+    std::set<int> dumpedLogs;
+    {
+      boost::recursive_mutex::scoped_lock catalogLock (_engine->getCatalogMutex());
+      std::vector<std::string> names = _engine->getSignatureSet().getWalNames (prefix);
+      for (size_t i = 0; i < names.size(); ++i) {
+        int walId = toWalId (prefix, names[i]);
+        if (walId >= 0) {
+          dumpedLogs.insert (walId);
+          _nextWalId = std::max (_nextWalId, walId + 1);
+        }
+      }
+    }
+    std::vector<std::string> names = FWriteAheadLog::listFiles (_engine->getDataFolder(), prefix);
+    for (size_t i = 0; i < names.size(); ++i) {
+      int walId = toWalId (prefix, names[i]);
+      if (walId < 0) {
+        continue; // not a log of this family
+      }
+      _nextWalId = std::max (_nextWalId, walId + 1);
+      if (dumpedLogs.find (walId) != dumpedLogs.end()) {
+        if (std::remove(getWalFilepath (walId).c_str()) == 0) {
+          LOG(INFO) << "deleted existing file " << getWalFilepath (walId) << " as its fracture was already dumped.";
+        }
+        continue;
+      }
+      oldLogs[walId] = getWalFilepath (walId);
+    }
+  }
+
+  renewCurrent ();
+  _dumperStopping = false;
+  _dumper = boost::shared_ptr<boost::thread> (new boost::thread (FractureDumper(this)));
+  _ingesting = true;
+  if (!oldLogs.empty()) {
+    replayLogs (oldLogs);
+  }
+}
+
+int FFamilyImpl::toWalId (const std::string &prefix, const std::string &walName) {
+  if (walName.compare (0, prefix.size(), prefix) != 0) {
+    return -1;
+  }
+  const std::string suffix = walName.substr (prefix.size());
+  if (suffix.empty() || suffix.find_first_not_of ("0123456789") != std::string::npos) {
+    return -1;
+  }
+  return std::atoi (suffix.c_str());
+}
+
+std::string FFamilyImpl::getWalFilepath (int walId) const {
+  const std::string &folder = _engine->getDataFolder();
+  bool addsSl = (folder.size() > 0 && folder[folder.size() - 1] != '/');
+  std::stringstream str;
+  str << folder << (addsSl ? "/" : "") << _name << ".wal." << walId;
+  return str.str();
+}
+
+struct ReplayContext {
+  FFamilyImpl *impl;
+  int keySize;
+  int64_t tuples;
+};
+void replayTuple (void *context, const void *record, int size) {
+  ReplayContext *replay = reinterpret_cast<ReplayContext*>(context);
+  const char *key = reinterpret_cast<const char*>(record);
+  assert (size > replay->keySize);
+  if (!replay->impl->insert (key, key + replay->keySize)) {
+    LOG(ERROR) << "failed to insert a replayed tuple";
+    throw std::exception();
+  }
+  ++replay->tuples;
+}
+
+void FFamilyImpl::replayLogs (const std::map<int, std::string> &logs) {
+  StopWatch watch;
+  watch.init();
+  ReplayContext context;
+  context.impl = this;
+  context.keySize = _cstore ? _ownedCurrentCStore->getKeySize() : _ownedCurrent->getKeySize();
+  context.tuples = 0;
+  // inserting them logs them again, so the old logs can be deleted after the commit
+  for (std::map<int, std::string>::const_iterator it = logs.begin(); it != logs.end(); ++it) {
+    FWriteAheadLog::replay (it->second, replayTuple, &context);
+  }
+  commit ();
+  for (std::map<int, std::string>::const_iterator it = logs.begin(); it != logs.end(); ++it) {
+    if (std::remove(it->second.c_str()) == 0) {
+      LOG(INFO) << "deleted existing file " << it->second << ".";
+    }
+  }
+  watch.stop();
+  {
+    boost::mutex::scoped_lock lock (_ingestMutex);
+    _ingestStats.replayedTuples += context.tuples;
+  }
+  LOG(INFO) << "replayed " << context.tuples << " tuples from " << logs.size() << " logs of the family " << _name << ". " << watch.getElapsed() << " microsec";
+}
+
+bool FFamilyImpl::insert (const void *key, const void *data) {
+  assert (_ingesting);
+  if (_wal) {
+    // logged before inserted
+    const int keySize = _cstore ? _ownedCurrentCStore->getKeySize() : _ownedCurrent->getKeySize();
+    const int dataSize = _cstore ? _ownedCurrentCStore->getDataSize() : _ownedCurrent->getDataSize();
+    _walRecord.resize (keySize + dataSize);
+    ::memcpy (&_walRecord[0], key, keySize);
+    ::memcpy (&_walRecord[keySize], data, dataSize);
+    _wal->append (&_walRecord[0], keySize + dataSize);
+  }
+  int64_t size, bytes;
+  if (_cstore) {
+    if (!_ownedCurrentCStore->insert (key, data)) {
+      return false;
+    }
+    size = _ownedCurrentCStore->size();
+    bytes = size * _ownedCurrentCStore->getDataSize();
+  } else {
+    if (!_ownedCurrent->insert (key, data)) {
+      return false;
+    }
+    size = _ownedCurrent->size();
+    bytes = size * (_ownedCurrent->getKeySize() + _ownedCurrent->getDataSize());
+  }
+  if (size >= _ingestMaxTuples || (_ingestMaxBytes > 0 && bytes >= _ingestMaxBytes)) {
+    sealCurrent ();
+  }
+  return true;
+}
+
+bool FFamilyImpl::insertBatch (const void *data, int64_t count) {
+  assert (_ingesting);
+  const char *tuples = reinterpret_cast<const char*>(data);
+  const ExtractKeyFromTupleFunc extractFunc = toExtractKeyFromTupleFunc (_type);
+  const int keySize = toKeySize (_type), dataSize = toDataSize (_type);
+  if (_cstore) {
+    boost::unique_lock<boost::shared_mutex> lock (_currentMutex);
+    std::vector<char> key (keySize);
+    for (int64_t i = 0; i < count; ++i) {
+      extractFunc (tuples + dataSize * i, &key[0]);
+      if (!insert (&key[0], tuples + dataSize * i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // a chunk always fits in an empty fracture
+  for (int64_t chunkBegin = 0; chunkBegin < count; chunkBegin += _ingestMaxTuples) {
+    const char *chunk = tuples + dataSize * chunkBegin;
+    const int64_t chunkSize = std::min (count - chunkBegin, _ingestMaxTuples);
+    while (true) {
+      boost::shared_ptr<FMainMemoryBTree> current;
+      bool inserted = false;
+      {
+        boost::shared_lock<boost::shared_mutex> lock (_currentMutex);
+        current = _ownedCurrent;
+        if (current->insertBatch (chunk, chunkSize)) {
+          inserted = true;
+          if (_wal) {
+            // logged after inserted, but before the fracture is sealed, so each log has the tuples of its fracture
+            std::vector<char> record (keySize + dataSize);
+            for (int64_t i = 0; i < chunkSize; ++i) {
+              extractFunc (chunk + dataSize * i, &record[0]);
+              ::memcpy (&record[keySize], chunk + dataSize * i, dataSize);
+              _wal->append (&record[0], keySize + dataSize);
+            }
+          }
+          const int64_t size = current->size();
+          if (size < _ingestMaxTuples && (_ingestMaxBytes == 0 || size * (keySize + dataSize) < _ingestMaxBytes)) {
+            break;
+          }
+        }
+      }
+      // the fracture is full. the first writer to find it seals it
+      boost::unique_lock<boost::shared_mutex> lock (_currentMutex);
+      if (_ownedCurrent == current) {
+        sealCurrent ();
+      }
+      if (inserted) {
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+void FFamilyImpl::commit () {
+  boost::shared_lock<boost::shared_mutex> lock (_currentMutex);
+  if (_wal) {
+    _wal->commit ();
+  }
+}
+
+void FFamilyImpl::flush () {
+  if (!_ingesting) {
+    return;
+  }
+  if ((_cstore ? _ownedCurrentCStore->size() : _ownedCurrent->size()) > 0) {
+    sealCurrent ();
+  }
+  boost::mutex::scoped_lock lock (_ingestMutex);
+  while (!_sealed.empty()) {
+    _sealedChanged.wait (lock);
+  }
+}
+
+size_t FFamilyImpl::getSealedFractureCount () const {
+  boost::mutex::scoped_lock lock (_ingestMutex);
+  return _sealed.size();
+}
+FIngestStats FFamilyImpl::getIngestStats () const {
+  boost::mutex::scoped_lock lock (_ingestMutex);
+  return _ingestStats;
+}
+
+void FFamilyImpl::renewCurrent (const boost::shared_ptr<FSealedFracture> &sealed) {
+  if (_cstore) {
+    _ownedCurrentCStore = boost::shared_ptr<FMainMemoryCStore> (new FMainMemoryCStore (_type, _ingestMaxTuples));
+    _currentCStore = _ownedCurrentCStore.get();
+  } else {
+    _ownedCurrent = boost::shared_ptr<FMainMemoryBTree> (new FMainMemoryBTree (_type, _ingestMaxTuples, _ingestSortedBuffer));
+    _current = _ownedCurrent.get();
+  }
+  if (_ingestWriteAheadLog) {
+    _wal = boost::shared_ptr<FWriteAheadLog> (new FWriteAheadLog (getWalFilepath (_nextWalId++)));
+  }
+  publishCurrent (sealed);
+}
+
+void FFamilyImpl::sealCurrent () {
+  SealedFracture sealed;
+  sealed.fracture = boost::shared_ptr<FSealedFracture> (new FSealedFracture (_ownedCurrent, _ownedCurrentCStore));
+  if (_wal) {
+    _wal->commit (); // the log is kept until the fracture is dumped
+    sealed.walFilepath = _wal->getFilepath();
+  }
+  {
+    boost::mutex::scoped_lock lock (_ingestMutex);
+    if (_sealed.size() >= FDB_MAX_SEALED_FRACTURES) {
+      // the dumper can't keep up. wait rather than holding more fractures in RAM
+      StopWatch watch;
+      watch.init();
+      while (_sealed.size() >= FDB_MAX_SEALED_FRACTURES) {
+        _sealedChanged.wait (lock);
+      }
+      watch.stop();
+      _ingestStats.stalledMicros += watch.getElapsed();
+    }
+  }
+  // in the snapshot before the dumper sees it, so the dump always replaces it there.
+  // only this thread adds to the queue, thus the room is still there.
+  renewCurrent (sealed.fracture);
+  boost::mutex::scoped_lock lock (_ingestMutex);
+  _sealed.push_back (sealed);
+  ++_ingestStats.sealedFractures;
+  _sealedChanged.notify_all();
+}
+
+void FFamilyImpl::runDumper () {
+  boost::mutex::scoped_lock lock (_ingestMutex);
+  int retryMillis = 0; // the wait after the last failure of the front fracture. 0 if not failed
+  while (true) {
+    while (_sealed.empty() && !_dumperStopping) {
+      _sealedChanged.wait (lock);
+    }
+    if (_sealed.empty()) {
+      break; // stopping, and nothing left to dump
+    }
+    SealedFracture sealed = _sealed.front();
+    lock.unlock();
+    StopWatch watch;
+    watch.init();
+    int64_t tuples = -1;
+    try {
+      tuples = dumpSealed (sealed);
+    } catch (const std::exception &ex) {
+      LOG(ERROR) << "failed to dump a sealed fracture of the family " << _name << ": " << ex.what();
+    }
+    watch.stop();
+    lock.lock();
+    _ingestStats.dumpMicros += watch.getElapsed();
+    if (tuples >= 0) {
+      _sealed.pop_front();
+      ++_ingestStats.dumpedFractures;
+      _ingestStats.dumpedTuples += tuples;
+      retryMillis = 0;
+      _sealedChanged.notify_all();
+      continue;
+    }
+
+    // the fracture stays in the queue (and in snapshots), so no tuple is lost. inserts stall
+    // once the queue is full, and flush() waits, until a retry succeeds.
+    ++_ingestStats.failedDumps;
+    if (_dumperStopping && retryMillis >= FDB_DUMP_RETRY_MAX_MS) {
+      _sealed.pop_front();
+      LOG(ERROR) << "gave up dumping a sealed fracture of the family " << _name << " as the family is deleted. "
+        << (sealed.walFilepath.empty() ? std::string("its tuples are lost.") : "its tuples are kept in the write-ahead log " + sealed.walFilepath + ".");
+      retryMillis = 0;
+      _sealedChanged.notify_all();
+      continue;
+    }
+    retryMillis = retryMillis == 0 ? FDB_DUMP_RETRY_MS : std::min (retryMillis * 2, FDB_DUMP_RETRY_MAX_MS);
+    LOG(ERROR) << "retrying the dump in " << retryMillis << " msec. " << _sealed.size() << " sealed fractures are waiting.";
+    const boost::system_time retryAt = boost::get_system_time() + boost::posix_time::milliseconds (retryMillis);
+    while (boost::get_system_time() < retryAt) {
+      _sealedChanged.timed_wait (lock, retryAt);
+    }
+  }
+}
+
+int64_t FFamilyImpl::dumpSealed (const SealedFracture &sealed) {
+  FMainMemoryBTree *btree = sealed.fracture->getBTree();
+  FMainMemoryCStore *cstore = sealed.fracture->getCStore();
+  {
+    // sorting doesn't touch the catalog, but queries must not read the fracture meanwhile
+    boost::unique_lock<boost::shared_mutex> sortLock (sealed.fracture->getMutex());
+    if (_cstore) {
+      cstore->finishInserts();
+    } else {
+      btree->finishInserts();
+    }
+  }
+  // the files are written without the catalog locked, under a name not in the catalog yet.
+  // the catalog is locked only to reserve the name and file ids, and then to register the files.
+  boost::recursive_mutex::scoped_lock catalogLock (_engine->getCatalogMutex());
+  FSignatureSet &signatures = _engine->getSignatureSet();
+  const std::string name = issueSealedName ();
+  std::vector<FFileSignature> fileSignatures;
+  if (_cstore) {
+    fileSignatures = signatures.createNewCStoreFileSignatures (_engine->getDataFolder(), name, _type);
+  } else {
+    const std::string &folder = _engine->getDataFolder();
+    bool addsSl = (folder.size() > 0 && folder[folder.size() - 1] != '/');
+    FFileSignature signature;
+    signature.fileId = signatures.issueNextFileId();
+    signature.setFilepath(folder + (addsSl ? "/" : "") + name);
+    fileSignatures.push_back (signature);
+  }
+  catalogLock.unlock();
+  try {
+    if (_cstore) {
+      FCStoreUtil::dumpToNewCStoreFile (fileSignatures, *cstore);
+    } else {
+      btree->dumpToNewRowStoreFile (fileSignatures[0]);
+    }
+  } catch (...) {
+    FFractureFile partial (name, fileSignatures);
+    partial.retire (true); // deletes the files written so far
+    throw;
+  }
+
+  if (sealed.walFilepath.size() > 0) {
+    // tells the replay of a later run that the log is already dumped, if it's left by a crash
+    const std::string walName = sealed.walFilepath.substr (sealed.walFilepath.rfind('/') + 1);
+    for (size_t i = 0; i < fileSignatures.size(); ++i) {
+      fileSignatures[i].setWalName (walName);
+    }
+  }
+
+  catalogLock.lock();
+  if (_cstore) {
+    std::vector<FCStoreColumn> columns = FCStoreUtil::getPhysicalDesignsOf(_type);
+    for (size_t i = 0; i < fileSignatures.size(); ++i) {
+      if (FCStoreUtil::getColumnGroupOf(columns, i)[0] != i) {
+        continue; // a later member of a column group. the file is already added.
+      }
+      signatures.addFileSignature (fileSignatures[i]);
+    }
+    addOnDiskFracture (name, sealed.fracture);
+  } else {
+    signatures.addFileSignature (fileSignatures[0]);
+    addOnDiskFracture (fileSignatures[0].getFilepath(), sealed.fracture);
+  }
+  if (sealed.walFilepath.size() > 0) {
+    // the log is needed until the new signatures are on disk
+    _engine->saveSignatureSet ();
+    if (std::remove(sealed.walFilepath.c_str()) == 0) {
+      LOG(INFO) << "deleted existing file " << sealed.walFilepath << ".";
+    }
+  }
+  return _cstore ? cstore->size() : btree->size();
+}
+
+std::string FFamilyImpl::issueSealedName () {
+  const std::string &folder = _engine->getDataFolder();
+  bool addsSl = (folder.size() > 0 && folder[folder.size() - 1] != '/');
+  // the first column file of a c-store fracture tells whether the prefix is used
+  std::string suffix = _cstore ? "." + FCStoreUtil::getPhysicalDesignsOf(_type)[0].getStorageName() + ".db" : "";
+  while (true) {
+    std::stringstream str;
+    str << _name << ".s" << _nextSealedId++;
+    if (!_engine->getSignatureSet().existsFile(folder + (addsSl ? "/" : "") + str.str() + suffix)) {
+      return str.str();
+    }
+  }
+}
+
+std::string FFamilyImpl::mergeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize, int threads) {
   if (_cstore) {
     return mergeCStoreFractures (engine, fractureNames, deleteOldFractures, mergeBufferSize);
   } else {
-    return mergeBTreeFractures (engine, fractureNames, deleteOldFractures, mergeBufferSize);
+    return mergeBTreeFractures (engine, fractureNames, deleteOldFractures, mergeBufferSize, threads);
   }
 }
 
@@ -112,27 +734,45 @@ std::string FFamilyImpl::mergeFractures (FEngine *engine, const std::vector<std:
 // ==========================================================================
 struct FractureReadBuffer {
 public:
-  FractureReadBuffer (FBufferPool *bufferpool, const FFileSignature &signature, int bufferSize, int tupleSize)
+  // reads tuples [beginTuple, endTuple) of a BTree fracture. endTuple=-1 for all tuples.
+  // a range is given only for BTree fractures (tupleSize > 0), to merge a key range of fractures.
+  FractureReadBuffer (FBufferPool *bufferpool, const FFileSignature &signature, int bufferSize, int tupleSize, int64_t beginTuple = 0, int64_t endTuple = -1)
     : _bufferpool(bufferpool), _signature (signature), _bufferSize (bufferSize), _tupleSize(tupleSize) {
     assert (bufferSize > 0);
     _buffer = reinterpret_cast<char*>(DirectFileStream::allocateMemoryForIO (bufferSize * FDB_PAGE_SIZE, FDB_DIRECT_IO_ALIGNMENT, FDB_USE_DIRECT_IO));
     _nextPageId = 0;
+    _endPageId = _signature.leafPageCount;
+    _remainingTuples = -1;
     _currentPageInBuffer = 0;
     _currentPageCountInBuffer = 0;
     _currentTupleInPage = 0;
     _currentTupleCountInPage = 0;
-    readBulk ();
+    if (endTuple >= 0) {
+      assert (tupleSize > 0);
+      assert (beginTuple <= endTuple);
+      const int tuplesPerPage = (FDB_PAGE_SIZE - sizeof (FPageHeader)) / tupleSize;
+      _nextPageId = beginTuple / tuplesPerPage;
+      _endPageId = (endTuple + tuplesPerPage - 1) / tuplesPerPage;
+      _remainingTuples = endTuple - beginTuple;
+      readBulk ();
+      _currentTupleInPage = beginTuple % tuplesPerPage;
+    } else {
+      readBulk ();
+    }
   }
   ~FractureReadBuffer () {
     DirectFileStream::deallocateMemoryForIO(FDB_USE_DIRECT_IO, _buffer);
   }
   bool hasCurrent () {
-    return _currentTupleInPage < _currentTupleCountInPage && _currentPageInBuffer < _currentPageCountInBuffer;
+    return _remainingTuples != 0 && _currentTupleInPage < _currentTupleCountInPage && _currentPageInBuffer < _currentPageCountInBuffer;
   }
-  inline const char* getCurrent () {
+  inline const char* getCurrent () const {
     return _buffer + FDB_PAGE_SIZE * _currentPageInBuffer + sizeof (FPageHeader) + _tupleSize * _currentTupleInPage;
   }
   bool next () {
+    if (_remainingTuples > 0 && --_remainingTuples == 0) {
+      return false; // end of the range
+    }
     if (_currentTupleInPage < _currentTupleCountInPage - 1) {
       ++_currentTupleInPage;
       return true;
@@ -153,8 +793,8 @@ public:
   }
   void readBulk () {
     int pagesToRead = _bufferSize;
-    if (_nextPageId + pagesToRead > _signature.leafPageCount) {
-      pagesToRead = _signature.leafPageCount - _nextPageId;
+    if (_nextPageId + pagesToRead > _endPageId) {
+      pagesToRead = _endPageId - _nextPageId;
     }
     if (pagesToRead > 0) {
       _bufferpool->readPages(_signature, _nextPageId, pagesToRead, _buffer);
@@ -172,6 +812,8 @@ public:
   int _tupleSize;
 
   int _nextPageId;
+  int _endPageId; // leaf pages to read are [0 or the first page of the range, _endPageId)
+  int64_t _remainingTuples; // -1 if not reading a range
   int _currentPageInBuffer;
   int _currentPageCountInBuffer;
   int _currentTupleInPage;
@@ -179,11 +821,280 @@ public:
 private:
   FractureReadBuffer (const FractureReadBuffer&);
 };
-std::string FFamilyImpl::mergeBTreeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize) {
+
+// ===========
+//  comparators for merging
+// ===========
+// tuple comparators of table types, inlined into the merge loops (see FLoserTree).
+// the generic one calls the comparison function of the table type.
+struct GenericTupleCompare {
+  explicit GenericTupleCompare (TableType type) : func (toDataDataCompareFunc(type)) {}
+  int operator() (const void *tuple1, const void *tuple2) const { return func (tuple1, tuple2); }
+  DataDataCompareFunc func;
+};
+struct LineorderTupleCompare {
+  explicit LineorderTupleCompare (TableType) {}
+  int operator() (const void *tuple1, const void *tuple2) const { return Lineorder::compareTuplePK (tuple1, tuple2); }
+};
+struct MVProjectionTupleCompare {
+  explicit MVProjectionTupleCompare (TableType) {}
+  int operator() (const void *tuple1, const void *tuple2) const { return MVProjection::compareTuple (tuple1, tuple2); }
+};
+
+// LESS of FLoserTree on the current tuples of fractures (FractureReadBuffer or CStoreReadBuffer).
+template <typename COMPARE, typename BUFFER>
+struct CurrentTupleLess {
+  CurrentTupleLess (TableType type, const std::vector<BUFFER*> &buffers_) : compare (type), buffers (&buffers_) {}
+  bool operator() (size_t a, size_t b) const {
+    return compare ((*buffers)[a]->getCurrent(), (*buffers)[b]->getCurrent()) < 0;
+  }
+  COMPARE compare;
+  const std::vector<BUFFER*> *buffers;
+};
+
+// ===========
+//  key range partitions of BTree merging
+// ===========
+// tuples [begins[i], ends[i]) of each fracture i, merged by one thread into the leaf pages
+// from the firstTuple-th tuple of the merged fracture.
+struct BTreeMergePartition {
+  std::vector<int64_t> begins;
+  std::vector<int64_t> ends;
+  int64_t firstTuple; // a multiple of tuples per leaf page, so partitions write disjoint pages
+  std::vector<BTreePageSignature> pageSignatures; // of the written leaf pages
+};
+
+// a sampled first tuple of a leaf page, standing for weight tuples.
+struct MergeFence {
+  std::string tuple;
+  int64_t weight;
+};
+struct MergeFenceLess {
+  explicit MergeFenceLess (TableType type) : compare (type) {}
+  bool operator() (const MergeFence &a, const MergeFence &b) const {
+    return compare (a.tuple.data(), b.tuple.data()) < 0;
+  }
+  GenericTupleCompare compare;
+};
+
+// returns the position of the first tuple >= the given tuple in the fracture.
+int64_t lowerBoundTuple (FBufferPool *bufferpool, const FFileSignature &signature, int tupleSize, const GenericTupleCompare &compare, const char *tuple) {
+  // first, the first leaf page whose first tuple >= tuple. leaf pages are [0, leafPageCount)
+  int low = 0, high = signature.leafPageCount;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    const char *page = bufferpool->readPage(signature, mid);
+    if (compare (page + sizeof (FPageHeader), tuple) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low == 0) return 0;
+  // then, the first tuple >= tuple in the previous page
+  const char *page = bufferpool->readPage(signature, low - 1);
+  const FPageHeader *header = reinterpret_cast<const FPageHeader*> (page);
+  int lowTuple = 0, highTuple = header->count;
+  while (lowTuple < highTuple) {
+    int mid = (lowTuple + highTuple) / 2;
+    if (compare (page + sizeof (FPageHeader) + mid * tupleSize, tuple) < 0) {
+      lowTuple = mid + 1;
+    } else {
+      highTuple = mid;
+    }
+  }
+  return header->beginningPos + lowTuple;
+}
+
+// moves a cut of fractures (positions before which tuples go to earlier partitions)
+// forward by the given number of tuples in the merged order.
+void advanceMergeCut (FBufferPool *bufferpool, const std::vector<FFileSignature> &inputs, TableType type, int tupleSize, std::vector<int64_t> &positions, int64_t count) {
+  if (count == 0) return;
+  std::vector<boost::shared_ptr<FractureReadBuffer> > bufferPtrs;
+  std::vector<FractureReadBuffer*> buffers;
+  std::vector<bool> finished;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    boost::shared_ptr<FractureReadBuffer> buffer (new FractureReadBuffer(bufferpool, inputs[i], 1, tupleSize, positions[i], inputs[i].totalTupleCount));
+    bufferPtrs.push_back (buffer);
+    buffers.push_back (buffer.get());
+    finished.push_back (!buffer->hasCurrent());
+  }
+  FLoserTree<CurrentTupleLess<GenericTupleCompare, FractureReadBuffer> > tree (finished, CurrentTupleLess<GenericTupleCompare, FractureReadBuffer> (type, buffers));
+  for (int64_t c = 0; c < count; ++c) {
+    int i = tree.top();
+    assert (i >= 0);
+    ++positions[i];
+    tree.pop (buffers[i]->next());
+  }
+}
+
+// splits a merge into partitions of about the same number of tuples.
+// the key space is cut at fence keys (first tuples of leaf pages) sampled from all fractures,
+// and then each cut is moved forward to a page boundary of the merged fracture.
+// as a cut is a prefix of the merged order (ties go to the earlier fracture as in FLoserTree),
+// concatenating the partitions gives the same result as merging all tuples by one thread.
+void splitBTreeMerge (FBufferPool *bufferpool, const std::vector<FFileSignature> &inputs, TableType type, int tupleSize,
+  size_t partitionCount, std::vector<BTreeMergePartition> &partitions) {
+  const int64_t tuplesPerPage = (FDB_PAGE_SIZE - sizeof (FPageHeader)) / tupleSize;
+  int64_t totalTuples = 0;
+  std::vector<int64_t> ends;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    totalTuples += inputs[i].totalTupleCount;
+    ends.push_back (inputs[i].totalTupleCount);
+  }
+
+  std::vector<MergeFence> fences;
+  for (size_t i = 0; i < inputs.size() && partitionCount > 1; ++i) {
+    const int leafPages = inputs[i].leafPageCount;
+    const int samples = std::min<int> (leafPages, partitionCount * FDB_MERGE_FENCES_PER_PARTITION);
+    for (int s = 0; s < samples; ++s) {
+      int pageId = (int) ((int64_t) s * leafPages / samples);
+      int nextPageId = (int) ((int64_t) (s + 1) * leafPages / samples);
+      const char *page = bufferpool->readPage(inputs[i], pageId);
+      MergeFence fence;
+      fence.tuple.assign (page + sizeof (FPageHeader), tupleSize);
+      fence.weight = std::min<int64_t> (nextPageId * tuplesPerPage, inputs[i].totalTupleCount) - pageId * tuplesPerPage;
+      fences.push_back (fence);
+    }
+  }
+  std::sort (fences.begin(), fences.end(), MergeFenceLess (type));
+
+  GenericTupleCompare compare (type);
+  std::vector<std::vector<int64_t> > cuts (1, std::vector<int64_t> (inputs.size(), 0));
+  int64_t lastCutTuples = 0, cumulativeWeight = 0;
+  size_t fence = 0;
+  for (size_t p = 1; p < partitionCount; ++p) {
+    const int64_t target = totalTuples * p / partitionCount;
+    while (fence < fences.size() && cumulativeWeight < target) {
+      cumulativeWeight += fences[fence].weight;
+      ++fence;
+    }
+    if (fence >= fences.size()) break;
+    std::vector<int64_t> positions;
+    int64_t cutTuples = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      positions.push_back (lowerBoundTuple (bufferpool, inputs[i], tupleSize, compare, fences[fence].tuple.data()));
+      cutTuples += positions.back();
+    }
+    int64_t alignedTuples = std::min (totalTuples, (cutTuples + tuplesPerPage - 1) / tuplesPerPage * tuplesPerPage);
+    if (alignedTuples <= lastCutTuples || alignedTuples >= totalTuples) continue; // empty partition
+    advanceMergeCut (bufferpool, inputs, type, tupleSize, positions, alignedTuples - cutTuples);
+    cuts.push_back (positions);
+    lastCutTuples = alignedTuples;
+  }
+  cuts.push_back (ends);
+
+  int64_t firstTuple = 0;
+  for (size_t p = 0; p + 1 < cuts.size(); ++p) {
+    BTreeMergePartition partition;
+    partition.begins = cuts[p];
+    partition.ends = cuts[p + 1];
+    partition.firstTuple = firstTuple;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      assert (partition.begins[i] <= partition.ends[i]);
+      firstTuple += partition.ends[i] - partition.begins[i];
+    }
+    partitions.push_back (partition);
+  }
+  assert (firstTuple == totalTuples);
+}
+
+// partitions to merge, shared by the merging threads.
+// each thread repeatedly takes the next partition and merges it with its own read/write buffers.
+struct ParallelBTreeMerge {
+  ParallelBTreeMerge (FBufferPool *bufferpool_, const std::vector<FFileSignature> &inputs_, FFileSignature &output_,
+    TableType type_, int64_t totalTuples_, std::vector<BTreeMergePartition> &partitions_, int readBufferPages_, int writeBufferPages_)
+    : bufferpool(bufferpool_), inputs(inputs_), output(output_), type(type_), tupleSize(toDataSize(type_)), totalTuples(totalTuples_),
+    partitions(partitions_), readBufferPages(readBufferPages_), writeBufferPages(writeBufferPages_), nextPartition(0), failed(false) {}
+
+  FBufferPool *bufferpool;
+  const std::vector<FFileSignature> &inputs;
+  FFileSignature &output;
+  TableType type;
+  int tupleSize;
+  int64_t totalTuples;
+  std::vector<BTreeMergePartition> &partitions;
+  int readBufferPages; // per thread
+  int writeBufferPages; // per thread
+  boost::mutex mutex; // protects nextPartition and failed
+  size_t nextPartition;
+  bool failed;
+
+  // returns false if no more partition to merge.
+  bool takeNextPartition (size_t &partitionIndex) {
+    boost::mutex::scoped_lock lock(mutex);
+    if (failed || nextPartition >= partitions.size()) return false;
+    partitionIndex = nextPartition++;
+    return true;
+  }
+  void setFailed () {
+    boost::mutex::scoped_lock lock(mutex);
+    failed = true;
+  }
+  void run () {
+    try {
+      size_t i;
+      while (takeNextPartition(i)) {
+        switch (type) {
+        case LINEORDER_PK_SORT:
+          mergePartition<LineorderTupleCompare> (partitions[i]);
+          break;
+        case MV_PROJECTION:
+          mergePartition<MVProjectionTupleCompare> (partitions[i]);
+          break;
+        default:
+          mergePartition<GenericTupleCompare> (partitions[i]);
+        }
+      }
+    } catch (const std::exception &ex) {
+      LOG(ERROR) << "failed to merge a partition: " << ex.what();
+      setFailed ();
+    }
+  }
+
+  template <typename COMPARE>
+  void mergePartition (BTreeMergePartition &partition) {
+    int64_t partitionTuples = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) partitionTuples += partition.ends[i] - partition.begins[i];
+    assert (partitionTuples > 0);
+    std::vector<boost::shared_ptr<FractureReadBuffer> > bufferPtrs; // to keep the objects
+    std::vector<FractureReadBuffer*> buffers;
+    std::vector<bool> finished;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      int bufferedPages = (int) ((double) readBufferPages * (partition.ends[i] - partition.begins[i]) / partitionTuples);
+      if (bufferedPages == 0) bufferedPages = 1;
+      boost::shared_ptr<FractureReadBuffer> buffer (new FractureReadBuffer(bufferpool, inputs[i], bufferedPages, tupleSize, partition.begins[i], partition.ends[i]));
+      bufferPtrs.push_back (buffer);
+      buffers.push_back (buffer.get());
+      finished.push_back (!buffer->hasCurrent());
+    }
+
+    ScopedMemoryForIO buffer(writeBufferPages * FDB_PAGE_SIZE, FDB_DIRECT_IO_ALIGNMENT, FDB_USE_DIRECT_IO);
+    FBTreeWriter writer (output, type, reinterpret_cast<char*>(buffer.get()), writeBufferPages, totalTuples, toKeySize(type), tupleSize, partition.firstTuple);
+    FLoserTree<CurrentTupleLess<COMPARE, FractureReadBuffer> > tree (finished, CurrentTupleLess<COMPARE, FractureReadBuffer> (type, buffers));
+    for (int i = tree.top(); i >= 0; i = tree.top()) {
+      writer.addTuple(buffers[i]->getCurrent());
+      if (writer.currentTuple % 1000000 == 0) {
+        VLOG (1) << "writing " << writer.currentTuple << "...";
+      }
+      tree.pop (buffers[i]->next ());
+    }
+    assert (writer.currentTuple == partition.firstTuple + partitionTuples);
+    writer.finishLeafPages();
+    partition.pageSignatures.swap (writer.pageSignatures);
+  }
+};
+struct ParallelBTreeMergeWorker {
+  ParallelBTreeMergeWorker (ParallelBTreeMerge *merge_) : merge(merge_) {}
+  void operator() () { merge->run(); }
+  ParallelBTreeMerge *merge;
+};
+
+std::string FFamilyImpl::mergeBTreeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize, int threads) {
   StopWatch watch;
   watch.init();
 
-  // this method implements a simple sort-merge
+  // this method implements a sort-merge with a loser tree, split into key ranges merged in parallel.
   const size_t fractureCount = fractureNames.size();
   int totalBufferedPages = mergeBufferSize / FDB_PAGE_SIZE;
   LOG (INFO) << "mergeBTreeFractures() start. merging " << fractureCount << " fractures into one with " << totalBufferedPages << " buffer pages...";
@@ -192,13 +1103,13 @@ std::string FFamilyImpl::mergeBTreeFractures (FEngine *engine, const std::vector
   // we have to pay disk seek costs for every page. it'd be too slow.
   // instead, we buffer a large number of pages to read sequentially.
   int tupleSize = toDataSize(_type);
+  const int64_t tuplesPerPage = (FDB_PAGE_SIZE - sizeof (FPageHeader)) / tupleSize;
 
   FSignatureSet &signatures = engine->getSignatureSet();
-  std::vector<boost::shared_ptr<FractureReadBuffer> > bufferPtrs; // to keep the objects
-  std::vector<FractureReadBuffer*> buffers;
-  std::vector<bool> finished;
-  size_t finishedFractures = 0;
+  boost::recursive_mutex::scoped_lock catalogLock (engine->getCatalogMutex());
+  std::vector<FFileSignature> inputs;
   int64_t grandTotalTupleCount = 0; // divide buffers based on size of fracture
+  int totalLeafPages = 0;
   for (size_t i = 0; i < fractureCount; ++i) {
     // check the given fractureNames exists in the family
     bool found = std::find (_fractures.begin(), _fractures.end(), fractureNames[i]) != _fractures.end();
@@ -206,23 +1117,20 @@ std::string FFamilyImpl::mergeBTreeFractures (FEngine *engine, const std::vector
       LOG (ERROR) << "The fracture '" << fractureNames[i] << "'doesn't exist in the family " << _name;
     }
     const FFileSignature &signature = signatures.getFileSignature (fractureNames[i]);
+    inputs.push_back (signature);
     grandTotalTupleCount += signature.totalTupleCount;
+    totalLeafPages += signature.leafPageCount;
   }
   assert (grandTotalTupleCount > 0);
-  for (size_t i = 0; i < fractureCount; ++i) {
-    const FFileSignature &signature = signatures.getFileSignature (fractureNames[i]);
-    int bufferedPages = (int) ((double) totalBufferedPages * signature.totalTupleCount / grandTotalTupleCount / 2);
-    if (bufferedPages == 0) bufferedPages = 1;
-    boost::shared_ptr<FractureReadBuffer> buffer (new FractureReadBuffer(engine->getBufferPool(), signature, bufferedPages, tupleSize));
-    bufferPtrs.push_back (buffer);
-    buffers.push_back (buffer.get());
-    if (buffer->hasCurrent()) {
-      finished.push_back (false);
-    } else {
-      finished.push_back (true);
-      ++finishedFractures;
-    }
+
+  if (threads <= 0) {
+    threads = FDB_MERGE_THREADS > 0 ? FDB_MERGE_THREADS : std::max<int> (1, boost::thread::hardware_concurrency());
+    threads = std::max (1, std::min (threads, totalLeafPages / FDB_MERGE_MIN_PARTITION_PAGES));
   }
+  std::vector<BTreeMergePartition> partitions;
+  splitBTreeMerge (engine->getBufferPool(), inputs, _type, tupleSize, threads, partitions);
+  threads = partitions.size();
+  LOG (INFO) << "merging " << partitions.size() << " key ranges in parallel";
 
   // okay, start merging leaf pages
   const std::string &folder = engine->getDataFolder();
@@ -234,47 +1142,42 @@ std::string FFamilyImpl::mergeBTreeFractures (FEngine *engine, const std::vector
     FFileSignature signature;
     signature.fileId = signatures.issueNextFileId();
     signature.setFilepath(filepath);
-    int outputBufferPages = totalBufferedPages / 2;
-    if (outputBufferPages == 0) outputBufferPages = 1;
-    ScopedMemoryForIO buffer(outputBufferPages * FDB_PAGE_SIZE, FDB_DIRECT_IO_ALIGNMENT, FDB_USE_DIRECT_IO);
-    FBTreeWriter writer (signature, _type, reinterpret_cast<char*>(buffer.get()), outputBufferPages, grandTotalTupleCount, toKeySize(_type), tupleSize);
-  
-    DataDataCompareFunc func = toDataDataCompareFunc(_type);
-    while (finishedFractures < fractureCount) {
-      const char *minTuple = NULL;
-      int minTupleIndex = -1;
-      for (size_t i = 0; i < fractureCount; ++i) {
-        if (finished[i]) continue;
-        const char *tuple = buffers[i]->getCurrent();
-        if (minTuple == NULL || func(tuple, minTuple) < 0) {
-          minTuple = tuple;
-          minTupleIndex = i;
-        }
-      }
-      assert (minTuple);
-      assert (minTupleIndex >= 0);
-      writer.addTuple(minTuple);
-      if (writer.currentTuple % 1000000 == 0) {
-        VLOG (1) << "writing " << writer.currentTuple << "...";
-      }
-      bool hasNext = buffers[minTupleIndex]->next ();
-      if (!hasNext) {
-        finished[minTupleIndex] = true;
-        ++finishedFractures;
+    if (std::remove(filepath.c_str()) == 0) {
+      LOG(INFO) << "deleted existing file " << filepath << ".";
+    }
+    catalogLock.unlock(); // the input files are not modified by others
+    // half of the buffer for reading, the other half for writing. divided by threads
+    int readBufferPages = std::max (1, totalBufferedPages / 2 / threads);
+    int outputBufferPages = std::max (1, totalBufferedPages / 2 / threads);
+    ParallelBTreeMerge merge (engine->getBufferPool(), inputs, signature, _type, grandTotalTupleCount, partitions, readBufferPages, outputBufferPages);
+    if (threads == 1) {
+      merge.run();
+    } else {
+      boost::thread_group group;
+      for (int i = 0; i < threads; ++i) {
+        group.create_thread (ParallelBTreeMergeWorker(&merge));
       }
+      group.join_all();
+    }
+    if (merge.failed) {
+      LOG(ERROR) << "failed to merge fractures";
+      throw std::exception();
+    }
+
+    // non-leaf pages follow the leaf pages of all partitions
+    ScopedMemoryForIO buffer(outputBufferPages * FDB_PAGE_SIZE, FDB_DIRECT_IO_ALIGNMENT, FDB_USE_DIRECT_IO);
+    const int64_t leafPages = (grandTotalTupleCount + tuplesPerPage - 1) / tuplesPerPage;
+    FBTreeWriter writer (signature, _type, reinterpret_cast<char*>(buffer.get()), outputBufferPages, grandTotalTupleCount, toKeySize(_type), tupleSize, leafPages * tuplesPerPage);
+    for (size_t p = 0; p < partitions.size(); ++p) {
+      writer.pageSignatures.insert (writer.pageSignatures.end(), partitions[p].pageSignatures.begin(), partitions[p].pageSignatures.end());
     }
     writer.finishWriting();
+    catalogLock.lock();
     signatures.addFileSignature(writer.signature);
-    addOnDiskFracture(signature.getFilepath());
+    // the old files are deleted when no snapshot holds them
+    replaceMergedFractures (fractureNames, signature.getFilepath(), deleteOldFractures);
     for (size_t i = 0; i < fractureCount; ++i) {
       signatures.removeFileSignature(fractureNames[i]);
-      std::vector<std::string>::iterator iter = std::find (_fractures.begin(), _fractures.end(), fractureNames[i]);
-      _fractures.erase (iter);
-      if (deleteOldFractures) {
-        if (std::remove((fractureNames[i]).c_str()) == 0) {
-          LOG(INFO) << "deleted existing file " << (fractureNames[i]) << ".";
-        }
-      }
     }
   }
 
@@ -288,10 +1191,12 @@ std::string FFamilyImpl::mergeBTreeFractures (FEngine *engine, const std::vector
 // FractureReadBuffer wrapper for column-specific reading
 struct FractureReadBufferColumn {
 public:
-  FractureReadBufferColumn (const FCStoreColumn &column, FBufferPool *bufferpool, const FFileSignature &signature, int bufferSize)
-    : _column(column), _impl(new FractureReadBuffer (bufferpool, signature, bufferSize, 0)), _bufferSize(bufferSize) {
+  // valueOffset is the byte offset of the first value in each leaf page.
+  // it differs from sizeof(FPageHeader) only for a member of a column group.
+  FractureReadBufferColumn (const FCStoreColumn &column, FBufferPool *bufferpool, const FFileSignature &signature, int bufferSize, int valueOffset)
+    : _column(column), _impl(new FractureReadBuffer (bufferpool, signature, bufferSize, 0)), _bufferSize(bufferSize), _valueOffset(valueOffset) {
     _dictionary = NULL;
-    _currentCursor = (_impl->_buffer) + sizeof(FPageHeader);
+    _currentCursor = (_impl->_buffer) + _valueOffset;
 
     if (column.compression == DICTIONARY_COMPRESSED) {
       _dictionary = new std::vector<std::string>();
@@ -322,6 +1227,12 @@ public:
       retrieveCurrentDictionaryValue ();
     } else if (column.compression == RLE_COMPRESSED) {
       retrieveRLEValue ();
+    } else if (column.compression == SYMBOL_COMPRESSED) {
+      // the page right after leaf pages
+      const char *page = bufferpool->readPage(signature, signature.leafPageCount);
+      _symbolTable.deserialize (page + sizeof (FPageHeader), reinterpret_cast<const FPageHeader*> (page)->count);
+      _decodedValue.resize (column.maxLength);
+      retrieveSymbolValue ();
     } else {
       assert (column.compression == UNCOMPRESSED);
       retrieveUncompressedValue();
@@ -332,8 +1243,10 @@ public:
     if (_dictionary != NULL) delete _dictionary;
   }
   void retrieveCurrentDictionaryValue () {
-    uint16_t index;
-    if (_dictionaryBits == 16) {
+    uint32_t index;
+    if (_dictionaryBits == 32) {
+      index = *reinterpret_cast<const uint32_t*>(_currentCursor);
+    } else if (_dictionaryBits == 16) {
       index = *reinterpret_cast<const uint16_t*>(_currentCursor);
     } else if (_dictionaryBits == 8) {
       index = *reinterpret_cast<const uint8_t*>(_currentCursor);
@@ -343,6 +1256,7 @@ public:
       index = (packedByte >> _currentBitOffset) & _mask;
     }
     assert (index < _dictionary->size());
+    _currentCode = index;
     _currentValue = (*_dictionary)[index].data();
   }
   void retrieveRLEValue () {
@@ -353,6 +1267,15 @@ public:
   void retrieveUncompressedValue () {
     _currentValue = _currentCursor;
   }
+  void retrieveSymbolValue () {
+    // end offsets of values are at the end of the page
+    const char *page = _impl->_buffer + FDB_PAGE_SIZE * _impl->_currentPageInBuffer;
+    const uint16_t *endOffsets = reinterpret_cast<const uint16_t*>(page + FDB_PAGE_SIZE);
+    const char *end = page + endOffsets[-_impl->_currentTupleInPage - 1];
+    _symbolTable.decode (reinterpret_cast<const unsigned char*>(_currentCursor), end - _currentCursor, &(_decodedValue[0]), _column.maxLength);
+    _currentValue = &(_decodedValue[0]);
+    _currentCursor = end; // beginning of the next value
+  }
   void retrieveNextValueInPage() {
     if (_column.compression == DICTIONARY_COMPRESSED) {
       _currentBitOffset += _dictionaryBits;
@@ -362,6 +1285,9 @@ public:
         ++(_impl->_currentTupleInPage);
       }
       retrieveCurrentDictionaryValue ();
+    } else if (_column.compression == SYMBOL_COMPRESSED) {
+      ++(_impl->_currentTupleInPage);
+      retrieveSymbolValue ();
     } else if (_column.compression == RLE_COMPRESSED) {
       --_currentRemainingRunCount;
       if (_currentRemainingRunCount <= 0) {
@@ -376,26 +1302,37 @@ public:
       retrieveUncompressedValue();
     }
   }
+  bool hasNextValueInPage () const {
+    if (_column.compression == SYMBOL_COMPRESSED) {
+      // _currentTupleInPage is the index of the current value
+      return _impl->_currentTupleInPage + 1 < _impl->_currentTupleCountInPage;
+    }
+    return _impl->_currentTupleInPage < _impl->_currentTupleCountInPage;
+  }
   // this method assumes there is at least one tuple to be read.
   void next () {
     // Note that in RLE, _currentTupleCountInPage is the number of runs, not tuples.
-    if (_impl->_currentTupleInPage < _impl->_currentTupleCountInPage) {
+    if (hasNextValueInPage ()) {
       retrieveNextValueInPage ();
       return;
     }
     ++(_impl->_currentPageInBuffer);
     _impl->_currentTupleInPage = 0;
-    if (_impl->_currentPageInBuffer < _impl->_currentPageCountInBuffer) {
-      _currentCursor = _impl->_buffer + FDB_PAGE_SIZE * _impl->_currentPageInBuffer + sizeof (FPageHeader);
-    } else {
+    if (_impl->_currentPageInBuffer >= _impl->_currentPageCountInBuffer) {
       _impl->readBulk ();
       assert (_impl->_currentPageInBuffer < _impl->_currentPageCountInBuffer);
     }
+    // the count varies in RLE/Symbol pages
+    const char *page = _impl->_buffer + FDB_PAGE_SIZE * _impl->_currentPageInBuffer;
+    _impl->_currentTupleCountInPage = reinterpret_cast<const FPageHeader*> (page)->count;
+    _currentCursor = page + _valueOffset;
     if (_column.compression == DICTIONARY_COMPRESSED) {
       _currentBitOffset = 0;
       retrieveCurrentDictionaryValue ();
     } else if (_column.compression == RLE_COMPRESSED) {
       retrieveRLEValue ();
+    } else if (_column.compression == SYMBOL_COMPRESSED) {
+      retrieveSymbolValue ();
     } else {
       retrieveUncompressedValue();
     }
@@ -404,6 +1341,7 @@ public:
   FCStoreColumn _column;
   FractureReadBuffer *_impl;
   int _bufferSize;
+  int _valueOffset;
 
   const char *_currentValue;
   const char *_currentCursor;
@@ -416,6 +1354,11 @@ public:
   int _dictionaryBits;
   unsigned char _mask;
   int _currentBitOffset; // for 1bit-4bit dictionary
+  uint32_t _currentCode; // dictionary code of _currentValue
+
+  // for Symbol Compression
+  FSymbolTable _symbolTable;
+  std::vector<char> _decodedValue;
 
 private:
   FractureReadBufferColumn (const FractureReadBufferColumn&);
@@ -448,13 +1391,21 @@ public:
     for (size_t i = 0; i < _signatures.size(); ++i) {
       int columnBufferSize = bufferSize * _signatures[i].pageCount / sumPageCount;
       if (columnBufferSize == 0) columnBufferSize = 1;
-      _readBuffers.push_back (new FractureReadBufferColumn(_columns[i], _bufferpool, _signatures[i], columnBufferSize));
+      int entriesPerPage, valueOffset = sizeof(FPageHeader);
+      if (_columns[i].compression == UNCOMPRESSED) {
+        // each member of a column group reads the group file separately
+        FCStoreUtil::getColumnGroupLayout (_columns, i, entriesPerPage, valueOffset);
+      }
+      _readBuffers.push_back (new FractureReadBufferColumn(_columns[i], _bufferpool, _signatures[i], columnBufferSize, valueOffset));
     }
 
     for (size_t i = 0; i < _columnCount; ++i) {
       ::memcpy (_currentTuple + _columns[i].offset, _readBuffers[i]->_currentValue, _columns[i].maxLength);
     }
   }
+  const char* getCurrent () const {
+    return _currentTuple;
+  }
   bool next () {
     ++_current;
     if (_current >= _totalTupleCount) return false;
@@ -490,32 +1441,81 @@ public:
     ::memset (_buffer, 0, bufferSize * FDB_PAGE_SIZE);
     _writer = new FCStoreWriter(_signature.fileId, fd, _buffer, bufferSize, column, totalTupleCount);
     if (column.compression == DICTIONARY_COMPRESSED) {
-      // create a new merged dictionary
-      for (size_t i = 0; i < readers.size(); ++i) {
-        FractureReadBufferColumn *reader = readers[i]->_readBuffers[columnIndex];
-        assert (reader->_dictionary != NULL);
-        _mergedSortedSet.insert (reader->_dictionary->begin(), reader->_dictionary->end());
+      mergeDictionaries (readers);
+    } else if (column.compression == SYMBOL_COMPRESSED) {
+      // reuse the symbol table of the largest fracture. values are re-encoded with it.
+      size_t largest = 0;
+      for (size_t i = 1; i < readers.size(); ++i) {
+        if (readers[i]->_totalTupleCount > readers[largest]->_totalTupleCount) largest = i;
       }
-      assert (_mergedSortedSet.size() < (1 << 16));
-      _writer->dictionarySize = _mergedSortedSet.size();
-      _writer->dictionaryHashmap = new StringHashMap<uint16_t>(column.maxLength, 16);
-      std::set<std::string>::const_iterator iter = _mergedSortedSet.begin();
-      for (size_t i = 0; i < _mergedSortedSet.size(); ++i) {
-        assert (iter != _mergedSortedSet.end());
-        const char *data = iter->data();
-        _writer->dictionaryHashmap->insert(data, i);
-        _writer->dictionaryEntries.push_back (data);
-        ++iter;
-      }
-      _writer->determineDictionaryBits();
+      assert (readers.size() > 0);
+      _writer->symbolTable = readers[largest]->_readBuffers[columnIndex]->_symbolTable;
     }
   }
   ~FractureWriteBufferColumn () {
     DirectFileStream::deallocateMemoryForIO(FDB_USE_DIRECT_IO, _buffer);
     delete _writer;
   }
-  inline void write (const char* value) {
-    _writer->addValue(value);
+  // writes the current value of the reader (readerIndex-th fracture).
+  inline void write (size_t readerIndex, const FractureReadBufferColumn &reader) {
+    if (_column.compression == DICTIONARY_COMPRESSED) {
+      // no hashing. just translate the code.
+      assert (readerIndex < _codeRemaps.size());
+      assert (reader._currentCode < _codeRemaps[readerIndex].size());
+      _writer->addDictionaryCode(_codeRemaps[readerIndex][reader._currentCode]);
+    } else {
+      _writer->addValue(reader._currentValue);
+    }
+  }
+  // writes values of all members of the column group from the current tuple.
+  inline void writeColumnGroup (const char *tuple) {
+    _writer->addTupleColumnGroup(tuple);
+  }
+  // merges the sorted dictionaries of all fractures into one sorted dictionary,
+  // recording the new code of each old code in _codeRemaps.
+  void mergeDictionaries (const std::vector<CStoreReadBuffer*> &readers) {
+    std::vector<const std::vector<std::string>*> dictionaries;
+    size_t totalEntries = 0;
+    for (size_t i = 0; i < readers.size(); ++i) {
+      FractureReadBufferColumn *reader = readers[i]->_readBuffers[_columnIndex];
+      assert (reader->_dictionary != NULL);
+      dictionaries.push_back (reader->_dictionary);
+      totalEntries += reader->_dictionary->size();
+    }
+    // k-way merge. the number of fractures is small, so simply compare the heads.
+    _mergedEntries.reserve (totalEntries); // dictionaryEntries points to them. no reallocation allowed.
+    _codeRemaps.resize (dictionaries.size());
+    std::vector<size_t> heads (dictionaries.size(), 0);
+    for (size_t i = 0; i < dictionaries.size(); ++i) {
+      _codeRemaps[i].resize (dictionaries[i]->size());
+    }
+    while (true) {
+      int minIndex = -1;
+      for (size_t i = 0; i < dictionaries.size(); ++i) {
+        if (heads[i] >= dictionaries[i]->size()) continue;
+        if (minIndex < 0 || compareColumnValues (_column, (*dictionaries[i])[heads[i]].data(), (*dictionaries[minIndex])[heads[minIndex]].data()) < 0) {
+          minIndex = i;
+        }
+      }
+      if (minIndex < 0) break;
+      const std::string &entry = (*dictionaries[minIndex])[heads[minIndex]];
+      if (_mergedEntries.empty() || compareColumnValues (_column, _mergedEntries.back().data(), entry.data()) != 0) {
+        assert (_mergedEntries.empty() || compareColumnValues (_column, _mergedEntries.back().data(), entry.data()) < 0);
+        _mergedEntries.push_back (entry);
+      }
+      _codeRemaps[minIndex][heads[minIndex]] = _mergedEntries.size() - 1;
+      ++heads[minIndex];
+    }
+    if (_mergedEntries.size() > (size_t) FDB_DICTIONARY_MAX_ENTRIES) {
+      LOG(ERROR) << "merged dictionary has " << _mergedEntries.size() << " entries. too many for dictionary encoding. column=" << _column.name;
+      assert (false);
+      throw std::exception();
+    }
+    _writer->dictionarySize = _mergedEntries.size();
+    for (size_t i = 0; i < _mergedEntries.size(); ++i) {
+      _writer->dictionaryEntries.push_back (_mergedEntries[i].data());
+    }
+    _writer->determineDictionaryBits();
   }
   void flushClose (TableType type, FSignatureSet &signatureSet) {
     _writer->finishWriting();
@@ -533,7 +1533,8 @@ public:
   int _bufferSize;
 
   // for Dictionary Encoding
-  std::set<std::string> _mergedSortedSet; // to keep entity of strings
+  std::vector<std::string> _mergedEntries; // to keep entity of strings
+  std::vector<std::vector<uint32_t> > _codeRemaps; // [fracture][old code] = new code
   FCStoreWriter *_writer;
 
 private:
@@ -560,6 +1561,11 @@ public:
     }
 
     for (size_t i = 0; i < signatures.size(); ++i) {
+      if (FCStoreUtil::getColumnGroupOf(columns, i)[0] != i) {
+        // a later member of a column group. the leading column writes the group file.
+        _writeBuffers.push_back (NULL);
+        continue;
+      }
       int columnBufferSize = (int) ((double) bufferSize * columnPageCounts[i] / grandTotalPageCount);
       if (columnBufferSize == 0) columnBufferSize = 1;
       std::string filepath (signatures[i].getFilepath());
@@ -568,7 +1574,13 @@ public:
       }
       boost::shared_ptr<DirectFileOutputStream> fd(new DirectFileOutputStream(filepath, FDB_USE_DIRECT_IO));
       _fds.push_back (fd);
-      _writeBuffers.push_back (new FractureWriteBufferColumn(signatures[i], columns[i], fd.get(), columnBufferSize, readers, i, totalTupleCount));
+      if (columns[i].group.empty()) {
+        _writeBuffers.push_back (new FractureWriteBufferColumn(signatures[i], columns[i], fd.get(), columnBufferSize, readers, i, totalTupleCount));
+      } else {
+        FractureWriteBufferColumn *buffer = new FractureWriteBufferColumn(signatures[i], FCStoreUtil::toColumnGroupFileColumn(columns, i), fd.get(), columnBufferSize, readers, i, totalTupleCount);
+        buffer->_writer->setColumnGroup (columns, i);
+        _writeBuffers.push_back (buffer);
+      }
     }
   }
   ~CStoreWriteBuffer () {
@@ -577,14 +1589,21 @@ public:
     }
     _writeBuffers.clear();
   }
-  void write (const char* tuple) {
+  // writes the current tuple of the reader (readerIndex-th fracture).
+  void write (size_t readerIndex, const CStoreReadBuffer &reader) {
     for (size_t i = 0; i < _columns.size(); ++i) {
-      _writeBuffers[i]->write (tuple + _columns[i].offset);
+      if (_writeBuffers[i] == NULL) continue;
+      if (_columns[i].group.empty()) {
+        _writeBuffers[i]->write (readerIndex, *reader._readBuffers[i]);
+      } else {
+        _writeBuffers[i]->writeColumnGroup (reader._currentTuple);
+      }
     }
     ++_totalTuplesWritten;
   }
   void flushClose (TableType type) {
     for (size_t i = 0; i < _columns.size(); ++i) {
+      if (_writeBuffers[i] == NULL) continue;
       _writeBuffers[i]->flushClose(type, _engine->getSignatureSet());
     }
   }
@@ -601,6 +1620,22 @@ private:
 
 
 
+// merges all tuples of the fractures in the order of the table type.
+// unlike BTree fractures, this is not split into partitions merged in parallel, because
+// the pages of compressed columns (RLE runs, symbol-encoded values) can't be cut at positions
+// known before writing them.
+template <typename COMPARE>
+void mergeCStoreTuples (TableType type, const std::vector<CStoreReadBuffer*> &readBuffers, const std::vector<bool> &finished, CStoreWriteBuffer &writeBuffer) {
+  FLoserTree<CurrentTupleLess<COMPARE, CStoreReadBuffer> > tree (finished, CurrentTupleLess<COMPARE, CStoreReadBuffer> (type, readBuffers));
+  for (int i = tree.top(); i >= 0; i = tree.top()) {
+    writeBuffer.write(i, *readBuffers[i]);
+    if (writeBuffer._totalTuplesWritten % 1000000 == 0) {
+      VLOG (1) << "writing " << writeBuffer._totalTuplesWritten << "...";
+    }
+    tree.pop (readBuffers[i]->next ());
+  }
+}
+
 std::string FFamilyImpl::mergeCStoreFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize) {
   StopWatch watch;
   watch.init();
@@ -616,11 +1651,11 @@ std::string FFamilyImpl::mergeCStoreFractures (FEngine *engine, const std::vecto
   int tupleSize = toDataSize(_type);
 
   // divide buffers based on each fracture's tuple count
+  boost::recursive_mutex::scoped_lock catalogLock (engine->getCatalogMutex());
   std::vector<boost::shared_ptr<CStoreReadBuffer> > readBufferPtrs;
   std::vector<CStoreReadBuffer*> readBuffers;
   int64_t grandTotalTupleCount = 0;
   std::vector<bool> finished;
-  size_t finishedFractures = 0;
   for (size_t i = 0; i < fractureCount; ++i) {
     boost::shared_ptr<CStoreReadBuffer> ptr(new CStoreReadBuffer(engine, columns, fractureNames[i], tupleSize));
     readBufferPtrs.push_back (ptr);
@@ -632,12 +1667,7 @@ std::string FFamilyImpl::mergeCStoreFractures (FEngine *engine, const std::vecto
     int bufferedPages = (int) ((double) totalBufferedPages * readBuffers[i]->_totalTupleCount / grandTotalTupleCount / 2);
     if (bufferedPages == 0) bufferedPages = 1;
     readBuffers[i]->assignBuffers (bufferedPages);
-    if (readBuffers[i]->_totalTupleCount > 0) {
-      finished.push_back (false);
-    } else {
-      finished.push_back (true);
-      ++finishedFractures;
-    }
+    finished.push_back (readBuffers[i]->_totalTupleCount == 0);
   }
 
   std::stringstream str;
@@ -645,50 +1675,33 @@ std::string FFamilyImpl::mergeCStoreFractures (FEngine *engine, const std::vecto
   std::string fracture = str.str();
   {
     CStoreWriteBuffer writeBuffer (engine, _type, columns, fracture, readBuffers, grandTotalTupleCount, totalBufferedPages / 2);
+    catalogLock.unlock(); // the input files are not modified by others
   
     // sort-merge
-    DataDataCompareFunc func = toDataDataCompareFunc(_type);
-    while (finishedFractures < fractureCount) {
-      const char *minTuple = NULL;
-      int minTupleIndex = -1;
-      for (size_t i = 0; i < fractureCount; ++i) {
-        if (finished[i]) continue;
-        const char *tuple = readBuffers[i]->_currentTuple;
-        if (minTuple == NULL || func(tuple, minTuple) < 0) {
-          minTuple = tuple;
-          minTupleIndex = i;
-        }
-      }
-      assert (minTuple);
-      assert (minTupleIndex >= 0);
-      writeBuffer.write(minTuple);
-      if (writeBuffer._totalTuplesWritten % 1000000 == 0) {
-        VLOG (1) << "writing " << writeBuffer._totalTuplesWritten << "...";
-      }
-  
-      bool hasNext = readBuffers[minTupleIndex]->next ();
-      if (!hasNext) {
-        finished[minTupleIndex] = true;
-        ++finishedFractures;
-      }
+    switch (_type) {
+    case LINEORDER_PK_SORT:
+      mergeCStoreTuples<LineorderTupleCompare> (_type, readBuffers, finished, writeBuffer);
+      break;
+    case MV_PROJECTION:
+      mergeCStoreTuples<MVProjectionTupleCompare> (_type, readBuffers, finished, writeBuffer);
+      break;
+    default:
+      mergeCStoreTuples<GenericTupleCompare> (_type, readBuffers, finished, writeBuffer);
     }
+    catalogLock.lock();
     writeBuffer.flushClose(_type);
     assert (writeBuffer._totalTuplesWritten == grandTotalTupleCount);
   }
 
-  addOnDiskFracture(fracture);
+  // the old files are deleted when no snapshot holds them
+  replaceMergedFractures (fractureNames, fracture, deleteOldFractures);
   for (size_t i = 0; i < fractureCount; ++i) {
-    std::vector<std::string>::iterator iter = std::find (_fractures.begin(), _fractures.end(), fractureNames[i]);
-    _fractures.erase (iter);
-
     std::vector<FFileSignature> colsigs = engine->getSignatureSet().getCStoreFileSignatures(engine->getDataFolder(), columns, fractureNames[i]);
     for (size_t j = 0; j < colsigs.size(); ++j) {
-      engine->getSignatureSet().removeFileSignature(colsigs[j].getFilepath());
-      if (deleteOldFractures) {
-        if (std::remove(colsigs[j].getFilepath().c_str()) == 0) {
-          LOG(INFO) << "deleted existing file " << colsigs[j].getFilepath() << ".";
-        }
+      if (FCStoreUtil::getColumnGroupOf(columns, j)[0] != j) {
+        continue; // a later member of a column group. the file is already removed.
       }
+      engine->getSignatureSet().removeFileSignature(colsigs[j].getFilepath());
     }
   }
 
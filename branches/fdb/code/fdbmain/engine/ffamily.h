@@ -2,30 +2,119 @@
 #define ENGINE_FFAMILY_H
 
 #include "../configvalues.h"
+#include "../storage/ffilesig.h"
 #include <vector>
 #include <string>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 namespace fdb {
 // the class that represents a family of fractures.
 // a family consists of versions of fractures which might be on-disk file (up to any number)
 // or a on-memory table (up to one, and always the latest).
 
+// an on-disk fracture, shared by the family and its snapshots.
+// files of a retired fracture (merged or erased) are deleted when the last holder releases it,
+// so a query holding a snapshot keeps reading them while a merge replaces them.
+class FFractureFile {
+public:
+  FFractureFile (const std::string &name, const std::vector<FFileSignature> &signatures);
+  ~FFractureFile (); // deletes the files if retired with deleteFiles
+
+  const std::string& getName () const { return _name; }
+  // the signature of the BTree file, or those of the columns for c-store
+  // (see FSignatureSet::getCStoreFileSignatures()). valid even after the signatures
+  // are removed from FSignatureSet, so readers of a snapshot open files with these.
+  const std::vector<FFileSignature>& getSignatures () const { return _signatures; }
+  // called when the family un-registers this fracture.
+  void retire (bool deleteFiles) { _deleteFiles = deleteFiles; }
+
+private:
+  std::string _name;
+  std::vector<FFileSignature> _signatures;
+  bool _deleteFiles;
+
+  FFractureFile (const FFractureFile&); // prohibit copying
+};
+
+class FMainMemoryBTree;
+class FMainMemoryCStore;
+
+// an on-memory fracture sealed by the automatic flush (see FFamily::startIngest()), shared by
+// the family and its snapshots until it's dumped and no snapshot holds it.
+// no tuple is inserted after sealed, but the dumper sorts it in place (finishInserts()),
+// so readers lock getMutex() shared while reading it.
+class FSealedFracture {
+public:
+  FSealedFracture (const boost::shared_ptr<FMainMemoryBTree> &btree, const boost::shared_ptr<FMainMemoryCStore> &cstore)
+    : _btree(btree), _cstore(cstore) {}
+
+  FMainMemoryBTree* getBTree () const { return _btree.get(); } // NULL for c-store families
+  FMainMemoryCStore* getCStore () const { return _cstore.get(); } // NULL for BTree families
+  boost::shared_mutex& getMutex () const { return _mutex; }
+
+private:
+  boost::shared_ptr<FMainMemoryBTree> _btree;
+  boost::shared_ptr<FMainMemoryCStore> _cstore;
+  mutable boost::shared_mutex _mutex;
+
+  FSealedFracture (const FSealedFracture&); // prohibit copying
+};
+
+// an immutable version of the fractures of a family.
+// a query acquires the latest snapshot at its beginning and reads only its fractures,
+// regardless of merges, dumps and new fractures after that.
+// every tuple is in exactly one of the on-disk, sealed and current fractures of a snapshot.
+struct FFractureSnapshot {
+  FFractureSnapshot () : version(0) {}
+  int64_t version; // incremented whenever fractures are added or removed, or the current fracture changes
+  std::vector<boost::shared_ptr<FFractureFile> > fractures; // on-disk fractures. oldest first
+  std::vector<boost::shared_ptr<FSealedFracture> > sealed; // sealed fractures not dumped yet. oldest first
+  // the current fractures (see FFamily::getCurrentFracture()). empty if not set.
+  // tuples inserted after the snapshot is acquired might be seen.
+  boost::shared_ptr<FMainMemoryBTree> current;
+  boost::shared_ptr<FMainMemoryCStore> currentCStore;
+};
+typedef boost::shared_ptr<const FFractureSnapshot> FFractureSnapshotPtr;
+
+// metrics of the automatic flush of a family (see FFamily::startIngest()).
+struct FIngestStats {
+  FIngestStats () : sealedFractures(0), dumpedFractures(0), failedDumps(0), dumpedTuples(0), dumpMicros(0), stalledMicros(0), replayedTuples(0) {}
+  int64_t sealedFractures;
+  int64_t dumpedFractures;
+  int64_t failedDumps; // failed attempts. the fracture is retried
+  int64_t dumpedTuples;
+  int64_t dumpMicros; // time spent by the background thread to sort and dump
+  int64_t stalledMicros; // time inserts waited for dumps (FDB_MAX_SEALED_FRACTURES)
+  int64_t replayedTuples; // tuples recovered from write-ahead logs at startIngest()
+};
+
 class FEngine;
 class FFamilyImpl;
-class FMainMemoryBTree;
 class FFamily {
 public:
-  FFamily (const std::string &name, TableType type, bool cstore); // TODO maybe constructed from some file?
+  // signatures of on-disk fractures are resolved in the engine.
+  FFamily (FEngine *engine, const std::string &name, TableType type, bool cstore); // TODO maybe constructed from some file?
   ~FFamily ();
 
+  // returns the latest snapshot of fractures. thread-safe and never blocked by merges or dumps.
+  // files and on-memory fractures are kept until the returned pointer (and its copies) are released.
+  FFractureSnapshotPtr acquireSnapshot () const;
+
   // returns the list of name (which chould be path of data file or its prefix if c-store)
   // for on-disk read-only fractures. the result is sorted by the version (first entry=oldest).
+  // the list changes with merges. queries concurrent with merges should use acquireSnapshot().
   const std::vector<std::string>& getOnDiskFractures () const;
   // registeres a new fracture as a latest on-disk fracture.
   // this method should be called when an on-memory fracture is saved to file.
+  // while background compaction runs, call this with FEngine::getCatalogMutex() locked.
   void addOnDiskFracture (const std::string &name);
   // un-registers a fracture. this method should be called when a fracture is merged and deleted 
-  bool eraseOnDiskFracture(const std::string &name);
+  // if deleteFiles, the files are deleted when no snapshot holds the fracture.
+  bool eraseOnDiskFracture(const std::string &name, bool deleteFiles = false);
+  // seconds since epoch when the fracture was added. a merged fracture takes the newest time of
+  // the merged ones. -1 if not found.
+  int64_t getOnDiskFractureTime (const std::string &name) const;
 
   // returns the pointer to current on-memory fracture.
   // returns NULL if current fracture is not registered yet.
@@ -33,8 +122,52 @@ public:
   // sets the current on-memory fracture.
   // if you want to clear the current fracture, pass NULL.
   // this class does not gain the ownership thus never deletes the pointer.
+  // snapshots acquired before the next call point to it too, so keep it while they are held.
   void setCurrentFracture(FMainMemoryBTree *fracture);
 
+  // same as above, but the current fracture is stored in columns.
+  // only for c-store families. queries on c-store families scan both (if set).
+  FMainMemoryCStore* getCurrentCStoreFracture();
+  void setCurrentCStoreFracture(FMainMemoryCStore *fracture);
+
+  // lets this family own the current fracture (FMainMemoryCStore for c-store families) and
+  // flush it automatically. once the current fracture reaches maxTuples tuples or maxBytes bytes
+  // (0 for no limit), it's sealed and a new empty one replaces it. a background thread sorts and
+  // dumps sealed fractures to new on-disk fractures (row-store or c-store files as the family)
+  // named <family name>.s<N> (the first N not in the catalog), and adds them to the family
+  // with FEngine::getCatalogMutex() locked. the files are written without the lock.
+  // inserts wait for the dump only when FDB_MAX_SEALED_FRACTURES fractures are waiting.
+  // a failed dump is retried after FDB_DUMP_RETRY_MS, doubled for each failure up to FDB_DUMP_RETRY_MAX_MS.
+  // meanwhile the fracture stays queryable and its log is kept. when the family is deleted, a fracture
+  // failing even after the longest wait is given up with an error (its log, if any, is replayed later).
+  // the current fracture set by setCurrentFracture() is replaced, but not deleted.
+  // if writeAheadLog, inserts are logged to <family name>.wal.<N> in the data folder (one file for
+  // each current fracture, deleted after the fracture is dumped and the signature set is saved).
+  // tuples in the logs left by a previous run (e.g., crashed) are inserted again here, except logs
+  // whose fractures are already in the signature set (the dumped files record their log names).
+  void startIngest (int64_t maxTuples, int64_t maxBytes = 0, bool sortedBuffer = false, bool writeAheadLog = false);
+  bool isIngesting () const;
+  // inserts a tuple to the current fracture. call only from one thread, after startIngest().
+  // the pointer of the current fracture changes when the fracture is sealed.
+  // with the write-ahead log, the tuple is durable after the next commit().
+  // throws once the log failed to write (see FWriteAheadLog); tuples committed before stay in the log.
+  bool insert (const void *key, const void *data);
+  // inserts count tuples (data is an array of them, keys are extracted from them) like insert().
+  // thread-safe: writers of row-store families copy and log their tuples in parallel
+  // (see FMainMemoryBTree::insertBatch()), and the writer filling the current fracture seals it
+  // while others wait. c-store families insert one writer at a time.
+  // don't call insert() or flush() concurrently with this.
+  bool insertBatch (const void *data, int64_t count);
+  // makes all inserted tuples durable with one write and fsync of the write-ahead log (group commit).
+  // the log also commits by itself every FDB_WAL_GROUP_COMMIT_BYTES. does nothing without the log.
+  // throws if the log failed.
+  void commit ();
+  // seals the current fracture (if not empty) and waits until all sealed fractures are dumped.
+  void flush ();
+  // sealed fractures not dumped yet. queries see their tuples through snapshots.
+  size_t getSealedFractureCount () const;
+  FIngestStats getIngestStats () const;
+
   const std::string& getName() const;
   TableType getTableType () const;
   bool isCStore () const;
@@ -43,9 +176,14 @@ public:
 
   // merge the given files (specified by name) of the family to one new fracture.
   // returns the name of the new fracture.
-  // @param deleteOldFractures if true, delete the old fractures from filesystem.
+  // @param deleteOldFractures if true, delete the old fractures from filesystem
+  // when no snapshot holds them.
   // @param mergeBufferSize the total size of RAM in bytes to be consumed for reading/writing fractures.
-  std::string mergeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize);
+  // @param threads the number of key ranges of a BTree family merged in parallel.
+  // 0 to decide from FDB_MERGE_THREADS and the size of fractures. c-store families are merged by one thread.
+  // the catalog is read and modified with FEngine::getCatalogMutex() locked, but not while
+  // tuples are merged, so fractures can be added to the family during a merge.
+  std::string mergeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize, int threads = 0);
 
 
   FFamilyImpl* getImpl () {return _impl; } // just for testcases
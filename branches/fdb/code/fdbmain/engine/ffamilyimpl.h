@@ -2,37 +2,119 @@
 #define ENGINE_FFAMILYIMPL_H
 
 #include "ffamily.h"
+#include "../io/fwal.h"
+#include <deque>
+#include <map>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace fdb {
 // pimpl class of FFamily.
 
+// a current fracture sealed by the automatic flush, waiting to be dumped.
+struct SealedFracture {
+  boost::shared_ptr<FSealedFracture> fracture; // also in the snapshot until dumped
+  std::string walFilepath; // the write-ahead log of the fracture. empty if not logged
+};
+
 class FFamilyImpl {
 public:
-  FFamilyImpl (const std::string &name, TableType type, bool cstore) : _name(name), _current(NULL), _type(type), _cstore(cstore), _nextFractureId(0) {}; // TODO maybe constructed from some file?
+  FFamilyImpl (FEngine *engine, const std::string &name, TableType type, bool cstore)
+    : _engine(engine), _name(name), _current(NULL), _currentCStore(NULL), _type(type), _cstore(cstore), _nextFractureId(0), _snapshot(new FFractureSnapshot()),
+    _ingesting(false), _ingestMaxTuples(0), _ingestMaxBytes(0), _ingestSortedBuffer(false), _ingestWriteAheadLog(false), _nextWalId(0), _nextSealedId(0), _dumperStopping(false) {}; // TODO maybe constructed from some file?
+  ~FFamilyImpl (); // waits for sealed fractures to be dumped
 
+  FFractureSnapshotPtr acquireSnapshot () const;
   const std::vector<std::string>& getOnDiskFractures () const;
-  void addOnDiskFracture (const std::string &name);
-  bool eraseOnDiskFracture(const std::string &name);
+  // if dumped is given, the sealed fracture is replaced with the new on-disk one at once.
+  void addOnDiskFracture (const std::string &name, const boost::shared_ptr<FSealedFracture> &dumped = boost::shared_ptr<FSealedFracture>());
+  bool eraseOnDiskFracture(const std::string &name, bool deleteFiles);
+  int64_t getOnDiskFractureTime (const std::string &name) const;
+  // registers the result of a merge, and un-registers the merged fractures.
+  void replaceMergedFractures (const std::vector<std::string> &fractureNames, const std::string &merged, bool deleteOldFractures);
+  // publishes a new version of the snapshot. the lists are copied from the current one, then modified.
+  void publishSnapshot (const std::vector<std::string> &erased, bool deleteFiles, const std::string &added,
+    const boost::shared_ptr<FSealedFracture> &dumped = boost::shared_ptr<FSealedFracture>());
+  // publishes a new version of the snapshot with the current fractures of this object.
+  // the previous current fracture is added as sealed, if given. only by the inserting thread.
+  void publishCurrent (const boost::shared_ptr<FSealedFracture> &sealed = boost::shared_ptr<FSealedFracture>());
 
   FMainMemoryBTree* getCurrentFracture();
   void setCurrentFracture(FMainMemoryBTree *fracture);
+  FMainMemoryCStore* getCurrentCStoreFracture();
+  void setCurrentCStoreFracture(FMainMemoryCStore *fracture);
   const std::string& getName() const;
   TableType getTableType () const;
   bool isCStore () const;
 
-  std::string mergeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize);
+  void startIngest (int64_t maxTuples, int64_t maxBytes, bool sortedBuffer, bool writeAheadLog);
+  bool insert (const void *key, const void *data);
+  bool insertBatch (const void *data, int64_t count);
+  void commit ();
+  void flush ();
+  size_t getSealedFractureCount () const;
+  FIngestStats getIngestStats () const;
+  // creates a new empty current fracture, and its write-ahead log if enabled.
+  // the sealed fracture (if given) replaces the previous current one in the snapshot at once.
+  void renewCurrent (const boost::shared_ptr<FSealedFracture> &sealed = boost::shared_ptr<FSealedFracture>());
+  // inserts the tuples in the write-ahead logs of a previous run (in the order of ids), then deletes the logs.
+  // the logs whose fractures were already dumped (see FFileSignature::getWalName()) must be excluded.
+  void replayLogs (const std::map<int, std::string> &logs);
+  std::string getWalFilepath (int walId) const;
+  // returns the id of the log of the given file name, -1 if it's not "<prefix><id>".
+  static int toWalId (const std::string &prefix, const std::string &walName);
+  // moves the current fracture to the queue of the dumper, waiting if the queue is full.
+  void sealCurrent ();
+  // body of the background thread dumping sealed fractures.
+  void runDumper ();
+  // sorts and dumps the sealed fracture, then adds it to the family. returns the tuple count.
+  int64_t dumpSealed (const SealedFracture &sealed);
+  // returns a file name (BTree) or a file name prefix (c-store) not used in the catalog yet,
+  // as fractures dumped by previous runs remain. with the catalog locked.
+  std::string issueSealedName ();
+
+  std::string mergeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize, int threads);
 
   // Btree version of merge implementation.
-  std::string mergeBTreeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize);
+  std::string mergeBTreeFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize, int threads);
   // CStore version of merge implementation.
   std::string mergeCStoreFractures (FEngine *engine, const std::vector<std::string> &fractureNames, bool deleteOldFractures, long long mergeBufferSize);
 
+  FEngine *_engine;
   std::vector<std::string> _fractures;
+  std::map<std::string, int64_t> _fractureTimes; // map<fracture, seconds since epoch when added>
   std::string _name;
   FMainMemoryBTree *_current;
+  FMainMemoryCStore *_currentCStore;
   TableType _type;
   bool _cstore;
   int _nextFractureId;
+
+  mutable boost::mutex _snapshotMutex; // protects _snapshot (the pointer, not the immutable object)
+  FFractureSnapshotPtr _snapshot;
+
+  // automatic flush. the current fracture is touched only by the inserting thread (or insertBatch() writers, see _currentMutex).
+  bool _ingesting;
+  int64_t _ingestMaxTuples;
+  int64_t _ingestMaxBytes;
+  bool _ingestSortedBuffer;
+  bool _ingestWriteAheadLog;
+  boost::shared_ptr<FMainMemoryBTree> _ownedCurrent;
+  boost::shared_ptr<FMainMemoryCStore> _ownedCurrentCStore;
+  boost::shared_ptr<FWriteAheadLog> _wal; // log of the current fracture. NULL if not logged
+  std::vector<char> _walRecord; // key and data of a tuple
+  // insertBatch() writers hold this shared while they insert to the current fracture and its log,
+  // and exclusively while they seal it (or insert to a c-store fracture)
+  boost::shared_mutex _currentMutex;
+  int _nextWalId;
+  int _nextSealedId; // used only by the dumper
+  mutable boost::mutex _ingestMutex; // protects the members below
+  boost::condition_variable _sealedChanged; // notified when a fracture is sealed or dumped
+  std::deque<SealedFracture> _sealed; // oldest first. the front is being dumped
+  FIngestStats _ingestStats;
+  bool _dumperStopping;
+  boost::shared_ptr<boost::thread> _dumper; // NULL if not ingesting
 };
 
 } //fdb
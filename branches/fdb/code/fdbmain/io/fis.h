@@ -69,8 +69,9 @@ public:
   DirectFileOutputStream (const std::string &name, bool direct);
   virtual ~DirectFileOutputStream () {};
 
-  int64_t write (const void *buffer, int64_t size);
-  void sync ();
+  // virtual so tests can inject failures
+  virtual int64_t write (const void *buffer, int64_t size);
+  virtual void sync ();
 };
 
 } // fdb
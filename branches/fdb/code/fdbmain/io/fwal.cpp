@@ -0,0 +1,306 @@
+#include "fwal.h"
+#include "fis.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef WIN32
+  #define NOGDI
+  #include <windows.h>
+#else //WIN32
+  #include <sys/types.h>
+  #include <dirent.h>
+#endif //WIN32
+
+#include <glog/logging.h>
+
+namespace fdb {
+
+// each record is preceded by this header.
+struct WalRecordHeader {
+  uint32_t size; // bytes of the record. 0 in zero padding (up to the next block, where the next commit starts)
+  uint32_t checksum; // of lsn, size and the record
+  int64_t lsn;
+};
+
+// FNV-1a
+inline uint32_t checksumRecord (int64_t lsn, uint32_t size, const char *record) {
+  uint32_t hash = 2166136261U;
+  const char *header[2] = {reinterpret_cast<const char*>(&lsn), reinterpret_cast<const char*>(&size)};
+  const size_t headerSizes[2] = {sizeof(lsn), sizeof(size)};
+  for (int i = 0; i < 2; ++i) {
+    for (size_t j = 0; j < headerSizes[i]; ++j) {
+      hash = (hash ^ (unsigned char) header[i][j]) * 16777619U;
+    }
+  }
+  for (uint32_t j = 0; j < size; ++j) {
+    hash = (hash ^ (unsigned char) record[j]) * 16777619U;
+  }
+  return hash;
+}
+
+const int WAL_BLOCK_SIZE = FDB_DIRECT_IO_ALIGNMENT;
+const int WAL_RECORD_ALIGNMENT = 8; // so the size of a header at the zero padding of a block is always in the block
+
+// bytes of a record in the log, including its header and padding.
+inline int walRecordBytes (uint32_t size) {
+  return ((sizeof(WalRecordHeader) + size + WAL_RECORD_ALIGNMENT - 1) / WAL_RECORD_ALIGNMENT) * WAL_RECORD_ALIGNMENT;
+}
+
+FWriteAheadLog::FWriteAheadLog (const std::string &filepath, bool direct, int bufferBytes)
+  : _filepath(filepath), _direct(direct), _bufferBytes(bufferBytes), _file(NULL),
+  _active(0), _committing(false), _failed(false), _lastLsn(0), _durableLsn(0), _commitCount(0) {
+  if (std::remove(filepath.c_str()) == 0) {
+    LOG(INFO) << "deleted existing file " << filepath << ".";
+  }
+  _file = new DirectFileOutputStream (filepath, direct);
+  init ();
+}
+
+FWriteAheadLog::FWriteAheadLog (DirectFileOutputStream *file, const std::string &filepath, bool direct, int bufferBytes)
+  : _filepath(filepath), _direct(direct), _bufferBytes(bufferBytes), _file(file),
+  _active(0), _committing(false), _failed(false), _lastLsn(0), _durableLsn(0), _commitCount(0) {
+  init ();
+}
+
+void FWriteAheadLog::init () {
+  if (_bufferBytes < 2 * WAL_BLOCK_SIZE || _bufferBytes % WAL_BLOCK_SIZE != 0) {
+    LOG(ERROR) << "the buffer of a log must be a multiple of " << WAL_BLOCK_SIZE << " bytes. bufferBytes=" << _bufferBytes;
+    delete _file;
+    assert (false);
+    throw std::exception();
+  }
+  for (int i = 0; i < 2; ++i) {
+    _buffers[i].data = reinterpret_cast<char*>(DirectFileStream::allocateMemoryForIO (_bufferBytes, FDB_DIRECT_IO_ALIGNMENT, _direct));
+    _buffers[i].fileOffset = 0;
+    _buffers[i].used = 0;
+    _buffers[i].lastLsn = 0;
+  }
+}
+
+FWriteAheadLog::~FWriteAheadLog () {
+  try {
+    commit ();
+  } catch (const std::exception &) {
+    LOG(ERROR) << "failed to commit the log " << _filepath << " on closing. records after lsn=" << _durableLsn << " are lost";
+  }
+  _file->close();
+  delete _file;
+  for (int i = 0; i < 2; ++i) {
+    DirectFileStream::deallocateMemoryForIO (_direct, _buffers[i].data);
+  }
+}
+
+int64_t FWriteAheadLog::append (const void *record, int size) {
+  assert (size > 0);
+  const int recordBytes = walRecordBytes (size);
+  if (recordBytes > _bufferBytes / 2) {
+    LOG(ERROR) << "too large record for the log " << _filepath << ". size=" << size;
+    assert (false);
+    throw std::exception();
+  }
+  boost::mutex::scoped_lock lock (_mutex);
+  checkFailed ();
+  while (_buffers[_active].used + recordBytes > _bufferBytes) {
+    if (_committing) {
+      _committed.wait (lock);
+      checkFailed ();
+    } else {
+      commitActive (lock);
+    }
+  }
+  LogBuffer &buffer = _buffers[_active];
+  WalRecordHeader header;
+  header.size = size;
+  header.lsn = ++_lastLsn;
+  header.checksum = checksumRecord (header.lsn, header.size, reinterpret_cast<const char*>(record));
+  ::memcpy (buffer.data + buffer.used, &header, sizeof(header));
+  ::memcpy (buffer.data + buffer.used + sizeof(header), record, size);
+  ::memset (buffer.data + buffer.used + sizeof(header) + size, 0, recordBytes - sizeof(header) - size);
+  buffer.used += recordBytes;
+  buffer.lastLsn = header.lsn;
+  int64_t lsn = header.lsn;
+  if (!_committing && buffer.used >= FDB_WAL_GROUP_COMMIT_BYTES) {
+    commitActive (lock);
+  }
+  return lsn;
+}
+
+void FWriteAheadLog::commit (int64_t lsn) {
+  boost::mutex::scoped_lock lock (_mutex);
+  if (lsn < 0) {
+    lsn = _lastLsn;
+  }
+  assert (lsn <= _lastLsn);
+  while (_durableLsn < lsn) {
+    checkFailed ();
+    if (_committing) {
+      _committed.wait (lock); // the running commit might cover lsn
+    } else {
+      commitActive (lock);
+    }
+  }
+}
+
+void FWriteAheadLog::checkFailed () const {
+  if (_failed) {
+    LOG(ERROR) << "the log " << _filepath << " has failed. durable up to lsn=" << _durableLsn;
+    throw std::runtime_error("the log " + _filepath + " has failed. ");
+  }
+}
+
+void FWriteAheadLog::commitActive (boost::mutex::scoped_lock &lock) {
+  assert (!_committing);
+  LogBuffer &buffer = _buffers[_active];
+  if (buffer.lastLsn <= _durableLsn) {
+    return; // nothing to commit
+  }
+  // the next buffer starts on a new block. the tail of the last block is left as padding,
+  // so a later commit never re-writes (and might tear) a block with records committed here
+  const int writeBytes = ((buffer.used + WAL_BLOCK_SIZE - 1) / WAL_BLOCK_SIZE) * WAL_BLOCK_SIZE;
+  LogBuffer &next = _buffers[1 - _active];
+  next.fileOffset = buffer.fileOffset + writeBytes;
+  next.used = 0;
+  next.lastLsn = buffer.lastLsn;
+  _active = 1 - _active;
+  _committing = true;
+  const int64_t lsn = buffer.lastLsn;
+  lock.unlock();
+
+  bool failed = false;
+  try {
+    ::memset (buffer.data + buffer.used, 0, writeBytes - buffer.used);
+    _file->setNextLocation (buffer.fileOffset);
+    _file->write (buffer.data, writeBytes);
+    _file->sync ();
+  } catch (const std::exception &) {
+    LOG(ERROR) << "failed to commit the log " << _filepath;
+    failed = true;
+  }
+
+  lock.lock();
+  _committing = false;
+  if (failed) {
+    // the next commit would start after the lost blocks, so no later record is made durable
+    _failed = true;
+  } else {
+    _durableLsn = lsn;
+    ++_commitCount;
+  }
+  _committed.notify_all();
+  checkFailed ();
+}
+
+int64_t FWriteAheadLog::getLastLsn () const {
+  boost::mutex::scoped_lock lock (_mutex);
+  return _lastLsn;
+}
+int64_t FWriteAheadLog::getDurableLsn () const {
+  boost::mutex::scoped_lock lock (_mutex);
+  return _durableLsn;
+}
+int64_t FWriteAheadLog::getCommitCount () const {
+  boost::mutex::scoped_lock lock (_mutex);
+  return _commitCount;
+}
+bool FWriteAheadLog::isFailed () const {
+  boost::mutex::scoped_lock lock (_mutex);
+  return _failed;
+}
+
+// reads the file until buffer has bytes unparsed bytes. false if the file ends before.
+inline bool fillReplayBuffer (DirectFileInputStream &file, std::vector<char> &buffer, size_t &begin, size_t &end, bool &eof, size_t bytes) {
+  while (end - begin < bytes && !eof) {
+    if (begin > 0) {
+      std::copy (buffer.begin() + begin, buffer.begin() + end, buffer.begin());
+      end -= begin;
+      begin = 0;
+    }
+    if (buffer.size() < bytes) {
+      buffer.resize (bytes);
+    }
+    int64_t readSize = file.read (&buffer[end], buffer.size() - end);
+    end += readSize;
+    eof = (readSize == 0);
+  }
+  return end - begin >= bytes;
+}
+
+int64_t FWriteAheadLog::replay (const std::string &filepath, WalReplayCallback callback, void *context) {
+  DirectFileInputStream file (filepath, false);
+  std::vector<char> buffer (1 << 20);
+  size_t begin = 0, end = 0; // unparsed bytes in buffer
+  int64_t position = 0; // file offset of buffer[begin]
+  bool eof = false;
+  int64_t count = 0;
+  while (true) {
+    WalRecordHeader header;
+    // the size first, as the zero padding might be shorter than a header at the end of the file
+    if (!fillReplayBuffer (file, buffer, begin, end, eof, sizeof(header.size))) {
+      if (end > begin) {
+        LOG(WARNING) << "the log " << filepath << " ends with a torn record. ignored.";
+      }
+      return count;
+    }
+    ::memcpy (&header.size, &buffer[begin], sizeof(header.size));
+    if (header.size == 0) {
+      // zero padding after the last record of a commit. the next commit starts on the next block
+      const size_t padding = (WAL_BLOCK_SIZE - position % WAL_BLOCK_SIZE) % WAL_BLOCK_SIZE;
+      if (padding == 0 || !fillReplayBuffer (file, buffer, begin, end, eof, padding)) {
+        return count; // no more commits
+      }
+      begin += padding;
+      position += padding;
+      continue;
+    }
+    const size_t recordBytes = walRecordBytes (header.size);
+    if (!fillReplayBuffer (file, buffer, begin, end, eof, recordBytes)) {
+      LOG(WARNING) << "the log " << filepath << " ends with a torn record. ignored.";
+      return count;
+    }
+    ::memcpy (&header, &buffer[begin], sizeof(header));
+    const char *record = &buffer[begin] + sizeof(header);
+    if (header.lsn != count + 1 || header.checksum != checksumRecord (header.lsn, header.size, record)) {
+      LOG(WARNING) << "the log " << filepath << " has a corrupted record at lsn=" << (count + 1) << ". ignored the rest.";
+      return count;
+    }
+    callback (context, record, header.size);
+    begin += recordBytes;
+    position += recordBytes;
+    ++count;
+  }
+}
+
+std::vector<std::string> FWriteAheadLog::listFiles (const std::string &folder, const std::string &prefix) {
+  std::vector<std::string> names;
+#ifdef WIN32
+  WIN32_FIND_DATAA found;
+  HANDLE handle = ::FindFirstFileA ((folder + "\\" + prefix + "*").c_str(), &found);
+  if (handle != INVALID_HANDLE_VALUE) {
+    do {
+      names.push_back (found.cFileName);
+    } while (::FindNextFileA (handle, &found) != 0);
+    ::FindClose (handle);
+  }
+#else //WIN32
+  DIR *dir = ::opendir (folder.empty() ? "." : folder.c_str());
+  if (dir == NULL) {
+    LOG(ERROR) << "could not open the folder " << folder;
+    throw std::runtime_error("could not open the folder " + folder + ". ");
+  }
+  for (struct dirent *entry = ::readdir (dir); entry != NULL; entry = ::readdir (dir)) {
+    std::string name (entry->d_name);
+    if (name.compare (0, prefix.size(), prefix) == 0) {
+      names.push_back (name);
+    }
+  }
+  ::closedir (dir);
+#endif //WIN32
+  std::sort (names.begin(), names.end());
+  return names;
+}
+
+} // fdb
@@ -0,0 +1,95 @@
+#ifndef IO_FWAL_H
+#define IO_FWAL_H
+
+#include "../configvalues.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace fdb {
+
+class DirectFileOutputStream;
+
+// called for each record while replaying a log. record is valid only in the call.
+typedef void (*WalReplayCallback) (void *context, const void *record, int size);
+
+// append-only write-ahead log file.
+// records are appended to a RAM buffer, and written and fsync-ed at commit() (group commit).
+// one commit makes all records appended before it durable with one sequential write and one
+// fsync, so callers can append many records (e.g., every insert of a batch) per commit.
+// records are written in blocks of FDB_DIRECT_IO_ALIGNMENT bytes, so the file can be written
+// with O_DIRECT. each commit starts on a new block and pads the tail of its last block with zeros,
+// so a block holding committed records is never written again, and a torn write of a commit
+// can't corrupt records made durable before it. records are aligned to 8 bytes.
+// thread-safe. while one thread writes and fsyncs, others keep appending to the other buffer
+// and wait for that commit only if their records are in it.
+// a failed write or fsync fails the log permanently: the failed blocks might be lost even if a
+// later fsync succeeds (the OS may drop the dirty pages), so no later record can be made durable
+// after them. append() and commit() throw from then on. records durable before the failure stay
+// replayable, and the caller should start a new log.
+class FWriteAheadLog {
+public:
+  // creates a new log file (an existing file is overwritten).
+  FWriteAheadLog (const std::string &filepath, bool direct = FDB_USE_DIRECT_IO, int bufferBytes = FDB_WAL_BUFFER_BYTES);
+  // writes the log to the given stream, which must be opened for filepath (e.g., to inject failures).
+  // takes the ownership of file.
+  FWriteAheadLog (DirectFileOutputStream *file, const std::string &filepath, bool direct, int bufferBytes);
+  ~FWriteAheadLog (); // commits and closes
+
+  // appends a record and returns its log sequence number (1, 2, ...).
+  // the record is not durable until commit() returns.
+  // commits by itself when FDB_WAL_GROUP_COMMIT_BYTES bytes are waiting for a commit.
+  int64_t append (const void *record, int size);
+  // makes records up to lsn durable. -1 for all appended records.
+  void commit (int64_t lsn = -1);
+
+  int64_t getLastLsn () const;
+  int64_t getDurableLsn () const;
+  int64_t getCommitCount () const; // number of fsyncs
+  bool isFailed () const; // a write or fsync failed (see above)
+  const std::string& getFilepath () const { return _filepath; }
+
+  // reads records of the log file in order and calls back for each.
+  // stops at the end of records, a torn record (partially written by a crash) or a corrupted one.
+  // returns the number of records replayed.
+  static int64_t replay (const std::string &filepath, WalReplayCallback callback, void *context);
+
+  // returns the names (not paths) of files in the folder starting with the prefix.
+  static std::vector<std::string> listFiles (const std::string &folder, const std::string &prefix);
+
+private:
+  struct LogBuffer {
+    char *data;
+    int64_t fileOffset; // file offset of data[0], aligned to blocks
+    int used; // bytes in data
+    int64_t lastLsn; // lsn of the last record in this buffer (or the previous buffer if empty)
+  };
+  void init ();
+  // writes and fsyncs the active buffer as the leader of a group commit. with _mutex locked.
+  void commitActive (boost::mutex::scoped_lock &lock);
+  // throws if the log failed. with _mutex locked.
+  void checkFailed () const;
+
+  std::string _filepath;
+  bool _direct;
+  int _bufferBytes;
+  DirectFileOutputStream *_file;
+
+  mutable boost::mutex _mutex; // protects the members below
+  boost::condition_variable _committed; // notified when a commit finishes
+  LogBuffer _buffers[2];
+  int _active; // index of the buffer records are appended to
+  bool _committing; // a leader is writing the other buffer
+  bool _failed; // a commit failed. never reset
+  int64_t _lastLsn;
+  int64_t _durableLsn;
+  int64_t _commitCount;
+
+  FWriteAheadLog (const FWriteAheadLog &); // prohibit copying
+};
+
+} // fdb
+
+#endif // IO_FWAL_H
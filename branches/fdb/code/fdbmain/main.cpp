@@ -59,7 +59,7 @@ int main(int argc, char *argv[]) {
       makeTinySSB("../../data/ssb1/", "../../data/tinyssb/", tuples);
     } else if (command == "runbench") {
       if (argc < 8) {
-        LOG(ERROR) << "Usage: fdbmain runbench <int:bufferPageCount> <flag:cstore> <flag:sortedBuffer> <int:batchCount> <int:batchSize> <int:queriesBetweenBatch>";
+        LOG(ERROR) << "Usage: fdbmain runbench <int:bufferPageCount> <flag:cstore> <flag:sortedBuffer> <int:batchCount> <int:batchSize> <int:queriesBetweenBatch> [<flag:includeFlights34>]";
         return EXIT_FAILURE;
       }
       int bufferPageCount = ::atol(argv[2]);
@@ -72,8 +72,10 @@ int main(int argc, char *argv[]) {
       assert (batchSize >= 0);
       int queriesBetweenBatch = ::atol(argv[7]);
       assert (queriesBetweenBatch >= 0);
+      // Q3.x/Q4.x are also run if true
+      bool includeFlights34 = argc >= 9 && string(argv[8]) == "true";
 
-      runSSBBench(bufferPageCount, cstore, sortedBuffer, batchCount, batchSize, queriesBetweenBatch);
+      runSSBBench(bufferPageCount, cstore, sortedBuffer, batchCount, batchSize, queriesBetweenBatch, includeFlights34);
     } else if (command == "describe") {
       if (argc < 3) {
         LOG(ERROR) << "Usage: fdbmain describe <path of signature file>";
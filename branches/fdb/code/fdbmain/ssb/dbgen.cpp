@@ -68,6 +68,10 @@ DBGen::DBGen (const string &dimensionDataFolder, size_t batchSize) : _dimensionD
 
   _lineorderBuffer = new Lineorder[_batchSize + 32]; // +32 as it might have more than _batchSize
   _mvBuffer = new MVProjection[_batchSize + 32];
+  // keys are compared with memcmp(), padding bytes included. normalize() drops
+  // the padding, so it gives up on keys with non-zero padding and the sort
+  // falls back to memcmp(). zeroed padding keeps both orders identical.
+  ::memset (static_cast<void*>(_mvBuffer), 0, sizeof(MVProjection) * (_batchSize + 32));
   LOG(INFO) << "completed initialization.";
 }
 DBGen::~DBGen() {
@@ -229,8 +229,11 @@ void loadLineorderMVAndBase(
   LOG(INFO) << "constructred main memory BTree (" << watch.getElapsed() << " micsosec for reading and constructing). writing to disk...";
   if (cstore) {
     LOG(INFO) << "cstore";
-    signatureFile.dumpToNewCStoreFiles(dataFolder, tblName, baseBtree);
-    signatureFile.dumpToNewCStoreFiles(dataFolder, "mvprojection", mvBtree);
+    // traverse each btree only once for its 17/23 columns
+    FCStoreDumpOptions options;
+    options.sharedTraversal = true;
+    signatureFile.dumpToNewCStoreFiles(dataFolder, tblName, baseBtree, options);
+    signatureFile.dumpToNewCStoreFiles(dataFolder, "mvprojection", mvBtree, options);
   } else {
     LOG(INFO) << "rowstore";
     signatureFile.dumpToNewRowStoreFile(dataFolder, tblName + ".db", baseBtree);
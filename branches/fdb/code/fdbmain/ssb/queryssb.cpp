@@ -5,19 +5,27 @@
 #include "../engine/ffamily.h"
 #include "../storage/fbtree.h"
 #include "../storage/fbufferpool.h"
+#include "../storage/fcaggregate.h"
+#include "../storage/fcbitmap.h"
+#include "../storage/fcparallel.h"
+#include "../storage/fcselection.h"
+#include "../storage/foperator.h"
 #include "../storage/fcstore.h"
 #include "../storage/ffile.h"
 #include "../storage/ffilesig.h"
 #include "../storage/searchcond.h"
 #include "../util/stopwatch.h"
 #include <stdint.h>
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <limits>
 #include <vector>
 #include <map>
 #include <set>
 #include <sstream>
 #include <glog/logging.h>
-#include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
 
 using namespace std;
 using namespace boost;
@@ -103,7 +111,18 @@ FEngine* SSBQueryExecutorImpl::getEngine() {
 }
 
 SSBQueryExecutorImpl::SSBQueryExecutorImpl (FEngine *engine)
-  : _engine(engine), _dataFolder(engine->getDataFolder()), _bufferpool (engine->getBufferPool()), _signatures(engine->getSignatureSet()) {
+  : _engine(engine), _dataFolder(engine->getDataFolder()), _bufferpool (engine->getBufferPool()), _signatures(engine->getSignatureSet()),
+  _threads (FParallelScan::getDefaultThreads()), _morselSize (FDB_MORSEL_SIZE) {
+}
+
+void SSBQueryExecutor::setParallelism (int threads, int64_t morselSize) {
+  _impl->setParallelism (threads, morselSize);
+}
+void SSBQueryExecutorImpl::setParallelism (int threads, int64_t morselSize) {
+  assert (threads > 0);
+  assert (morselSize > 0);
+  _threads = threads;
+  _morselSize = morselSize;
 }
 
 boost::shared_ptr<SSBQueryResult> SSBQueryExecutor::query (int query, bool cstore, const SSBQueryParam &param) {
@@ -111,200 +130,558 @@ boost::shared_ptr<SSBQueryResult> SSBQueryExecutor::query (int query, bool cstor
 }
 
 boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query (int query, bool cstore, const SSBQueryParam &param) {
+  SSBPlan plan;
   switch (query) {
-  case 11:
-    if (cstore) {
-      return query11C (param);
-    } else {
-      return query11B (param);
-    }
-    break;
-  case 12:
-    if (cstore) {
-      return query12C (param);
-    } else {
-      return query12B (param);
-    }
-    break;
-  case 13:
-    if (cstore) {
-      return query13C (param);
-    } else {
-      return query13B (param);
-    }
-    break;
-  case 21:
-    if (cstore) {
-      return query21C (param);
-    } else {
-      return query21B (param);
-    }
-    break;
-  case 22:
-    if (cstore) {
-      return query22C (param);
-    } else {
-      return query22B (param);
-    }
-    break;
-  case 23:
-    if (cstore) {
-      return query23C (param);
-    } else {
-      return query23B (param);
-    }
-    break;
+  case 11: createPlanQ11 (param, plan); break;
+  case 12: createPlanQ12 (param, plan); break;
+  case 13: createPlanQ13 (param, plan); break;
+  case 21: createPlanQ21 (param, plan); break;
+  case 22: createPlanQ22 (param, plan); break;
+  case 23: createPlanQ23 (param, plan); break;
+  case 31: createPlanQ31 (param, plan); break;
+  case 32: createPlanQ32 (param, plan); break;
+  case 33: createPlanQ33 (param, plan); break;
+  case 34: createPlanQ34 (param, plan); break;
+  case 41: createPlanQ41 (param, plan); break;
+  case 42: createPlanQ42 (param, plan); break;
+  case 43: createPlanQ43 (param, plan); break;
   default:
     LOG(ERROR) << "Not implemented yet: query=" << query;
     assert (false);
     return boost::shared_ptr<SSBQueryResult>();
   }
+  return executePlan (plan, cstore);
 }
 
 
 // ==========================================================================
-//  Query Implementations
+//  Query plans
 // ==========================================================================
-// ===========
-//  for BTree search with d_year
-// ===========
 #define REGION_SIZE 12
 const char* REGIONS[] = {"AFRICA", "AMERICA", "ASIA", "EUROPE", "MIDDLE EAST"};
 void setRegionString (char *dest, const char *str) {
   ::memset (dest, 0, REGION_SIZE);
   ::memcpy (dest, str, ::strlen(str));
 }
-MVProjection createBtreeMVSearchYearKey (int year, size_t regionId) {
-  MVProjection key;
-  assert (REGION_SIZE == sizeof (key.key.s_region));
-  ::memset (&key, 0, sizeof (MVProjection::PKType));
-  key.key.d_year = year;
-  setRegionString (key.key.s_region, REGIONS[regionId]);
-  return key;
+
+// nations and their regions (from dists.dss of SSB dbgen)
+#define NATION_COUNT 25
+const char* NATIONS[][2] = {
+  {"ALGERIA", "AFRICA"}, {"ARGENTINA", "AMERICA"}, {"BRAZIL", "AMERICA"}, {"CANADA", "AMERICA"},
+  {"EGYPT", "MIDDLE EAST"}, {"ETHIOPIA", "AFRICA"}, {"FRANCE", "EUROPE"}, {"GERMANY", "EUROPE"},
+  {"INDIA", "ASIA"}, {"INDONESIA", "ASIA"}, {"IRAN", "MIDDLE EAST"}, {"IRAQ", "MIDDLE EAST"},
+  {"JAPAN", "ASIA"}, {"JORDAN", "MIDDLE EAST"}, {"KENYA", "AFRICA"}, {"MOROCCO", "AFRICA"},
+  {"MOZAMBIQUE", "AFRICA"}, {"PERU", "AMERICA"}, {"CHINA", "ASIA"}, {"ROMANIA", "EUROPE"},
+  {"SAUDI ARABIA", "MIDDLE EAST"}, {"VIETNAM", "ASIA"}, {"RUSSIA", "EUROPE"},
+  {"UNITED KINGDOM", "EUROPE"}, {"UNITED STATES", "AMERICA"}};
+std::string getRegionOfNation (const std::string &nation) {
+  for (int i = 0; i < NATION_COUNT; ++i) {
+    if (nation == NATIONS[i][0]) return NATIONS[i][1];
+  }
+  LOG(ERROR) << "unknown nation:" << nation;
+  assert (false);
+  throw std::exception();
 }
-struct BtreeMVSearchYearContext {
-  BtreeMVSearchYearContext (int year_, size_t regionId_, BtreeMVSearchCallback childCallback_, void *childContext_)
-    : year (year_), childCallback (childCallback_), childContext (childContext_) {
-    setRegionString(s_region, REGIONS[regionId_]);
+// a city is the first 9 characters of its nation (space-padded) followed by a digit. e.g., 'UNITED KI1'
+#define CITY_PREFIX_SIZE 9
+std::string getCityOfNation (const std::string &nation, int cityId) {
+  assert (cityId >= 0 && cityId < 10);
+  std::string city = nation.substr(0, CITY_PREFIX_SIZE);
+  city.resize (CITY_PREFIX_SIZE, ' ');
+  city += (char) ('0' + cityId);
+  return city;
+}
+std::string getNationOfCity (const std::string &city) {
+  for (int i = 0; i < NATION_COUNT; ++i) {
+    if (getCityOfNation (NATIONS[i][0], 0).compare (0, CITY_PREFIX_SIZE, city, 0, CITY_PREFIX_SIZE) == 0) return NATIONS[i][0];
   }
+  LOG(ERROR) << "unknown city:" << city;
+  assert (false);
+  throw std::exception();
+}
 
-  int year;
-  char s_region[REGION_SIZE];
-  BtreeMVSearchCallback childCallback;
-  void *childContext;
-};
-TupleCallbackRet btreeMVSearchYearCallback (void *context, const void *tuple) {
-  BtreeMVSearchYearContext* parentContext = reinterpret_cast<BtreeMVSearchYearContext*>(context);
-  const MVProjection *tup = reinterpret_cast<const MVProjection*>(tuple);
-  if (tup->key.d_year > parentContext->year || ::memcmp(tup->key.s_region, parentContext->s_region, REGION_SIZE) != 0) {
-    return TUPLE_CALLBACK_QUIT;
+// column designs of MVProjection. offsets are used to read columns from BTree tuples.
+const FCStoreColumn& getMVColumn (const std::string &name) {
+  static const vector<FCStoreColumn> columns = FCStoreUtil::getPhysicalDesignsOf(MV_PROJECTION);
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (columns[i].name == name) return columns[i];
   }
-  if (tup->key.d_year == parentContext->year) {
-    parentContext->childCallback (parentContext->childContext, tup);
-  } 
-  return TUPLE_CALLBACK_OK;
+  LOG(ERROR) << "no such column in MVProjection:" << name;
+  assert (false);
+  throw std::exception();
 }
 
-void SSBQueryExecutorImpl::btreeMVSearchYearMainMemory (const std::string &familyName, BtreeMVSearchCallback callback, void* childContext, int year) {
-  FFamily *family = _engine->getFractureFamily(familyName);
-  if (family == NULL) return;
-  FMainMemoryBTree *fracture = family->getCurrentFracture();
-  if (fracture == NULL) return;
-  if (fracture->isSortedBuffer()) {
-    VLOG(1) << "btreeMVSearchYearMainMemory: scanning sorted on-memory BTree..";
-    //then, we do exactly same thing to onmemory btree
-    for (int i = 0; i < 5; ++i) {
-      BtreeMVSearchYearContext context (year, i, callback, childContext);
-      MVProjection key = createBtreeMVSearchYearKey (year, i);
-      fracture->scanTuplesGreaterEqual(btreeMVSearchYearCallback, &context, reinterpret_cast<const char*>(&key));
+// a value in the column type of MVProjection column
+string toMVColumnValue (const std::string &column, int64_t value) {
+  switch (getMVColumn(column).type) {
+  case COLUMN_INT8: { int8_t v = value; return string (reinterpret_cast<const char*>(&v), sizeof(v)); }
+  case COLUMN_INT16: { int16_t v = value; return string (reinterpret_cast<const char*>(&v), sizeof(v)); }
+  case COLUMN_INT32: { int32_t v = value; return string (reinterpret_cast<const char*>(&v), sizeof(v)); }
+  case COLUMN_INT64: return string (reinterpret_cast<const char*>(&value), sizeof(value));
+  default:
+    LOG(ERROR) << "not an integer column:" << column;
+    assert (false);
+    throw std::exception();
+  }
+}
+string toMVColumnValue (const std::string &column, const std::string &value) {
+  const FCStoreColumn &design = getMVColumn(column);
+  assert (design.type == COLUMN_CHAR);
+  assert (value.size() <= (size_t) design.maxLength);
+  string ret (design.maxLength, '\0');
+  ret.replace (0, value.size(), value);
+  return ret;
+}
+
+SearchCond SSBPredicate::toSearchCond () const {
+  switch (type) {
+  case SCT_BETWEEN:
+    assert (values.size() == 2);
+    return SearchCond (values[0].data(), values[1].data());
+  case SCT_IN:
+    {
+      vector<const void*> keys;
+      for (size_t i = 0; i < values.size(); ++i) keys.push_back (values[i].data());
+      return SearchCond (keys);
     }
-  } else {
-    // in this case, we have to fully scan the onmemory btree
-    VLOG(1) << "btreeMVSearchYearMainMemory: scanning unsorted on-memory BTree..";
-    const MVProjection *buffer = reinterpret_cast<const MVProjection*>(fracture->getUnsortedBuffer());
-    int64_t tuples = fracture->size();
-    for (int64_t i = 0; i < tuples; ++i) {
-      const MVProjection *p = buffer + i;
-      if (p->key.d_year == year) {
-        callback (childContext, p);
-      }
+  default:
+    assert (values.size() == 1);
+    return SearchCond (type, values[0].data());
+  }
+}
+
+SSBPredicate createIntPredicate (const std::string &column, SearchCondType type, int64_t value) {
+  SSBPredicate predicate (column, type);
+  predicate.values.push_back (toMVColumnValue(column, value));
+  return predicate;
+}
+SSBPredicate createIntBetween (const std::string &column, int64_t from, int64_t to) {
+  SSBPredicate predicate (column, SCT_BETWEEN);
+  predicate.values.push_back (toMVColumnValue(column, from));
+  predicate.values.push_back (toMVColumnValue(column, to));
+  return predicate;
+}
+SSBPredicate createStringPredicate (const std::string &column, SearchCondType type, const std::string &value) {
+  SSBPredicate predicate (column, type);
+  predicate.values.push_back (toMVColumnValue(column, value));
+  return predicate;
+}
+SSBPredicate createStringBetween (const std::string &column, const std::string &from, const std::string &to) {
+  SSBPredicate predicate (column, SCT_BETWEEN);
+  predicate.values.push_back (toMVColumnValue(column, from));
+  predicate.values.push_back (toMVColumnValue(column, to));
+  return predicate;
+}
+
+vector<ResultGroupColumType> getGroupColumnTypes (const SSBPlan &plan) {
+  vector<ResultGroupColumType> types;
+  for (size_t i = 0; i < plan.groupColumns.size(); ++i) {
+    switch (getMVColumn(plan.groupColumns[i]).type) {
+    case COLUMN_INT8: types.push_back (RESULT_GROUP_INT8); break;
+    case COLUMN_INT16: types.push_back (RESULT_GROUP_INT16); break;
+    case COLUMN_INT32: types.push_back (RESULT_GROUP_INT32); break;
+    case COLUMN_INT64: types.push_back (RESULT_GROUP_INT64); break;
+    default: types.push_back (RESULT_GROUP_STRING); break;
     }
   }
-  VLOG(1) << "btreeMVSearchYearMainMemory: scanning on-memory BTree done.";
+  return types;
+}
+
+// ===========
+//  key ranges
+// ===========
+// index of the column in the sort order (=key) of MVProjection. -1 if not a sort column.
+int getMVSortIndex (const std::string &name) {
+  static const vector<FCStoreColumn> columns = FCStoreUtil::getPhysicalDesignsOf(MV_PROJECTION);
+  static const vector<SortOrder> orders = FCStoreUtil::getSortOrdersOf(MV_PROJECTION);
+  for (size_t i = 0; i < orders.size(); ++i) {
+    if (columns[orders[i].first].name == name) return i;
+  }
+  return -1;
+}
+#define MV_SORT_INDEX_AFTER_YEAR 2 // s_region, d_year, c_region, ...
+// SSB dates are in these years, so d_year groups fit in a dense array (see FAggregateOperator).
+#define SSB_FIRST_YEAR 1992
+#define SSB_LAST_YEAR 1998
+
+bool compareBySortIndex (const SSBPredicate &left, const SSBPredicate &right) {
+  return getMVSortIndex(left.column) < getMVSortIndex(right.column);
 }
-void SSBQueryExecutorImpl::btreeMVSearchYear (BtreeMVSearchCallback callback, void* childContext, int year) {
-  FReadOnlyDiskBTree mv (_bufferpool, _signatures.getFileSignature(_dataFolder + BTREE_MV_MAIN_FILENAME));
 
-  // to skip the first s_region sort order, search for every 5 value of s_region.
-  for (int i = 0; i < 5; ++i) {
-    BtreeMVSearchYearContext context (year, i, callback, childContext);
-    MVProjection key = createBtreeMVSearchYearKey (year, i);
-    mv.scanTuplesGreaterEqual(btreeMVSearchYearCallback, &context, reinterpret_cast<const char*>(&key));
+// splits the predicates of the plan into those on sort columns following s_region/d_year
+// (c_region, s_nation, .., c_city, ..), in the sort order, and the others.
+// the former are evaluated together with the key range.
+void splitKeyPredicates (const SSBPlan &plan, vector<SSBPredicate> &keyPredicates, vector<SSBPredicate> &otherPredicates) {
+  for (size_t i = 0; i < plan.predicates.size(); ++i) {
+    if (getMVSortIndex(plan.predicates[i].column) >= MV_SORT_INDEX_AFTER_YEAR) {
+      keyPredicates.push_back (plan.predicates[i]);
+    } else {
+      otherPredicates.push_back (plan.predicates[i]);
+    }
   }
-  // if there is current fracture, read from it too with the same callback function
-  btreeMVSearchYearMainMemory (BTREE_MV_FAMILY, callback, childContext, year);
+  std::stable_sort (keyPredicates.begin(), keyPredicates.end(), compareBySortIndex);
+}
+
+// the number of keyPredicates forming a key prefix with s_region and d_year:
+// EQUAL predicates on consecutive sort columns right after d_year.
+size_t countKeyPrefixPredicates (const SSBPlan &plan, const vector<SSBPredicate> &keyPredicates) {
+  if (plan.yearFrom == 0) return 0;
+  size_t count = 0;
+  for (; count < keyPredicates.size(); ++count) {
+    const SSBPredicate &predicate = keyPredicates[count];
+    if (predicate.type != SCT_EQUAL || getMVSortIndex(predicate.column) != (int) (MV_SORT_INDEX_AFTER_YEAR + count)) break;
+  }
+  return count;
+}
+
+vector<string> getKeyRegions (const SSBPlan &plan) {
+  if (plan.region.empty()) {
+    return vector<string> (REGIONS, REGIONS + 5);
+  }
+  return vector<string> (1, plan.region);
 }
 
 // ===========
-//  for BTree search with s_region
+//  chain of operators for a plan
 // ===========
-struct BtreeMVSearchSRegionContext {
-  BtreeMVSearchSRegionContext (const std::string &region, BtreeMVSearchCallback childCallback_, void *childContext_)
-    : childCallback(childCallback_), childContext(childContext_) {
-    setRegionString(s_region, region.c_str());
+// [filters ->] [project ->] aggregate, built for each thread and each fracture.
+// filters are needed only for BTree fractures, as FColumnScan evaluates predicates by itself.
+struct SSBPlanChain {
+  // filters: predicates evaluated by filter operators. filterKeyRange: adds filters of the key range too.
+  SSBPlanChain (const SSBPlan &plan, const vector<SSBPredicate> &filters, bool filterKeyRange) {
+    string sumColumn = plan.valueColumn;
+    if (!plan.valueColumn2.empty()) sumColumn = "value";
+    aggregate.reset (new FAggregateOperator (plan.groupColumns, sumColumn));
+    aggregate->setGroupDomain ("d_year", plan.yearFrom > 0 ? plan.yearFrom : SSB_FIRST_YEAR, plan.yearTo > 0 ? plan.yearTo : SSB_LAST_YEAR);
+    head = aggregate.get();
+    if (!plan.valueColumn2.empty()) {
+      addOperator (new FProjectOperator (sumColumn, plan.valueColumn, plan.arithmetic, plan.valueColumn2, head));
+    }
+    addColumn (plan.valueColumn);
+    if (!plan.valueColumn2.empty()) addColumn (plan.valueColumn2);
+    for (size_t i = 0; i < plan.groupColumns.size(); ++i) {
+      addColumn (plan.groupColumns[i]);
+    }
+    for (size_t i = filters.size(); i > 0; --i) {
+      const SSBPredicate &predicate = filters[i - 1];
+      addOperator (new FFilterOperator (getMVColumn(predicate.column), predicate.toSearchCond(), head));
+      addColumn (predicate.column);
+    }
+    if (filterKeyRange) {
+      if (plan.yearFrom > 0) {
+        addOperator (new FFilterOperator (getMVColumn("d_year"), SearchCond(&plan.yearFrom, &plan.yearTo), head));
+        addColumn ("d_year");
+      }
+      if (!plan.region.empty()) {
+        region = toMVColumnValue("s_region", plan.region);
+        addOperator (new FFilterOperator (getMVColumn("s_region"), SearchCond(SCT_EQUAL, region.data()), head));
+        addColumn ("s_region");
+      }
+    }
+  }
+  void addOperator (FOperator *op) {
+    operators.push_back (boost::shared_ptr<FOperator> (op));
+    head = op;
+  }
+  // the columns read from the source
+  void addColumn (const std::string &name) {
+    if (std::find (columnNames.begin(), columnNames.end(), name) == columnNames.end()) {
+      columnNames.push_back (name);
+    }
+  }
+  vector<FCStoreColumn> getColumns () const {
+    vector<FCStoreColumn> columns;
+    for (size_t i = 0; i < columnNames.size(); ++i) columns.push_back (getMVColumn(columnNames[i]));
+    return columns;
+  }
+
+  // adds the aggregated values to the result.
+  void addTo (SSBQueryResult &result) const {
+    if (result.groupColumnTypes.empty()) {
+      result.singleIntResult += aggregate->getTotal();
+      return;
+    }
+    vector<vector<string> > keys;
+    vector<int64_t> sums;
+    aggregate->getGroups (keys, sums);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      result.groupedResults[keys[i]] += sums[i];
+    }
+  }
+
+  boost::shared_ptr<FAggregateOperator> aggregate;
+  vector<boost::shared_ptr<FOperator> > operators; // other than aggregate
+  FOperator *head;
+  vector<string> columnNames;
+  string region; // value for the key range filter
+};
+
+// ===========
+//  plans on c-store
+// ===========
+// narrows ranges by a predicate on an RLE sort column. the found ranges are runs of the column.
+// if sorted, the column is sorted within each range (all preceding sort columns are fixed),
+// so the runs are found by binary search.
+void narrowKeyRanges (FColumnReader *reader, const SearchCond &cond, bool sorted, vector<PositionRange> &ranges) {
+  if (ranges.empty()) return;
+  reader->setSearchRanges(ranges);
+  if (sorted) reader->setSortedInSearchRanges();
+  ranges.clear();
+  reader->getPositionRanges(cond, ranges);
+  reader->clearSearchRanges();
+}
+
+// finds the positions in the key range of the plan and matching keyPredicates by the RLE runs of
+// sort columns: s_region, d_year, then c_region, s_nation, .. c_city, .. in the sort order.
+// each region and year is searched separately, so that following columns stay sorted
+// as long as preceding ones are fixed by EQUAL.
+template <typename CSTORE>
+void findKeyRanges (const SSBPlan &plan, const vector<SSBPredicate> &keyPredicates, CSTORE &cstore, vector<PositionRange> &ranges) {
+  FColumnReader *regionReader = cstore.getColumnReader("s_region");
+  FColumnReader *yearReader = cstore.getColumnReader("d_year");
+  vector<FColumnReader*> keyReaders;
+  for (size_t i = 0; i < keyPredicates.size(); ++i) {
+    keyReaders.push_back (cstore.getColumnReader(keyPredicates[i].column));
+  }
+  const vector<string> regions = getKeyRegions (plan);
+  for (size_t r = 0; r < regions.size(); ++r) {
+    string region = regionReader->normalize(regions[r]);
+    vector<PositionRange> regionRanges;
+    regionReader->clearSearchRanges();
+    regionReader->getPositionRanges(SearchCond(SCT_EQUAL, region.data()), regionRanges);
+    // year=0 once if d_year is not fixed
+    for (int16_t year = plan.yearFrom; year <= plan.yearTo; ++year) {
+      vector<PositionRange> keyRanges (regionRanges);
+      if (plan.yearFrom != 0) {
+        narrowKeyRanges (yearReader, SearchCond(SCT_EQUAL, &year), true, keyRanges);
+      }
+      bool sorted = plan.yearFrom != 0;
+      for (size_t i = 0; i < keyPredicates.size(); ++i) {
+        sorted = sorted && getMVSortIndex(keyPredicates[i].column) == (int) (MV_SORT_INDEX_AFTER_YEAR + i);
+        narrowKeyRanges (keyReaders[i], keyPredicates[i].toSearchCond(), sorted, keyRanges);
+        sorted = sorted && keyPredicates[i].type == SCT_EQUAL;
+      }
+      ranges.insert (ranges.end(), keyRanges.begin(), keyRanges.end());
+    }
+  }
+}
+
+// scans morsels of a plan with the column readers of one thread.
+template <typename CSTORE>
+struct SSBCStoreMorselWorker : public FMorselWorker {
+  // orderedPredicates are on the readers of another thread. same conditions are applied in the same order.
+  SSBCStoreMorselWorker (const SSBPlan &plan, CSTORE &cstore, const vector<ColumnPredicate> &orderedPredicates)
+    : chain (plan, vector<SSBPredicate>(), false) {
+    vector<ColumnPredicate> predicates;
+    for (size_t i = 0; i < orderedPredicates.size(); ++i) {
+      predicates.push_back (ColumnPredicate (cstore.getColumnReader(orderedPredicates[i].reader->getColumn().name), orderedPredicates[i].cond));
+    }
+    vector<FColumnReader*> readers;
+    vector<bool> asCodes;
+    for (size_t i = 0; i < chain.columnNames.size(); ++i) {
+      readers.push_back (cstore.getColumnReader(chain.columnNames[i]));
+      // group columns are aggregated on dictionary codes
+      asCodes.push_back (std::find (plan.groupColumns.begin(), plan.groupColumns.end(), chain.columnNames[i]) != plan.groupColumns.end());
+    }
+    scan.reset (new FColumnScan (readers, asCodes, predicates));
   }
-  char s_region[REGION_SIZE];
-  BtreeMVSearchCallback childCallback;
-  void *childContext;
+  void processMorsel (size_t morselIndex, const PositionRange &morsel) {
+    scan->scan (morsel, *chain.head);
+  }
+
+  SSBPlanChain chain;
+  boost::scoped_ptr<FColumnScan> scan;
 };
-MVProjection createBtreeMVSearchSRegionKey (const std::string &region) {
-  MVProjection key;
-  ::memset (&key, 0, sizeof (MVProjection::PKType));
-  setRegionString(key.key.s_region, region.c_str());
-  return key;
-}
-TupleCallbackRet btreeMVSearchSRegionCallback (void *context, const void *tuple) {
-  BtreeMVSearchSRegionContext* parentContext = reinterpret_cast<BtreeMVSearchSRegionContext*>(context);
-  const MVProjection *tup = reinterpret_cast<const MVProjection*>(tuple);
-  if (::memcmp(tup->key.s_region, parentContext->s_region, REGION_SIZE) != 0) {
-    return TUPLE_CALLBACK_QUIT;
+
+// executes the plan on a c-store fracture. the key range is split into morsels and scanned
+// by one thread for each of cstores (see FParallelScan), then the partial results are merged.
+// CSTORE is FReadOnlyCStore (on-disk fracture) or FMainMemoryCStore (current fracture, one thread).
+template <typename CSTORE>
+void executeCStorePlan (const SSBPlan &plan, const vector<CSTORE*> &cstores, int64_t morselSize, SSBQueryResult &result) {
+  assert (cstores.size() > 0);
+  CSTORE &cstore = *cstores[0];
+  vector<SSBPredicate> keyPredicates, otherPredicates;
+  splitKeyPredicates (plan, keyPredicates, otherPredicates);
+  vector<PositionRange> ranges;
+  findKeyRanges (plan, keyPredicates, cstore, ranges);
+  FSelection keySelection (ranges);
+  if (keySelection.empty()) return;
+  ranges.clear(); // sorted and merged by FSelection
+  keySelection.getRanges (ranges);
+
+  vector<ColumnPredicate> predicates;
+  for (size_t i = 0; i < otherPredicates.size(); ++i) {
+    predicates.push_back (ColumnPredicate (cstore.getColumnReader(otherPredicates[i].column), otherPredicates[i].toSearchCond()));
   }
-  parentContext->childCallback (parentContext->childContext, tup);
-  return TUPLE_CALLBACK_OK;
+  FSelectionPlanner::orderBySelectivity (predicates, keySelection);
+
+  vector<PositionRange> morsels;
+  FParallelScan::splitIntoMorsels (ranges, morsels, morselSize);
+  vector<boost::shared_ptr<SSBCStoreMorselWorker<CSTORE> > > workerPtrs;
+  vector<FMorselWorker*> workers;
+  for (size_t i = 0; i < cstores.size(); ++i) {
+    workerPtrs.push_back (boost::shared_ptr<SSBCStoreMorselWorker<CSTORE> > (new SSBCStoreMorselWorker<CSTORE> (plan, *cstores[i], predicates)));
+    workers.push_back (workerPtrs.back().get());
+  }
+  FParallelScan::run (morsels, workers);
+  FOperatorStats scanStats;
+  for (size_t i = 0; i < workerPtrs.size(); ++i) {
+    workerPtrs[i]->chain.head->finish();
+    workerPtrs[i]->chain.addTo (result);
+    scanStats.add (workerPtrs[i]->scan->getStats());
+    VLOG(2) << plan.name << " thread-" << i << ":" << endl << workerPtrs[i]->chain.head->describe();
+  }
+  VLOG(1) << plan.name << " c-store scan: " << ranges.size() << " key ranges, " << morsels.size() << " morsels, " << cstores.size() << " threads, " << scanStats.toString();
 }
-void SSBQueryExecutorImpl::btreeMVSearchSRegionMainMemory (const std::string &familyName, BtreeMVSearchCallback callback, void* childContext, const std::string &region) {
+
+// ===========
+//  plans on BTree
+// ===========
+// the search key of s_region, d_year and prefixPredicates (see countKeyPrefixPredicates()).
+// returns the length of the key prefix.
+int createBtreeMVSearchKey (const std::string &region, int16_t year, const vector<SSBPredicate> &prefixPredicates, MVProjection &key) {
+  assert (REGION_SIZE == sizeof (MVProjection::PKType().s_region));
+  ::memset (static_cast<void*>(&key), 0, sizeof (key));
+  setRegionString (key.key.s_region, region.c_str());
+  if (year == 0) return REGION_SIZE;
+  key.key.d_year = year;
+  int prefixLength = offsetof(MVProjection::PKType, d_year) + sizeof(int16_t);
+  // key columns are at the same offsets in MVProjection and its PKType
+  char *data = reinterpret_cast<char*>(&key);
+  for (size_t i = 0; i < prefixPredicates.size(); ++i) {
+    const FCStoreColumn &column = getMVColumn(prefixPredicates[i].column);
+    assert (prefixPredicates[i].type == SCT_EQUAL);
+    assert (column.offset >= prefixLength);
+    ::memcpy (data + column.offset, prefixPredicates[i].values[0].data(), column.maxLength);
+    prefixLength = column.offset + column.maxLength;
+  }
+  return prefixLength;
+}
+
+// scans the key range of the plan as key prefixes: s_region, or s_region + d_year (+ prefixPredicates) for each year.
+template <typename BTREE>
+void scanMVKeyRange (const SSBPlan &plan, const vector<SSBPredicate> &prefixPredicates, BTREE &btree, FTupleBatcher &batcher) {
+  const vector<string> regions = getKeyRegions (plan);
+  for (size_t i = 0; i < regions.size(); ++i) {
+    MVProjection key;
+    if (plan.yearFrom == 0) {
+      int prefixLength = createBtreeMVSearchKey (regions[i], 0, prefixPredicates, key);
+      batcher.scanPrefix (btree, &key, prefixLength);
+      continue;
+    }
+    for (int16_t year = plan.yearFrom; year <= plan.yearTo; ++year) {
+      int prefixLength = createBtreeMVSearchKey (regions[i], year, prefixPredicates, key);
+      batcher.scanPrefix (btree, &key, prefixLength);
+    }
+  }
+}
+
+// executes the plan on an on-disk BTree fracture and/or an on-memory BTree current fracture (either can be NULL).
+void executeBTreePlan (const SSBPlan &plan, FReadOnlyDiskBTree *btree, const FMainMemoryBTree *fracture, SSBQueryResult &result) {
+  // leading EQUAL predicates on key columns extend the search key. others are filtered.
+  vector<SSBPredicate> keyPredicates, filters;
+  splitKeyPredicates (plan, keyPredicates, filters);
+  const size_t prefixCount = countKeyPrefixPredicates (plan, keyPredicates);
+  const vector<SSBPredicate> prefixPredicates (keyPredicates.begin(), keyPredicates.begin() + prefixCount);
+  filters.insert (filters.begin(), keyPredicates.begin() + prefixCount, keyPredicates.end());
+  if (btree != NULL) {
+    SSBPlanChain chain (plan, filters, false);
+    FTupleBatcher batcher (chain.getColumns(), *chain.head);
+    scanMVKeyRange (plan, prefixPredicates, *btree, batcher);
+    batcher.flush();
+    chain.head->finish();
+    chain.addTo (result);
+    VLOG(1) << plan.name << " BTree scan: " << batcher.getStats().toString() << endl << chain.head->describe();
+  }
+  if (fracture != NULL) {
+    // an unsorted buffer is fully scanned, so all predicates and the key range are evaluated by filters.
+    const bool sorted = fracture->isSortedBuffer();
+    SSBPlanChain chain (plan, sorted ? filters : plan.predicates, !sorted);
+    FTupleBatcher batcher (chain.getColumns(), *chain.head);
+    if (sorted) {
+      scanMVKeyRange (plan, prefixPredicates, *fracture, batcher);
+    } else {
+      batcher.scanUnsorted (*fracture);
+    }
+    batcher.flush();
+    chain.head->finish();
+    chain.addTo (result);
+    VLOG(1) << plan.name << " on-memory BTree scan (" << (sorted ? "sorted" : "unsorted") << "): " << batcher.getStats().toString() << endl << chain.head->describe();
+  }
+}
+// executes the plan on a sealed fracture of a family, while the dumper doesn't sort it.
+void executeSealedPlan (const SSBPlan &plan, const FSealedFracture &sealed, int64_t morselSize, SSBQueryResult &result) {
+  boost::shared_lock<boost::shared_mutex> lock (sealed.getMutex());
+  if (sealed.getCStore() != NULL) {
+    executeCStorePlan (plan, vector<FMainMemoryCStore*> (1, sealed.getCStore()), morselSize, result);
+  }
+  if (sealed.getBTree() != NULL) {
+    executeBTreePlan (plan, NULL, sealed.getBTree(), result);
+  }
+}
+
+void SSBQueryExecutorImpl::openMVCStores (MVCStores &stores) {
+  for (int i = 0; i < std::max (_threads, 1); ++i) {
+    // each thread sets its own search ranges. signatures and decoded dictionaries are shared in FEngine
+    boost::shared_ptr<FReadOnlyCStore> cstore = _engine->getReadOnlyCStore(MV_PROJECTION, CSTORE_MV_MAIN_PREFIX);
+    stores.opened.push_back (cstore);
+    stores.cstores.push_back (cstore.get());
+  }
+}
+void SSBQueryExecutorImpl::openMVCStores (const std::vector<FFileSignature> &signatures, MVCStores &stores) {
+  for (int i = 0; i < _threads; ++i) {
+    boost::shared_ptr<FReadOnlyCStore> cstore (new FReadOnlyCStore(_bufferpool, MV_PROJECTION, signatures, &(_engine->getDictionaryCache())));
+    stores.opened.push_back (cstore);
+    stores.cstores.push_back (cstore.get());
+  }
+}
+FFractureSnapshotPtr SSBQueryExecutorImpl::acquireSnapshot (const std::string &familyName) {
   FFamily *family = _engine->getFractureFamily(familyName);
-  if (family == NULL) return;
-  FMainMemoryBTree *fracture = family->getCurrentFracture();
-  if (fracture == NULL) return;
-  if (fracture->isSortedBuffer()) {
-    VLOG(1) << "btreeMVSearchSRegionMainMemory: scanning sorted on-memory BTree..";
-    MVProjection key = createBtreeMVSearchSRegionKey (region);
-    BtreeMVSearchSRegionContext context (region, callback, childContext);
-    fracture->scanTuplesGreaterEqual(btreeMVSearchSRegionCallback, &context, reinterpret_cast<const char*>(&key));
+  if (family == NULL) return FFractureSnapshotPtr (new FFractureSnapshot());
+  return family->acquireSnapshot();
+}
+
+boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::executePlan (const SSBPlan &plan, bool cstore) {
+  StopWatch watch;
+  watch.init();
+  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(getGroupColumnTypes(plan)));
+  // fractures of the family are fixed here. on-disk files and on-memory fractures are kept
+  // until the query ends, even if a merge or a dump replaces them meanwhile.
+  FFractureSnapshotPtr snapshot = acquireSnapshot (cstore ? CSTORE_MV_FAMILY : BTREE_MV_FAMILY);
+  if (cstore) {
+    MVCStores stores;
+    openMVCStores (stores);
+    executeCStorePlan (plan, stores.cstores, _morselSize, *result);
+    for (size_t i = 0; i < snapshot->fractures.size(); ++i) {
+      MVCStores fractureStores;
+      openMVCStores (snapshot->fractures[i]->getSignatures(), fractureStores);
+      executeCStorePlan (plan, fractureStores.cstores, _morselSize, *result);
+    }
+    // in case there is on-memory current fracture, search on it too.
+    if (snapshot->currentCStore) {
+      executeCStorePlan (plan, vector<FMainMemoryCStore*> (1, snapshot->currentCStore.get()), _morselSize, *result);
+    }
+    executeBTreePlan (plan, NULL, snapshot->current.get(), *result);
   } else {
-    // in this case, we have to fully scan the onmemory btree
-    VLOG(1) << "btreeMVSearchSRegionMainMemory: scanning unsorted on-memory BTree..";
-    const MVProjection *buffer = reinterpret_cast<const MVProjection*>(fracture->getUnsortedBuffer());
-    int64_t tuples = fracture->size();
-    char s_region[REGION_SIZE];
-    setRegionString(s_region, region.c_str());
-    for (int64_t i = 0; i < tuples; ++i) {
-      const MVProjection *p = buffer + i;
-      if (::memcmp(p->key.s_region, s_region, REGION_SIZE) == 0) {
-        callback (childContext, p);
-      }
+    FFileSignature signature;
+    {
+      boost::recursive_mutex::scoped_lock catalogLock (_engine->getCatalogMutex());
+      signature = _signatures.getFileSignature(_dataFolder + BTREE_MV_MAIN_FILENAME);
+    }
+    FReadOnlyDiskBTree mv (_bufferpool, signature);
+    executeBTreePlan (plan, &mv, snapshot->current.get(), *result);
+    for (size_t i = 0; i < snapshot->fractures.size(); ++i) {
+      FReadOnlyDiskBTree fracture (_bufferpool, snapshot->fractures[i]->getSignatures()[0]);
+      executeBTreePlan (plan, &fracture, NULL, *result);
     }
   }
-  VLOG(1) << "btreeMVSearchSRegionMainMemory: scanning on-memory BTree done.";
-}
-void SSBQueryExecutorImpl::btreeMVSearchSRegion (BtreeMVSearchCallback callback, void* childContext, const std::string &region) {
-  FReadOnlyDiskBTree mv (_bufferpool, _signatures.getFileSignature(_dataFolder + BTREE_MV_MAIN_FILENAME));
-  MVProjection key = createBtreeMVSearchSRegionKey (region);
-  BtreeMVSearchSRegionContext context (region, callback, childContext);
-  mv.scanTuplesGreaterEqual(btreeMVSearchSRegionCallback, &context, reinterpret_cast<const char*>(&key));
-  // if there is current fracture, read from it too with the same callback function
-  btreeMVSearchSRegionMainMemory (BTREE_MV_FAMILY, callback, childContext, region);
+  for (size_t i = 0; i < snapshot->sealed.size(); ++i) {
+    executeSealedPlan (plan, *snapshot->sealed[i], _morselSize, *result);
+  }
+  watch.stop();
+  result->elapsedMicrosec = watch.getElapsed();
+  VLOG(1) << plan.name << (cstore ? "C" : "B") << " done: sum=" << result->singleIntResult << ", " << result->groupedResults.size() << " rows. " << watch.getElapsed() << " microsec";
+  return result;
 }
 
 // ===========
@@ -327,99 +704,15 @@ void SSBQueryParam::generateRandomParamQ11 (int &seed) {
   ints.push_back (quanTo);
 }
 
-struct Q11BContext {
-  Q11BContext (int discFrom_, int discTo_, int quanTo_)
-    : sum (0), discFrom(discFrom_), discTo(discTo_), quanTo(quanTo_) {}
-  int64_t sum;
-  int discFrom;
-  int discTo;
-  int quanTo;
-};
-void query11BCallback (void *context, const MVProjection *tuple) {
-  Q11BContext* con = reinterpret_cast<Q11BContext*>(context);
-  if (tuple->l_discount >= con->discFrom && tuple->l_discount <= con->discTo && tuple->l_quantity < con->quanTo) {
-    con->sum += tuple->l_extendedprice * tuple->l_discount;
-  }
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query11B (const SSBQueryParam &param) {
+void createPlanQ11 (const SSBQueryParam &param, SSBPlan &plan) {
   assert (param.ints.size() >= 4);
-  StopWatch watch;
-  watch.init();
-  int16_t year = param.ints[0];
-  Q11BContext context (param.ints[1], param.ints[2], param.ints[3]);
-  btreeMVSearchYear (query11BCallback, &context, year);
-  watch.stop();
-  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(watch.getElapsed(), context.sum));
-  VLOG(1) << "Q11B done: sum=" << context.sum << ". " << watch.getElapsed() << " microsec";
-  return result;
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query11C (const SSBQueryParam &param) {
-  assert (param.ints.size() >= 4);
-  StopWatch watch;
-  watch.init();
-  FReadOnlyCStore mv (_bufferpool, MV_PROJECTION, _signatures, _dataFolder, CSTORE_MV_MAIN_PREFIX);
-
-  FColumnReader *yearReader = mv.getColumnReader("d_year");
-  assert (yearReader->getColumn().compression == RLE_COMPRESSED);
-  assert (yearReader->getColumn().type == COLUMN_INT16);
-
-  FColumnReader *discReader = mv.getColumnReader("l_discount");
-  assert (discReader->getColumn().compression == UNCOMPRESSED);
-  FColumnReader *quanReader = mv.getColumnReader("l_quantity");
-  assert (quanReader->getColumn().compression == UNCOMPRESSED);
-  FColumnReader *extReader = mv.getColumnReader("l_extendedprice");
-  assert (extReader->getColumn().compression == UNCOMPRESSED);
-
-  int16_t year = param.ints[0];
-  vector <PositionRange> ranges;
-  yearReader->getPositionRanges(SearchCond(SCT_EQUAL, &year), ranges);
-  assert (ranges.size() > 0);
-  int64_t sum = 0;
-  size_t maxLen = 0;
-  for (size_t i = 0; i < ranges.size(); ++i) {
-    const PositionRange &range = ranges[i];
-    size_t length = range.end - range.begin;
-    if (length > maxLen) maxLen = length;
-  }
-
-  // minor TODO : split the reading to suppress memory consumption.
-  assert (discReader->getColumn().maxLength == sizeof(int8_t));
-  scoped_array<int8_t> discBufferPtr(new int8_t[maxLen]);
-  int8_t *discBuffer = (discBufferPtr.get());
-
-  assert (extReader->getColumn().maxLength == sizeof(int32_t));
-  scoped_array<int32_t> extBufferPtr(new int32_t[maxLen]);
-  int32_t *extBuffer = (extBufferPtr.get());
-
-  assert (quanReader->getColumn().maxLength == sizeof(int8_t));
-  scoped_array<int8_t> quanBufferPtr(new int8_t[maxLen]);
-  int8_t *quanBuffer = (quanBufferPtr.get());
-
-  int discFrom = param.ints[1];
-  int discTo = param.ints[2];
-  int quanTo = param.ints[3];
-  for (size_t i = 0; i < ranges.size(); ++i) {
-    const PositionRange &range = ranges[i];
-    size_t length = range.end - range.begin;
-    discReader->getDecompressedData(range, discBuffer, maxLen * sizeof(int8_t));
-    extReader->getDecompressedData(range, extBuffer, maxLen * sizeof(int32_t));
-    quanReader->getDecompressedData(range, quanBuffer, maxLen * sizeof(int8_t));
-    for (size_t j = 0; j < length; ++j) {
-      if (discBuffer[j] >= discFrom && discBuffer[j] <= discTo && quanBuffer[j] < quanTo) {
-        sum += extBuffer[j] * discBuffer[j];
-      }
-    }
-  }
-
-  // in case there is on-memory current fracture, search on it too.
-  Q11BContext context (param.ints[1], param.ints[2], param.ints[3]);
-  btreeMVSearchYearMainMemory(CSTORE_MV_FAMILY, query11BCallback, &context, year);
-  sum += context.sum;
-
-  watch.stop();
-  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(watch.getElapsed(), sum));
-  VLOG(1) << "Q11C done: sum=" << sum << ". " << watch.getElapsed() << " microsec";
-  return result;
+  plan.name = "Q1.1";
+  plan.yearFrom = plan.yearTo = param.ints[0];
+  plan.predicates.push_back (createIntBetween ("l_discount", param.ints[1], param.ints[2]));
+  plan.predicates.push_back (createIntPredicate ("l_quantity", SCT_LT, param.ints[3]));
+  plan.valueColumn = "l_extendedprice";
+  plan.arithmetic = ARITHMETIC_MULTIPLY;
+  plan.valueColumn2 = "l_discount";
 }
 
 // ===========
@@ -446,103 +739,19 @@ void SSBQueryParam::generateRandomParamQ12 (int &seed) {
   ints.push_back (quanTo);
 }
 
-struct Q12BContext {
-  Q12BContext (int yearMonthNum_, int discFrom_, int discTo_, int quanFrom_, int quanTo_)
-    : sum (0), yearMonthNum(yearMonthNum_), discFrom(discFrom_), discTo(discTo_), quanFrom(quanFrom_), quanTo(quanTo_) {}
-  int64_t sum;
-  int yearMonthNum;
-  int discFrom;
-  int discTo;
-  int quanFrom;
-  int quanTo;
-};
-void query12BCallback (void *context, const MVProjection *tuple) {
-  Q12BContext* con = reinterpret_cast<Q12BContext*>(context);
-  if (tuple->key.d_yearmonthnum == con->yearMonthNum) {
-    if (tuple->l_discount >= con->discFrom && tuple->l_discount <= con->discTo && tuple->l_quantity >= con->quanFrom && tuple->l_quantity <= con->quanTo) {
-      con->sum += tuple->l_extendedprice * tuple->l_discount;
-    }
-  }
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query12B (const SSBQueryParam &param) {
+void createPlanQ12 (const SSBQueryParam &param, SSBPlan &plan) {
   assert (param.ints.size() >= 5);
-  StopWatch watch;
-  watch.init();
-  Q12BContext context (param.ints[0], param.ints[1], param.ints[2], param.ints[3], param.ints[4]);
-  btreeMVSearchYear (query12BCallback, &context, context.yearMonthNum / 100);
-  watch.stop();
-  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(watch.getElapsed(), context.sum));
-  VLOG(1) << "Q12B done: sum=" << context.sum << ". " << watch.getElapsed() << " microsec";
-  return result;
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query12C (const SSBQueryParam &param) {
-  assert (param.ints.size() >= 5);
-  StopWatch watch;
-  watch.init();
-  FReadOnlyCStore mv (_bufferpool, MV_PROJECTION, _signatures, _dataFolder, CSTORE_MV_MAIN_PREFIX);
-
-  FColumnReader *yearmonthnumReader = mv.getColumnReader("d_yearmonthnum");
-  assert (yearmonthnumReader->getColumn().compression == RLE_COMPRESSED);
-  assert (yearmonthnumReader->getColumn().type == COLUMN_INT32);
-
-  FColumnReader *discReader = mv.getColumnReader("l_discount");
-  assert (discReader->getColumn().compression == UNCOMPRESSED);
-  FColumnReader *quanReader = mv.getColumnReader("l_quantity");
-  assert (quanReader->getColumn().compression == UNCOMPRESSED);
-  FColumnReader *extReader = mv.getColumnReader("l_extendedprice");
-  assert (extReader->getColumn().compression == UNCOMPRESSED);
-
-  int32_t yearMonthNum = param.ints[0];
-  vector <PositionRange> ranges;
-  yearmonthnumReader->getPositionRanges(SearchCond(SCT_EQUAL, &yearMonthNum), ranges);
-  assert (ranges.size() > 0);
-  int64_t sum = 0;
-  size_t maxLen = 0;
-  for (size_t i = 0; i < ranges.size(); ++i) {
-    const PositionRange &range = ranges[i];
-    size_t length = range.end - range.begin;
-    if (length > maxLen) maxLen = length;
-  }
-
-  scoped_array<int8_t> discBufferPtr(new int8_t[maxLen]);
-  int8_t *discBuffer = (discBufferPtr.get());
-
-  scoped_array<int32_t> extBufferPtr(new int32_t[maxLen]);
-  int32_t *extBuffer = (extBufferPtr.get());
-
-  scoped_array<int8_t> quanBufferPtr(new int8_t[maxLen]);
-  int8_t *quanBuffer = (quanBufferPtr.get());
-
-  int discFrom = param.ints[1];
-  int discTo = param.ints[2];
-  int quanFrom = param.ints[3];
-  int quanTo = param.ints[4];
-  for (size_t i = 0; i < ranges.size(); ++i) {
-    const PositionRange &range = ranges[i];
-    size_t length = range.end - range.begin;
-    discReader->getDecompressedData(range, discBuffer, maxLen * sizeof(int8_t));
-    extReader->getDecompressedData(range, extBuffer, maxLen * sizeof(int32_t));
-    quanReader->getDecompressedData(range, quanBuffer, maxLen * sizeof(int8_t));
-    for (size_t j = 0; j < length; ++j) {
-      if (discBuffer[j] >= discFrom && discBuffer[j] <= discTo && quanBuffer[j] >= quanFrom && quanBuffer[j] <= quanTo) {
-        sum += extBuffer[j] * discBuffer[j];
-      }
-    }
-  }
-
-  // in case there is on-memory current fracture, search on it too.
-  Q12BContext context (param.ints[0], param.ints[1], param.ints[2], param.ints[3], param.ints[4]);
-  btreeMVSearchYearMainMemory (CSTORE_MV_FAMILY, query12BCallback, &context, context.yearMonthNum / 100);
-  sum += context.sum;
-
-  watch.stop();
-  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(watch.getElapsed(), sum));
-  VLOG(1) << "Q12C done: sum=" << sum << ". " << watch.getElapsed() << " microsec";
-  return result;
+  plan.name = "Q1.2";
+  // d_yearmonthnum determines d_year, which narrows the key range
+  plan.yearFrom = plan.yearTo = param.ints[0] / 100;
+  plan.predicates.push_back (createIntPredicate ("d_yearmonthnum", SCT_EQUAL, param.ints[0]));
+  plan.predicates.push_back (createIntBetween ("l_discount", param.ints[1], param.ints[2]));
+  plan.predicates.push_back (createIntBetween ("l_quantity", param.ints[3], param.ints[4]));
+  plan.valueColumn = "l_extendedprice";
+  plan.arithmetic = ARITHMETIC_MULTIPLY;
+  plan.valueColumn2 = "l_discount";
 }
 
-
-
 // ===========
 //  Q1.3
 // ===========
@@ -566,100 +775,17 @@ void SSBQueryParam::generateRandomParamQ13 (int &seed) {
   ints.push_back (quanTo);
 }
 
-struct Q13BContext {
-  Q13BContext (int weeknuminyear_, int discFrom_, int discTo_, int quanFrom_, int quanTo_)
-    : sum (0), weeknuminyear(weeknuminyear_), discFrom(discFrom_), discTo(discTo_), quanFrom(quanFrom_), quanTo(quanTo_) {}
-  int64_t sum;
-  int weeknuminyear;
-  int discFrom;
-  int discTo;
-  int quanFrom;
-  int quanTo;
-};
-void query13BCallback (void *context, const MVProjection *tuple) {
-  Q13BContext* con = reinterpret_cast<Q13BContext*>(context);
-  if (tuple->d_weeknuminyear == con->weeknuminyear && tuple->l_discount >= con->discFrom && tuple->l_discount <= con->discTo && tuple->l_quantity < con->quanTo) {
-    con->sum += tuple->l_extendedprice * tuple->l_discount;
-  }
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query13B (const SSBQueryParam &param) {
+void createPlanQ13 (const SSBQueryParam &param, SSBPlan &plan) {
   assert (param.ints.size() >= 6);
-  StopWatch watch;
-  watch.init();
-  Q13BContext context(param.ints[1], param.ints[2], param.ints[3], param.ints[4], param.ints[5]);
-  btreeMVSearchYear (query13BCallback, &context, param.ints[0]);
-  watch.stop();
-  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(watch.getElapsed(), context.sum));
-  VLOG(1) << "Q13B done: sum=" << context.sum << ". " << watch.getElapsed() << " microsec";
-  return result;
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query13C (const SSBQueryParam &param) {
-  assert (param.ints.size() >= 6);
-  StopWatch watch;
-  watch.init();
-  FReadOnlyCStore mv (_bufferpool, MV_PROJECTION, _signatures, _dataFolder, CSTORE_MV_MAIN_PREFIX);
-
-  FColumnReader *yearReader = mv.getColumnReader("d_year");
-  FColumnReader *discReader = mv.getColumnReader("l_discount");
-  FColumnReader *quanReader = mv.getColumnReader("l_quantity");
-  FColumnReader *extReader = mv.getColumnReader("l_extendedprice");
-  FColumnReader *weekReader = mv.getColumnReader("d_weeknuminyear");
-  assert (weekReader->getColumn().compression == UNCOMPRESSED);
-
-  int16_t year = param.ints[0];
-  vector <PositionRange> ranges;
-  yearReader->getPositionRanges(SearchCond(SCT_EQUAL, &year), ranges);
-  assert (ranges.size() > 0);
-  int64_t sum = 0;
-  size_t maxLen = 0;
-  for (size_t i = 0; i < ranges.size(); ++i) {
-    const PositionRange &range = ranges[i];
-    size_t length = range.end - range.begin;
-    if (length > maxLen) maxLen = length;
-  }
-
-  // minor TODO : split the reading to suppress memory consumption.
-  scoped_array<int8_t> discBufferPtr(new int8_t[maxLen]);
-  int8_t *discBuffer = (discBufferPtr.get());
-
-  scoped_array<int32_t> extBufferPtr(new int32_t[maxLen]);
-  int32_t *extBuffer = (extBufferPtr.get());
-
-  scoped_array<int8_t> quanBufferPtr(new int8_t[maxLen]);
-  int8_t *quanBuffer = (quanBufferPtr.get());
-
-  assert (weekReader->getColumn().maxLength == sizeof(int8_t));
-  scoped_array<int8_t> weekBufferPtr(new int8_t[maxLen]);
-  int8_t *weekBuffer = (weekBufferPtr.get());
-
-  int weeknuminyear = param.ints[1];
-  int discFrom = param.ints[2];
-  int discTo = param.ints[3];
-  int quanFrom = param.ints[4];
-  int quanTo = param.ints[5];
-  for (size_t i = 0; i < ranges.size(); ++i) {
-    const PositionRange &range = ranges[i];
-    size_t length = range.end - range.begin;
-    discReader->getDecompressedData(range, discBuffer, maxLen * sizeof(int8_t));
-    extReader->getDecompressedData(range, extBuffer, maxLen * sizeof(int32_t));
-    quanReader->getDecompressedData(range, quanBuffer, maxLen * sizeof(int8_t));
-    weekReader->getDecompressedData(range, weekBuffer, maxLen * sizeof(int8_t));
-    for (size_t j = 0; j < length; ++j) {
-      if (weekBuffer[j] == weeknuminyear && discBuffer[j] >= discFrom && discBuffer[j] <= discTo && quanBuffer[j] >= quanFrom && quanBuffer[j] <= quanTo) {
-        sum += extBuffer[j] * discBuffer[j];
-      }
-    }
-  }
-
-  // in case there is on-memory current fracture, search on it too.
-  Q13BContext context(param.ints[1], param.ints[2], param.ints[3], param.ints[4], param.ints[5]);
-  btreeMVSearchYearMainMemory (CSTORE_MV_FAMILY, query13BCallback, &context, param.ints[0]);
-  sum += context.sum;
-
-  watch.stop();
-  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(watch.getElapsed(), sum));
-  VLOG(1) << "Q13C done: sum=" << sum << ". " << watch.getElapsed() << " microsec";
-  return result;
+  plan.name = "Q1.3";
+  plan.yearFrom = plan.yearTo = param.ints[0];
+  plan.predicates.push_back (createIntPredicate ("d_weeknuminyear", SCT_EQUAL, param.ints[1]));
+  plan.predicates.push_back (createIntBetween ("l_discount", param.ints[2], param.ints[3]));
+  // NOTE: only the upper bound of lo_quantity ($6) is applied, as the BTree plan always did.
+  plan.predicates.push_back (createIntPredicate ("l_quantity", SCT_LT, param.ints[5]));
+  plan.valueColumn = "l_extendedprice";
+  plan.arithmetic = ARITHMETIC_MULTIPLY;
+  plan.valueColumn2 = "l_discount";
 }
 
 // ===========
@@ -671,183 +797,20 @@ boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query13C (const SSBQuery
 // 'AMERICA' group by d_year, p_brand1 order by d_year, p_brand1;
 // $$: and lo_suppkey = s_suppkey and p_category = '$1' and s_region =
 // $$: '$2' group by d_year, p_brand1 order by d_year, p_brand1;
-#define  P_CATEGORY_SIZE 7
-#define  P_BRAND_SIZE 9
 
 void SSBQueryParam::generateRandomParamQ21 (int &seed) {
   strings.push_back (generateRandomCategory(seed));
   strings.push_back (generateRandomRegion(seed));
 }
 
-struct Q21BContext {
-  Q21BContext (const std::string &category) {
-    ::memset (p_category, 0, P_CATEGORY_SIZE);
-    ::memcpy (p_category, category.data(), category.size());
-  }
-  char p_category[P_CATEGORY_SIZE];
-  map<int16_t, map<string, int64_t> > resultMap; //map<year, map<brand, sum>>
-
-  boost::shared_ptr<SSBQueryResult> toResult () {
-    boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(RESULT_GROUP_INT16, RESULT_GROUP_STRING));
-    SSBQueryResult *resultRaw = result.get(); 
-    for (map<int16_t, map<string, int64_t> >::const_iterator yearIt = resultMap.begin(); yearIt != resultMap.end(); ++yearIt) {
-      int16_t year = yearIt->first;
-      string yearStr (reinterpret_cast<char *>(&year), sizeof(int16_t));
-      const map<string, int64_t> &brandMap = yearIt->second;
-      for (map<string, int64_t>::const_iterator brandIt = brandMap.begin(); brandIt != brandMap.end(); ++brandIt) {
-        vector<string> groupString;
-        groupString.push_back(yearStr);
-        groupString.push_back(brandIt->first);
-        resultRaw->groupedResults[groupString] = brandIt->second;
-      }
-    }
-    return result;
-  }
-};
-void query21BCallback (void *context, const MVProjection *tuple) {
-  Q21BContext* con = reinterpret_cast<Q21BContext*>(context);
-  assert (P_CATEGORY_SIZE == sizeof (tuple->p_category));
-  assert (P_BRAND_SIZE == sizeof (tuple->p_brand));
-  if (::memcmp (con->p_category, tuple->p_category, P_CATEGORY_SIZE) == 0) {
-    // con->sum += tuple->l_revenue;
-    map<int16_t, map<string, int64_t> >::iterator yearIt = con->resultMap.find(tuple->key.d_year);
-    if (yearIt == con->resultMap.end()) {
-      con->resultMap[tuple->key.d_year] = map<string, int64_t>();
-      yearIt = con->resultMap.find(tuple->key.d_year);
-    }
-    assert (yearIt != con->resultMap.end());
-    yearIt->second;
-
-    map<string, int64_t> &brandMap = yearIt->second;
-    map<string, int64_t>::iterator brandIt = brandMap.find(string(tuple->p_brand, P_BRAND_SIZE));
-    if (brandIt == brandMap.end()) {
-      brandMap[string(tuple->p_brand, P_BRAND_SIZE)] = tuple->l_revenue;
-    } else {
-      (brandIt->second) += tuple->l_revenue;
-    }
-  }
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query21B (const SSBQueryParam &param) {
-  assert (param.strings.size() >= 2);
-  StopWatch watch;
-  watch.init();
-  Q21BContext context (param.strings[0]);
-  btreeMVSearchSRegion(query21BCallback, &context, param.strings[1]);
-  boost::shared_ptr<SSBQueryResult> result = context.toResult();
-  watch.stop();
-  result->elapsedMicrosec = watch.getElapsed();
-  VLOG(1) << "Q21B done: " << result->groupedResults.size() << " rows. " << result->elapsedMicrosec << " microsec";
-  return result;
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query21C (const SSBQueryParam &param) {
+void createPlanQ21 (const SSBQueryParam &param, SSBPlan &plan) {
   assert (param.strings.size() >= 2);
-  StopWatch watch;
-  watch.init();
-  FReadOnlyCStore mv (_bufferpool, MV_PROJECTION, _signatures, _dataFolder, CSTORE_MV_MAIN_PREFIX);
-
-  FColumnReader *sregionReader = mv.getColumnReader("s_region");
-  assert (sregionReader->getColumn().compression == RLE_COMPRESSED);
-  FColumnReaderRLE *yearReader = dynamic_cast<FColumnReaderRLE*>(mv.getColumnReader("d_year"));
-  assert (yearReader != NULL);
-  FColumnReader *revReader = mv.getColumnReader("l_revenue");
-  assert (revReader->getColumn().compression == UNCOMPRESSED);
-  FColumnReaderDictionary *brandReader = dynamic_cast<FColumnReaderDictionary*>(mv.getColumnReader("p_brand"));
-  assert (brandReader->getColumn().compression == DICTIONARY_COMPRESSED);
-  int brandDictionaryBits = brandReader->getDictionaryEntrySizeInBits ();
-  FColumnReaderDictionary *categoryReader = dynamic_cast<FColumnReaderDictionary*>(mv.getColumnReader("p_category"));
-  assert (categoryReader->getColumn().compression == DICTIONARY_COMPRESSED);
-
-  string p_category = categoryReader->normalize(param.strings[0]);
-  string s_region = sregionReader->normalize(param.strings[1]);
-
-  vector <PositionRange> regionRanges;
-  sregionReader->getPositionRanges(SearchCond(SCT_EQUAL, s_region.data()), regionRanges);
-  assert (regionRanges.size() == 1);
-  const PositionRange &regionRange = regionRanges[0];
-
-  // get ranges of each year, to make grouping/ordering efficient
-  vector <pair<PositionRange, int16_t> > yearRanges;
-  yearReader->getRLECompressedData(regionRange, yearRanges);
-  assert (yearRanges.size() > 0);
-  size_t maxLen = 0;
-  vector <PositionRange> yearRangesVec;
-  for (size_t i = 0; i < yearRanges.size(); ++i) {
-    const PositionRange &range = yearRanges[i].first;
-    yearRangesVec.push_back (range);
-    size_t length = range.end - range.begin;
-    if (length > maxLen) maxLen = length;
-  }
-
-  scoped_array<int32_t> revBufferPtr(new int32_t[maxLen]);
-  int32_t *revBuffer = (revBufferPtr.get());
-  scoped_array<unsigned char> brandBufferPtr(new unsigned char[(maxLen * brandDictionaryBits / 8) + 1]);
-  unsigned char *brandBuffer = (brandBufferPtr.get());
-  const vector<string> &brands = brandReader->getAllDictionaryEntries();
-  size_t brandDictionarySize = brands.size();
-
-  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(RESULT_GROUP_INT16, RESULT_GROUP_STRING));
-  SSBQueryResult *resultRaw = result.get();
-
-  vector<boost::shared_ptr<PositionBitmap> > positions;
-  categoryReader->setSearchRanges(yearRangesVec);
-  categoryReader->getPositionBitmaps(SearchCond(SCT_EQUAL, p_category.data()), positions);
-  assert (positions.size () == yearRanges.size());
-
-  scoped_array<int64_t> sumBufferPtr(new int64_t[brandDictionarySize]);
-  int64_t *sumBuffer = (sumBufferPtr.get());
-  int rows = 0;
-  for (size_t i = 0; i < yearRanges.size(); ++i) {
-    const PositionRange &range = yearRanges[i].first;
-    size_t length = range.end - range.begin;
-    int16_t year = yearRanges[i].second;
-    string yearStr (reinterpret_cast<char *>(&year), sizeof(int16_t));
-
-    ::memset (sumBuffer, 0, sizeof(int64_t) * brandDictionarySize);
-    revReader->getDecompressedData(range, revBuffer, maxLen * sizeof(int32_t));
-
-    boost::shared_ptr<PositionBitmap> position = positions[i];
-    const unsigned char *bitmap = position->bitmap;
-    int bitOffset = 0;
-    brandReader->getDictionaryCompressedData(range, brandBuffer, (maxLen * brandDictionaryBits / 8) + 1, bitOffset);
-    assert (bitOffset == 0);
-
-    for (size_t j = 0; j < length; ++j) {
-      unsigned char byte = bitmap[j / 8];
-      unsigned char bitmask = (unsigned char) 1 << (j % 8);
-      if ((byte & bitmask) == bitmask) {
-        int16_t brandId = -1;
-        switch (brandDictionaryBits) {
-        case 8: brandId = reinterpret_cast<uint8_t*>(brandBuffer)[j]; break;
-        case 16: brandId = reinterpret_cast<uint16_t*>(brandBuffer)[j]; break;
-        default:
-          assert (false); // NOTE: could be less bits, depending on test data.
-        }
-        assert (brandId >= 0);
-        assert ((size_t) brandId < brandDictionarySize);
-        sumBuffer[brandId] += revBuffer[j];
-      }
-    }
-    for (size_t brandId = 0; brandId < brandDictionarySize; ++brandId) {
-      assert (sumBuffer[brandId] >= 0);
-      if (sumBuffer[brandId] == 0) continue;
-      ++rows;
-
-      vector<string> groupString;
-      groupString.push_back(yearStr);
-      groupString.push_back(brands[brandId]);
-      resultRaw->groupedResults[groupString] = sumBuffer[brandId];
-    }
-  }
-
-  // in case there is on-memory current fracture, search on it too.
-  Q21BContext context (param.strings[0]);
-  btreeMVSearchSRegionMainMemory(CSTORE_MV_FAMILY, query21BCallback, &context, param.strings[1]);
-  resultRaw->sumResult(*(context.toResult()));
-
-  watch.stop();
-  resultRaw->elapsedMicrosec = watch.getElapsed();
-  VLOG(1) << "Q21C done: " << rows << " rows. " << watch.getElapsed() << " microsec";
-  return result;
+  plan.name = "Q2.1";
+  plan.region = param.strings[1];
+  plan.predicates.push_back (createStringPredicate ("p_category", SCT_EQUAL, param.strings[0]));
+  plan.groupColumns.push_back ("d_year");
+  plan.groupColumns.push_back ("p_brand");
+  plan.valueColumn = "l_revenue";
 }
 
 // ===========
@@ -874,162 +837,15 @@ void SSBQueryParam::generateRandomParamQ22 (int &seed) {
   strings.push_back (generateRandomRegion(seed));
 }
 
-struct Q22BContext {
-  Q22BContext (const std::string &brand_from, const std::string &brand_to) {
-    ::memset (p_brand_from, 0, P_BRAND_SIZE);
-    ::memcpy (p_brand_from, brand_from.data(), brand_from.size());
-    ::memset (p_brand_to, 0, P_BRAND_SIZE);
-    ::memcpy (p_brand_to, brand_to.data(), brand_to.size());
-  }
-  char p_brand_from[P_BRAND_SIZE];
-  char p_brand_to[P_BRAND_SIZE];
-  map<int16_t, map<string, int64_t> > resultMap; //map<year, map<brand, sum>>
-
-  boost::shared_ptr<SSBQueryResult> toResult () {
-    boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(RESULT_GROUP_INT16, RESULT_GROUP_STRING));
-    SSBQueryResult *resultRaw = result.get(); 
-    for (map<int16_t, map<string, int64_t> >::const_iterator yearIt = resultMap.begin(); yearIt != resultMap.end(); ++yearIt) {
-      int16_t year = yearIt->first;
-      string yearStr (reinterpret_cast<char *>(&year), sizeof(int16_t));
-      const map<string, int64_t> &brandMap = yearIt->second;
-      for (map<string, int64_t>::const_iterator brandIt = brandMap.begin(); brandIt != brandMap.end(); ++brandIt) {
-        vector<string> groupString;
-        groupString.push_back(yearStr);
-        groupString.push_back(brandIt->first);
-        resultRaw->groupedResults[groupString] = brandIt->second;
-      }
-    }
-    return result;
-  }
-};
-void query22BCallback (void *context, const MVProjection *tuple) {
-  Q22BContext* con = reinterpret_cast<Q22BContext*>(context);
-  assert (P_BRAND_SIZE == sizeof (tuple->p_brand));
-  if (::memcmp (tuple->p_brand, con->p_brand_from, P_BRAND_SIZE) >= 0
-    && ::memcmp (tuple->p_brand, con->p_brand_to, P_BRAND_SIZE) <= 0) {
-    map<int16_t, map<string, int64_t> >::iterator yearIt = con->resultMap.find(tuple->key.d_year);
-    if (yearIt == con->resultMap.end()) {
-      con->resultMap[tuple->key.d_year] = map<string, int64_t>();
-      yearIt = con->resultMap.find(tuple->key.d_year);
-    }
-    assert (yearIt != con->resultMap.end());
-    yearIt->second;
-
-    map<string, int64_t> &brandMap = yearIt->second;
-    map<string, int64_t>::iterator brandIt = brandMap.find(string(tuple->p_brand, P_BRAND_SIZE));
-    if (brandIt == brandMap.end()) {
-      brandMap[string(tuple->p_brand, P_BRAND_SIZE)] = tuple->l_revenue;
-    } else {
-      (brandIt->second) += tuple->l_revenue;
-    }
-  }
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query22B (const SSBQueryParam &param) {
+void createPlanQ22 (const SSBQueryParam &param, SSBPlan &plan) {
   assert (param.strings.size() >= 3);
-  StopWatch watch;
-  watch.init();
-  Q22BContext context (param.strings[0], param.strings[1]);
-  btreeMVSearchSRegion(query22BCallback, &context, param.strings[2]);
-  boost::shared_ptr<SSBQueryResult> result = context.toResult();
-  watch.stop();
-  result->elapsedMicrosec = watch.getElapsed();
-  VLOG(1) << "Q22B done: " << result->groupedResults.size() << " rows. " << result->elapsedMicrosec << " microsec";
-  return result;
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query22C (const SSBQueryParam &param) {
-  assert (param.strings.size() >= 3);
-  StopWatch watch;
-  watch.init();
-  FReadOnlyCStore mv (_bufferpool, MV_PROJECTION, _signatures, _dataFolder, CSTORE_MV_MAIN_PREFIX);
-
-  FColumnReader *sregionReader = mv.getColumnReader("s_region");
-  FColumnReaderRLE *yearReader = dynamic_cast<FColumnReaderRLE*>(mv.getColumnReader("d_year"));
-  FColumnReader *revReader = mv.getColumnReader("l_revenue");
-  FColumnReaderDictionary *brandReader = dynamic_cast<FColumnReaderDictionary*>(mv.getColumnReader("p_brand"));
-  int brandDictionaryBits = brandReader->getDictionaryEntrySizeInBits ();
-
-  string p_brand_from = brandReader->normalize(param.strings[0]);
-  string p_brand_to = brandReader->normalize(param.strings[1]);
-  string s_region = sregionReader->normalize(param.strings[2]);
-
-  vector <PositionRange> regionRanges;
-  sregionReader->getPositionRanges(SearchCond(SCT_EQUAL, s_region.data()), regionRanges);
-  assert (regionRanges.size() == 1);
-  const PositionRange &regionRange = regionRanges[0];
-
-  vector <pair<PositionRange, int16_t> > yearRanges;
-  yearReader->getRLECompressedData(regionRange, yearRanges);
-  assert (yearRanges.size() > 0);
-  size_t maxLen = 0;
-  for (size_t i = 0; i < yearRanges.size(); ++i) {
-    const PositionRange &range = yearRanges[i].first;
-    size_t length = range.end - range.begin;
-    if (length > maxLen) maxLen = length;
-  }
-
-  scoped_array<int32_t> revBufferPtr(new int32_t[maxLen]);
-  int32_t *revBuffer = (revBufferPtr.get());
-  scoped_array<unsigned char> brandBufferPtr(new unsigned char[(maxLen * brandDictionaryBits / 8) + 1]);
-  unsigned char *brandBuffer = (brandBufferPtr.get());
-  const vector<string> &brands = brandReader->getAllDictionaryEntries();
-  size_t brandDictionarySize = brands.size();
-  vector<int> matchingBrandIds = brandReader->searchDictionary(SearchCond(p_brand_from.data(), p_brand_to.data()));
-
-  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(RESULT_GROUP_INT16, RESULT_GROUP_STRING));
-  SSBQueryResult *resultRaw = result.get();
-
-  scoped_array<int64_t> resultsPtr(new int64_t[brandDictionarySize]);
-  int64_t *results = resultsPtr.get();
-  int rows = 0;
-  for (size_t i = 0; i < yearRanges.size(); ++i) {
-    const PositionRange &range = yearRanges[i].first;
-    size_t length = range.end - range.begin;
-    int16_t year = yearRanges[i].second;
-    string yearStr (reinterpret_cast<char *>(&year), sizeof(int16_t));
-
-    ::memset (results, 0, sizeof(int64_t) * brandDictionarySize);
-    revReader->getDecompressedData(range, revBuffer, maxLen * sizeof(int32_t));
-
-    int bitOffset = 0;
-    brandReader->getDictionaryCompressedData(range, brandBuffer, (maxLen * brandDictionaryBits / 8) + 1, bitOffset);
-    assert (bitOffset == 0);
-
-    for (size_t j = 0; j < length; ++j) {
-      int brandId = -1;
-      switch (brandDictionaryBits) {
-      case 8: brandId = reinterpret_cast<uint8_t*>(brandBuffer)[j]; break;
-      case 16: brandId = reinterpret_cast<uint16_t*>(brandBuffer)[j]; break;
-      default:
-        assert (false); // NOTE: could be less bits, depending on test data.
-      }
-      assert (brandId >= 0);
-      assert ((size_t) brandId < brandDictionarySize);
-      bool matched = std::find(matchingBrandIds.begin(), matchingBrandIds.end(), brandId) != matchingBrandIds.end();
-      if (matched) {
-        results[brandId] += revBuffer[j];
-      }
-    }
-    for (size_t brandId = 0; brandId < brandDictionarySize; ++brandId) {
-      assert (results[brandId] >= 0);
-      if (results[brandId] == 0) continue;
-      ++rows;
-
-      vector<string> groupString;
-      groupString.push_back(yearStr);
-      groupString.push_back(brands[brandId]);
-      resultRaw->groupedResults[groupString] = results[brandId];
-    }
-  }
-
-  // in case there is on-memory current fracture, search on it too.
-  Q22BContext context (param.strings[0], param.strings[1]);
-  btreeMVSearchSRegionMainMemory(CSTORE_MV_FAMILY, query22BCallback, &context, param.strings[2]);
-  resultRaw->sumResult(*(context.toResult()));
-
-  watch.stop();
-  resultRaw->elapsedMicrosec = watch.getElapsed();
-  VLOG(1) << "Q22C done: " << rows << " rows. " << watch.getElapsed() << " microsec";
-  return result;
+  plan.name = "Q2.2";
+  plan.region = param.strings[2];
+  // the dictionary is order-preserving, so this is evaluated on codes.
+  plan.predicates.push_back (createStringBetween ("p_brand", param.strings[0], param.strings[1]));
+  plan.groupColumns.push_back ("d_year");
+  plan.groupColumns.push_back ("p_brand");
+  plan.valueColumn = "l_revenue";
 }
 
 // ===========
@@ -1047,173 +863,207 @@ void SSBQueryParam::generateRandomParamQ23 (int &seed) {
   strings.push_back (generateRandomRegion(seed));
 }
 
-struct Q23BContext {
-  Q23BContext (const std::string &brand) {
-    ::memset (p_brand, 0, P_BRAND_SIZE);
-    ::memcpy (p_brand, brand.data(), brand.size());
-  }
-  char p_brand[P_BRAND_SIZE];
-  map<int16_t, int64_t> resultMap; //map<year, sum>
-
-  boost::shared_ptr<SSBQueryResult> toResult () {
-    boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(RESULT_GROUP_INT16));
-    SSBQueryResult *resultRaw = result.get();
-    for (map<int16_t, int64_t>::const_iterator yearIt = resultMap.begin(); yearIt != resultMap.end(); ++yearIt) {
-      int16_t year = yearIt->first;
-      string yearStr (reinterpret_cast<char *>(&year), sizeof(int16_t));
-      vector<string> groupString;
-      groupString.push_back(yearStr);
-      resultRaw->groupedResults[groupString] = yearIt->second;
-    }
-    return result;
-  }
-};
-void query23BCallback (void *context, const MVProjection *tuple) {
-  Q23BContext* con = reinterpret_cast<Q23BContext*>(context);
-  assert (P_BRAND_SIZE == sizeof (tuple->p_brand));
-  if (::memcmp (tuple->p_brand, con->p_brand, P_BRAND_SIZE) == 0) {
-    map<int16_t, int64_t>::iterator yearIt = con->resultMap.find(tuple->key.d_year);
-    if (yearIt == con->resultMap.end()) {
-      con->resultMap[tuple->key.d_year] = tuple->l_revenue;
-    } else {
-      (yearIt->second) += tuple->l_revenue;
-    }
-  }
-}
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query23B (const SSBQueryParam &param) {
+void createPlanQ23 (const SSBQueryParam &param, SSBPlan &plan) {
   assert (param.strings.size() >= 2);
-  StopWatch watch;
-  watch.init();
-  Q23BContext context (param.strings[0]);
-  btreeMVSearchSRegion(query23BCallback, &context, param.strings[1]);
-  boost::shared_ptr<SSBQueryResult> result = context.toResult();
-  watch.stop();
-  result->elapsedMicrosec = watch.getElapsed();
-  VLOG(1) << "Q23B done: " << result->groupedResults.size() << " rows. " << result->elapsedMicrosec << " microsec";
-  return result;
+  plan.name = "Q2.3";
+  plan.region = param.strings[1];
+  plan.predicates.push_back (createStringPredicate ("p_brand", SCT_EQUAL, param.strings[0]));
+  plan.groupColumns.push_back ("d_year");
+  plan.valueColumn = "l_revenue";
 }
-boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query23C (const SSBQueryParam &param) {
-  assert (param.strings.size() >= 2);
-  StopWatch watch;
-  watch.init();
-
-  FReadOnlyCStore mv (_bufferpool, MV_PROJECTION, _signatures, _dataFolder, CSTORE_MV_MAIN_PREFIX);
-
-  FColumnReader *sregionReader = mv.getColumnReader("s_region");
-  FColumnReaderRLE *yearReader = dynamic_cast<FColumnReaderRLE*>(mv.getColumnReader("d_year"));
-  FColumnReader *revReader = mv.getColumnReader("l_revenue");
-  FColumnReaderDictionary *brandReader = dynamic_cast<FColumnReaderDictionary*>(mv.getColumnReader("p_brand"));
-
-  string p_brand = brandReader->normalize(param.strings[0]);
-  string s_region = sregionReader->normalize(param.strings[1]);
-
-  vector <PositionRange> regionRanges;
-  sregionReader->getPositionRanges(SearchCond(SCT_EQUAL, s_region.data()), regionRanges);
-  assert (regionRanges.size() == 1);
-  const PositionRange &regionRange = regionRanges[0];
-
-  vector <pair<PositionRange, int16_t> > yearRanges;
-  yearReader->getRLECompressedData(regionRange, yearRanges);
-  assert (yearRanges.size() > 0);
-  size_t maxLen = 0;
-  vector <PositionRange> yearRangesVec;
-  for (size_t i = 0; i < yearRanges.size(); ++i) {
-    const PositionRange &range = yearRanges[i].first;
-    yearRangesVec.push_back (range);
-    size_t length = range.end - range.begin;
-    if (length > maxLen) maxLen = length;
-  }
-
-  scoped_array<int32_t> revBufferPtr(new int32_t[maxLen]);
-  int32_t *revBuffer = (revBufferPtr.get());
-
-  boost::shared_ptr<SSBQueryResult> result (new SSBQueryResult(RESULT_GROUP_INT16));
-  SSBQueryResult *resultRaw = result.get();
 
-  vector<boost::shared_ptr<PositionBitmap> > positions;
-  brandReader->setSearchRanges(yearRangesVec);
-  brandReader->getPositionBitmaps(SearchCond(SCT_EQUAL, p_brand.data()), positions);
-  assert (positions.size () == yearRanges.size());
 
-  int rows = 0;
-  for (size_t i = 0; i < yearRanges.size(); ++i) {
-    const PositionRange &range = yearRanges[i].first;
-    size_t length = range.end - range.begin;
-    int16_t year = yearRanges[i].second;
-    string yearStr (reinterpret_cast<char *>(&year), sizeof(int16_t));
-
-    revReader->getDecompressedData(range, revBuffer, maxLen * sizeof(int32_t));
+// ===========
+//  common to Q3.x/Q4.x plans
+// ===========
+// join conditions are already resolved in MVProjection. the RLE sort columns
+// (c_region, s_nation, c_nation, s_city, c_city) narrow the key range by their runs,
+// and group values on them are read once per run (see FColumnScan).
+// a nation or a city determines the region, which is added to the plan as the key range.
+
+SSBPredicate createStringIn (const std::string &column, const std::string &value1, const std::string &value2) {
+  SSBPredicate predicate (column, SCT_IN);
+  predicate.values.push_back (toMVColumnValue(column, value1));
+  predicate.values.push_back (toMVColumnValue(column, value2));
+  return predicate;
+}
 
-    boost::shared_ptr<PositionBitmap> position = positions[i];
-    const unsigned char *bitmap = position->bitmap;
+// c_nation = s_nation = nation, in the region of the nation.
+void addSameNationPredicates (const std::string &nation, SSBPlan &plan) {
+  plan.region = getRegionOfNation (nation);
+  plan.predicates.push_back (createStringPredicate ("c_region", SCT_EQUAL, plan.region));
+  plan.predicates.push_back (createStringPredicate ("s_nation", SCT_EQUAL, nation));
+  plan.predicates.push_back (createStringPredicate ("c_nation", SCT_EQUAL, nation));
+}
 
-    int64_t sum = 0;
-    for (size_t j = 0; j < length; ++j) {
-      unsigned char byte = bitmap[j / 8];
-      unsigned char bitmask = (unsigned char) 1 << (j % 8);
-      if ((byte & bitmask) == bitmask) {
-        sum += revBuffer[j];
-      }
-    }
-    if (sum != 0) {
-      ++rows;
-      vector<string> groupString;
-      groupString.push_back(yearStr);
-      resultRaw->groupedResults[groupString] = sum;
-    }
+// (c_city = $1 or c_city = $2) and (s_city = $1 or s_city = $2)
+void addCityPredicates (const std::string &city1, const std::string &city2, SSBPlan &plan) {
+  const std::string nation = getNationOfCity (city1);
+  if (nation == getNationOfCity (city2)) {
+    addSameNationPredicates (nation, plan);
   }
-
-  // in case there is on-memory current fracture, search on it too.
-  Q23BContext context (param.strings[0]);
-  btreeMVSearchSRegionMainMemory(CSTORE_MV_FAMILY, query23BCallback, &context, param.strings[1]);
-  resultRaw->sumResult(*(context.toResult()));
-
-  watch.stop();
-  resultRaw->elapsedMicrosec = watch.getElapsed();
-  VLOG(1) << "Q23C done: " << rows << " rows. " << watch.getElapsed() << " microsec";
-  return result;
+  plan.predicates.push_back (createStringIn ("s_city", city1, city2));
+  plan.predicates.push_back (createStringIn ("c_city", city1, city2));
 }
 
-// Q3.1
+// ===========
+//  Q3.1
+// ===========
 // select c_nation, s_nation, d_year, sum(lo_revenue) as revenue from
 // customer, lineorder, supplier, dwdate where lo_custkey = c_custkey and
 // lo_suppkey = s_suppkey and lo_orderdate = d_datekey and c_region = 'ASIA'
 // and s_region = 'ASIA' and d_year >= 1992 and d_year <= 1997 group by
 // c_nation, s_nation, d_year order by d_year asc, revenue desc;
+// $$: lo_suppkey = s_suppkey and lo_orderdate = d_datekey and c_region = '$1'
+// $$: and s_region = '$1' and d_year >= $2 and d_year <= $3 group by
+// NOTE: the result is not ordered (so are other queries).
+
+void SSBQueryParam::generateRandomParamQ31 (int &seed) {
+  strings.push_back (generateRandomRegion(seed));
+  generateRandomYearRange (seed, ints);
+}
 
-// Q3.2
+void createPlanQ31 (const SSBQueryParam &param, SSBPlan &plan) {
+  assert (param.strings.size() >= 1);
+  assert (param.ints.size() >= 2);
+  plan.name = "Q3.1";
+  plan.region = param.strings[0];
+  plan.yearFrom = param.ints[0];
+  plan.yearTo = param.ints[1];
+  plan.predicates.push_back (createStringPredicate ("c_region", SCT_EQUAL, param.strings[0]));
+  plan.groupColumns.push_back ("c_nation");
+  plan.groupColumns.push_back ("s_nation");
+  plan.groupColumns.push_back ("d_year");
+  plan.valueColumn = "l_revenue";
+}
+
+// ===========
+//  Q3.2
+// ===========
 // select c_city, s_city, d_year, sum(lo_revenue) as revenue from
 // customer, lineorder, supplier, dwdate where lo_custkey = c_custkey and
 // lo_suppkey = s_suppkey and lo_orderdate = d_datekey and c_nation =
 // 'UNITED STATES' and s_nation = 'UNITED STATES' and d_year >= 1992 and
 // d_year <= 1997 group by c_city, s_city, d_year order by d_year asc,
 // revenue desc;
+// $$: lo_suppkey = s_suppkey and lo_orderdate = d_datekey and c_nation =
+// $$: '$1' and s_nation = '$1' and d_year >= $2 and
+// $$: d_year <= $3 group by c_city, s_city, d_year order by d_year asc,
+
+void SSBQueryParam::generateRandomParamQ32 (int &seed) {
+  strings.push_back (generateRandomNation(seed));
+  generateRandomYearRange (seed, ints);
+}
+
+void createPlanQ32 (const SSBQueryParam &param, SSBPlan &plan) {
+  assert (param.strings.size() >= 1);
+  assert (param.ints.size() >= 2);
+  plan.name = "Q3.2";
+  plan.yearFrom = param.ints[0];
+  plan.yearTo = param.ints[1];
+  addSameNationPredicates (param.strings[0], plan);
+  plan.groupColumns.push_back ("c_city");
+  plan.groupColumns.push_back ("s_city");
+  plan.groupColumns.push_back ("d_year");
+  plan.valueColumn = "l_revenue";
+}
 
-// Q3.3
+// ===========
+//  Q3.3
+// ===========
 // select c_city, s_city, d_year, sum(lo_revenue) as revenue from
 // customer, lineorder, supplier, dwdate where lo_custkey = c_custkey and
 // lo_suppkey = s_suppkey and lo_orderdate = d_datekey and (c_city='UNITED
 // KI1' or c_city='UNITED KI5') and (s_city='UNITED KI1' or s_city='UNITED
 // KI5') and d_year >= 1992 and d_year <= 1997 group by c_city, s_city,
 // d_year order by d_year asc, revenue desc;
+// $$: lo_suppkey = s_suppkey and lo_orderdate = d_datekey and (c_city='$1'
+// $$: or c_city='$2') and (s_city='$1' or s_city='$2') and d_year >= $3
+// $$: and d_year <= $4 group by c_city, s_city,
 
-// Q3.4
+void SSBQueryParam::generateRandomParamQ33 (int &seed) {
+  generateRandomCityPair (seed, strings);
+  generateRandomYearRange (seed, ints);
+}
+
+void createPlanQ33 (const SSBQueryParam &param, SSBPlan &plan) {
+  assert (param.strings.size() >= 2);
+  assert (param.ints.size() >= 2);
+  plan.name = "Q3.3";
+  plan.yearFrom = param.ints[0];
+  plan.yearTo = param.ints[1];
+  addCityPredicates (param.strings[0], param.strings[1], plan);
+  plan.groupColumns.push_back ("c_city");
+  plan.groupColumns.push_back ("s_city");
+  plan.groupColumns.push_back ("d_year");
+  plan.valueColumn = "l_revenue";
+}
+
+// ===========
+//  Q3.4
+// ===========
 // select c_city, s_city, d_year, sum(lo_revenue) as revenue from
 // customer, lineorder, supplier, dwdate where lo_custkey = c_custkey and
 // lo_suppkey = s_suppkey and lo_orderdate = d_datekey and (c_city='UNITED
 // KI1' or c_city='UNITED KI5') and (s_city='UNITED KI1' or s_city='UNITED
 // KI5') and d_yearmonth = 'Dec1997' group by c_city, s_city, d_year order
 // by d_year asc, revenue desc;
+// $$: lo_suppkey = s_suppkey and lo_orderdate = d_datekey and (c_city='$1'
+// $$: or c_city='$2') and (s_city='$1' or s_city='$2')
+// $$: and d_yearmonth = '$3' group by c_city, s_city, d_year order
+
+void SSBQueryParam::generateRandomParamQ34 (int &seed) {
+  generateRandomCityPair (seed, strings);
+  strings.push_back (generateRandomYearMonth(seed));
+}
+
+void createPlanQ34 (const SSBQueryParam &param, SSBPlan &plan) {
+  assert (param.strings.size() >= 3);
+  plan.name = "Q3.4";
+  // d_yearmonth (e.g., 'Dec1997') determines d_year
+  assert (param.strings[2].size() == 7);
+  plan.yearFrom = plan.yearTo = ::atoi (param.strings[2].substr(3).c_str());
+  addCityPredicates (param.strings[0], param.strings[1], plan);
+  plan.predicates.push_back (createStringPredicate ("d_yearmonth", SCT_EQUAL, param.strings[2]));
+  plan.groupColumns.push_back ("c_city");
+  plan.groupColumns.push_back ("s_city");
+  plan.groupColumns.push_back ("d_year");
+  plan.valueColumn = "l_revenue";
+}
 
-// Q4.1
+// ===========
+//  Q4.1
+// ===========
 // select d_year, c_nation, sum(lo_revenue - lo_supplycost) as profit
 // from dwdate, customer, supplier, part, lineorder where lo_custkey =
 // c_custkey and lo_suppkey = s_suppkey and lo_partkey = p_partkey and
 // lo_orderdate = d_datekey and c_region = 'AMERICA' and s_region =
 // 'AMERICA' and (p_mfgr = 'MFGR#1' or p_mfgr = 'MFGR#2') group by d_year,
 // c_nation order by d_year, c_nation;
+// $$: lo_orderdate = d_datekey and c_region = '$1' and s_region =
+// $$: '$1' and (p_mfgr = '$2' or p_mfgr = '$3') group by d_year,
+
+void SSBQueryParam::generateRandomParamQ41 (int &seed) {
+  strings.push_back (generateRandomRegion(seed));
+  generateRandomMfgrPair (seed, strings);
+}
 
-// Q4.2
+void createPlanQ41 (const SSBQueryParam &param, SSBPlan &plan) {
+  assert (param.strings.size() >= 3);
+  plan.name = "Q4.1";
+  plan.region = param.strings[0];
+  plan.predicates.push_back (createStringPredicate ("c_region", SCT_EQUAL, param.strings[0]));
+  plan.predicates.push_back (createStringIn ("p_mfgr", param.strings[1], param.strings[2]));
+  plan.groupColumns.push_back ("d_year");
+  plan.groupColumns.push_back ("c_nation");
+  plan.valueColumn = "l_revenue";
+  plan.arithmetic = ARITHMETIC_SUBTRACT;
+  plan.valueColumn2 = "l_supplycost";
+}
+
+// ===========
+//  Q4.2
+// ===========
 // select d_year, s_nation, p_category, sum(lo_revenue - lo_supplycost)
 // as profit from dwdate, customer, supplier, part, lineorder where
 // lo_custkey = c_custkey and lo_suppkey = s_suppkey and lo_partkey =
@@ -1221,15 +1071,68 @@ boost::shared_ptr<SSBQueryResult> SSBQueryExecutorImpl::query23C (const SSBQuery
 // s_region = 'AMERICA' and (d_year = 1997 or d_year = 1998) and (p_mfgr =
 // 'MFGR#1' or p_mfgr = 'MFGR#2') group by d_year, s_nation, p_category
 // order by d_year, s_nation, p_category;
+// $$: p_partkey and lo_orderdate = d_datekey and c_region = '$1' and
+// $$: s_region = '$1' and (d_year = $4 or d_year = $4 + 1) and (p_mfgr =
+// $$: '$2' or p_mfgr = '$3') group by d_year, s_nation, p_category
+
+void SSBQueryParam::generateRandomParamQ42 (int &seed) {
+  strings.push_back (generateRandomRegion(seed));
+  generateRandomMfgrPair (seed, strings);
+  ints.push_back (generateUInt(seed, 1992, 1998));
+}
+
+void createPlanQ42 (const SSBQueryParam &param, SSBPlan &plan) {
+  assert (param.strings.size() >= 3);
+  assert (param.ints.size() >= 1);
+  plan.name = "Q4.2";
+  plan.region = param.strings[0];
+  plan.yearFrom = param.ints[0];
+  plan.yearTo = param.ints[0] + 1;
+  plan.predicates.push_back (createStringPredicate ("c_region", SCT_EQUAL, param.strings[0]));
+  plan.predicates.push_back (createStringIn ("p_mfgr", param.strings[1], param.strings[2]));
+  plan.groupColumns.push_back ("d_year");
+  plan.groupColumns.push_back ("s_nation");
+  plan.groupColumns.push_back ("p_category");
+  plan.valueColumn = "l_revenue";
+  plan.arithmetic = ARITHMETIC_SUBTRACT;
+  plan.valueColumn2 = "l_supplycost";
+}
 
-// Q4.3
+// ===========
+//  Q4.3
+// ===========
 // select d_year, s_city, p_brand1, sum(lo_revenue - lo_supplycost) as
 // profit from dwdate, customer, supplier, part, lineorder where lo_custkey
 // = c_custkey and lo_suppkey = s_suppkey and lo_partkey = p_partkey and
 // lo_orderdate = d_datekey and s_nation = 'UNITED STATES' and (d_year =
 // 1997 or d_year = 1998) and p_category = 'MFGR#14' group by d_year,
 // s_city, p_brand1; order by d_year, s_city, p_brand1;
+// $$: lo_orderdate = d_datekey and s_nation = '$1' and (d_year =
+// $$: $3 or d_year = $3 + 1) and p_category = '$2' group by d_year,
 
+void SSBQueryParam::generateRandomParamQ43 (int &seed) {
+  strings.push_back (generateRandomNation(seed));
+  strings.push_back (generateRandomCategory(seed));
+  ints.push_back (generateUInt(seed, 1992, 1998));
+}
+
+void createPlanQ43 (const SSBQueryParam &param, SSBPlan &plan) {
+  assert (param.strings.size() >= 2);
+  assert (param.ints.size() >= 1);
+  plan.name = "Q4.3";
+  // s_nation determines s_region
+  plan.region = getRegionOfNation (param.strings[0]);
+  plan.yearFrom = param.ints[0];
+  plan.yearTo = param.ints[0] + 1;
+  plan.predicates.push_back (createStringPredicate ("s_nation", SCT_EQUAL, param.strings[0]));
+  plan.predicates.push_back (createStringPredicate ("p_category", SCT_EQUAL, param.strings[1]));
+  plan.groupColumns.push_back ("d_year");
+  plan.groupColumns.push_back ("s_city");
+  plan.groupColumns.push_back ("p_brand");
+  plan.valueColumn = "l_revenue";
+  plan.arithmetic = ARITHMETIC_SUBTRACT;
+  plan.valueColumn2 = "l_supplycost";
+}
 
 // ==========================================================================
 //  Query parameter random generation
@@ -1250,6 +1153,20 @@ void SSBQueryParam::generateRandomParam (int query, int &seed) {
     break;
   case 23: generateRandomParamQ23(seed);
     break;
+  case 31: generateRandomParamQ31(seed);
+    break;
+  case 32: generateRandomParamQ32(seed);
+    break;
+  case 33: generateRandomParamQ33(seed);
+    break;
+  case 34: generateRandomParamQ34(seed);
+    break;
+  case 41: generateRandomParamQ41(seed);
+    break;
+  case 42: generateRandomParamQ42(seed);
+    break;
+  case 43: generateRandomParamQ43(seed);
+    break;
   default:
     assert (false);
   }
@@ -1304,10 +1221,45 @@ std::string generateRandomBrand (int &seed) {
   str << "MFGR#" << generateRandomBrandId(seed);
   return str.str();
 }
+std::string generateRandomNation (int &seed) {
+  return NATIONS[generateUInt(seed, 0, NATION_COUNT)][0];
+}
+std::string generateRandomYearMonth (int &seed) {
+  const char* MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+  stringstream str;
+  str << MONTHS[generateUInt(seed, 0, 12)];
+  str << generateUInt(seed, 1992, 1999);
+  return str.str();
+}
+// d_year >= $2 and d_year <= $3 of flight 3.
+void generateRandomYearRange (int &seed, std::vector<int> &ints) {
+  int yearFrom = generateUInt(seed, 1992, 1997);
+  int yearTo = std::min (yearFrom + 5, 1998);
+  ints.push_back (yearFrom);
+  ints.push_back (yearTo);
+}
+// two different cities of a nation.
+void generateRandomCityPair (int &seed, std::vector<std::string> &strings) {
+  std::string nation = generateRandomNation(seed);
+  int city1 = generateUInt(seed, 0, 10);
+  int city2 = (city1 + generateUInt(seed, 1, 10)) % 10;
+  strings.push_back (getCityOfNation(nation, city1));
+  strings.push_back (getCityOfNation(nation, city2));
+}
+// two different manufacturers.
+void generateRandomMfgrPair (int &seed, std::vector<std::string> &strings) {
+  int mfgr1 = generateUInt(seed, P_MFG_MIN, P_MFG_MAX);
+  int mfgr2 = P_MFG_MIN + (mfgr1 - P_MFG_MIN + generateUInt(seed, 1, P_MFG_MAX - P_MFG_MIN)) % (P_MFG_MAX - P_MFG_MIN);
+  stringstream str1, str2;
+  str1 << "MFGR#" << mfgr1;
+  str2 << "MFGR#" << mfgr2;
+  strings.push_back (str1.str());
+  strings.push_back (str2.str());
+}
 
-int generateRandomQuery (int &seed) {
-  const int implementedQueries [] = {11, 12, 13, 21, 22, 23};
-  const size_t queryCount = 6;
+int generateRandomQuery (int &seed, bool includeFlights34) {
+  const int implementedQueries [] = {11, 12, 13, 21, 22, 23, 31, 32, 33, 34, 41, 42, 43};
+  const size_t queryCount = includeFlights34 ? 13 : 6;
   int query = implementedQueries[generateUInt(seed, 0, queryCount)];
   return query;
 }
@@ -1,6 +1,7 @@
 #ifndef SSB_QUERYSSB_H
 #define SSB_QUERYSSB_H
 
+#include "../configvalues.h"
 #include <stdint.h>
 #include <map>
 #include <string>
@@ -11,12 +12,18 @@ namespace fdb {
 
 
 unsigned int generateUInt (int &seed, unsigned int beginVal, unsigned int endVal);
-int generateRandomQuery (int &seed);
+// queries of flights 3 and 4 (Q3.x, Q4.x) are included only if includeFlights34.
+int generateRandomQuery (int &seed, bool includeFlights34 = false);
 std::string generateRandomRegion (int &seed);
 std::string generateRandomMfgr (int &seed);
 std::string generateRandomCategory (int &seed);
 std::string generateRandomBrand (int &seed);
 int generateRandomBrandId (int &seed);
+std::string generateRandomNation (int &seed);
+std::string generateRandomYearMonth (int &seed);
+void generateRandomYearRange (int &seed, std::vector<int> &ints);
+void generateRandomCityPair (int &seed, std::vector<std::string> &strings);
+void generateRandomMfgrPair (int &seed, std::vector<std::string> &strings);
 struct SSBQueryParam {
   std::vector<int> ints;
   std::vector<std::string> strings;
@@ -30,6 +37,13 @@ struct SSBQueryParam {
   void generateRandomParamQ21 (int &seed);
   void generateRandomParamQ22 (int &seed);
   void generateRandomParamQ23 (int &seed);
+  void generateRandomParamQ31 (int &seed);
+  void generateRandomParamQ32 (int &seed);
+  void generateRandomParamQ33 (int &seed);
+  void generateRandomParamQ34 (int &seed);
+  void generateRandomParamQ41 (int &seed);
+  void generateRandomParamQ42 (int &seed);
+  void generateRandomParamQ43 (int &seed);
 };
 
 enum ResultGroupColumType {
@@ -86,6 +100,10 @@ public:
   // execute the specified SSB query (out of 13 queries defined in SSB spec)
   boost::shared_ptr<SSBQueryResult> query (int query, bool cstore, const SSBQueryParam &param);
 
+  // c-store plans scan the on-disk projection with this number of threads, each taking
+  // morsels of morselSize positions (see FParallelScan). all cores by default.
+  void setParallelism (int threads, int64_t morselSize = FDB_MORSEL_SIZE);
+
   FEngine* getEngine();
   SSBQueryExecutorImpl* getImpl() {return _impl;} // only for testcases
 private:
@@ -2,6 +2,13 @@
 #define SSB_QUERYSSBIMPL_H
 
 #include "queryssb.h"
+#include "../engine/ffamily.h"
+#include "../storage/foperator.h"
+#include "../storage/searchcond.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
 
 namespace fdb {
 
@@ -9,47 +16,92 @@ namespace fdb {
 #define BTREE_MV_FAMILY "mvprojection.btree"
 #define CSTORE_MV_MAIN_PREFIX "mvprojection"
 #define CSTORE_MV_FAMILY "mvprojection.cstore"
+#define LINEORDER_FAMILY "lineorder.btree"
 
 class FEngine;
 class FBufferPool;
 class FSignatureSet;
 class MVProjection;
-typedef void (*BtreeMVSearchCallback) (void *context, const MVProjection *tuple);
+class FMainMemoryBTree;
+class FMainMemoryCStore;
+class FReadOnlyCStore;
+class FReadOnlyDiskBTree;
+
+// a predicate of a query plan on a column of MVProjection.
+// values are raw bytes in the column type (e.g., int8_t for INT8, NULL-padded string for CHAR).
+struct SSBPredicate {
+  SSBPredicate (const std::string &column_, SearchCondType type_) : column(column_), type(type_) {}
+  // points to values, so valid while this object lives.
+  SearchCond toSearchCond () const;
+
+  std::string column;
+  SearchCondType type;
+  std::vector<std::string> values; // 2 values for BETWEEN
+};
+
+// a query on MVProjection, executed by the operators (see foperator.h) on any fracture.
+//   SELECT SUM(valueColumn [arithmetic valueColumn2]) WHERE <key range> AND predicates GROUP BY groupColumns
+// the key range (s_region, d_year) is the sort order of MVProjection, thus searched by
+// key prefixes on BTree and by RLE runs on c-store. predicates on the following sort columns
+// (c_region, s_nation, .., c_city, ..) further narrow it in the same way.
+struct SSBPlan {
+  SSBPlan () : yearFrom(0), yearTo(0), arithmetic(ARITHMETIC_MULTIPLY) {}
+
+  std::string name; // e.g., "Q1.1"
+  std::string region; // s_region. empty for any
+  int16_t yearFrom, yearTo; // d_year (inclusive). 0 for any
+  std::vector<SSBPredicate> predicates;
+  std::vector<std::string> groupColumns; // empty for a single SUM
+  std::string valueColumn;
+  FArithmetic arithmetic;
+  std::string valueColumn2; // empty to sum valueColumn itself
+};
+
+void createPlanQ11 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ12 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ13 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ21 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ22 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ23 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ31 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ32 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ33 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ34 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ41 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ42 (const SSBQueryParam &param, SSBPlan &plan);
+void createPlanQ43 (const SSBQueryParam &param, SSBPlan &plan);
+
+// the on-disk c-store MV projection opened for each query thread.
+// column readers keep search ranges, so threads never share them.
+struct MVCStores {
+  std::vector<FReadOnlyCStore*> cstores; // one for each thread
+  std::vector<boost::shared_ptr<FReadOnlyCStore> > opened; // owns cstores, closed with this object
+};
 class SSBQueryExecutorImpl {
 public:
   SSBQueryExecutorImpl (FEngine *engine);
   FEngine* getEngine();
 
   boost::shared_ptr<SSBQueryResult> query (int query, bool cstore, const SSBQueryParam &param);
+  void setParallelism (int threads, int64_t morselSize);
 
-  void btreeMVSearchYear (BtreeMVSearchCallback callback, void* context, int year);
-  void btreeMVSearchYearMainMemory (const std::string &familyName, BtreeMVSearchCallback callback, void* childContext, int year);
-
-  void btreeMVSearchSRegion (BtreeMVSearchCallback callback, void* context, const std::string &region);
-  void btreeMVSearchSRegionMainMemory (const std::string &familyName, BtreeMVSearchCallback callback, void* childContext, const std::string &region);
-
-  boost::shared_ptr<SSBQueryResult> query11B (const SSBQueryParam &param);
-  boost::shared_ptr<SSBQueryResult> query11C (const SSBQueryParam &param);
-
-  boost::shared_ptr<SSBQueryResult> query12B (const SSBQueryParam &param);
-  boost::shared_ptr<SSBQueryResult> query12C (const SSBQueryParam &param);
-
-  boost::shared_ptr<SSBQueryResult> query13B (const SSBQueryParam &param);
-  boost::shared_ptr<SSBQueryResult> query13C (const SSBQueryParam &param);
-
-  boost::shared_ptr<SSBQueryResult> query21B (const SSBQueryParam &param);
-  boost::shared_ptr<SSBQueryResult> query21C (const SSBQueryParam &param);
-
-  boost::shared_ptr<SSBQueryResult> query22B (const SSBQueryParam &param);
-  boost::shared_ptr<SSBQueryResult> query22C (const SSBQueryParam &param);
+  // executes the plan on all fractures of the c-store (cstore=true) or BTree MV projection:
+  // the main projection, and on-disk, sealed and current fractures in a snapshot of the family.
+  boost::shared_ptr<SSBQueryResult> executePlan (const SSBPlan &plan, bool cstore);
 
-  boost::shared_ptr<SSBQueryResult> query23B (const SSBQueryParam &param);
-  boost::shared_ptr<SSBQueryResult> query23C (const SSBQueryParam &param);
+  // opens the on-disk c-store MV projection for each of _threads threads.
+  void openMVCStores (MVCStores &stores);
+  // same as above, but an on-disk fracture of the c-store family (see FFractureFile::getSignatures()).
+  void openMVCStores (const std::vector<FFileSignature> &signatures, MVCStores &stores);
+  // returns the latest snapshot of the family. an empty one if the family doesn't exist.
+  FFractureSnapshotPtr acquireSnapshot (const std::string &familyName);
 
   FEngine *_engine;
   std::string _dataFolder;
   FBufferPool *_bufferpool;
-  const FSignatureSet &_signatures;
+  const FSignatureSet &_signatures; // read with FEngine::getCatalogMutex() locked
+  int _threads; // threads to scan on-disk c-store in a query
+  int64_t _morselSize;
 };
 
 } //fdb
@@ -7,6 +7,7 @@
 #include "../engine/fengine.h"
 #include "../engine/ffamily.h"
 #include "../storage/fbtree.h"
+#include "../storage/fcstore.h"
 #include "../util/stopwatch.h"
 #include <fstream>
 #include <glog/logging.h>
@@ -16,29 +17,32 @@ using namespace boost;
 
 namespace fdb {
 
-int64_t finishFracture (FMainMemoryBTree &btree) {
+int64_t flushFamily (FFamily &family) {
   StopWatch watch;
   watch.init();
-  btree.finishInserts();
+  family.flush();
   watch.stop();
+  FIngestStats stats = family.getIngestStats();
+  LOG(INFO) << "flushed " << family.getName() << ". sealed=" << stats.sealedFractures << ", dumped=" << stats.dumpedFractures
+    << ", failed=" << stats.failedDumps << ", dumpMicros=" << stats.dumpMicros << ", stalledMicros=" << stats.stalledMicros;
   return watch.getElapsed();
 }
 
-void runSSBBench(size_t bufferPoolSize, bool cstore, bool sortedBuffer, int batchCount, int batchSize, int queriesBetweenBatch) {
-  LOG(INFO) << "starting. bufferPoolSize=" << bufferPoolSize << ", cstore=" << cstore << ", sortedBuffer=" << sortedBuffer << ", batchCount=" << batchCount << ", batchSize=" << batchSize << ",queriesBetweenBatch=" << queriesBetweenBatch;
+void runSSBBench(size_t bufferPoolSize, bool cstore, bool sortedBuffer, int batchCount, int batchSize, int queriesBetweenBatch, bool includeFlights34) {
+  LOG(INFO) << "starting. bufferPoolSize=" << bufferPoolSize << ", cstore=" << cstore << ", sortedBuffer=" << sortedBuffer << ", batchCount=" << batchCount << ", batchSize=" << batchSize << ",queriesBetweenBatch=" << queriesBetweenBatch << ", includeFlights34=" << includeFlights34;
 
 
   FEngine engine ("../../data/", "../../data/data.sig", bufferPoolSize);
   DBGen dbGen ("../../data/ssb1/", batchSize);
+  // current fractures are sealed and dumped to new on-disk fractures in background
+  // whenever they have this number of tuples, so the benchmark can run arbitrarily long.
+  // inserts are logged, and each batch is committed at once.
   const int MAX_TUPLE = 5200000;
-  if ((batchCount * batchSize) > MAX_TUPLE) {
-    LOG(INFO) << "Too large. needs flushing.";
-    return;
-  }
-  FMainMemoryBTree fractureMv (MV_PROJECTION, MAX_TUPLE, sortedBuffer);
-  FMainMemoryBTree fractureLineorder (LINEORDER_PK_SORT, MAX_TUPLE, sortedBuffer);
+  // c-store family keeps its current fracture in columns too.
   FFamily *family = engine.createNewFractureFamily(cstore ? CSTORE_MV_FAMILY : BTREE_MV_FAMILY, MV_PROJECTION, cstore);
-  family->setCurrentFracture(&fractureMv);
+  family->startIngest(MAX_TUPLE, 0, sortedBuffer, true);
+  FFamily *lineorderFamily = engine.createNewFractureFamily(LINEORDER_FAMILY, LINEORDER_PK_SORT, false);
+  lineorderFamily->startIngest(MAX_TUPLE, 0, sortedBuffer, true);
   SSBQueryExecutor exec (&engine);
   StopWatch watchTotal;
   watchTotal.init();
@@ -51,7 +55,7 @@ void runSSBBench(size_t bufferPoolSize, bool cstore, bool sortedBuffer, int batc
     StopWatch watchQuery;
     watchQuery.init();
     for (int j = 0; j < queriesBetweenBatch; ++j) {
-      int query = generateRandomQuery(seed);
+      int query = generateRandomQuery(seed, includeFlights34);
       param.generateRandomParam(query, seed);
       exec.query(query, cstore, param);
     }
@@ -67,17 +71,19 @@ void runSSBBench(size_t bufferPoolSize, bool cstore, bool sortedBuffer, int batc
     MVProjection *mvs = dbGen.getMVBuffer();
     Lineorder *lineorders = dbGen.getLineorderBuffer();
     for (size_t j = 0; j < currentBatchSize; ++j) {
-      fractureMv.insert(&(mvs[j].key), &mvs[j]);
+      family->insert(&(mvs[j].key), &mvs[j]);
       int64_t pk = lineorders[j].getPK();
-      fractureLineorder.insert(&pk, &lineorders[j]);
+      lineorderFamily->insert(&pk, &lineorders[j]);
     }
+    family->commit();
+    lineorderFamily->commit();
     watchInsert.stop();
     LOG(INFO) << "Insert batch done. " << i << ". " << watchInsert.getElapsed() << " microsec";
     insertTotal += watchInsert.getElapsed();
   }
 
-  int64_t mvTime = finishFracture (fractureMv);
-  int64_t lineorderTime = finishFracture (fractureLineorder);
+  int64_t mvTime = flushFamily (*family);
+  int64_t lineorderTime = flushFamily (*lineorderFamily);
 
   watchTotal.stop();
   LOG(INFO) << "Finished benchmark: total:" << watchTotal.getElapsed() << " microsec. queryTotal=" << queryTotal << ", insertTotal=" << insertTotal << ", mvTime=" << mvTime << ", lineorderTime=" << lineorderTime;
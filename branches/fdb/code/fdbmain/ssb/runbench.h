@@ -5,7 +5,8 @@
 
 namespace fdb {
 
-void runSSBBench(size_t bufferPoolSize, bool cstore, bool sortedBuffer, int batchCount, int batchSize, int queriesBetweenBatch);
+// queries are randomly chosen from Q1.x and Q2.x, and also Q3.x and Q4.x if includeFlights34.
+void runSSBBench(size_t bufferPoolSize, bool cstore, bool sortedBuffer, int batchCount, int batchSize, int queriesBetweenBatch, bool includeFlights34);
 
 } // fdb
 #endif // SSB_RUNBENCH_H
@@ -1,6 +1,10 @@
 #include "ssb.h"
+#include "../storage/fkeycomp.h"
 
 #include <string.h>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
 #include <iostream>
 #include <sstream>
 #include <boost/tokenizer.hpp>
@@ -184,4 +188,139 @@ void Date::debugout() const {
     << "weekdayfl=" << weekdayfl << std::endl;
 }
 
+// ==========================================================================
+//  Normalized keys of MVProjection
+// ==========================================================================
+namespace {
+// sorted values of a fixed-width string column. the code of a value is its index.
+class KeyDictionary {
+public:
+  KeyDictionary (const char * const *values, int count, int width, char pad) : _width(width) {
+    for (int i = 0; i < count; ++i) {
+      std::string value (values[i]);
+      value.resize (width, pad);
+      _values.push_back (value);
+    }
+    std::sort (_values.begin(), _values.end());
+  }
+  // returns the code of the value, or -1 if it's not in the dictionary.
+  int find (const char *value) const {
+    size_t low = 0, high = _values.size();
+    while (low < high) {
+      size_t mid = (low + high) / 2;
+      int cmp = ::memcmp (_values[mid].data(), value, _width);
+      if (cmp == 0) return mid;
+      if (cmp < 0) low = mid + 1;
+      else high = mid;
+    }
+    return -1;
+  }
+private:
+  std::vector<std::string> _values;
+  int _width;
+};
+
+// "" (all zeros) is in the dictionaries so that keys of partially filled tuples are encoded too.
+const char* const SSB_REGIONS[] = {"", "AFRICA", "AMERICA", "ASIA", "EUROPE", "MIDDLE EAST"};
+const char* const SSB_NATIONS[] = {"", "ALGERIA", "ARGENTINA", "BRAZIL", "CANADA", "CHINA", "EGYPT",
+  "ETHIOPIA", "FRANCE", "GERMANY", "INDIA", "INDONESIA", "IRAN", "IRAQ", "JAPAN", "JORDAN", "KENYA",
+  "MOROCCO", "MOZAMBIQUE", "PERU", "ROMANIA", "RUSSIA", "SAUDI ARABIA", "UNITED KINGDOM", "UNITED STATES", "VIETNAM"};
+const char* const SSB_MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+// a city is the first 9 characters of its nation (padded with spaces) and a digit, e.g., "UNITED KI1".
+const int SSB_CITY_PREFIX = 9;
+
+const KeyDictionary MV_REGIONS (SSB_REGIONS, 6, sizeof(MVProjection::PKType().s_region), '\0');
+const KeyDictionary MV_NATIONS (SSB_NATIONS, 26, sizeof(MVProjection::PKType().s_nation), '\0');
+const KeyDictionary MV_CITY_PREFIXES (SSB_NATIONS + 1, 25, SSB_CITY_PREFIX, ' ');
+const KeyDictionary MV_MONTHS (SSB_MONTHS, 12, 3, '\0');
+
+bool isAllZero (const char *value, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    if (value[i] != '\0') return false;
+  }
+  return true;
+}
+
+// 0 for "", 1 + prefix * 10 + digit otherwise (8 bits). -1 if out of the domain.
+int encodeCity (const char *city) {
+  if (isAllZero (city, sizeof(MVProjection::PKType().s_city))) return 0;
+  int prefix = MV_CITY_PREFIXES.find (city);
+  char digit = city[SSB_CITY_PREFIX];
+  if (prefix < 0 || digit < '0' || digit > '9') return -1;
+  return 1 + prefix * 10 + (digit - '0');
+}
+
+// "MmmYYYY" as (1 + month in the dictionary) << 8 | (year - 1900) (12 bits). 0 for "". -1 if out of the domain.
+int encodeYearmonth (const char *yearmonth) {
+  if (isAllZero (yearmonth, sizeof(MVProjection::PKType().d_yearmonth))) return 0;
+  int month = MV_MONTHS.find (yearmonth);
+  if (month < 0) return -1;
+  int year = 0;
+  for (int i = 3; i < 7; ++i) {
+    if (yearmonth[i] < '0' || yearmonth[i] > '9') return -1;
+    year = year * 10 + (yearmonth[i] - '0');
+  }
+  if (year < 1900 || year >= 1900 + 256) return -1;
+  return ((1 + month) << 8) | (year - 1900);
+}
+
+// bytes of an integer column in memory order, as memcmp() compares them.
+uint64_t memoryOrderBytes (const void *column, int bytes) {
+  const unsigned char *data = reinterpret_cast<const unsigned char*>(column);
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+inline void appendBits (FNormalizedKey &normalized, uint64_t value, int bits) {
+  normalized.high = (normalized.high << bits) | (normalized.low >> (64 - bits));
+  normalized.low = (normalized.low << bits) | value;
+}
+} // anonymous namespace
+
+bool MVProjection::PKType::normalize (FNormalizedKey &normalized) const {
+  // memcmp() compares padding bytes between columns too
+  const size_t columnEnds[] = {
+    offsetof(PKType, s_region) + sizeof(s_region), offsetof(PKType, d_year) + sizeof(d_year),
+    offsetof(PKType, c_region) + sizeof(c_region), offsetof(PKType, s_nation) + sizeof(s_nation),
+    offsetof(PKType, c_nation) + sizeof(c_nation), offsetof(PKType, s_city) + sizeof(s_city),
+    offsetof(PKType, c_city) + sizeof(c_city), offsetof(PKType, d_yearmonthnum) + sizeof(d_yearmonthnum),
+    offsetof(PKType, d_yearmonth) + sizeof(d_yearmonth), offsetof(PKType, l_orderkey) + sizeof(l_orderkey),
+    offsetof(PKType, l_linenumber) + sizeof(l_linenumber)};
+  const size_t nextColumns[] = {
+    offsetof(PKType, d_year), offsetof(PKType, c_region), offsetof(PKType, s_nation), offsetof(PKType, c_nation),
+    offsetof(PKType, s_city), offsetof(PKType, c_city), offsetof(PKType, d_yearmonthnum), offsetof(PKType, d_yearmonth),
+    offsetof(PKType, l_orderkey), offsetof(PKType, l_linenumber), sizeof(PKType)};
+  const char *data = reinterpret_cast<const char*>(this);
+  for (int i = 0; i < 11; ++i) {
+    if (!isAllZero (data + columnEnds[i], nextColumns[i] - columnEnds[i])) return false;
+  }
+  const int sRegion = MV_REGIONS.find (s_region), cRegion = MV_REGIONS.find (c_region);
+  const int sNation = MV_NATIONS.find (s_nation), cNation = MV_NATIONS.find (c_nation);
+  const int sCity = encodeCity (s_city), cCity = encodeCity (c_city);
+  const int yearmonth = encodeYearmonth (d_yearmonth);
+  if (sRegion < 0 || cRegion < 0 || sNation < 0 || cNation < 0 || sCity < 0 || cCity < 0 || yearmonth < 0) return false;
+  // yyyymm fits in 3 bytes. the last byte in memory order must be zero (little endian)
+  const uint64_t yearmonthnum = memoryOrderBytes (&d_yearmonthnum, sizeof(d_yearmonthnum));
+  if ((yearmonthnum & 0xFF) != 0) return false;
+
+  normalized.high = 0;
+  normalized.low = 0;
+  appendBits (normalized, sRegion, 3);
+  appendBits (normalized, memoryOrderBytes (&d_year, sizeof(d_year)), 16);
+  appendBits (normalized, cRegion, 3);
+  appendBits (normalized, sNation, 5);
+  appendBits (normalized, cNation, 5);
+  appendBits (normalized, sCity, 8);
+  appendBits (normalized, cCity, 8);
+  appendBits (normalized, yearmonthnum >> 8, 24);
+  appendBits (normalized, yearmonth, 12);
+  appendBits (normalized, memoryOrderBytes (&l_orderkey, sizeof(l_orderkey)), 32);
+  appendBits (normalized, memoryOrderBytes (&l_linenumber, sizeof(l_linenumber)), 8);
+  appendBits (normalized, 0, 4); // 124 bits are used
+  return true;
+}
+
 } //fdb
@@ -7,6 +7,8 @@
 
 namespace fdb {
 
+struct FNormalizedKey;
+
 class Lineorder {
 public:
   int32_t orderkey;
@@ -187,6 +189,15 @@ public:
       const MVProjection *k2 = reinterpret_cast<const MVProjection*> (data2);
       return k1->compare(k2->key);
     }
+
+    // encodes this key into 124 bits which compare as memcmp() of the keys does.
+    // regions, nations, cities and months are encoded as codes in the SSB domains,
+    // and integers as their bytes in memory order. returns false if a column has a value
+    // out of the domains or padding bytes are not zero.
+    bool normalize (FNormalizedKey &normalized) const;
+    static bool normalizeKey (const void *key, FNormalizedKey &normalized) {
+      return reinterpret_cast<const PKType*> (key)->normalize(normalized);
+    }
   };
 
   PKType key;
@@ -76,6 +76,9 @@ FMainMemoryBTree::~FMainMemoryBTree() {
 bool FMainMemoryBTree::insert (const void *key, const void *data) {
   return _impl->insert(key, data);
 }
+bool FMainMemoryBTree::insertBatch (const void *data, int64_t count) {
+  return _impl->insertBatch(data, count);
+}
 
 long long FMainMemoryBTree::size () const {
   return _impl->size();
@@ -125,26 +128,83 @@ FMainMemoryBTreeImpl::FMainMemoryBTreeImpl(int keySize, int dataSize, TableType
 {
   _keydataFunc = toKeyDataCompareFunc(tableType);
   _datadataFunc = toDataDataCompareFunc(tableType);
+  _extractFunc = toExtractKeyFromTupleFunc(tableType);
+  _normalizeFunc = toNormalizeKeyFunc(tableType);
   _array = new char[dataSize * maxSize];
   ::memset (_array, 0, dataSize * maxSize);
   _tuples = 0;
+  _settled = 0;
+  _reserved = 0;
+  _abandoned = false;
 }
 FMainMemoryBTreeImpl::~FMainMemoryBTreeImpl() {
   delete[] _array;
 }
 
-void FMainMemoryBTreeImpl::insertTupleToArray (const void *key, const void *data) {
-  assert (_tuples < _maxSize);
+int64_t FMainMemoryBTreeImpl::size () const {
+  boost::mutex::scoped_lock lock (_insertMutex);
+  return _tuples;
+}
+
+int64_t FMainMemoryBTreeImpl::reserveSlots (int64_t count) {
+  assert (count > 0);
   assert (_finishedInserts == false);
-  ::memcpy (_array + (_dataSize * _tuples), data, _dataSize);
-  ++_tuples;
+  boost::mutex::scoped_lock lock (_insertMutex);
+  if (_abandoned) {
+    LOG(ERROR) << "the on-memory btree doesn't take inserts after a writer abandoned its slots";
+    return -1;
+  }
+  if (_reserved + count > _maxSize) {
+    LOG(ERROR) << "the on-memory btree is full. maxSize=" << _maxSize;
+    return -1;
+  }
+  int64_t begin = _reserved;
+  _reserved += count;
+  return begin;
+}
+
+bool FMainMemoryBTreeImpl::publishSlots (int64_t begin, int64_t count, const void *keys) {
+  boost::mutex::scoped_lock lock (_insertMutex);
+  // a writer that reserved earlier might be still copying its tuples
+  while (_settled != begin) {
+    _publishedCond.wait (lock);
+  }
+  _settled = begin + count;
+  _publishedCond.notify_all();
+  if (_abandoned) {
+    return false;
+  }
+  try {
+    onPublishSlots (begin, count, keys);
+  } catch (...) {
+    LOG(ERROR) << "failed to publish slots [" << begin << ", " << (begin + count) << ") of the on-memory btree. abandoned";
+    _abandoned = true;
+    throw;
+  }
+  _tuples = _settled;
+  return true;
+}
+
+void FMainMemoryBTreeImpl::abandonSlots (int64_t begin, int64_t count) {
+  boost::mutex::scoped_lock lock (_insertMutex);
+  while (_settled < begin) {
+    _publishedCond.wait (lock);
+  }
+  if (_settled > begin) {
+    return; // already settled by publishSlots(), which threw
+  }
+  LOG(ERROR) << "a writer abandoned slots [" << begin << ", " << (begin + count) << ") of the on-memory btree. "
+    << _tuples << " tuples are kept, and later inserts fail";
+  _settled = begin + count;
+  _abandoned = true;
+  _publishedCond.notify_all();
 }
 
 // ==========================================================================
 //  Dump to disk
 // ==========================================================================
 
-FBTreeWriter::FBTreeWriter(FFileSignature &signature_, TableType type_, char *buffer_, int bufferSize_, int64_t tupleCount_, int keySize_, int dataSize_)
+FBTreeWriter::FBTreeWriter(FFileSignature &signature_, TableType type_, char *buffer_, int bufferSize_, int64_t tupleCount_, int keySize_, int dataSize_, int64_t firstTuple)
   : signature(signature_), fileId (signature.fileId), type(type_), extractFunc(toExtractKeyFromTupleFunc(type)),
     buffer(buffer_), bufferSize(bufferSize_), bufferedPages (0),
     currentPageId (0), currentPageOffset (0), currentTuple (0), tupleCount(tupleCount_),
@@ -154,14 +214,22 @@ FBTreeWriter::FBTreeWriter(FFileSignature &signature_, TableType type_, char *bu
     leafPageCount (0), rootPageStart (0), rootPageCount (0), rootPageLevel (0) {
   assert (signature.fileId > 0);
   assert (signature.getFilepath().size() > 0);
-  if (std::remove(signature.getFilepath().c_str()) == 0) {
-    LOG(INFO) << "deleted existing file " << signature.getFilepath() << ".";
+  if (firstTuple < 0) {
+    if (std::remove(signature.getFilepath().c_str()) == 0) {
+      LOG(INFO) << "deleted existing file " << signature.getFilepath() << ".";
+    }
+    fd = new DirectFileOutputStream(signature.getFilepath(), FDB_USE_DIRECT_IO);
+    pageSignatures.reserve ((tupleCount / entryPerLeafPage) + 10);
+  } else {
+    assert (firstTuple % entryPerLeafPage == 0);
+    currentTuple = firstTuple;
+    currentPageId = firstTuple / entryPerLeafPage;
+    fd = new DirectFileOutputStream(signature.getFilepath(), FDB_USE_DIRECT_IO);
+    fd->setNextLocation (((int64_t) currentPageId) * FDB_PAGE_SIZE);
   }
-  fd = new DirectFileOutputStream(signature.getFilepath(), FDB_USE_DIRECT_IO);
   ::memset (buffer, 0, bufferSize * FDB_PAGE_SIZE);
   keyBuffer = new char[keySize];
   ::memset (keyBuffer, 0, keySize);
-  pageSignatures.reserve ((tupleCount / entryPerLeafPage) + 10);
 }
 FBTreeWriter::~FBTreeWriter() {
   delete fd;
@@ -302,6 +370,12 @@ void FBTreeWriter::dumpNonLeafPages (int currentLevel) {
   }
 }
 
+void FBTreeWriter::finishLeafPages () {
+  flipPage();
+  flush();
+  fd->close();
+}
+
 void FBTreeWriter::finishWriting () {
   // flush last leaf pages
   flipPage();
@@ -37,9 +37,19 @@ public:
   ~FMainMemoryBTree();
 
   // inserts a new entry into the btree. returns true when succeeded.
+  // inserts are thread-safe, and run in parallel except for short critical sections
+  // (ordering the inserted tuples, and the key insertion for sorted buffer, which serializes
+  // writers more than unsorted buffer does).
+  // readers running with inserts see a prefix of the inserted tuples (see size()).
+  // returns false if full, or once an insert failed with an exception (the tree keeps the
+  // tuples inserted before it, and takes no more).
   bool insert (const void *key, const void *data);
+  // inserts count tuples (data is an array of them), extracting keys from the tuples.
+  // takes the critical sections once for all of them, so concurrent writers should use this.
+  bool insertBatch (const void *data, int64_t count);
 
   // call this method when you are done with INSERTs.
+  // no insert must be running then.
   // this method 'might' trigger reorganization (sorting) of the on-memory data
   // , leading to better query performance.
   // once this method is called, insert () can't be called for this object.
@@ -48,7 +58,7 @@ public:
   // returns the tuple for given key. NULL if not found.
   const void* getSingleTupleByKey (const void *key) const;
 
-  // returns the total count of entries
+  // returns the total count of entries, which are readable in getUnsortedBuffer().
   int64_t size () const;
 
   // traverses all entries in this btree, calls back the function for each entry with given context object.
@@ -4,11 +4,16 @@
 #include "ffilesig.h"
 #include "fbtree.h"
 #include "fkeycomp.h"
+#include "fsort.h"
 #include <algorithm>
 #include <string.h>
 #include <stdint.h>
 #include <vector>
 #include <stx/btree_map.h>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
 namespace fdb {
 
@@ -16,18 +21,23 @@ namespace fdb {
 // so far, this class uses the STX Btree as an internal data structure.
 // STX BTree does not support variable length key/data, thus
 // we parameterize key/data types in the derived class.
+// writers reserve slots of _array (reserveSlots()), copy tuples into them without locks, and
+// publish them in the order of reservation (publishSlots()). readers see only the published
+// tuples [0, _tuples), which never have holes. a writer failing before it publishes abandons
+// its slots (see SlotReservation), which stops the tree from growing rather than blocking others.
 class FMainMemoryBTreeImpl {
 public:
   FMainMemoryBTreeImpl(int keySize, int dataSize, TableType tableType, int64_t maxSize);
   virtual ~FMainMemoryBTreeImpl();
 
   virtual bool insert (const void *key, const void *data) = 0;
+  virtual bool insertBatch (const void *data, int64_t count) = 0;
   virtual void finishInserts () = 0;
   virtual const void* getSingleTupleByKey (const void *key) const = 0;
   virtual void traverse(TraversalCallback callback, void *context) const = 0;
   virtual void addAllToWriter(FBTreeWriter &writer) const = 0;
   void dumpToNewRowStoreFile (FFileSignature &signature) const;
-  int64_t size () const { return _tuples; }
+  int64_t size () const;
   int getKeySize() const { return _keySize; }
   int getDataSize() const { return _dataSize; }
   TableType getTableType() const {return _tableType;}
@@ -44,12 +54,59 @@ public:
   bool _finishedInserts;
   KeyDataCompareFunc _keydataFunc;
   DataDataCompareFunc _datadataFunc;
+  ExtractKeyFromTupleFunc _extractFunc;
+  NormalizeKeyFunc _normalizeFunc; // NULL if the table type has no normalized keys
 
 protected:
-  void insertTupleToArray (const void *key, const void *data);
+  // reserves slots [returned value, returned value + count) for a writer.
+  // -1 if no room, or if a writer abandoned its slots.
+  int64_t reserveSlots (int64_t count);
+  // makes the slots visible to readers after all slots reserved before them are settled
+  // (published or abandoned). keys are given to onPublishSlots().
+  // returns false if the slots stay invisible, as a writer reserved before them abandoned its slots.
+  bool publishSlots (int64_t begin, int64_t count, const void *keys);
+  // settles the slots of a writer failed before publishing them, so later writers don't wait
+  // forever. no slot after them becomes visible then (it would leave a hole), so inserts fail.
+  void abandonSlots (int64_t begin, int64_t count);
+  // called by publishSlots() in the order of reservation, with _insertMutex locked.
+  // the slots are abandoned if this throws.
+  virtual void onPublishSlots (int64_t begin, int64_t count, const void *keys) {}
+  void copyTuplesToArray (int64_t begin, const void *data, int64_t count) {
+    ::memcpy (_array + (_dataSize * begin), data, _dataSize * count);
+  }
+
+  // reserves slots, and abandons them when destructed without being published
+  // (e.g., the writer threw), so no writer is left waiting in publishSlots().
+  class SlotReservation {
+  public:
+    SlotReservation (FMainMemoryBTreeImpl *impl, int64_t count)
+      : _impl(impl), _begin(impl->reserveSlots(count)), _count(count), _settled(false) {}
+    ~SlotReservation () {
+      if (_begin >= 0 && !_settled) {
+        _impl->abandonSlots (_begin, _count);
+      }
+    }
+    int64_t begin () const { return _begin; } // -1 if not reserved
+    bool publish (const void *keys = NULL) {
+      bool published = _impl->publishSlots (_begin, _count, keys);
+      _settled = true;
+      return published;
+    }
+  private:
+    FMainMemoryBTreeImpl *_impl;
+    int64_t _begin;
+    int64_t _count;
+    bool _settled;
+    SlotReservation (const SlotReservation &); // prohibit copying
+  };
 
   char *_array;
-  int64_t _tuples;
+  int64_t _tuples; // published tuples
+  int64_t _settled; // slots published or abandoned. _tuples <= _settled <= _reserved
+  int64_t _reserved; // reserved slots
+  bool _abandoned; // a writer abandoned its slots. never reset
+  mutable boost::mutex _insertMutex; // protects _tuples, _settled, _reserved and _abandoned
+  boost::condition_variable _publishedCond;
 };
 
 struct BTreePageSignature {
@@ -62,9 +119,15 @@ struct BTreePageSignature {
 class DirectFileOutputStream;
 class FBTreeWriter {
 public:
-  FBTreeWriter(FFileSignature &signature_, TableType type_, char *buffer_, int bufferSize_, int64_t tupleCount_, int keySize_, int dataSize_);
+  // firstTuple: -1 to write a new file from the first tuple. otherwise, writes leaf pages from
+  // the firstTuple-th tuple (a multiple of entryPerLeafPage) into the existing file,
+  // so that partitions of a merge are written in parallel (see FFamily::mergeFractures()).
+  FBTreeWriter(FFileSignature &signature_, TableType type_, char *buffer_, int bufferSize_, int64_t tupleCount_, int keySize_, int dataSize_, int64_t firstTuple = -1);
   ~FBTreeWriter();
   void addTuple (const char *data);
+  // writes the remaining leaf pages of a partition. non-leaf pages are written by finishWriting()
+  // of a writer whose firstTuple is after all leaf pages, given pageSignatures of all partitions.
+  void finishLeafPages ();
 
   void flushIfFull ();
   void flush();
@@ -111,33 +174,81 @@ public:
   typedef typename stx::btree_map<Key, void*, Compare> MapType;
   typedef typename MapType::const_iterator MapConstIter;
   MapType _map;
+  // STX BTree isn't thread-safe. writers copy tuples, extract and sort their keys in parallel,
+  // then the keys are inserted when the slots are published (onPublishSlots()), one writer at a
+  // time. so the map has only published tuples, but its inserts don't scale with writers;
+  // many writers should use unsorted buffers, which sort once in finishInserts().
+  // readers hold the shared lock while they scan, so they see a consistent set of tuples.
+  mutable boost::shared_mutex _mapMutex;
+  typedef std::pair<Key, void*> PendingKey; // key and tuple of a slot not published yet
+  struct PendingKeyLess {
+    bool operator() (const PendingKey &left, const PendingKey &right) const {
+      return Compare() (left.first, right.first);
+    }
+  };
 
   bool insert (const void *key, const void *data) {
-    _map.insert(*(reinterpret_cast<const Key*>(key)), _array + (_dataSize * _tuples));
-    insertTupleToArray(key, data);
-    return true;
+    SlotReservation reservation (this, 1);
+    if (reservation.begin() < 0) return false;
+    copyTuplesToArray(reservation.begin(), data, 1);
+    PendingKey pending (*(reinterpret_cast<const Key*>(key)), _array + (_dataSize * reservation.begin()));
+    return reservation.publish(&pending);
+  }
+  bool insertBatch (const void *data, int64_t count) {
+    SlotReservation reservation (this, count);
+    const int64_t begin = reservation.begin();
+    if (begin < 0) return false;
+    copyTuplesToArray(begin, data, count);
+    // sorted outside the critical section, so the map is filled in key order there
+    std::vector<PendingKey> pending (count);
+    for (int64_t i = 0; i < count; ++i) {
+      pending[i].second = _array + (_dataSize * (begin + i));
+      _extractFunc(pending[i].second, &(pending[i].first));
+    }
+    std::sort (pending.begin(), pending.end(), PendingKeyLess());
+    return reservation.publish(&pending[0]);
+  }
+  void onPublishSlots (int64_t begin, int64_t count, const void *keys) {
+    const PendingKey *pending = reinterpret_cast<const PendingKey*>(keys);
+    std::vector<char> inserted (count, 0);
+    boost::unique_lock<boost::shared_mutex> lock(_mapMutex);
+    try {
+      for (int64_t i = 0; i < count; ++i) {
+        inserted[i] = _map.insert(pending[i].first, pending[i].second).second ? 1 : 0;
+      }
+    } catch (...) {
+      // the slots are abandoned. their keys must not remain
+      for (int64_t i = 0; i < count; ++i) {
+        if (inserted[i]) _map.erase_one(pending[i].first);
+      }
+      throw;
+    }
   }
   void finishInserts () {
     // does nothing. data is always sorted
     _finishedInserts = true;
   }
   const void* getSingleTupleByKey (const void *key) const {
+    boost::shared_lock<boost::shared_mutex> lock(_mapMutex);
     MapConstIter iter = _map.find (*(reinterpret_cast<const Key*>(key)));
     if (iter == _map.end()) return NULL;
     return iter.data();
   }
   void traverse(TraversalCallback callback, void *context) const {
+    boost::shared_lock<boost::shared_mutex> lock(_mapMutex);
     for (MapConstIter iter = _map.begin(); iter != _map.end(); ++iter) {
       callback(context, &(iter.key()), iter.data());
     }
   }
   void addAllToWriter(FBTreeWriter &writer) const {
+    boost::shared_lock<boost::shared_mutex> lock(_mapMutex);
     for (MapConstIter iter = _map.begin(); iter != _map.end(); ++iter) {
       writer.addTuple(reinterpret_cast<const char*>(iter.data()));
     }
   }
   bool isSortedBuffer() const { return true; }
   void scanTuplesGreaterEqual (TupleCallback callback, void *context, const char *key) const {
+    boost::shared_lock<boost::shared_mutex> lock(_mapMutex);
     for (MapConstIter iter = _map.lower_bound(*(reinterpret_cast<const Key*>(key))); iter != _map.end(); ++iter) {
       TupleCallbackRet ret = callback(context, iter.data());
       if (ret != TUPLE_CALLBACK_OK) break;
@@ -147,14 +258,21 @@ public:
 
 // unlike FMainMemoryBTreeImplUnsortedArray,
 // this class just keep appending the data without maintaining BTree until finishInserts() is called.
+// each batch is sorted by its writer, and consecutive slots in ascending order form a sorted run.
+// finishInserts() does nothing for one run, merges a few runs, or sorts all keys otherwise
+// (radix sort for integer keys, sample sort for wide keys), in parallel for large trees (see fsort.h).
+// wide keys of table types with normalized keys (see FNormalizedKey) are sorted as pairs of
+// their normalized keys and slots, which are compared and moved much faster than the keys.
 template <typename Key, typename Compare=std::less<Key> >
 class FMainMemoryBTreeImplUnsorted : public FMainMemoryBTreeImpl {
 public:
-  FMainMemoryBTreeImplUnsorted (TableType tableType, int dataSize, int64_t maxSize) : FMainMemoryBTreeImpl(sizeof(Key), dataSize, tableType, maxSize) {
+  FMainMemoryBTreeImplUnsorted (TableType tableType, int dataSize, int64_t maxSize) : FMainMemoryBTreeImpl(sizeof(Key), dataSize, tableType, maxSize), _tooManyRuns(false) {
     _sortedKeys = new KeyAndPtr[maxSize];
-    ::memset (_sortedKeys, 0, sizeof(KeyAndPtr) * maxSize);
+    ::memset (static_cast<void*>(_sortedKeys), 0, sizeof(KeyAndPtr) * maxSize);
+  }
+  virtual ~FMainMemoryBTreeImplUnsorted(){
+    delete[] _sortedKeys;
   }
-  virtual ~FMainMemoryBTreeImplUnsorted(){}
 
   struct KeyAndPtr {
     KeyAndPtr() {}
@@ -171,20 +289,145 @@ public:
       return _key < other._key;
     }
   };
+  struct RadixKeyOf {
+    uint64_t operator() (const KeyAndPtr &keyAndPtr) const {
+      return FRadixKey<Key>::toUnsigned(keyAndPtr._key);
+    }
+  };
   KeyAndPtr *_sortedKeys; // sorted only when finishInserts() is called
+  std::vector<int64_t> _runStarts; // first slot of each sorted run. empty if _tooManyRuns
+  bool _tooManyRuns; // more than FDB_SORT_MAX_MERGE_RUNS runs
 
+  // each writer fills its own slots, so inserts run in parallel without locks except
+  // reserving and publishing slots (once per batch for insertBatch()).
   bool insert (const void *key, const void *data) {
-    _sortedKeys[_tuples]._key = *reinterpret_cast<const Key*>(key);
-    _sortedKeys[_tuples]._data = _array + (_dataSize * _tuples);
-    insertTupleToArray(key, data);
-    return true;
+    SlotReservation reservation (this, 1);
+    const int64_t slot = reservation.begin();
+    if (slot < 0) return false;
+    _sortedKeys[slot]._key = *reinterpret_cast<const Key*>(key);
+    _sortedKeys[slot]._data = _array + (_dataSize * slot);
+    copyTuplesToArray(slot, data, 1);
+    return reservation.publish();
+  }
+  bool insertBatch (const void *data, int64_t count) {
+    SlotReservation reservation (this, count);
+    const int64_t begin = reservation.begin();
+    if (begin < 0) return false;
+    copyTuplesToArray(begin, data, count);
+    for (int64_t i = begin; i < begin + count; ++i) {
+      _extractFunc(_array + (_dataSize * i), &(_sortedKeys[i]._key));
+      _sortedKeys[i]._data = _array + (_dataSize * i);
+    }
+    // sorted here, in parallel with other writers, so the batch is one sorted run
+    std::sort (_sortedKeys + begin, _sortedKeys + begin + count);
+    return reservation.publish();
   }
+  // no insert must be running. slots after abandoned ones are ignored.
   void finishInserts () {
+    assert (_reserved == _settled);
     if (!_finishedInserts) {
-      std::sort (_sortedKeys, _sortedKeys + _tuples);
+      if (_tooManyRuns || _runStarts.size() > 1) {
+        sortKeys();
+      }
+      _runStarts.clear();
       _finishedInserts = true;
     }
   }
+  void sortKeys () {
+    int threads = FDB_SORT_THREADS > 0 ? FDB_SORT_THREADS : std::max<int> (1, boost::thread::hardware_concurrency());
+    if (_normalizeFunc != NULL && sortNormalizedKeys(threads)) {
+      return;
+    }
+    if (_tuples < FDB_SORT_PARALLEL_MIN || threads == 1) {
+      std::sort (_sortedKeys, _sortedKeys + _tuples);
+      return;
+    }
+    std::vector<KeyAndPtr> buffer (_tuples);
+    if (!_tooManyRuns) {
+      parallelMergeRuns (_sortedKeys, &buffer[0], _tuples, _runStarts, threads, FDB_SORT_SAMPLES_PER_THREAD);
+    } else if (FRadixKey<Key>::RADIX) {
+      parallelRadixSort (_sortedKeys, &buffer[0], _tuples, threads, sizeof(Key), RadixKeyOf());
+    } else {
+      parallelSampleSort (_sortedKeys, &buffer[0], _tuples, threads, FDB_SORT_SAMPLES_PER_THREAD);
+    }
+  }
+
+  struct NormalizedSlot {
+    FNormalizedKey _key;
+    int64_t _slot;
+    inline bool operator<(const NormalizedSlot &other) const {
+      return _key < other._key;
+    }
+  };
+  // normalizes keys of [n * t / threads, n * (t + 1) / threads), or moves them to buffer in the sorted order.
+  struct NormalizedSlotJob {
+    void operator() (int t) const {
+      const int64_t begin = n * t / threads, end = n * (t + 1) / threads;
+      for (int64_t i = begin; i < end; ++i) {
+        if (phase == 0) {
+          (*normalized)[i]._slot = i;
+          if (!normalizeFunc(&(keys[i]._key), (*normalized)[i]._key)) {
+            (*failed)[t] = 1;
+            return;
+          }
+        } else {
+          buffer[i] = keys[(*normalized)[i]._slot];
+        }
+      }
+    }
+    const KeyAndPtr *keys;
+    KeyAndPtr *buffer;
+    int64_t n;
+    int threads;
+    int phase;
+    NormalizeKeyFunc normalizeFunc;
+    std::vector<NormalizedSlot> *normalized;
+    std::vector<char> *failed; // per thread
+  };
+  // returns false if some key can't be normalized.
+  bool sortNormalizedKeys (int threads) {
+    if (_tuples < FDB_SORT_PARALLEL_MIN) threads = 1;
+    std::vector<NormalizedSlot> normalized (_tuples);
+    std::vector<char> failed (threads, 0);
+    NormalizedSlotJob job;
+    job.keys = _sortedKeys;
+    job.n = _tuples;
+    job.threads = threads;
+    job.phase = 0;
+    job.normalizeFunc = _normalizeFunc;
+    job.normalized = &normalized;
+    job.failed = &failed;
+    runParallelJobs (threads, job);
+    if (std::find (failed.begin(), failed.end(), 1) != failed.end()) {
+      return false;
+    }
+    {
+      std::vector<NormalizedSlot> buffer (threads == 1 ? 0 : _tuples);
+      if (threads == 1) {
+        std::sort (normalized.begin(), normalized.end());
+      } else if (!_tooManyRuns) {
+        parallelMergeRuns (&normalized[0], &buffer[0], _tuples, _runStarts, threads, FDB_SORT_SAMPLES_PER_THREAD);
+      } else {
+        parallelSampleSort (&normalized[0], &buffer[0], _tuples, threads, FDB_SORT_SAMPLES_PER_THREAD);
+      }
+    }
+    std::vector<KeyAndPtr> buffer (_tuples);
+    job.buffer = &buffer[0];
+    job.phase = 1;
+    runParallelJobs (threads, job);
+    std::copy (buffer.begin(), buffer.end(), _sortedKeys);
+    return true;
+  }
+  void onPublishSlots (int64_t begin, int64_t count, const void *) {
+    if (_tooManyRuns) return;
+    if (begin > 0 && !(_sortedKeys[begin] < _sortedKeys[begin - 1])) return; // continues the last run
+    if (_runStarts.size() >= FDB_SORT_MAX_MERGE_RUNS) {
+      _tooManyRuns = true;
+      _runStarts.clear();
+      return;
+    }
+    _runStarts.push_back (begin);
+  }
   const void* getSingleTupleByKey (const void *key) const {
     assert (_finishedInserts);
     KeyAndPtr *found = std::lower_bound (_sortedKeys, _sortedKeys + _tuples, KeyAndPtr(*reinterpret_cast<const Key*>(key), NULL));
@@ -193,13 +436,13 @@ public:
   }
   void traverse(TraversalCallback callback, void *context) const {
     assert (_finishedInserts);
-    for (size_t i = 0; i < _tuples; ++i) {
+    for (int64_t i = 0; i < _tuples; ++i) {
       callback(context, &(_sortedKeys[i]._key), _sortedKeys[i]._data);
     }
   }
   void addAllToWriter(FBTreeWriter &writer) const {
     assert (_finishedInserts);
-    for (size_t i = 0; i < _tuples; ++i) {
+    for (int64_t i = 0; i < _tuples; ++i) {
       writer.addTuple(reinterpret_cast<const char*>(_sortedKeys[i]._data));
     }
   }
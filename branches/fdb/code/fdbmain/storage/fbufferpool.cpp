@@ -170,27 +170,33 @@ FBufferPool::~FBufferPool() {
 }
 
 void FBufferPool::clear () {
+  boost::mutex::scoped_lock lock(_impl->_mutex);
   _impl->clear();
 }
 
 char* FBufferPool::findPage (int fileId, int pageId) {
+  boost::mutex::scoped_lock lock(_impl->_mutex);
   PoolEntry *entry = _impl->findEntry(fileId, pageId);
   if (entry == NULL) return NULL;
   entry->read = true;
   return entry->data;
 }
 void FBufferPool::addPage (int fileId, int pageId, char *data) {
+  boost::mutex::scoped_lock lock(_impl->_mutex);
   _impl->addPage(fileId, pageId, data);
 }
 
 const char* FBufferPool::readPage (const FFileSignature &signature, int pageId) {
+  boost::mutex::scoped_lock lock(_impl->_mutex);
   return _impl->readPage(signature, pageId);
 }
 
 std::vector<const char*> FBufferPool::readPages (const FFileSignature &signature, int beginningPageId, int pageCount) {
+  boost::mutex::scoped_lock lock(_impl->_mutex);
   return _impl->readPages(signature, beginningPageId, pageCount);
 }
 void FBufferPool::readPages (const FFileSignature &signature, int beginningPageId, int pageCount, char *buffer) {
+  boost::mutex::scoped_lock lock(_impl->_mutex);
   _impl->readPages (signature, beginningPageId, pageCount, buffer);
 }
 
@@ -13,6 +13,7 @@ struct FFileSignature;
 // note that this buffer pool is *just for reading*, thus all pages
 // in it cannot be 'dirty' thanks to the simple fractured
 // database architecture where every disk write is a 'dump'.
+// all methods are thread-safe so that threads of a parallel scan can share one pool.
 class FBufferPool {
 public:
   FBufferPool(int _maxPageCount);
@@ -7,6 +7,7 @@
 
 #include <map>
 #include <boost/shared_array.hpp>
+#include <boost/thread/mutex.hpp>
 #include <glog/logging.h>
 
 namespace fdb {
@@ -61,6 +62,8 @@ public:
   typedef std::map<int, FBufferedFileStatus> FileMap;
   typedef FileMap::iterator FileMapIter;
   FileMap _fileMap; // map<file-id, FBufferedFileStatus>
+
+  boost::mutex _mutex; // FBufferPool locks this in each method
 };
 
 
@@ -0,0 +1,397 @@
+#include "fcaggregate.h"
+#include "fcstore.h"
+#include "fcbitmap.h"
+#include "searchcond.h"
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <glog/logging.h>
+
+using namespace std;
+
+namespace fdb {
+
+// ==========================================================================
+//  Internal helpers
+// ==========================================================================
+// counts set bits of the bitmap in [from, to) (positions in original relation).
+int64_t countBitsInRange (const PositionBitmap *bitmap, int64_t from, int64_t to) {
+  assert (from >= bitmap->beginPosition);
+  assert (to <= bitmap->beginPosition + (int64_t) bitmap->bitLength);
+  int64_t bit = from - bitmap->beginPosition;
+  const int64_t bitEnd = to - bitmap->beginPosition;
+  int64_t count = 0;
+  for (; bit < bitEnd && bit % 8 != 0; ++bit) {
+    if (bitmap->bitmap[bit / 8] & (1 << (bit % 8))) ++count;
+  }
+  for (; bit + 8 <= bitEnd; bit += 8) {
+    count += __builtin_popcount (bitmap->bitmap[bit / 8]);
+  }
+  for (; bit < bitEnd; ++bit) {
+    if (bitmap->bitmap[bit / 8] & (1 << (bit % 8))) ++count;
+  }
+  return count;
+}
+
+inline bool isPositionSet (const PositionBitmap *bitmap, int64_t position) {
+  int64_t bit = position - bitmap->beginPosition;
+  return (bitmap->bitmap[bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+void checkFilterBitmapCovers (const AggregateFilter &filter, const PositionRange &range) {
+  if (filter.bitmap != NULL && filter.positions != NULL) {
+    LOG(ERROR) << "the filter can't have both raw bitmap and compressed bitmap";
+    assert (false);
+    throw std::exception();
+  }
+  if (filter.bitmap != NULL
+    && (filter.bitmap->beginPosition > range.begin
+      || filter.bitmap->beginPosition + (int64_t) filter.bitmap->bitLength < range.end)) {
+    LOG(ERROR) << "the filter bitmap doesn't cover the aggregated range";
+    assert (false);
+    throw std::exception();
+  }
+}
+
+// number of positions in [from, to) passing the position filter of the filter.
+int64_t countFilteredPositions (const AggregateFilter &filter, int64_t from, int64_t to) {
+  if (filter.bitmap != NULL) return countBitsInRange(filter.bitmap, from, to);
+  if (filter.positions != NULL) return filter.positions->count(PositionRange(from, to));
+  return to - from;
+}
+
+// fills mask so that bit i tells whether block.begin + i passes the position filter.
+// returns false (mask untouched) if the filter has no position filter.
+// mask must have FDB_COLUMN_BLOCK_SIZE / 64 + 1 words.
+bool readFilterMask (const AggregateFilter &filter, const PositionRange &block, uint64_t *mask) {
+  assert (block.end - block.begin <= FDB_COLUMN_BLOCK_SIZE);
+  if (filter.positions != NULL) {
+    filter.positions->getWords(block, mask);
+    return true;
+  }
+  if (filter.bitmap != NULL) {
+    const size_t length = block.end - block.begin;
+    ::memset (mask, 0, ((length + 63) / 64) * sizeof(uint64_t));
+    for (size_t i = 0; i < length; ++i) {
+      if (isPositionSet(filter.bitmap, block.begin + i)) mask[i / 64] |= (uint64_t) 1 << (i % 64);
+    }
+    return true;
+  }
+  return false;
+}
+
+inline bool isMaskSet (const uint64_t *mask, size_t i) {
+  return (mask[i / 64] & ((uint64_t) 1 << (i % 64))) != 0;
+}
+
+template <typename INT_TYPE>
+void readIntRunsTyped (FColumnReaderRLE *reader, const PositionRange &range, const SearchCond *cond, vector<pair<PositionRange, int64_t> > &runs) {
+  vector<pair<PositionRange, INT_TYPE> > typedRuns;
+  reader->getRLECompressedData(range, typedRuns);
+  for (size_t i = 0; i < typedRuns.size(); ++i) {
+    if (cond != NULL && !cond->matchInts<INT_TYPE>(typedRuns[i].second)) continue;
+    runs.push_back (pair<PositionRange, int64_t>(typedRuns[i].first, typedRuns[i].second));
+  }
+}
+
+// returns RLE runs in the range as int64_t. only runs matching with cond if cond is given.
+void readIntRuns (FColumnReaderRLE *reader, const PositionRange &range, const SearchCond *cond, vector<pair<PositionRange, int64_t> > &runs) {
+  switch (reader->getColumn().type) {
+  case COLUMN_INT8: readIntRunsTyped<int8_t>(reader, range, cond, runs); break;
+  case COLUMN_INT16: readIntRunsTyped<int16_t>(reader, range, cond, runs); break;
+  case COLUMN_INT32: readIntRunsTyped<int32_t>(reader, range, cond, runs); break;
+  case COLUMN_INT64: readIntRunsTyped<int64_t>(reader, range, cond, runs); break;
+  default:
+    LOG(ERROR) << "RLE aggregation is only for integer columns. column=" << reader->getColumn().name;
+    assert (false);
+    throw std::exception();
+  }
+}
+
+template <typename INT_TYPE>
+void widenToInt64 (const char *buffer, size_t count, int64_t *values) {
+  const INT_TYPE *cursor = reinterpret_cast<const INT_TYPE*>(buffer);
+  for (size_t i = 0; i < count; ++i) {
+    values[i] = cursor[i];
+  }
+}
+
+// counts the occurrences of each dictionary code in the range.
+// only positions passing the position filter are counted. (codes filter is ignored)
+void countDictionaryCodes (FColumnReaderDictionary *reader, const PositionRange &range, const AggregateFilter &filter, vector<int64_t> &counts) {
+  counts.assign (reader->getDictionaryEntryCount(), 0);
+  uint32_t codes[FDB_COLUMN_BLOCK_SIZE];
+  uint64_t mask[FDB_COLUMN_BLOCK_SIZE / 64 + 1];
+  for (int64_t blockBegin = range.begin; blockBegin < range.end; blockBegin += FDB_COLUMN_BLOCK_SIZE) {
+    PositionRange block (blockBegin, std::min<int64_t>(range.end, blockBegin + FDB_COLUMN_BLOCK_SIZE));
+    size_t length = block.end - block.begin;
+    if (countFilteredPositions(filter, block.begin, block.end) == 0) continue;
+    FColumnAggregator::readBlockCodes(reader, block, codes);
+    if (!readFilterMask(filter, block, mask)) {
+      for (size_t i = 0; i < length; ++i) {
+        assert (codes[i] < counts.size());
+        ++counts[codes[i]];
+      }
+    } else {
+      for (size_t i = 0; i < length; ++i) {
+        if (!isMaskSet(mask, i)) continue;
+        assert (codes[i] < counts.size());
+        ++counts[codes[i]];
+      }
+    }
+  }
+}
+
+// ==========================================================================
+//  Block readers
+// ==========================================================================
+void FColumnAggregator::readBlockAsInt64 (FColumnReader *reader, const PositionRange &range, int64_t *values) {
+  assert (range.begin <= range.end);
+  assert (range.end - range.begin <= FDB_COLUMN_BLOCK_SIZE);
+  size_t length = range.end - range.begin;
+  if (length == 0) return;
+  const FCStoreColumn &column = reader->getColumn();
+  char buffer[FDB_COLUMN_BLOCK_SIZE * sizeof(int64_t)];
+  // the uncompressed/RLE/dictionary readers all return raw values of maxLength bytes here.
+  // as the range is at most one block, this never materializes a large buffer.
+  reader->getDecompressedData(range, buffer, sizeof(buffer));
+  switch (column.type) {
+  case COLUMN_INT8: widenToInt64<int8_t>(buffer, length, values); break;
+  case COLUMN_INT16: widenToInt64<int16_t>(buffer, length, values); break;
+  case COLUMN_INT32: widenToInt64<int32_t>(buffer, length, values); break;
+  case COLUMN_INT64: widenToInt64<int64_t>(buffer, length, values); break;
+  default:
+    LOG(ERROR) << "aggregation is only for integer columns. column=" << column.name;
+    assert (false);
+    throw std::exception();
+  }
+}
+
+void FColumnAggregator::readBlockCodes (FColumnReaderDictionary *reader, const PositionRange &range, uint32_t *codes) {
+  assert (range.begin <= range.end);
+  assert (range.end - range.begin <= FDB_COLUMN_BLOCK_SIZE);
+  size_t length = range.end - range.begin;
+  if (length == 0) return;
+  const int bits = reader->getDictionaryEntrySizeInBits();
+  unsigned char buffer[FDB_COLUMN_BLOCK_SIZE * sizeof(uint32_t) + 2];
+  int bitOffset = 0;
+  reader->getDictionaryCompressedData(range, buffer, sizeof(buffer), bitOffset);
+  switch (bits) {
+  case 8:
+    assert (bitOffset == 0);
+    for (size_t i = 0; i < length; ++i) codes[i] = buffer[i];
+    break;
+  case 16:
+    assert (bitOffset == 0);
+    for (size_t i = 0; i < length; ++i) codes[i] = reinterpret_cast<const uint16_t*>(buffer)[i];
+    break;
+  case 32:
+    assert (bitOffset == 0);
+    ::memcpy (codes, buffer, length * sizeof(uint32_t));
+    break;
+  default:
+    {
+      // 1-4 bits. same bit order as FCStoreWriter (lower bits first).
+      assert (bits < 8);
+      const uint8_t mask = (1 << bits) - 1;
+      const unsigned char *cursor = buffer;
+      for (size_t i = 0; i < length; ++i) {
+        codes[i] = (*cursor >> bitOffset) & mask;
+        bitOffset += bits;
+        if (bitOffset >= 8) {
+          bitOffset -= 8;
+          ++cursor;
+        }
+      }
+    }
+  }
+}
+
+std::vector<int64_t> FColumnAggregator::getDictionaryValuesAsInt64 (FColumnReaderDictionary *reader) {
+  const FCStoreColumn &column = reader->getColumn();
+  const vector<string> &entries = reader->getAllDictionaryEntries();
+  vector<int64_t> values (entries.size(), 0);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    assert ((int) entries[i].size() == column.maxLength);
+    switch (column.type) {
+    case COLUMN_INT8: widenToInt64<int8_t>(entries[i].data(), 1, &values[i]); break;
+    case COLUMN_INT16: widenToInt64<int16_t>(entries[i].data(), 1, &values[i]); break;
+    case COLUMN_INT32: widenToInt64<int32_t>(entries[i].data(), 1, &values[i]); break;
+    case COLUMN_INT64: widenToInt64<int64_t>(entries[i].data(), 1, &values[i]); break;
+    default:
+      LOG(ERROR) << "aggregation is only for integer columns. column=" << column.name;
+      assert (false);
+      throw std::exception();
+    }
+  }
+  return values;
+}
+
+// ==========================================================================
+//  Aggregations
+// ==========================================================================
+int64_t FColumnAggregator::sum (FColumnReader *reader, const PositionRange &range, const AggregateFilter &filter) {
+  checkFilterBitmapCovers (filter, range);
+  int64_t total = 0;
+  switch (reader->getColumn().compression) {
+  case RLE_COMPRESSED:
+    {
+      // value * run length. runs are never expanded.
+      vector<pair<PositionRange, int64_t> > runs;
+      readIntRuns (dynamic_cast<FColumnReaderRLE*>(reader), range, NULL, runs);
+      for (size_t i = 0; i < runs.size(); ++i) {
+        const PositionRange &run = runs[i].first;
+        int64_t length = countFilteredPositions(filter, run.begin, run.end);
+        total += runs[i].second * length;
+      }
+    }
+    break;
+  case DICTIONARY_COMPRESSED:
+    {
+      // count per code, then look up each distinct value only once.
+      FColumnReaderDictionary *dictReader = dynamic_cast<FColumnReaderDictionary*>(reader);
+      vector<int64_t> counts;
+      countDictionaryCodes (dictReader, range, filter, counts);
+      vector<int64_t> values = getDictionaryValuesAsInt64(dictReader);
+      for (size_t code = 0; code < counts.size(); ++code) {
+        total += values[code] * counts[code];
+      }
+    }
+    break;
+  default:
+    {
+      int64_t values[FDB_COLUMN_BLOCK_SIZE];
+      uint64_t mask[FDB_COLUMN_BLOCK_SIZE / 64 + 1];
+      for (int64_t blockBegin = range.begin; blockBegin < range.end; blockBegin += FDB_COLUMN_BLOCK_SIZE) {
+        PositionRange block (blockBegin, std::min<int64_t>(range.end, blockBegin + FDB_COLUMN_BLOCK_SIZE));
+        size_t length = block.end - block.begin;
+        if (countFilteredPositions(filter, block.begin, block.end) == 0) continue;
+        readBlockAsInt64 (reader, block, values);
+        if (!readFilterMask(filter, block, mask)) {
+          for (size_t i = 0; i < length; ++i) total += values[i];
+        } else {
+          for (size_t i = 0; i < length; ++i) {
+            if (isMaskSet(mask, i)) total += values[i];
+          }
+        }
+      }
+    }
+  }
+  return total;
+}
+
+int64_t FColumnAggregator::count (FColumnReader *reader, const SearchCond &cond, const PositionRange &range) {
+  const FCStoreColumn &column = reader->getColumn();
+  int64_t total = 0;
+  switch (column.compression) {
+  case RLE_COMPRESSED:
+    {
+      FColumnReaderRLE *rleReader = dynamic_cast<FColumnReaderRLE*>(reader);
+      if (column.type == COLUMN_CHAR) {
+        vector<pair<PositionRange, string> > runs;
+        rleReader->getRLECompressedData(range, runs);
+        for (size_t i = 0; i < runs.size(); ++i) {
+          if (cond.matchString(runs[i].second.data(), column.maxLength)) total += runs[i].first.end - runs[i].first.begin;
+        }
+      } else {
+        vector<pair<PositionRange, int64_t> > runs;
+        readIntRuns (rleReader, range, &cond, runs);
+        for (size_t i = 0; i < runs.size(); ++i) {
+          total += runs[i].first.end - runs[i].first.begin;
+        }
+      }
+    }
+    break;
+  case DICTIONARY_COMPRESSED:
+    {
+      // evaluate the condition on the dictionary, then count codes.
+      FColumnReaderDictionary *dictReader = dynamic_cast<FColumnReaderDictionary*>(reader);
+      vector<int> matchingCodes = dictReader->searchDictionary(cond);
+      if (matchingCodes.empty()) return 0;
+      vector<int64_t> counts;
+      countDictionaryCodes (dictReader, range, AggregateFilter(), counts);
+      for (size_t i = 0; i < matchingCodes.size(); ++i) {
+        total += counts[matchingCodes[i]];
+      }
+    }
+    break;
+  default:
+    {
+      char buffer[FDB_COLUMN_BLOCK_SIZE * 16];
+      const int64_t blockSize = std::max<int64_t>(1, sizeof(buffer) / column.maxLength);
+      for (int64_t blockBegin = range.begin; blockBegin < range.end; blockBegin += blockSize) {
+        PositionRange block (blockBegin, std::min<int64_t>(range.end, blockBegin + blockSize));
+        size_t length = block.end - block.begin;
+        reader->getDecompressedData(block, buffer, sizeof(buffer));
+        const char *cursor = buffer;
+        for (size_t i = 0; i < length; ++i, cursor += column.maxLength) {
+          bool matched = (column.type == COLUMN_CHAR) ? cond.matchString(cursor, column.maxLength) : cond.matchInts(cursor, column.maxLength);
+          if (matched) ++total;
+        }
+      }
+    }
+  }
+  return total;
+}
+
+void FColumnAggregator::countGroupByDictionary (FColumnReaderDictionary *groupReader, const PositionRange &range, std::vector<int64_t> &counts) {
+  countDictionaryCodes (groupReader, range, AggregateFilter(), counts);
+}
+
+void FColumnAggregator::sumGroupByDictionary (FColumnReaderDictionary *groupReader, FColumnReader *valueReader,
+  const PositionRange &range, const AggregateFilter &filter, std::vector<int64_t> &sums) {
+  checkFilterBitmapCovers (filter, range);
+  const size_t entryCount = groupReader->getDictionaryEntryCount();
+  sums.assign (entryCount, 0);
+
+  // code filter as a flag array to avoid searching the code list for each tuple.
+  vector<char> codeMatched;
+  if (filter.codes != NULL) {
+    codeMatched.assign (entryCount, 0);
+    for (size_t i = 0; i < filter.codes->size(); ++i) {
+      int code = (*filter.codes)[i];
+      assert (code >= 0 && (size_t) code < entryCount);
+      codeMatched[code] = 1;
+    }
+  }
+
+  uint32_t codes[FDB_COLUMN_BLOCK_SIZE];
+  int64_t values[FDB_COLUMN_BLOCK_SIZE];
+  uint64_t mask[FDB_COLUMN_BLOCK_SIZE / 64 + 1];
+  for (int64_t blockBegin = range.begin; blockBegin < range.end; blockBegin += FDB_COLUMN_BLOCK_SIZE) {
+    PositionRange block (blockBegin, std::min<int64_t>(range.end, blockBegin + FDB_COLUMN_BLOCK_SIZE));
+    size_t length = block.end - block.begin;
+    if (countFilteredPositions(filter, block.begin, block.end) == 0) continue;
+    readBlockCodes (groupReader, block, codes);
+    readBlockAsInt64 (valueReader, block, values);
+    const bool masked = readFilterMask(filter, block, mask);
+    for (size_t i = 0; i < length; ++i) {
+      uint32_t code = codes[i];
+      assert (code < entryCount);
+      if (masked && !isMaskSet(mask, i)) continue;
+      if (filter.codes != NULL && !codeMatched[code]) continue;
+      sums[code] += values[i];
+    }
+  }
+}
+
+void FColumnAggregator::sumGroupByRLE (FColumnReaderRLE *groupReader, FColumnReader *valueReader,
+  const PositionRange &range, const AggregateFilter &filter, std::vector<std::pair<int64_t, int64_t> > &sums) {
+  checkFilterBitmapCovers (filter, range);
+  sums.clear();
+  vector<pair<PositionRange, int64_t> > runs;
+  readIntRuns (groupReader, range, NULL, runs);
+  AggregateFilter valueFilter (filter);
+  valueFilter.codes = NULL;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    int64_t runSum = sum (valueReader, runs[i].first, valueFilter);
+    if (!sums.empty() && sums.back().first == runs[i].second) {
+      sums.back().second += runSum;
+    } else {
+      sums.push_back (pair<int64_t, int64_t>(runs[i].second, runSum));
+    }
+  }
+}
+
+} // fdb
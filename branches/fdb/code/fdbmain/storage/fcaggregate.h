@@ -0,0 +1,74 @@
+#ifndef STORAGE_FCAGGREGATE_H
+#define STORAGE_FCAGGREGATE_H
+
+#include "../configvalues.h"
+#include "fcstore.h"
+#include <stdint.h>
+#include <vector>
+#include <utility>
+
+namespace fdb {
+
+// Aggregations (SUM/COUNT/GROUP BY) over c-store columns, evaluated
+// directly on compressed data whenever possible.
+//  RLE: aggregated per run (value * run length). runs are never expanded.
+//  Dictionary: aggregated per dictionary code. dictionary entries are not
+//    looked up while scanning; the caller converts codes to values only once
+//    at the end (see FColumnReaderDictionary::getAllDictionaryEntries()).
+//  Uncompressed: read in blocks of FDB_COLUMN_BLOCK_SIZE values.
+// In any case, no method here materializes the whole range in memory.
+
+class CompressedPositionBitmap;
+// optional filters on the positions to aggregate. NULL means no filter.
+struct AggregateFilter {
+  AggregateFilter () : bitmap(NULL), positions(NULL), codes(NULL) {}
+  explicit AggregateFilter (const PositionBitmap *bitmap_) : bitmap(bitmap_), positions(NULL), codes(NULL) {}
+  explicit AggregateFilter (const CompressedPositionBitmap *positions_) : bitmap(NULL), positions(positions_), codes(NULL) {}
+  explicit AggregateFilter (const std::vector<int> *codes_) : bitmap(NULL), positions(NULL), codes(codes_) {}
+
+  // only positions set in this bitmap are aggregated.
+  // the bitmap must cover the whole aggregated range.
+  const PositionBitmap *bitmap;
+  // same as bitmap, but compressed and covers any range. don't set both.
+  // RLE runs are counted with popcount, other columns are filtered a word (64 positions) at a time.
+  const CompressedPositionBitmap *positions;
+  // only these dictionary codes of the grouping column are aggregated.
+  // (only for GROUP BY on dictionary-compressed column)
+  const std::vector<int> *codes;
+};
+
+class FColumnAggregator {
+public:
+  // SUM(column) over the range. the column must be an integer column.
+  static int64_t sum (FColumnReader *reader, const PositionRange &range, const AggregateFilter &filter = AggregateFilter());
+
+  // COUNT(*) over the range for positions matching with the condition.
+  static int64_t count (FColumnReader *reader, const SearchCond &cond, const PositionRange &range);
+
+  // COUNT(*) GROUP BY dictionary code. counts is resized to the dictionary entry count.
+  static void countGroupByDictionary (FColumnReaderDictionary *groupReader, const PositionRange &range, std::vector<int64_t> &counts);
+
+  // SUM(valueReader) GROUP BY groupReader, where groupReader is dictionary compressed.
+  // sums is resized to the dictionary entry count and indexed by dictionary code.
+  static void sumGroupByDictionary (FColumnReaderDictionary *groupReader, FColumnReader *valueReader,
+    const PositionRange &range, const AggregateFilter &filter, std::vector<int64_t> &sums);
+
+  // SUM(valueReader) GROUP BY groupReader, where groupReader is RLE compressed (integer).
+  // sums receives <group value, sum> in the order of runs. adjacent runs with same value are merged.
+  static void sumGroupByRLE (FColumnReaderRLE *groupReader, FColumnReader *valueReader,
+    const PositionRange &range, const AggregateFilter &filter, std::vector<std::pair<int64_t, int64_t> > &sums);
+
+  // reads the values of an integer column in the range as int64_t.
+  // range must not be longer than FDB_COLUMN_BLOCK_SIZE.
+  static void readBlockAsInt64 (FColumnReader *reader, const PositionRange &range, int64_t *values);
+
+  // reads dictionary codes in the range as unsigned integers, unpacking sub-byte codes.
+  // range must not be longer than FDB_COLUMN_BLOCK_SIZE.
+  static void readBlockCodes (FColumnReaderDictionary *reader, const PositionRange &range, uint32_t *codes);
+
+  // returns the integer values of dictionary entries, indexed by dictionary code.
+  static std::vector<int64_t> getDictionaryValuesAsInt64 (FColumnReaderDictionary *reader);
+};
+
+} // fdb
+#endif // STORAGE_FCAGGREGATE_H
@@ -0,0 +1,403 @@
+#include "fcbitmap.h"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+namespace fdb {
+
+// positions in a container
+#define CONTAINER_BITS 16
+#define CONTAINER_SIZE (1 << CONTAINER_BITS)
+#define CONTAINER_MASK (CONTAINER_SIZE - 1)
+#define BITMAP_CONTAINER_WORDS (CONTAINER_SIZE / 64)
+// array container holds at most this number of positions. (same byte size as bitmap container)
+#define ARRAY_CONTAINER_MAX 4096
+
+// ==========================================================================
+//  Internal helpers
+// ==========================================================================
+// sets bits [from, to) of words
+void setWordBits (uint64_t *words, int from, int to) {
+  while (from < to) {
+    int bit = from & 63;
+    int n = std::min (64 - bit, to - from);
+    uint64_t mask = (n == 64) ? ~((uint64_t) 0) : ((((uint64_t) 1 << n) - 1) << bit);
+    words[from >> 6] |= mask;
+    from += n;
+  }
+}
+// counts bits [from, to) of words
+int64_t countWordBits (const uint64_t *words, int from, int to) {
+  int64_t count = 0;
+  while (from < to) {
+    int bit = from & 63;
+    int n = std::min (64 - bit, to - from);
+    uint64_t mask = (n == 64) ? ~((uint64_t) 0) : ((((uint64_t) 1 << n) - 1) << bit);
+    count += __builtin_popcountll (words[from >> 6] & mask);
+    from += n;
+  }
+  return count;
+}
+
+// ==========================================================================
+//  Container
+// ==========================================================================
+void CompressedPositionBitmap::Container::toBitmap () {
+  if (isBitmap()) return;
+  words.assign (BITMAP_CONTAINER_WORDS, 0);
+  for (size_t i = 0; i < array.size(); ++i) {
+    words[array[i] >> 6] |= (uint64_t) 1 << (array[i] & 63);
+  }
+  std::vector<uint16_t>().swap(array);
+}
+void CompressedPositionBitmap::Container::recount () {
+  if (isBitmap()) {
+    cardinality = 0;
+    for (int i = 0; i < BITMAP_CONTAINER_WORDS; ++i) {
+      cardinality += __builtin_popcountll (words[i]);
+    }
+  } else {
+    cardinality = array.size();
+  }
+}
+void CompressedPositionBitmap::Container::optimize () {
+  if (!isBitmap() || cardinality > ARRAY_CONTAINER_MAX) return;
+  array.clear();
+  array.reserve (cardinality);
+  for (int i = 0; i < BITMAP_CONTAINER_WORDS; ++i) {
+    for (uint64_t word = words[i]; word != 0; word &= word - 1) {
+      array.push_back ((uint16_t) ((i << 6) + __builtin_ctzll (word)));
+    }
+  }
+  std::vector<uint64_t>().swap(words);
+  assert ((int) array.size() == cardinality);
+}
+
+void CompressedPositionBitmap::Container::swapWith (Container &other) {
+  std::swap (key, other.key);
+  std::swap (cardinality, other.cardinality);
+  array.swap (other.array);
+  words.swap (other.words);
+}
+
+CompressedPositionBitmap::Container& CompressedPositionBitmap::getOrCreate (int64_t key) {
+  std::vector<Container>::iterator it = std::lower_bound (_containers.begin(), _containers.end(), key, keyLess);
+  if (it == _containers.end() || it->key != key) {
+    it = _containers.insert (it, Container(key));
+  }
+  return *it;
+}
+const CompressedPositionBitmap::Container* CompressedPositionBitmap::find (int64_t key) const {
+  std::vector<Container>::const_iterator it = std::lower_bound (_containers.begin(), _containers.end(), key, keyLess);
+  if (it == _containers.end() || it->key != key) return NULL;
+  return &(*it);
+}
+void CompressedPositionBitmap::removeEmptyContainers () {
+  size_t j = 0;
+  for (size_t i = 0; i < _containers.size(); ++i) {
+    if (_containers[i].cardinality == 0) continue;
+    if (i != j) _containers[j].swapWith (_containers[i]);
+    ++j;
+  }
+  _containers.resize (j);
+}
+
+// ==========================================================================
+//  Building
+// ==========================================================================
+void CompressedPositionBitmap::add (int64_t position) {
+  assert (position >= 0);
+  Container &container = getOrCreate (position >> CONTAINER_BITS);
+  uint16_t low = (uint16_t) (position & CONTAINER_MASK);
+  if (container.isBitmap()) {
+    uint64_t &word = container.words[low >> 6];
+    uint64_t bit = (uint64_t) 1 << (low & 63);
+    if ((word & bit) == 0) {
+      word |= bit;
+      ++container.cardinality;
+    }
+  } else {
+    std::vector<uint16_t>::iterator it = std::lower_bound (container.array.begin(), container.array.end(), low);
+    if (it != container.array.end() && *it == low) return;
+    container.array.insert (it, low);
+    ++container.cardinality;
+    if (container.cardinality > ARRAY_CONTAINER_MAX) container.toBitmap();
+  }
+}
+
+void CompressedPositionBitmap::addRange (const PositionRange &range) {
+  assert (range.begin >= 0);
+  if (range.begin >= range.end) return;
+  for (int64_t key = range.begin >> CONTAINER_BITS; key <= ((range.end - 1) >> CONTAINER_BITS); ++key) {
+    const int64_t base = key << CONTAINER_BITS;
+    int from = (int) (std::max (range.begin, base) - base);
+    int to = (int) (std::min (range.end, base + CONTAINER_SIZE) - base);
+    Container &container = getOrCreate (key);
+    if (!container.isBitmap() && container.cardinality + (to - from) <= ARRAY_CONTAINER_MAX) {
+      std::vector<uint16_t> added;
+      added.reserve (to - from);
+      for (int low = from; low < to; ++low) added.push_back ((uint16_t) low);
+      std::vector<uint16_t> merged;
+      merged.reserve (container.array.size() + added.size());
+      std::set_union (container.array.begin(), container.array.end(), added.begin(), added.end(), std::back_inserter(merged));
+      container.array.swap (merged);
+    } else {
+      container.toBitmap ();
+      setWordBits (&(container.words[0]), from, to);
+    }
+    container.recount ();
+  }
+}
+
+void CompressedPositionBitmap::addRanges (const std::vector<PositionRange> &ranges) {
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    addRange (ranges[i]);
+  }
+}
+
+void CompressedPositionBitmap::addBitmap (const PositionBitmap &bitmap) {
+  for (size_t i = 0; i < bitmap.byteLength; ++i) {
+    for (unsigned int byte = bitmap.bitmap[i]; byte != 0; byte &= byte - 1) {
+      int64_t bit = i * 8 + __builtin_ctz (byte);
+      if (bit >= (int64_t) bitmap.bitLength) break;
+      add (bitmap.beginPosition + bit);
+    }
+  }
+}
+
+// ==========================================================================
+//  Accessors
+// ==========================================================================
+bool CompressedPositionBitmap::contains (int64_t position) const {
+  const Container *container = find (position >> CONTAINER_BITS);
+  if (container == NULL) return false;
+  uint16_t low = (uint16_t) (position & CONTAINER_MASK);
+  if (container->isBitmap()) {
+    return (container->words[low >> 6] & ((uint64_t) 1 << (low & 63))) != 0;
+  } else {
+    return std::binary_search (container->array.begin(), container->array.end(), low);
+  }
+}
+
+int64_t CompressedPositionBitmap::count () const {
+  int64_t total = 0;
+  for (size_t i = 0; i < _containers.size(); ++i) {
+    total += _containers[i].cardinality;
+  }
+  return total;
+}
+
+int64_t CompressedPositionBitmap::count (const PositionRange &range) const {
+  if (range.begin >= range.end) return 0;
+  int64_t total = 0;
+  std::vector<Container>::const_iterator it = std::lower_bound (_containers.begin(), _containers.end(), range.begin >> CONTAINER_BITS, keyLess);
+  for (; it != _containers.end() && (it->key << CONTAINER_BITS) < range.end; ++it) {
+    const int64_t base = it->key << CONTAINER_BITS;
+    int from = (int) (std::max (range.begin, base) - base);
+    int to = (int) (std::min (range.end, base + CONTAINER_SIZE) - base);
+    if (from == 0 && to == CONTAINER_SIZE) {
+      total += it->cardinality;
+    } else if (it->isBitmap()) {
+      total += countWordBits (&(it->words[0]), from, to);
+    } else {
+      total += std::lower_bound (it->array.begin(), it->array.end(), to) - std::lower_bound (it->array.begin(), it->array.end(), from);
+    }
+  }
+  return total;
+}
+
+void CompressedPositionBitmap::toRanges (std::vector<PositionRange> &ranges) const {
+  Iterator it (*this);
+  int64_t position;
+  bool hasCurrent = false;
+  PositionRange current;
+  while (it.next(position)) {
+    if (hasCurrent && current.end == position) {
+      ++current.end;
+      continue;
+    }
+    if (hasCurrent) ranges.push_back (current);
+    current = PositionRange (position, position + 1);
+    hasCurrent = true;
+  }
+  if (hasCurrent) ranges.push_back (current);
+}
+
+void CompressedPositionBitmap::getWords (const PositionRange &range, uint64_t *words) const {
+  assert (range.begin <= range.end);
+  ::memset (words, 0, ((range.end - range.begin + 63) / 64) * sizeof(uint64_t));
+  if (range.begin >= range.end) return;
+  std::vector<Container>::const_iterator it = std::lower_bound (_containers.begin(), _containers.end(), range.begin >> CONTAINER_BITS, keyLess);
+  for (; it != _containers.end() && (it->key << CONTAINER_BITS) < range.end; ++it) {
+    const int64_t base = it->key << CONTAINER_BITS;
+    int from = (int) (std::max (range.begin, base) - base);
+    int to = (int) (std::min (range.end, base + CONTAINER_SIZE) - base);
+    const int64_t offset = base - range.begin; // bit index in words of low=0
+    if (it->isBitmap()) {
+      for (int i = from >> 6; i <= ((to - 1) >> 6); ++i) {
+        for (uint64_t word = it->words[i]; word != 0; word &= word - 1) {
+          int low = (i << 6) + __builtin_ctzll (word);
+          if (low < from) continue;
+          if (low >= to) break;
+          int64_t bit = offset + low;
+          words[bit >> 6] |= (uint64_t) 1 << (bit & 63);
+        }
+      }
+    } else {
+      std::vector<uint16_t>::const_iterator cur = std::lower_bound (it->array.begin(), it->array.end(), from);
+      for (; cur != it->array.end() && *cur < to; ++cur) {
+        int64_t bit = offset + *cur;
+        words[bit >> 6] |= (uint64_t) 1 << (bit & 63);
+      }
+    }
+  }
+}
+
+bool CompressedPositionBitmap::Iterator::next (int64_t &position) {
+  while (_container < _bitmap._containers.size()) {
+    const Container &container = _bitmap._containers[_container];
+    if (container.isBitmap()) {
+      while (_index < (size_t) CONTAINER_SIZE) {
+        uint64_t word = container.words[_index >> 6] >> (_index & 63);
+        if (word == 0) {
+          _index = (_index | 63) + 1;
+          continue;
+        }
+        _index += __builtin_ctzll (word);
+        position = (container.key << CONTAINER_BITS) | _index;
+        ++_index;
+        return true;
+      }
+    } else if (_index < container.array.size()) {
+      position = (container.key << CONTAINER_BITS) | container.array[_index];
+      ++_index;
+      return true;
+    }
+    ++_container;
+    _index = 0;
+  }
+  return false;
+}
+
+// ==========================================================================
+//  Set operations
+// ==========================================================================
+void CompressedPositionBitmap::andWith (const CompressedPositionBitmap &other) {
+  std::vector<Container>::iterator it = _containers.begin();
+  std::vector<Container>::const_iterator ot = other._containers.begin();
+  for (; it != _containers.end(); ++it) {
+    while (ot != other._containers.end() && ot->key < it->key) ++ot;
+    if (ot == other._containers.end() || ot->key != it->key) {
+      it->cardinality = 0;
+      continue;
+    }
+    Container &a = *it;
+    const Container &b = *ot;
+    if (a.isBitmap() && b.isBitmap()) {
+      for (int i = 0; i < BITMAP_CONTAINER_WORDS; ++i) a.words[i] &= b.words[i];
+      a.recount ();
+      a.optimize ();
+    } else if (a.isBitmap()) {
+      // the result is at most b's cardinality. make it an array.
+      std::vector<uint16_t> result;
+      for (size_t i = 0; i < b.array.size(); ++i) {
+        if (a.words[b.array[i] >> 6] & ((uint64_t) 1 << (b.array[i] & 63))) result.push_back (b.array[i]);
+      }
+      std::vector<uint64_t>().swap(a.words);
+      a.array.swap (result);
+      a.recount ();
+    } else if (b.isBitmap()) {
+      std::vector<uint16_t> result;
+      for (size_t i = 0; i < a.array.size(); ++i) {
+        if (b.words[a.array[i] >> 6] & ((uint64_t) 1 << (a.array[i] & 63))) result.push_back (a.array[i]);
+      }
+      a.array.swap (result);
+      a.recount ();
+    } else {
+      std::vector<uint16_t> result;
+      std::set_intersection (a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(result));
+      a.array.swap (result);
+      a.recount ();
+    }
+  }
+  removeEmptyContainers ();
+}
+
+void CompressedPositionBitmap::orWith (const CompressedPositionBitmap &other) {
+  std::vector<Container> result;
+  result.reserve (_containers.size() + other._containers.size());
+  std::vector<Container>::iterator it = _containers.begin();
+  std::vector<Container>::const_iterator ot = other._containers.begin();
+  while (it != _containers.end() || ot != other._containers.end()) {
+    if (ot == other._containers.end() || (it != _containers.end() && it->key < ot->key)) {
+      result.push_back (Container());
+      result.back().swapWith (*it);
+      ++it;
+    } else if (it == _containers.end() || ot->key < it->key) {
+      result.push_back (*ot);
+      ++ot;
+    } else {
+      result.push_back (Container());
+      Container &a = result.back();
+      a.swapWith (*it);
+      const Container &b = *ot;
+      if (!a.isBitmap() && !b.isBitmap()) {
+        std::vector<uint16_t> merged;
+        merged.reserve (a.array.size() + b.array.size());
+        std::set_union (a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(merged));
+        a.array.swap (merged);
+        a.recount ();
+        if (a.cardinality > ARRAY_CONTAINER_MAX) a.toBitmap();
+      } else {
+        a.toBitmap ();
+        if (b.isBitmap()) {
+          for (int i = 0; i < BITMAP_CONTAINER_WORDS; ++i) a.words[i] |= b.words[i];
+        } else {
+          for (size_t i = 0; i < b.array.size(); ++i) a.words[b.array[i] >> 6] |= (uint64_t) 1 << (b.array[i] & 63);
+        }
+        a.recount ();
+      }
+      ++it;
+      ++ot;
+    }
+  }
+  _containers.swap (result);
+}
+
+void CompressedPositionBitmap::andNotWith (const CompressedPositionBitmap &other) {
+  std::vector<Container>::iterator it = _containers.begin();
+  std::vector<Container>::const_iterator ot = other._containers.begin();
+  for (; it != _containers.end(); ++it) {
+    while (ot != other._containers.end() && ot->key < it->key) ++ot;
+    if (ot == other._containers.end() || ot->key != it->key) continue;
+    Container &a = *it;
+    const Container &b = *ot;
+    if (a.isBitmap()) {
+      if (b.isBitmap()) {
+        for (int i = 0; i < BITMAP_CONTAINER_WORDS; ++i) a.words[i] &= ~b.words[i];
+      } else {
+        for (size_t i = 0; i < b.array.size(); ++i) a.words[b.array[i] >> 6] &= ~((uint64_t) 1 << (b.array[i] & 63));
+      }
+      a.recount ();
+      a.optimize ();
+    } else if (b.isBitmap()) {
+      std::vector<uint16_t> result;
+      for (size_t i = 0; i < a.array.size(); ++i) {
+        if ((b.words[a.array[i] >> 6] & ((uint64_t) 1 << (a.array[i] & 63))) == 0) result.push_back (a.array[i]);
+      }
+      a.array.swap (result);
+      a.recount ();
+    } else {
+      std::vector<uint16_t> result;
+      std::set_difference (a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(result));
+      a.array.swap (result);
+      a.recount ();
+    }
+  }
+  removeEmptyContainers ();
+}
+
+} // fdb
@@ -0,0 +1,89 @@
+#ifndef STORAGE_FCBITMAP_H
+#define STORAGE_FCBITMAP_H
+
+#include "fcstore.h"
+#include <stdint.h>
+#include <vector>
+
+namespace fdb {
+
+// Compressed set of positions (=tupleid), in the style of Roaring bitmaps.
+// Positions are split into chunks of 2^16 positions by their higher bits.
+// Each non-empty chunk is stored in a container which is either
+//  array: sorted lower 16 bits of positions. when at most 4096 positions are set.
+//  bitmap: 2^16 bits (1024 words). otherwise.
+// So, a sparse result of a selective predicate is small, while a dense one
+// is processed a word (64 positions) at a time in AND/OR/ANDNOT and counting.
+// Unlike PositionBitmap, one object can hold positions of any number of
+// ranges (see FColumnReader::getPositionBitmap()).
+class CompressedPositionBitmap {
+public:
+  CompressedPositionBitmap () {}
+
+  void add (int64_t position);
+  void addRange (const PositionRange &range);
+  void addRanges (const std::vector<PositionRange> &ranges);
+  // adds set bits of the raw bitmap.
+  void addBitmap (const PositionBitmap &bitmap);
+
+  bool contains (int64_t position) const;
+  bool empty () const { return _containers.empty(); }
+  void clear () { _containers.clear(); }
+
+  // number of set positions (in the range)
+  int64_t count () const;
+  int64_t count (const PositionRange &range) const;
+
+  // this = this AND other, this OR other, this AND NOT other.
+  void andWith (const CompressedPositionBitmap &other);
+  void orWith (const CompressedPositionBitmap &other);
+  void andNotWith (const CompressedPositionBitmap &other);
+
+  // returns set positions as ranges of consecutive positions.
+  void toRanges (std::vector<PositionRange> &ranges) const;
+  // fills words so that bit i of words[i / 64] tells whether range.begin + i is set.
+  // words must have (range.end - range.begin + 63) / 64 entries.
+  void getWords (const PositionRange &range, uint64_t *words) const;
+
+  // iterates set positions in ascending order.
+  //   CompressedPositionBitmap::Iterator it (bitmap);
+  //   for (int64_t pos; it.next(pos);) { ... }
+  class Iterator {
+  public:
+    Iterator (const CompressedPositionBitmap &bitmap) : _bitmap(bitmap), _container(0), _index(0) {}
+    bool next (int64_t &position);
+  private:
+    const CompressedPositionBitmap &_bitmap;
+    size_t _container;
+    size_t _index; // index in array, or bit index in bitmap
+  };
+
+private:
+  struct Container {
+    Container () : key(0), cardinality(0) {}
+    explicit Container (int64_t key_) : key(key_), cardinality(0) {}
+    int64_t key; // position >> 16
+    int cardinality;
+    std::vector<uint16_t> array; // used when words is empty
+    std::vector<uint64_t> words; // 1024 words if bitmap container
+
+    bool isBitmap () const { return !words.empty(); }
+    void toBitmap ();
+    // converts to array container if small enough. removes nothing even if empty.
+    void optimize ();
+    void recount ();
+    // cheap exchange, to move containers without copying arrays
+    void swapWith (Container &other);
+  };
+  static bool keyLess (const Container &container, int64_t key) { return container.key < key; }
+
+  // returns the container for the key. creates it if not exists.
+  Container& getOrCreate (int64_t key);
+  const Container* find (int64_t key) const;
+  void removeEmptyContainers ();
+
+  std::vector<Container> _containers; // sorted by key
+};
+
+} // fdb
+#endif // STORAGE_FCBITMAP_H
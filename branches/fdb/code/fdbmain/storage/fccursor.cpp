@@ -0,0 +1,45 @@
+#include "fccursor.h"
+#include <cassert>
+#include <algorithm>
+
+using namespace std;
+
+namespace fdb {
+
+FColumnCursor::FColumnCursor (FColumnReader *reader, const std::vector<PositionRange> &ranges, size_t chunkSize)
+  : _reader(reader), _ranges(ranges), _chunkSize(chunkSize) {
+  init ();
+}
+FColumnCursor::FColumnCursor (FColumnReader *reader, const PositionRange &range, size_t chunkSize)
+  : _reader(reader), _ranges(1, range), _chunkSize(chunkSize) {
+  init ();
+}
+
+void FColumnCursor::init () {
+  assert (_reader != NULL);
+  assert (_chunkSize > 0);
+  _rangeIndex = 0;
+  _nextPosition = _ranges.empty() ? 0 : _ranges[0].begin;
+  _buffer.reset (new char[_chunkSize * _reader->getColumn().maxLength]);
+}
+
+bool FColumnCursor::next () {
+  // skip consumed (or empty) ranges
+  while (_rangeIndex < _ranges.size() && _nextPosition >= _ranges[_rangeIndex].end) {
+    ++_rangeIndex;
+    if (_rangeIndex < _ranges.size()) {
+      _nextPosition = _ranges[_rangeIndex].begin;
+    }
+  }
+  if (_rangeIndex >= _ranges.size()) {
+    _current = PositionRange ();
+    return false;
+  }
+
+  _current = PositionRange (_nextPosition, min<int64_t>(_ranges[_rangeIndex].end, _nextPosition + _chunkSize));
+  _reader->getDecompressedData(_current, _buffer.get(), _chunkSize * _reader->getColumn().maxLength);
+  _nextPosition = _current.end;
+  return true;
+}
+
+} // fdb
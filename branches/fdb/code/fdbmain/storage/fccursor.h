@@ -0,0 +1,63 @@
+#ifndef STORAGE_FCCURSOR_H
+#define STORAGE_FCCURSOR_H
+
+#include "../configvalues.h"
+#include "fcstore.h"
+#include <stdint.h>
+#include <vector>
+#include <cassert>
+#include <boost/scoped_array.hpp>
+
+namespace fdb {
+
+// Vector-at-a-time cursor over a column.
+// Reads the decompressed values of the given position ranges chunk by chunk.
+// Each chunk has at most chunkSize values and never spans two ranges, so
+// the memory consumption is bounded and the chunk stays in L1/L2 cache.
+// Works with any FColumnReader (uncompressed, RLE and dictionary).
+// Cursors of different columns created with the same ranges and chunkSize
+// return chunks of exactly same positions, so a multi-column scan can
+// simply call next() on each cursor in lockstep:
+//   FColumnCursor a (readerA, ranges), b (readerB, ranges);
+//   while (a.next() && b.next()) { ... a.getValues<int8_t>()[i] ... b.getValues<int32_t>()[i] ... }
+class FColumnCursor {
+public:
+  FColumnCursor (FColumnReader *reader, const std::vector<PositionRange> &ranges, size_t chunkSize = FDB_COLUMN_BLOCK_SIZE);
+  FColumnCursor (FColumnReader *reader, const PositionRange &range, size_t chunkSize = FDB_COLUMN_BLOCK_SIZE);
+
+  // reads the next chunk. returns false when all ranges are consumed.
+  bool next ();
+
+  // positions of the current chunk
+  const PositionRange& getCurrentRange () const { return _current; }
+  // number of values in the current chunk
+  size_t getCount () const { return _current.end - _current.begin; }
+  // index of the range (in the ranges given to constructor) the current chunk belongs to
+  size_t getCurrentRangeIndex () const { return _rangeIndex; }
+
+  // decompressed values of the current chunk. each value has column.maxLength bytes.
+  const char* getData () const { return _buffer.get(); }
+  template <typename T>
+  const T* getValues () const {
+    assert (sizeof(T) == (size_t) _reader->getColumn().maxLength);
+    return reinterpret_cast<const T*>(_buffer.get());
+  }
+
+  FColumnReader* getReader () const { return _reader; }
+
+private:
+  void init ();
+
+  FColumnReader *_reader;
+  std::vector<PositionRange> _ranges;
+  size_t _chunkSize;
+  size_t _rangeIndex; // index of _ranges being read
+  int64_t _nextPosition; // next position to read in _ranges[_rangeIndex]
+  PositionRange _current;
+  boost::scoped_array<char> _buffer;
+
+  FColumnCursor (const FColumnCursor &); // prohibit copying
+};
+
+} // fdb
+#endif // STORAGE_FCCURSOR_H
@@ -0,0 +1,153 @@
+#include "fcparallel.h"
+#include "searchcond.h"
+#include <cassert>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <glog/logging.h>
+
+namespace fdb {
+
+int FParallelScan::getDefaultThreads () {
+  if (FDB_QUERY_THREADS > 0) return FDB_QUERY_THREADS;
+  return std::max<int> (1, boost::thread::hardware_concurrency());
+}
+
+void FParallelScan::splitIntoMorsels (const std::vector<PositionRange> &ranges, std::vector<PositionRange> &morsels, int64_t morselSize) {
+  assert (morselSize > 0);
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    assert (i == 0 || ranges[i - 1].end <= ranges[i].begin);
+    for (int64_t begin = ranges[i].begin; begin < ranges[i].end;) {
+      int64_t end = std::min<int64_t> (ranges[i].end, (begin / morselSize + 1) * morselSize);
+      morsels.push_back (PositionRange (begin, end));
+      begin = end;
+    }
+  }
+}
+
+// morsels to process, shared by the scanning threads.
+struct ParallelMorselScan {
+  ParallelMorselScan (const std::vector<PositionRange> &morsels_) : morsels(morsels_), nextMorsel(0), failed(false) {}
+
+  const std::vector<PositionRange> &morsels;
+  boost::mutex mutex; // protects nextMorsel and failed
+  size_t nextMorsel;
+  bool failed;
+
+  // returns false if no more morsel to process.
+  bool takeNextMorsel (size_t &morselIndex) {
+    boost::mutex::scoped_lock lock(mutex);
+    if (failed || nextMorsel >= morsels.size()) return false;
+    morselIndex = nextMorsel++;
+    return true;
+  }
+  void setFailed () {
+    boost::mutex::scoped_lock lock(mutex);
+    failed = true;
+  }
+  void run (FMorselWorker *worker) {
+    try {
+      size_t i;
+      while (takeNextMorsel(i)) {
+        worker->processMorsel (i, morsels[i]);
+      }
+    } catch (const std::exception &ex) {
+      LOG(ERROR) << "failed to process a morsel: " << ex.what();
+      setFailed ();
+    }
+  }
+};
+struct ParallelMorselScanWorker {
+  ParallelMorselScanWorker (ParallelMorselScan *scan_, FMorselWorker *worker_) : scan(scan_), worker(worker_) {}
+  void operator() () { scan->run(worker); }
+  ParallelMorselScan *scan;
+  FMorselWorker *worker;
+};
+
+void FParallelScan::run (const std::vector<PositionRange> &morsels, const std::vector<FMorselWorker*> &workers) {
+  assert (workers.size() > 0);
+  // no point to have more threads than morsels
+  size_t threads = std::max<size_t> (1, std::min (workers.size(), morsels.size()));
+  VLOG(2) << "scanning " << morsels.size() << " morsels with " << threads << " threads";
+
+  ParallelMorselScan scan (morsels);
+  boost::thread_group group;
+  for (size_t i = 1; i < threads; ++i) {
+    group.create_thread (ParallelMorselScanWorker(&scan, workers[i]));
+  }
+  scan.run (workers[0]);
+  group.join_all();
+  if (scan.failed) {
+    LOG(ERROR) << "failed to scan morsels";
+    throw std::exception();
+  }
+}
+
+// ==========================================================================
+//  Parallel versions of FColumnReader methods
+// ==========================================================================
+struct DecompressMorselWorker : public FMorselWorker {
+  DecompressMorselWorker (FColumnReader *reader_, int64_t beginPosition_, char *buffer_)
+    : reader(reader_), beginPosition(beginPosition_), buffer(buffer_) {}
+  void processMorsel (size_t morselIndex, const PositionRange &morsel) {
+    const int length = reader->getColumn().maxLength;
+    reader->getDecompressedData (morsel, buffer + (morsel.begin - beginPosition) * length, (morsel.end - morsel.begin) * length);
+  }
+  FColumnReader *reader;
+  int64_t beginPosition;
+  char *buffer;
+};
+
+void FParallelScan::getDecompressedData (const std::vector<FColumnReader*> &readers, const PositionRange &range, void *buffer, size_t bufferSize,
+  int64_t morselSize) {
+  assert (readers.size() > 0);
+  if (range.end - range.begin > 0 && bufferSize < (size_t) ((range.end - range.begin) * readers[0]->getColumn().maxLength)) {
+    LOG(ERROR) << "buffer size is too small (" << bufferSize << ") for " << (range.end - range.begin) << " values";
+    assert (false);
+    throw std::exception();
+  }
+  std::vector<PositionRange> morsels;
+  splitIntoMorsels (std::vector<PositionRange> (1, range), morsels, morselSize);
+  std::vector<boost::shared_ptr<DecompressMorselWorker> > workerPtrs;
+  std::vector<FMorselWorker*> workers;
+  for (size_t i = 0; i < readers.size(); ++i) {
+    assert (readers[i]->getColumn().name == readers[0]->getColumn().name);
+    workerPtrs.push_back (boost::shared_ptr<DecompressMorselWorker> (new DecompressMorselWorker(readers[i], range.begin, reinterpret_cast<char*>(buffer))));
+    workers.push_back (workerPtrs.back().get());
+  }
+  run (morsels, workers);
+}
+
+struct BitmapMorselWorker : public FMorselWorker {
+  BitmapMorselWorker (FColumnReader *reader_, const SearchCond &cond_, std::vector<std::vector<boost::shared_ptr<PositionBitmap> > > &results_)
+    : reader(reader_), cond(cond_), results(results_) {}
+  void processMorsel (size_t morselIndex, const PositionRange &morsel) {
+    // each morsel has its own slot. no lock needed.
+    reader->setSearchRange (morsel);
+    reader->getPositionBitmaps (cond, results[morselIndex]);
+    reader->clearSearchRanges ();
+  }
+  FColumnReader *reader;
+  const SearchCond &cond;
+  std::vector<std::vector<boost::shared_ptr<PositionBitmap> > > &results;
+};
+
+void FParallelScan::getPositionBitmaps (const std::vector<FColumnReader*> &readers, const SearchCond &cond,
+  const std::vector<PositionRange> &ranges, std::vector<boost::shared_ptr<PositionBitmap> > &positions, int64_t morselSize) {
+  assert (readers.size() > 0);
+  std::vector<PositionRange> morsels;
+  splitIntoMorsels (ranges, morsels, morselSize);
+  std::vector<std::vector<boost::shared_ptr<PositionBitmap> > > results (morsels.size());
+  std::vector<boost::shared_ptr<BitmapMorselWorker> > workerPtrs;
+  std::vector<FMorselWorker*> workers;
+  for (size_t i = 0; i < readers.size(); ++i) {
+    assert (readers[i]->getColumn().name == readers[0]->getColumn().name);
+    workerPtrs.push_back (boost::shared_ptr<BitmapMorselWorker> (new BitmapMorselWorker(readers[i], cond, results)));
+    workers.push_back (workerPtrs.back().get());
+  }
+  run (morsels, workers);
+  for (size_t i = 0; i < results.size(); ++i) {
+    positions.insert (positions.end(), results[i].begin(), results[i].end());
+  }
+}
+
+} // fdb
@@ -0,0 +1,54 @@
+#ifndef STORAGE_FCPARALLEL_H
+#define STORAGE_FCPARALLEL_H
+
+#include "../configvalues.h"
+#include "fcstore.h"
+#include <stdint.h>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+namespace fdb {
+
+// Intra-query parallelism for scanning c-store columns (morsel-driven).
+// Position ranges are split into morsels of at most FDB_MORSEL_SIZE positions.
+// Each thread repeatedly takes the next unprocessed morsel, so a thread finishing
+// early simply takes over the remaining morsels instead of waiting for slower ones.
+// Column readers keep search ranges and decoding state, thus are never shared by
+// threads: each thread uses its own reader (e.g., its own FReadOnlyCStore)
+// while the buffer pool and decoded dictionaries are shared.
+
+// processes morsels in one thread. partial results (e.g., sums) are kept in the
+// worker and merged by the caller after FParallelScan::run() returns.
+class FMorselWorker {
+public:
+  virtual ~FMorselWorker() {}
+  // morselIndex is the index of the morsel in the list given to FParallelScan::run().
+  virtual void processMorsel (size_t morselIndex, const PositionRange &morsel) = 0;
+};
+
+class FParallelScan {
+public:
+  // FDB_QUERY_THREADS, or the number of cores if it's 0.
+  static int getDefaultThreads ();
+
+  // splits sorted, non-overlapping ranges into morsels in the same order.
+  // a morsel never crosses a multiple of morselSize.
+  static void splitIntoMorsels (const std::vector<PositionRange> &ranges, std::vector<PositionRange> &morsels, int64_t morselSize = FDB_MORSEL_SIZE);
+
+  // processes all morsels with one thread per worker, and returns after all of them are processed.
+  // the calling thread runs workers[0]. throws an exception if any worker threw one.
+  static void run (const std::vector<PositionRange> &morsels, const std::vector<FMorselWorker*> &workers);
+
+  // parallel FColumnReader::getDecompressedData(). readers[i] is used by the i-th thread
+  // and all of them must read the same column.
+  static void getDecompressedData (const std::vector<FColumnReader*> &readers, const PositionRange &range, void *buffer, size_t bufferSize,
+    int64_t morselSize = FDB_MORSEL_SIZE);
+
+  // parallel FColumnReader::getPositionBitmaps() restricted to the ranges.
+  // bitmaps are returned in the order of positions. search ranges of the readers are cleared.
+  static void getPositionBitmaps (const std::vector<FColumnReader*> &readers, const SearchCond &cond,
+    const std::vector<PositionRange> &ranges, std::vector<boost::shared_ptr<PositionBitmap> > &positions, int64_t morselSize = FDB_MORSEL_SIZE);
+};
+
+} // fdb
+#endif // STORAGE_FCPARALLEL_H
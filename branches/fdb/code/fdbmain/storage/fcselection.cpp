@@ -0,0 +1,345 @@
+#include "fcselection.h"
+#include <cassert>
+#include <algorithm>
+#include <iterator>
+#include <boost/scoped_array.hpp>
+#include <glog/logging.h>
+
+using namespace std;
+
+namespace fdb {
+
+// ==========================================================================
+//  Internal helpers
+// ==========================================================================
+bool rangeBeginLess (const PositionRange &left, const PositionRange &right) {
+  return left.begin < right.begin;
+}
+
+// sorts ranges and merges overlapping/adjacent ones. empty ranges are removed.
+void normalizeRanges (std::vector<PositionRange> &ranges) {
+  std::sort (ranges.begin(), ranges.end(), rangeBeginLess);
+  size_t j = 0;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    if (ranges[i].begin >= ranges[i].end) continue;
+    if (j > 0 && ranges[j - 1].end >= ranges[i].begin) {
+      ranges[j - 1].end = std::max (ranges[j - 1].end, ranges[i].end);
+    } else {
+      ranges[j++] = ranges[i];
+    }
+  }
+  ranges.resize (j);
+}
+
+// both must be normalized.
+void intersectRanges (const std::vector<PositionRange> &left, const std::vector<PositionRange> &right, std::vector<PositionRange> &result) {
+  size_t i = 0, j = 0;
+  while (i < left.size() && j < right.size()) {
+    int64_t begin = std::max (left[i].begin, right[j].begin);
+    int64_t end = std::min (left[i].end, right[j].end);
+    if (begin < end) result.push_back (PositionRange(begin, end));
+    if (left[i].end < right[j].end) {
+      ++i;
+    } else {
+      ++j;
+    }
+  }
+}
+
+// ==========================================================================
+//  FSelection
+// ==========================================================================
+FSelection::FSelection () : _representation(SELECTION_RANGES) {
+}
+FSelection::FSelection (const PositionRange &range) : _representation(SELECTION_RANGES) {
+  if (range.begin < range.end) _ranges.push_back (range);
+}
+FSelection::FSelection (const std::vector<PositionRange> &ranges) : _representation(SELECTION_RANGES), _ranges(ranges) {
+  normalizeRanges (_ranges);
+}
+FSelection::FSelection (const CompressedPositionBitmap &bitmap) : _representation(SELECTION_BITMAP), _bitmap(bitmap) {
+  optimize ();
+}
+FSelection::FSelection (const std::vector<int64_t> &positions) : _representation(SELECTION_POSITIONS), _positions(positions) {
+  std::sort (_positions.begin(), _positions.end());
+  _positions.erase (std::unique (_positions.begin(), _positions.end()), _positions.end());
+  optimize ();
+}
+
+int64_t FSelection::count () const {
+  switch (_representation) {
+  case SELECTION_RANGES:
+    {
+      int64_t total = 0;
+      for (size_t i = 0; i < _ranges.size(); ++i) total += _ranges[i].end - _ranges[i].begin;
+      return total;
+    }
+  case SELECTION_BITMAP: return _bitmap.count();
+  case SELECTION_POSITIONS: return _positions.size();
+  }
+  assert (false);
+  return 0;
+}
+
+bool FSelection::empty () const {
+  switch (_representation) {
+  case SELECTION_RANGES: return _ranges.empty();
+  case SELECTION_BITMAP: return _bitmap.empty();
+  case SELECTION_POSITIONS: return _positions.empty();
+  }
+  assert (false);
+  return true;
+}
+
+bool FSelection::contains (int64_t position) const {
+  switch (_representation) {
+  case SELECTION_RANGES:
+    {
+      // the last range beginning at or before the position
+      std::vector<PositionRange>::const_iterator it = std::upper_bound (_ranges.begin(), _ranges.end(), PositionRange(position, position), rangeBeginLess);
+      if (it == _ranges.begin()) return false;
+      --it;
+      return position < it->end;
+    }
+  case SELECTION_BITMAP: return _bitmap.contains(position);
+  case SELECTION_POSITIONS: return std::binary_search (_positions.begin(), _positions.end(), position);
+  }
+  assert (false);
+  return false;
+}
+
+void FSelection::getRanges (std::vector<PositionRange> &ranges) const {
+  switch (_representation) {
+  case SELECTION_RANGES:
+    ranges.insert (ranges.end(), _ranges.begin(), _ranges.end());
+    break;
+  case SELECTION_BITMAP:
+    _bitmap.toRanges (ranges);
+    break;
+  case SELECTION_POSITIONS:
+    for (size_t i = 0; i < _positions.size(); ++i) {
+      if (i > 0 && ranges.back().end == _positions[i]) {
+        ++ranges.back().end;
+      } else {
+        ranges.push_back (PositionRange(_positions[i], _positions[i] + 1));
+      }
+    }
+    break;
+  }
+}
+
+void FSelection::getCoveringRanges (std::vector<PositionRange> &ranges, int64_t maxGap) const {
+  std::vector<PositionRange> exact;
+  getRanges (exact);
+  for (size_t i = 0; i < exact.size(); ++i) {
+    if (!ranges.empty() && exact[i].begin - ranges.back().end <= maxGap) {
+      ranges.back().end = exact[i].end;
+    } else {
+      ranges.push_back (exact[i]);
+    }
+  }
+}
+
+void FSelection::getPositions (std::vector<int64_t> &positions) const {
+  switch (_representation) {
+  case SELECTION_RANGES:
+    for (size_t i = 0; i < _ranges.size(); ++i) {
+      for (int64_t pos = _ranges[i].begin; pos < _ranges[i].end; ++pos) positions.push_back (pos);
+    }
+    break;
+  case SELECTION_BITMAP:
+    {
+      CompressedPositionBitmap::Iterator it (_bitmap);
+      for (int64_t pos; it.next(pos);) positions.push_back (pos);
+    }
+    break;
+  case SELECTION_POSITIONS:
+    positions.insert (positions.end(), _positions.begin(), _positions.end());
+    break;
+  }
+}
+
+const CompressedPositionBitmap& FSelection::asBitmap () {
+  toBitmap ();
+  return _bitmap;
+}
+
+void FSelection::toBitmap () {
+  switch (_representation) {
+  case SELECTION_RANGES:
+    _bitmap.clear ();
+    _bitmap.addRanges (_ranges);
+    _ranges.clear ();
+    break;
+  case SELECTION_BITMAP:
+    return;
+  case SELECTION_POSITIONS:
+    _bitmap.clear ();
+    for (size_t i = 0; i < _positions.size(); ++i) _bitmap.add (_positions[i]);
+    _positions.clear ();
+    break;
+  }
+  _representation = SELECTION_BITMAP;
+}
+
+void FSelection::optimize () {
+  if (_representation == SELECTION_BITMAP && _bitmap.count() <= FDB_SELECTION_POSITIONS_MAX) {
+    _positions.clear ();
+    CompressedPositionBitmap::Iterator it (_bitmap);
+    for (int64_t pos; it.next(pos);) _positions.push_back (pos);
+    _bitmap.clear ();
+    _representation = SELECTION_POSITIONS;
+  } else if (_representation == SELECTION_POSITIONS && _positions.size() > FDB_SELECTION_POSITIONS_MAX) {
+    toBitmap ();
+  }
+}
+
+void FSelection::intersectWith (const FSelection &other) {
+  if (this == &other) return;
+  if (_representation == SELECTION_POSITIONS || other._representation == SELECTION_POSITIONS) {
+    // probe the other for each position. the result is never larger than the position list.
+    std::vector<int64_t> result;
+    if (_representation == SELECTION_POSITIONS) {
+      for (size_t i = 0; i < _positions.size(); ++i) {
+        if (other.contains(_positions[i])) result.push_back (_positions[i]);
+      }
+    } else {
+      for (size_t i = 0; i < other._positions.size(); ++i) {
+        if (contains(other._positions[i])) result.push_back (other._positions[i]);
+      }
+    }
+    _ranges.clear ();
+    _bitmap.clear ();
+    _positions.swap (result);
+    _representation = SELECTION_POSITIONS;
+  } else if (_representation == SELECTION_RANGES && other._representation == SELECTION_RANGES) {
+    std::vector<PositionRange> result;
+    intersectRanges (_ranges, other._ranges, result);
+    _ranges.swap (result);
+  } else {
+    toBitmap ();
+    if (other._representation == SELECTION_BITMAP) {
+      _bitmap.andWith (other._bitmap);
+    } else {
+      CompressedPositionBitmap otherBitmap;
+      otherBitmap.addRanges (other._ranges);
+      _bitmap.andWith (otherBitmap);
+    }
+  }
+  optimize ();
+}
+
+void FSelection::uniteWith (const FSelection &other) {
+  if (this == &other) return;
+  if (_representation == SELECTION_RANGES && other._representation == SELECTION_RANGES) {
+    _ranges.insert (_ranges.end(), other._ranges.begin(), other._ranges.end());
+    normalizeRanges (_ranges);
+  } else if (_representation == SELECTION_POSITIONS && other._representation == SELECTION_POSITIONS) {
+    std::vector<int64_t> result;
+    result.reserve (_positions.size() + other._positions.size());
+    std::set_union (_positions.begin(), _positions.end(), other._positions.begin(), other._positions.end(), std::back_inserter(result));
+    _positions.swap (result);
+  } else {
+    toBitmap ();
+    switch (other._representation) {
+    case SELECTION_RANGES:
+      _bitmap.addRanges (other._ranges);
+      break;
+    case SELECTION_BITMAP:
+      _bitmap.orWith (other._bitmap);
+      break;
+    case SELECTION_POSITIONS:
+      for (size_t i = 0; i < other._positions.size(); ++i) _bitmap.add (other._positions[i]);
+      break;
+    }
+  }
+  optimize ();
+}
+
+FSelection::Iterator::Iterator (const FSelection &selection)
+  : _selection(selection), _bitmapIterator(selection._bitmap), _index(0),
+  _nextPosition(selection._ranges.empty() ? 0 : selection._ranges[0].begin) {
+}
+
+bool FSelection::Iterator::next (int64_t &position) {
+  switch (_selection._representation) {
+  case SELECTION_RANGES:
+    while (_index < _selection._ranges.size()) {
+      if (_nextPosition < _selection._ranges[_index].end) {
+        position = _nextPosition++;
+        return true;
+      }
+      ++_index;
+      if (_index < _selection._ranges.size()) _nextPosition = _selection._ranges[_index].begin;
+    }
+    return false;
+  case SELECTION_BITMAP:
+    return _bitmapIterator.next(position);
+  case SELECTION_POSITIONS:
+    if (_index >= _selection._positions.size()) return false;
+    position = _selection._positions[_index++];
+    return true;
+  }
+  assert (false);
+  return false;
+}
+
+// ==========================================================================
+//  Predicate ordering
+// ==========================================================================
+ColumnPredicate::ColumnPredicate (FColumnReader *reader_, const SearchCond &cond_)
+  : reader(reader_), cond(cond_), selectivity(1.0) {
+}
+
+// ratio of positions in the sample range matching with the predicate.
+double estimateSelectivity (const ColumnPredicate &predicate, const PositionRange &sample) {
+  const FCStoreColumn &column = predicate.reader->getColumn();
+  const int64_t length = sample.end - sample.begin;
+  if (length <= 0) return 0;
+  boost::scoped_array<char> buffer (new char[length * column.maxLength]);
+  predicate.reader->getDecompressedData (sample, buffer.get(), length * column.maxLength);
+  int64_t matched = 0;
+  for (int64_t i = 0; i < length; ++i) {
+    const char *value = buffer.get() + i * column.maxLength;
+    if (column.type == COLUMN_CHAR) {
+      if (predicate.cond.matchString(value, column.maxLength)) ++matched;
+    } else {
+      if (predicate.cond.matchInts(value, column.maxLength)) ++matched;
+    }
+  }
+  return (double) matched / length;
+}
+
+struct PredicateSelectivityLess {
+  bool operator() (const ColumnPredicate &left, const ColumnPredicate &right) const {
+    if (left.selectivity != right.selectivity) return left.selectivity < right.selectivity;
+    bool leftRLE = left.reader->getColumn().compression == RLE_COMPRESSED;
+    bool rightRLE = right.reader->getColumn().compression == RLE_COMPRESSED;
+    return leftRLE && !rightRLE;
+  }
+};
+
+void FSelectionPlanner::orderBySelectivity (std::vector<ColumnPredicate> &predicates, const FSelection &selection) {
+  std::vector<PositionRange> ranges;
+  selection.getCoveringRanges (ranges, FDB_COLUMN_BLOCK_SIZE);
+  PositionRange sample;
+  if (!ranges.empty()) {
+    const PositionRange &middle = ranges[ranges.size() / 2];
+    const int64_t length = std::min<int64_t> (middle.end - middle.begin, FDB_COLUMN_BLOCK_SIZE);
+    sample.begin = middle.begin + (middle.end - middle.begin - length) / 2;
+    sample.end = sample.begin + length;
+  }
+  for (size_t i = 0; i < predicates.size(); ++i) {
+    predicates[i].selectivity = estimateSelectivity (predicates[i], sample);
+    VLOG(2) << "estimated selectivity of " << predicates[i].reader->getColumn().name << ": " << predicates[i].selectivity;
+  }
+  std::stable_sort (predicates.begin(), predicates.end(), PredicateSelectivityLess());
+}
+
+void FSelectionPlanner::applyPredicates (const std::vector<ColumnPredicate> &predicates, FSelection &selection) {
+  for (size_t i = 0; i < predicates.size() && !selection.empty(); ++i) {
+    predicates[i].reader->getPositionSelection (predicates[i].cond, selection, selection);
+  }
+}
+
+} // fdb
@@ -0,0 +1,109 @@
+#ifndef STORAGE_FCSELECTION_H
+#define STORAGE_FCSELECTION_H
+
+#include "../configvalues.h"
+#include "fcstore.h"
+#include "fcbitmap.h"
+#include "searchcond.h"
+#include <stdint.h>
+#include <vector>
+
+namespace fdb {
+
+// Selected positions (=tupleid) of a relation, as the result of predicates.
+// RLE columns find positions as ranges, uncompressed/dictionary columns as bitmaps,
+// so a selection is kept in one of three representations:
+//  RANGES: sorted, non-overlapping ranges. cheapest when selected positions are clustered.
+//  BITMAP: CompressedPositionBitmap. for scattered positions.
+//  POSITIONS: sorted position list. for a handful of positions (<= FDB_SELECTION_POSITIONS_MAX).
+// intersectWith()/uniteWith() choose the representation of the result from those
+// of the operands, so query code can combine predicates of any columns without
+// caring how each of them was evaluated:
+//   FSelection selection (yearRanges);
+//   categoryReader->getPositionSelection (cond1, selection, selection);
+//   brandReader->getPositionSelection (cond2, selection, selection);
+class FSelection {
+public:
+  enum Representation {
+    SELECTION_RANGES,
+    SELECTION_BITMAP,
+    SELECTION_POSITIONS
+  };
+
+  // empty selection
+  FSelection ();
+  explicit FSelection (const PositionRange &range);
+  // ranges don't have to be sorted. overlapping/adjacent ranges are merged.
+  explicit FSelection (const std::vector<PositionRange> &ranges);
+  explicit FSelection (const CompressedPositionBitmap &bitmap);
+  // positions don't have to be sorted. duplicates are removed.
+  explicit FSelection (const std::vector<int64_t> &positions);
+
+  Representation getRepresentation () const { return _representation; }
+  int64_t count () const;
+  bool empty () const;
+  bool contains (int64_t position) const;
+
+  // selected positions as exact ranges.
+  void getRanges (std::vector<PositionRange> &ranges) const;
+  // ranges covering all selected positions. ranges closer than maxGap are merged,
+  // so that a column reader can scan them without too many small ranges.
+  void getCoveringRanges (std::vector<PositionRange> &ranges, int64_t maxGap) const;
+  // selected positions in ascending order.
+  void getPositions (std::vector<int64_t> &positions) const;
+  // converts this selection to BITMAP representation (if not yet) and returns it.
+  const CompressedPositionBitmap& asBitmap ();
+
+  // this = this AND other.
+  void intersectWith (const FSelection &other);
+  // this = this OR other.
+  void uniteWith (const FSelection &other);
+
+  // iterates selected positions in ascending order.
+  class Iterator {
+  public:
+    Iterator (const FSelection &selection);
+    bool next (int64_t &position);
+  private:
+    const FSelection &_selection;
+    CompressedPositionBitmap::Iterator _bitmapIterator;
+    size_t _index; // index in _ranges or _positions
+    int64_t _nextPosition; // next position in _ranges[_index]
+  };
+
+private:
+  // switches between BITMAP and POSITIONS depending on the count.
+  void optimize ();
+  void toBitmap ();
+
+  Representation _representation;
+  std::vector<PositionRange> _ranges; // used if RANGES
+  CompressedPositionBitmap _bitmap; // used if BITMAP
+  std::vector<int64_t> _positions; // used if POSITIONS
+};
+
+// a predicate on a column, evaluated by FColumnReader::getPositionSelection().
+struct ColumnPredicate {
+  ColumnPredicate (FColumnReader *reader_, const SearchCond &cond_);
+  FColumnReader *reader;
+  SearchCond cond;
+  // estimated ratio of matching positions (0-1). set by FSelectionPlanner::orderBySelectivity().
+  double selectivity;
+};
+
+// decides the order of predicates on a relation so that later predicates (and later
+// columns read with FColumnReader::getDecompressedData(selection)) touch as few
+// positions as possible.
+class FSelectionPlanner {
+public:
+  // estimates the selectivity of each predicate by a sample of at most FDB_COLUMN_BLOCK_SIZE
+  // positions in the middle of selection, then sorts predicates by it (most selective first).
+  // on a tie, RLE columns come first as they are evaluated without decompression.
+  static void orderBySelectivity (std::vector<ColumnPredicate> &predicates, const FSelection &selection);
+
+  // narrows selection by each predicate in the given order. stops as soon as selection becomes empty.
+  static void applyPredicates (const std::vector<ColumnPredicate> &predicates, FSelection &selection);
+};
+
+} // fdb
+#endif // STORAGE_FCSELECTION_H
@@ -1,5 +1,7 @@
 #include "fcstore.h"
 #include "fcstoreimpl.h"
+#include "fcbitmap.h"
+#include "fcselection.h"
 #include "fbtree.h"
 #include "fbufferpool.h"
 #include "ffile.h"
@@ -8,9 +10,12 @@
 #include "../util/stopwatch.h"
 #include <stdint.h>
 #include <string.h>
+#include <algorithm>
 #include <cstdio>
 #include <sstream>
+#include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
 #include <glog/logging.h>
 
 using namespace std;
@@ -62,7 +67,7 @@ std::vector<FCStoreColumn> FCStoreUtil::getPhysicalDesignsOf(TableType table) {
     case  CUSTOMER_PK_SORT:
       ret.push_back (FCStoreColumn("custkey", COLUMN_INT32, calculateOffset(&(c.custkey), cp), UNCOMPRESSED));
       ret.push_back (FCStoreColumn("name", COLUMN_CHAR, sizeof(c.name), calculateOffset(&(c.name), cp), UNCOMPRESSED));
-      ret.push_back (FCStoreColumn("address", COLUMN_CHAR, sizeof(c.address), calculateOffset(&(c.address), cp), UNCOMPRESSED));
+      ret.push_back (FCStoreColumn("address", COLUMN_CHAR, sizeof(c.address), calculateOffset(&(c.address), cp), SYMBOL_COMPRESSED));
       ret.push_back (FCStoreColumn("city", COLUMN_CHAR, sizeof(c.city), calculateOffset(&(c.city), cp), DICTIONARY_COMPRESSED));
       ret.push_back (FCStoreColumn("nation", COLUMN_CHAR, sizeof(c.nation), calculateOffset(&(c.nation), cp), DICTIONARY_COMPRESSED));
       ret.push_back (FCStoreColumn("region", COLUMN_CHAR, sizeof(c.region), calculateOffset(&(c.region), cp), DICTIONARY_COMPRESSED));
@@ -73,7 +78,7 @@ std::vector<FCStoreColumn> FCStoreUtil::getPhysicalDesignsOf(TableType table) {
     case  SUPPLIER_PK_SORT:
       ret.push_back (FCStoreColumn("suppkey", COLUMN_INT32, calculateOffset(&(s.suppkey), sp), UNCOMPRESSED));
       ret.push_back (FCStoreColumn("name", COLUMN_CHAR, sizeof(s.name), calculateOffset(&(s.name), sp), UNCOMPRESSED));
-      ret.push_back (FCStoreColumn("address", COLUMN_CHAR, sizeof(s.address), calculateOffset(&(s.address), sp), UNCOMPRESSED));
+      ret.push_back (FCStoreColumn("address", COLUMN_CHAR, sizeof(s.address), calculateOffset(&(s.address), sp), SYMBOL_COMPRESSED));
       ret.push_back (FCStoreColumn("city", COLUMN_CHAR, sizeof(s.city), calculateOffset(&(s.city), sp), DICTIONARY_COMPRESSED));
       ret.push_back (FCStoreColumn("nation", COLUMN_CHAR, sizeof(s.nation), calculateOffset(&(s.nation), sp), DICTIONARY_COMPRESSED));
       ret.push_back (FCStoreColumn("region", COLUMN_CHAR, sizeof(s.region), calculateOffset(&(s.region), sp), DICTIONARY_COMPRESSED));
@@ -82,12 +87,12 @@ std::vector<FCStoreColumn> FCStoreUtil::getPhysicalDesignsOf(TableType table) {
       break;
     case  PART_PK_SORT:
       ret.push_back (FCStoreColumn("partkey", COLUMN_INT32, calculateOffset(&(p.partkey), pp), UNCOMPRESSED));
-      ret.push_back (FCStoreColumn("name", COLUMN_CHAR, sizeof(p.name), calculateOffset(&(p.name), pp), UNCOMPRESSED));
+      ret.push_back (FCStoreColumn("name", COLUMN_CHAR, sizeof(p.name), calculateOffset(&(p.name), pp), SYMBOL_COMPRESSED));
       ret.push_back (FCStoreColumn("mfgr", COLUMN_CHAR, sizeof(p.mfgr), calculateOffset(&(p.mfgr), pp), DICTIONARY_COMPRESSED));
       ret.push_back (FCStoreColumn("category", COLUMN_CHAR, sizeof(p.category), calculateOffset(&(p.category), pp), DICTIONARY_COMPRESSED));
       ret.push_back (FCStoreColumn("brand", COLUMN_CHAR, sizeof(p.brand), calculateOffset(&(p.brand), pp), DICTIONARY_COMPRESSED));
       ret.push_back (FCStoreColumn("color", COLUMN_CHAR, sizeof(p.color), calculateOffset(&(p.color), pp), DICTIONARY_COMPRESSED));
-      ret.push_back (FCStoreColumn("type", COLUMN_CHAR, sizeof(p.type), calculateOffset(&(p.type), pp), UNCOMPRESSED));
+      ret.push_back (FCStoreColumn("type", COLUMN_CHAR, sizeof(p.type), calculateOffset(&(p.type), pp), SYMBOL_COMPRESSED));
       ret.push_back (FCStoreColumn("size", COLUMN_INT8, calculateOffset(&(p.size), pp), UNCOMPRESSED));
       ret.push_back (FCStoreColumn("container", COLUMN_CHAR, sizeof(p.container), calculateOffset(&(p.container), pp), DICTIONARY_COMPRESSED));
       totalSize = sizeof(Part);
@@ -129,6 +134,8 @@ std::vector<FCStoreColumn> FCStoreUtil::getPhysicalDesignsOf(TableType table) {
       ret.push_back (FCStoreColumn("l_quantity", COLUMN_INT8, calculateOffset(&(m.l_quantity), mp), UNCOMPRESSED));
       ret.push_back (FCStoreColumn("l_extendedprice", COLUMN_INT32, calculateOffset(&(m.l_extendedprice), mp), UNCOMPRESSED));
       ret.push_back (FCStoreColumn("l_discount", COLUMN_INT8, calculateOffset(&(m.l_discount), mp), UNCOMPRESSED));
+      // Q1.x always reads these three together. stored in one column group (PAX) file.
+      for (size_t i = ret.size() - 3; i < ret.size(); ++i) ret[i].group = "l_pricing";
       ret.push_back (FCStoreColumn("l_revenue", COLUMN_INT32, calculateOffset(&(m.l_revenue), mp), UNCOMPRESSED));
       ret.push_back (FCStoreColumn("l_supplycost", COLUMN_INT32, calculateOffset(&(m.l_supplycost), mp), UNCOMPRESSED));
       ret.push_back (FCStoreColumn("p_mfgr", COLUMN_CHAR, sizeof(m.p_mfgr), calculateOffset(&(m.p_mfgr), mp), DICTIONARY_COMPRESSED));
@@ -145,6 +152,7 @@ std::vector<FCStoreColumn> FCStoreUtil::getPhysicalDesignsOf(TableType table) {
 #ifdef DEBUG
   assert (totalSize > 0);
   for (size_t i = 0; i < ret.size(); ++i) {
+    assert (ret[i].group.empty() || ret[i].compression == UNCOMPRESSED);
     if (i == 0) {
       assert (ret[i].offset == 0); // not 100% sure this is true in every environment...
     } else {
@@ -179,10 +187,58 @@ std::vector<SortOrder> FCStoreUtil::getSortOrdersOf(TableType table) {
   return orders;
 }
 
+std::vector<size_t> FCStoreUtil::getColumnGroupOf(const std::vector<FCStoreColumn> &columns, size_t columnIndex) {
+  assert (columnIndex < columns.size());
+  std::vector<size_t> members;
+  const std::string &group = columns[columnIndex].group;
+  if (group.empty()) {
+    members.push_back (columnIndex);
+    return members;
+  }
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (columns[i].group == group) {
+      if (columns[i].compression != UNCOMPRESSED) {
+        LOG(ERROR) << "only uncompressed columns can be in a column group. column=" << columns[i].name;
+        assert (false);
+        throw std::exception();
+      }
+      members.push_back (i);
+    }
+  }
+  return members;
+}
+
+void FCStoreUtil::getColumnGroupLayout(const std::vector<FCStoreColumn> &columns, size_t columnIndex, int &entriesPerPage, int &valueOffset) {
+  std::vector<size_t> members = getColumnGroupOf (columns, columnIndex);
+  int tupleSize = 0;
+  for (size_t i = 0; i < members.size(); ++i) {
+    tupleSize += columns[members[i]].maxLength;
+  }
+  entriesPerPage = (FDB_PAGE_SIZE - sizeof(FPageHeader)) / tupleSize;
+  valueOffset = sizeof(FPageHeader);
+  for (size_t i = 0; i < members.size() && members[i] != columnIndex; ++i) {
+    valueOffset += entriesPerPage * columns[members[i]].maxLength;
+  }
+}
+
+FCStoreColumn FCStoreUtil::toColumnGroupFileColumn(const std::vector<FCStoreColumn> &columns, size_t columnIndex) {
+  std::vector<size_t> members = getColumnGroupOf (columns, columnIndex);
+  const FCStoreColumn &leading = columns[members[0]];
+  int tupleSize = 0;
+  for (size_t i = 0; i < members.size(); ++i) {
+    tupleSize += columns[members[i]].maxLength;
+  }
+  FCStoreColumn ret (leading.getStorageName(), COLUMN_CHAR, tupleSize, leading.offset, UNCOMPRESSED);
+  ret.group = leading.group;
+  return ret;
+}
+
 // ==========================================================================
 //  Dump method for RowStore temporary table to CStore file
 // ==========================================================================
 void buildDictionaryFromBTree(FCStoreWriter &context, const FMainMemoryBTree &btree);
+void buildDictionary(FCStoreWriter &context, const char *values, int stride, int64_t tuples);
+void checkSelectionBufferSize (const FColumnReader *reader, const FSelection &selection, size_t bufferSize);
 
 /* this is concise, but has some overhead for _each value_. below are the specialized ones.
 void dumpCStoreCallback (void *context, const void *key, const void *data) {
@@ -212,66 +268,343 @@ void dumpCStoreCallbackLargeDictionary (void *context, const void *key, const vo
   const char *value = reinterpret_cast<const char*>(data) + (writer->column.offset);
   writer->addValueLargeDictionary<T>(value);
 }
+void dumpCStoreCallbackSymbol (void *context, const void *key, const void *data) {
+  FCStoreWriter *writer = reinterpret_cast<FCStoreWriter*> (context);
+  const char *value = reinterpret_cast<const char*>(data) + (writer->column.offset);
+  writer->addValueSymbol(value);
+}
+void dumpCStoreCallbackColumnGroup (void *context, const void *key, const void *data) {
+  FCStoreWriter *writer = reinterpret_cast<FCStoreWriter*> (context);
+  writer->addTupleColumnGroup(reinterpret_cast<const char*>(data));
+}
+
+// values of a column fed to FCStoreWriter, in the sorted order.
+// values are read from (in this priority) values, tuples or by traversing btree.
+struct DumpColumnSource {
+  DumpColumnSource () : btree(NULL), tuples(NULL), values(NULL) {}
+  // traversed for each column.
+  const FMainMemoryBTree *btree;
+  // pointers to tuples (shared by all columns), each value is at tuples[i] + column.offset.
+  const char * const *tuples;
+  // contiguous values of the column (FMainMemoryCStore).
+  const char *values;
+};
 
-void FCStoreUtil::dumpToNewCStoreFile (
-  std::vector<FFileSignature> &signatures, const FMainMemoryBTree &btree) {
-  std::vector<FCStoreColumn> columns = getPhysicalDesignsOf(btree.getTableType());
-  std::vector<SortOrder> orders = getSortOrdersOf(btree.getTableType());
-  assert (columns.size() == signatures.size());
-  LOG(INFO) << "dumping an on-memory btree to new CStore files...";
+// functors to add a value to FCStoreWriter. one for each compression scheme.
+struct AddValueUncompressed {
+  void operator() (FCStoreWriter &writer, const char *value) const { writer.addValueUncompressed(value); }
+};
+struct AddValueRLE {
+  void operator() (FCStoreWriter &writer, const char *value) const { writer.addValueRLE(value); }
+};
+struct AddValueSmallDictionary {
+  void operator() (FCStoreWriter &writer, const char *value) const { writer.addValueSmallDictionary(value); }
+};
+template <typename T>
+struct AddValueLargeDictionary {
+  void operator() (FCStoreWriter &writer, const char *value) const { writer.addValueLargeDictionary<T>(value); }
+};
+struct AddValueSymbol {
+  void operator() (FCStoreWriter &writer, const char *value) const { writer.addValueSymbol(value); }
+};
 
-  StopWatch watch;
-  watch.init();
+template <typename ADD_VALUE>
+void addAllValues (FCStoreWriter &context, const DumpColumnSource &source, ADD_VALUE addValue) {
+  const int64_t tuples = context.tupleCount;
+  if (source.values != NULL) {
+    const int length = context.column.maxLength;
+    const char *end = source.values + tuples * length;
+    for (const char *value = source.values; value < end; value += length) {
+      addValue (context, value);
+    }
+  } else {
+    assert (source.tuples != NULL);
+    const int offset = context.column.offset;
+    for (int64_t i = 0; i < tuples; ++i) {
+      addValue (context, source.tuples[i] + offset);
+    }
+  }
+}
 
-  assert (FDB_PAGE_SIZE % FDB_DIRECT_IO_ALIGNMENT == 0);
-  ScopedMemoryForIO bufferPtr(FDB_DISK_WRITE_BUFFER_PAGES * FDB_PAGE_SIZE, FDB_DIRECT_IO_ALIGNMENT, FDB_USE_DIRECT_IO);
-  void *buffer = bufferPtr.get();
+// dumps one column to a new file.
+void dumpColumnToNewCStoreFile (FFileSignature &signature, const FCStoreColumn &column, size_t columnIndex,
+  TableType tableType, int64_t tuples, const DumpColumnSource &source, char *buffer, int bufferPages) {
+  StopWatch watchColumn;
+  watchColumn.init();
 
-  const size_t count = signatures.size();
-  for (size_t i = 0; i < count; ++i) {
-    FFileSignature &signature = signatures[i];
-    const FCStoreColumn &column = columns[i];
+  assert (signature.fileId > 0);
+  assert (signature.filepathlen > 0);
+  std::string filepath (signature.getFilepath());
+  if (std::remove((filepath).c_str()) == 0) {
+    VLOG(1) << "deleted existing file " << (filepath) << ".";
+  }
+  VLOG(1) << "dumping an on-memory table to a new CStore file " << filepath << " (compression=" << toCompressionSchemeName(column.compression) << ")...";
 
-    StopWatch watchColumn;
-    watchColumn.init();
+  scoped_ptr<DirectFileOutputStream> fd(new DirectFileOutputStream(filepath, FDB_USE_DIRECT_IO));
+  FCStoreWriter context(signature.fileId, fd.get(), buffer, bufferPages, column, tuples);
 
-    assert (signature.fileId > 0);
-    assert (signature.filepathlen > 0);
-    std::string filepath (signature.getFilepath());
-    if (std::remove((filepath).c_str()) == 0) {
-      VLOG(1) << "deleted existing file " << (filepath) << ".";
+  if (column.compression == DICTIONARY_COMPRESSED) {
+    if (source.values != NULL) {
+      buildDictionary (context, source.values, column.maxLength, tuples);
+    } else {
+      // order doesn't matter for the dictionary. use the btree's buffer.
+      assert (source.btree != NULL);
+      buildDictionaryFromBTree (context, *source.btree);
     }
-    VLOG(1) << "dumping an on-memory btree to a new CStore file " << filepath << " (compression=" << toCompressionSchemeName(column.compression) << ")...";
-
-    scoped_ptr<DirectFileOutputStream> fd(new DirectFileOutputStream(filepath, FDB_USE_DIRECT_IO));
-    FCStoreWriter context(signature.fileId, fd.get(), (char*) buffer, FDB_DISK_WRITE_BUFFER_PAGES, column, btree.size());
-
-    if (column.compression == DICTIONARY_COMPRESSED) {
-      buildDictionaryFromBTree (context, btree);
+  } else if (column.compression == SYMBOL_COMPRESSED) {
+    if (source.values != NULL) {
+      context.symbolTable.build (source.values, column.maxLength, tuples, column.maxLength);
+    } else {
+      // the sample doesn't have to be sorted either. use the btree's buffer.
+      assert (source.btree != NULL);
+      const char *values = reinterpret_cast<const char *>(source.btree->getUnsortedBuffer());
+      context.symbolTable.build (values + column.offset, source.btree->getDataSize(), tuples, column.maxLength);
     }
+  }
 
+  if (source.tuples == NULL && source.values == NULL) {
+    // traverse the btree just for this column
+    assert (source.btree != NULL);
+    const FMainMemoryBTree &btree = *source.btree;
     if (column.compression == UNCOMPRESSED) {
       btree.traverse (dumpCStoreCallbackUncompressed, &context);
     } else if (column.compression == RLE_COMPRESSED) {
       btree.traverse (dumpCStoreCallbackRLE, &context);
+    } else if (column.compression == SYMBOL_COMPRESSED) {
+      btree.traverse (dumpCStoreCallbackSymbol, &context);
     } else {
       assert (column.compression == DICTIONARY_COMPRESSED);
-      if (context.dictionaryBits == 16) btree.traverse (dumpCStoreCallbackLargeDictionary<uint16_t>, &context);
+      if (context.dictionaryBits == 32) btree.traverse (dumpCStoreCallbackLargeDictionary<uint32_t>, &context);
+      else if (context.dictionaryBits == 16) btree.traverse (dumpCStoreCallbackLargeDictionary<uint16_t>, &context);
       else if (context.dictionaryBits == 8) btree.traverse (dumpCStoreCallbackLargeDictionary<uint8_t>, &context);
       else {
         assert (context.dictionaryBits < 8);
         btree.traverse (dumpCStoreCallbackSmallDictionary, &context);
       }
     }
+  } else {
+    if (column.compression == UNCOMPRESSED) {
+      addAllValues (context, source, AddValueUncompressed());
+    } else if (column.compression == RLE_COMPRESSED) {
+      addAllValues (context, source, AddValueRLE());
+    } else if (column.compression == SYMBOL_COMPRESSED) {
+      addAllValues (context, source, AddValueSymbol());
+    } else {
+      assert (column.compression == DICTIONARY_COMPRESSED);
+      if (context.dictionaryBits == 32) addAllValues (context, source, AddValueLargeDictionary<uint32_t>());
+      else if (context.dictionaryBits == 16) addAllValues (context, source, AddValueLargeDictionary<uint16_t>());
+      else if (context.dictionaryBits == 8) addAllValues (context, source, AddValueLargeDictionary<uint8_t>());
+      else {
+        assert (context.dictionaryBits < 8);
+        addAllValues (context, source, AddValueSmallDictionary());
+      }
+    }
+  }
+
+  // done. flush and close
+  context.finishWriting();
+  fd->sync();
+  fd->close();
+  context.updateFileSignature(signature, tableType, columnIndex);
+  watchColumn.stop();
+  VLOG(1) << "finished writing " << signature.pageCount << " pages in " << watchColumn.getElapsed() << " microsec.";
+}
+
+// dumps all columns of the column group of columns[columnIndex] to a new file.
+// columnIndex must be the leading column of the group. signatures of all members are set.
+void dumpColumnGroupToNewCStoreFile (std::vector<FFileSignature> &signatures, const std::vector<FCStoreColumn> &columns, size_t columnIndex,
+  TableType tableType, int64_t tuples, const std::vector<DumpColumnSource> &sources, char *buffer, int bufferPages) {
+  StopWatch watchColumn;
+  watchColumn.init();
+
+  std::vector<size_t> members = FCStoreUtil::getColumnGroupOf (columns, columnIndex);
+  assert (members[0] == columnIndex);
+  FFileSignature &signature = signatures[columnIndex];
+  assert (signature.fileId > 0);
+  assert (signature.filepathlen > 0);
+  std::string filepath (signature.getFilepath());
+  if (std::remove((filepath).c_str()) == 0) {
+    VLOG(1) << "deleted existing file " << (filepath) << ".";
+  }
+  VLOG(1) << "dumping an on-memory table to a new CStore column group file " << filepath << " (" << members.size() << " columns)...";
+
+  FCStoreColumn groupColumn = FCStoreUtil::toColumnGroupFileColumn (columns, columnIndex);
+  scoped_ptr<DirectFileOutputStream> fd(new DirectFileOutputStream(filepath, FDB_USE_DIRECT_IO));
+  FCStoreWriter context(signature.fileId, fd.get(), buffer, bufferPages, groupColumn, tuples);
+  context.setColumnGroup (columns, columnIndex);
+
+  const DumpColumnSource &source = sources[columnIndex];
+  if (source.values != NULL) {
+    // each member has its own array of values
+    std::vector<const char*> values (members.size());
+    for (size_t j = 0; j < members.size(); ++j) {
+      values[j] = sources[members[j]].values;
+    }
+    for (int64_t i = 0; i < tuples; ++i) {
+      context.addValuesColumnGroup (&(values[0]));
+      for (size_t j = 0; j < members.size(); ++j) {
+        values[j] += columns[members[j]].maxLength;
+      }
+    }
+  } else if (source.tuples != NULL) {
+    for (int64_t i = 0; i < tuples; ++i) {
+      context.addTupleColumnGroup (source.tuples[i]);
+    }
+  } else {
+    assert (source.btree != NULL);
+    source.btree->traverse (dumpCStoreCallbackColumnGroup, &context);
+  }
 
-    // done. flush and close
-    context.finishWriting();
-    fd->sync();
-    fd->close();
-    context.updateFileSignature(signature, btree.getTableType(), i);
-    watchColumn.stop();
-    VLOG(1) << "finished writing " << signature.pageCount << " pages in " << watchColumn.getElapsed() << " microsec.";
+  context.finishWriting();
+  fd->sync();
+  fd->close();
+  context.updateFileSignature(signature, tableType, columnIndex);
+  for (size_t j = 1; j < members.size(); ++j) {
+    // same file
+    assert (signatures[members[j]].fileId == signature.fileId);
+    signatures[members[j]] = signature;
   }
+  watchColumn.stop();
+  VLOG(1) << "finished writing " << signature.pageCount << " pages in " << watchColumn.getElapsed() << " microsec.";
+}
+
+// columns to dump, shared by the dumping threads.
+// each thread repeatedly takes the next column and dumps it with its own write buffer.
+struct ParallelColumnDump {
+  ParallelColumnDump (std::vector<FFileSignature> &signatures_, const std::vector<FCStoreColumn> &columns_,
+    TableType tableType_, int64_t tuples_, const std::vector<DumpColumnSource> &sources_, int bufferPages_)
+    : signatures(signatures_), columns(columns_), tableType(tableType_), tuples(tuples_), sources(sources_),
+    bufferPages(bufferPages_), nextColumn(0), failed(false) {}
+
+  std::vector<FFileSignature> &signatures;
+  const std::vector<FCStoreColumn> &columns;
+  TableType tableType;
+  int64_t tuples;
+  const std::vector<DumpColumnSource> &sources;
+  int bufferPages; // per thread
+  boost::mutex mutex; // protects nextColumn and failed
+  size_t nextColumn;
+  bool failed;
+
+  // returns false if no more column to dump.
+  bool takeNextColumn (size_t &columnIndex) {
+    boost::mutex::scoped_lock lock(mutex);
+    if (failed || nextColumn >= columns.size()) return false;
+    columnIndex = nextColumn++;
+    return true;
+  }
+  void setFailed () {
+    boost::mutex::scoped_lock lock(mutex);
+    failed = true;
+  }
+  void run () {
+    try {
+      ScopedMemoryForIO bufferPtr(bufferPages * FDB_PAGE_SIZE, FDB_DIRECT_IO_ALIGNMENT, FDB_USE_DIRECT_IO);
+      char *buffer = reinterpret_cast<char*>(bufferPtr.get());
+      size_t i;
+      while (takeNextColumn(i)) {
+        if (!columns[i].group.empty()) {
+          // the leading column writes the whole group. the others share its file.
+          if (FCStoreUtil::getColumnGroupOf(columns, i)[0] == i) {
+            dumpColumnGroupToNewCStoreFile (signatures, columns, i, tableType, tuples, sources, buffer, bufferPages);
+          }
+          continue;
+        }
+        dumpColumnToNewCStoreFile (signatures[i], columns[i], i, tableType, tuples, sources[i], buffer, bufferPages);
+      }
+    } catch (const std::exception &ex) {
+      LOG(ERROR) << "failed to dump a column: " << ex.what();
+      setFailed ();
+    }
+  }
+};
+struct ParallelColumnDumpWorker {
+  ParallelColumnDumpWorker (ParallelColumnDump *dump_) : dump(dump_) {}
+  void operator() () { dump->run(); }
+  ParallelColumnDump *dump;
+};
+
+void dumpColumnsInParallel (std::vector<FFileSignature> &signatures, const std::vector<FCStoreColumn> &columns,
+  TableType tableType, int64_t tuples, const std::vector<DumpColumnSource> &sources, const FCStoreDumpOptions &options) {
+  assert (columns.size() == signatures.size());
+  assert (columns.size() == sources.size());
+  assert (FDB_PAGE_SIZE % FDB_DIRECT_IO_ALIGNMENT == 0);
+  int threads = std::max (1, std::min (options.threads, (int) columns.size()));
+  // the total write buffer is bounded regardless of the number of threads
+  int bufferPages = std::max (1, options.writeBufferPages / threads);
+  VLOG(1) << "dumping " << columns.size() << " columns with " << threads << " threads, " << bufferPages << " write buffer pages each";
+
+  ParallelColumnDump dump (signatures, columns, tableType, tuples, sources, bufferPages);
+  if (threads == 1) {
+    dump.run();
+  } else {
+    boost::thread_group group;
+    for (int i = 0; i < threads; ++i) {
+      group.create_thread (ParallelColumnDumpWorker(&dump));
+    }
+    group.join_all();
+  }
+  if (dump.failed) {
+    LOG(ERROR) << "failed to dump columns";
+    throw std::exception();
+  }
+}
+
+void collectTupleCallback (void *context, const void *key, const void *data) {
+  std::vector<const char*> *tuples = reinterpret_cast<std::vector<const char*>*> (context);
+  tuples->push_back (reinterpret_cast<const char*>(data));
+}
+
+void FCStoreUtil::dumpToNewCStoreFile (
+  std::vector<FFileSignature> &signatures, const FMainMemoryBTree &btree, const FCStoreDumpOptions &options) {
+  std::vector<FCStoreColumn> columns = getPhysicalDesignsOf(btree.getTableType());
+  assert (columns.size() == signatures.size());
+  LOG(INFO) << "dumping an on-memory btree to new CStore files...";
+
+  StopWatch watch;
+  watch.init();
+
+  std::vector<const char*> tuples;
+  std::vector<DumpColumnSource> sources (columns.size());
+  if (options.sharedTraversal) {
+    // traverse only once. all columns read the tuples through the pointers.
+    tuples.reserve (btree.size());
+    btree.traverse (collectTupleCallback, &tuples);
+    assert ((int64_t) tuples.size() == btree.size());
+  }
+  for (size_t i = 0; i < columns.size(); ++i) {
+    sources[i].btree = &btree;
+    if (!tuples.empty()) {
+      sources[i].tuples = &(tuples[0]);
+    }
+  }
+  dumpColumnsInParallel (signatures, columns, btree.getTableType(), btree.size(), sources, options);
+
+  watch.stop();
+  LOG(INFO) << "completed all dumping. " << watch.getElapsed() << " micsosec";
+}
+
+void FCStoreUtil::dumpToNewCStoreFile (
+  std::vector<FFileSignature> &signatures, const FMainMemoryCStore &cstore, const FCStoreDumpOptions &options) {
+  const std::vector<FCStoreColumn> &columns = cstore.getColumns();
+  assert (columns.size() == signatures.size());
+  if (!cstore.isFinishedInserts()) {
+    LOG(ERROR) << "finishInserts() must be called before dumping an on-memory CStore.";
+    assert (false);
+    throw std::exception();
+  }
+  LOG(INFO) << "dumping an on-memory CStore to new CStore files...";
+
+  StopWatch watch;
+  watch.init();
+
+  // values are already sorted and contiguous. no callback per tuple.
+  std::vector<DumpColumnSource> sources (columns.size());
+  for (size_t i = 0; i < columns.size(); ++i) {
+    sources[i].values = reinterpret_cast<const char*>(cstore.getBuffer(i));
+  }
+  dumpColumnsInParallel (signatures, columns, cstore.getTableType(), cstore.size(), sources, options);
+
   watch.stop();
   LOG(INFO) << "completed all dumping. " << watch.getElapsed() << " micsosec";
 }
@@ -305,7 +638,13 @@ FCStoreWriter::FCStoreWriter(int fileId_, DirectFileOutputStream *fd_, char *buf
   case DICTIONARY_COMPRESSED:
     leafEntrySize = 0; // determined later
     entryPerLeafPage = 0; // determined later
-    dictionaryHashmap = new StringHashMap<uint16_t>(column.maxLength, 16);
+    // dictionaryHashmap is created with the dictionary (buildDictionary())
+    break;
+  case SYMBOL_COMPRESSED:
+    assert (column.type == COLUMN_CHAR);
+    leafEntrySize = 0; // variable
+    entryPerLeafPage = 0; // variable
+    symbolEncodeBuffer.resize (FSymbolTable::getMaxEncodedLength(column.maxLength));
     break;
   default:
       // unsupported type
@@ -324,7 +663,10 @@ FCStoreWriter::FCStoreWriter(int fileId_, DirectFileOutputStream *fd_, char *buf
   rootPageStart = 0;
   rootPageCount = 0;
   rootPageLevel = 0;
+  maxRootPages = FDB_MAX_ROOT_PAGES;
+  entriesPerIndexPage = (FDB_PAGE_SIZE - sizeof (FPageHeader)) / (sizeof(int64_t) + sizeof (int));
   leafPageCount = 0;
+  symbolEncodedBytes = 0;
 }
 FCStoreWriter::~FCStoreWriter() {
   if (dictionaryHashmap != NULL) delete dictionaryHashmap;
@@ -337,14 +679,12 @@ void FCStoreWriter::addValue (const char* value) {
     addValueUncompressed(value);
   } else if (column.compression == RLE_COMPRESSED) {
     addValueRLE(value);
+  } else if (column.compression == SYMBOL_COMPRESSED) {
+    addValueSymbol(value);
   } else {
     assert (column.compression == DICTIONARY_COMPRESSED);
-    if (dictionaryBits == 16) addValueLargeDictionary<uint16_t>(value);
-    else if (dictionaryBits == 8) addValueLargeDictionary<uint8_t>(value);
-    else {
-      assert (dictionaryBits < 8);
-      addValueSmallDictionary(value);
-    }
+    assert (dictionaryHashmap != NULL);
+    addDictionaryCode (dictionaryHashmap->find(value));
   }
 }
 void FCStoreWriter::finishWriting () {
@@ -352,6 +692,8 @@ void FCStoreWriter::finishWriting () {
     finishWritingUncompressed();
   } else if (column.compression == RLE_COMPRESSED) {
     finishWritingRLE();
+  } else if (column.compression == SYMBOL_COMPRESSED) {
+    finishWritingSymbol();
   } else {
     finishWritingDictionary();
   }
@@ -532,6 +874,49 @@ void FCStoreWriter::finishWritingUncompressed () {
   leafPageCount = currentPageId;
 }
 
+// ========================================
+//  Column Group (PAX)
+// ========================================
+void FCStoreWriter::setColumnGroup (const std::vector<FCStoreColumn> &columns, size_t columnIndex) {
+  assert (column.compression == UNCOMPRESSED);
+  std::vector<size_t> members = FCStoreUtil::getColumnGroupOf (columns, columnIndex);
+  groupMembers.clear();
+  groupValueOffsets.clear();
+  for (size_t i = 0; i < members.size(); ++i) {
+    int entriesPerPage, valueOffset;
+    FCStoreUtil::getColumnGroupLayout (columns, members[i], entriesPerPage, valueOffset);
+    assert (entriesPerPage == entryPerLeafPage);
+    groupMembers.push_back (columns[members[i]]);
+    groupValueOffsets.push_back (valueOffset);
+  }
+}
+void FCStoreWriter::addTupleColumnGroup (const char* tuple) {
+  assert (currentTuple < tupleCount);
+  assert (!groupMembers.empty());
+  prepareForNewPageUniform();
+  char *page = buffer + (FDB_PAGE_SIZE * bufferedPages);
+  for (size_t i = 0; i < groupMembers.size(); ++i) {
+    const int length = groupMembers[i].maxLength;
+    ::memcpy (page + groupValueOffsets[i] + entryInCurrentPage * length, tuple + groupMembers[i].offset, length);
+  }
+  currentPageOffset += leafEntrySize;
+  ++entryInCurrentPage;
+  ++currentTuple;
+}
+void FCStoreWriter::addValuesColumnGroup (const char* const* values) {
+  assert (currentTuple < tupleCount);
+  assert (!groupMembers.empty());
+  prepareForNewPageUniform();
+  char *page = buffer + (FDB_PAGE_SIZE * bufferedPages);
+  for (size_t i = 0; i < groupMembers.size(); ++i) {
+    const int length = groupMembers[i].maxLength;
+    ::memcpy (page + groupValueOffsets[i] + entryInCurrentPage * length, values[i], length);
+  }
+  currentPageOffset += leafEntrySize;
+  ++entryInCurrentPage;
+  ++currentTuple;
+}
+
 // ========================================
 //  RLE Compressed Column
 // ========================================
@@ -590,34 +975,64 @@ void FCStoreWriter::finishWritingRLE () {
 
   VLOG(1) << "in total " << runTotal << " runs";
 
-  // then, write root pages for position search
+  writePositionIndex();
+}
+
+void FCStoreWriter::writePositionIndex () {
+  assert ((int) pageBeginningPositions.size() == leafPageCount);
+  // write index pages for position search. like non-leaf pages of BTree,
+  // each level has <beginningPos, pageId> of every page in the level below, and
+  // levels are added until a level fits in maxRootPages pages (root pages).
+  // entries are sorted by beginningPos, so the reader binary-searches each level.
   size_t rootEntrySize = sizeof(int64_t) + sizeof (int);
-  int entriesInRootPage = (FDB_PAGE_SIZE - sizeof (FPageHeader)) / rootEntrySize;
-  rootPageStart = currentPageId;
-  rootPageCount = (leafPageCount / entriesInRootPage) + (leafPageCount % entriesInRootPage == 0 ? 0 : 1);
-  rootPageLevel = 1;
-  for (int i = 0; i < rootPageCount; ++i) {
-    bool lastSibling;
-    int countInThisPage;
-    if (i == rootPageCount - 1) {
-      countInThisPage = leafPageCount - i * entriesInRootPage;
-      assert (countInThisPage <= entriesInRootPage);
-      assert (countInThisPage > 0);
-      lastSibling = true;
-    } else {
-      countInThisPage = entriesInRootPage;
-      lastSibling = false;
+  const int entriesInRootPage = entriesPerIndexPage;
+  assert (entriesInRootPage >= 2); // otherwise levels never shrink
+  assert (entriesInRootPage <= (int) ((FDB_PAGE_SIZE - sizeof (FPageHeader)) / rootEntrySize));
+  assert (maxRootPages >= 1);
+  std::vector<int64_t> childBeginningPositions (pageBeginningPositions);
+  std::vector<int> childPageIds;
+  for (int pageId = 0; pageId < leafPageCount; ++pageId) {
+    childPageIds.push_back (pageId);
+  }
+  rootPageLevel = 0;
+  bool root = false;
+  while (!root) {
+    ++rootPageLevel;
+    const int childCount = childPageIds.size();
+    const int pageCount = (childCount / entriesInRootPage) + (childCount % entriesInRootPage == 0 ? 0 : 1);
+    root = (pageCount <= maxRootPages);
+    if (root) {
+      rootPageStart = currentPageId;
+      rootPageCount = pageCount;
     }
-    writePageHeader(countInThisPage, lastSibling, pageBeginningPositions[i * entriesInRootPage], 1, true, rootEntrySize);
-    for (int j = 0; j < countInThisPage; ++j) {
-      int pageId = i * entriesInRootPage + j;
-      int64_t beginningPos = pageBeginningPositions[pageId];
-      writeRootEntryRLE(beginningPos, pageId);
+    std::vector<int64_t> levelBeginningPositions;
+    std::vector<int> levelPageIds;
+    for (int i = 0; i < pageCount; ++i) {
+      bool lastSibling;
+      int countInThisPage;
+      if (i == pageCount - 1) {
+        countInThisPage = childCount - i * entriesInRootPage;
+        assert (countInThisPage <= entriesInRootPage);
+        assert (countInThisPage > 0);
+        lastSibling = true;
+      } else {
+        countInThisPage = entriesInRootPage;
+        lastSibling = false;
+      }
+      const int firstChild = i * entriesInRootPage;
+      levelBeginningPositions.push_back (childBeginningPositions[firstChild]);
+      levelPageIds.push_back (currentPageId);
+      writePageHeader(countInThisPage, lastSibling, childBeginningPositions[firstChild], rootPageLevel, root, rootEntrySize);
+      for (int j = 0; j < countInThisPage; ++j) {
+        writeRootEntryRLE(childBeginningPositions[firstChild + j], childPageIds[firstChild + j]);
+      }
+      flipPage();
+      flushBufferIfNeeded();
     }
-    flipPage();
-    flushBufferIfNeeded();
+    childBeginningPositions.swap (levelBeginningPositions);
+    childPageIds.swap (levelPageIds);
   }
-  VLOG(1) << "RLE " << rootPageCount << " root pages";
+  VLOG(1) << "position index. " << rootPageCount << " root pages. " << rootPageLevel << " levels";
   flipPage();
   flushBuffer();
 }
@@ -634,18 +1049,28 @@ void FCStoreWriter::flushCurrentPackedByte() {
   ++currentPageOffset;
 }
 
-void FCStoreWriter::addValueSmallDictionary (const char* value) {
+void FCStoreWriter::addDictionaryCode (uint32_t code) {
+  assert (column.compression == DICTIONARY_COMPRESSED);
+  if (dictionaryBits == 32) addCodeLargeDictionary<uint32_t>(code);
+  else if (dictionaryBits == 16) addCodeLargeDictionary<uint16_t>(code);
+  else if (dictionaryBits == 8) addCodeLargeDictionary<uint8_t>(code);
+  else {
+    assert (dictionaryBits < 8);
+    addCodeSmallDictionary(code);
+  }
+}
+
+void FCStoreWriter::addCodeSmallDictionary (uint32_t code) {
   assert (dictionaryBits <= 4);
   assert (currentTuple < tupleCount);
+  assert (code < (uint32_t) dictionarySize);
 
   if (currentBitOffset == 0) {
     prepareForNewPageUniform();
   }
 
-  uint8_t foundIndex = dictionaryHashmap->find(value);
-
   // <=4bits have to pack to a byte.
-  currentPackedByte |= (foundIndex << currentBitOffset);
+  currentPackedByte |= ((uint8_t) code << currentBitOffset);
   ++entryInCurrentPage;
   currentBitOffset += dictionaryBits;
   if (currentBitOffset == 8) {
@@ -668,38 +1093,69 @@ void FCStoreWriter::finishWritingDictionary () {
 }
 
 
+template <typename INT_TYPE>
+int compareInts (const char *left, const void *right) {
+  INT_TYPE l = *reinterpret_cast<const INT_TYPE*> (left);
+  INT_TYPE r = *reinterpret_cast<const INT_TYPE*> (right);
+  return l < r ? -1 : (l > r ? 1 : 0);
+}
+
+int compareColumnValues (const FCStoreColumn &column, const char *left, const void *right) {
+  switch (column.type) {
+  case COLUMN_INT8: return compareInts<int8_t> (left, right);
+  case COLUMN_INT16: return compareInts<int16_t> (left, right);
+  case COLUMN_INT32: return compareInts<int32_t> (left, right);
+  case COLUMN_INT64: return compareInts<int64_t> (left, right);
+  case COLUMN_CHAR: return ::memcmp (left, right, column.maxLength);
+  default:
+    assert (false);
+    throw std::exception();
+  }
+}
+
+int getDictionaryHashBits (int64_t entryCount) {
+  // about one entry per bucket. StringHashMap allows at most 20 bits.
+  int bits = 8;
+  while (bits < 20 && ((int64_t) 1 << bits) < entryCount) ++bits;
+  return bits;
+}
+
 struct CompFunctor {
-  CompFunctor (int columnLength) : _columnLength (columnLength) {}
+  CompFunctor (const FCStoreColumn &column) : _column (column) {}
   bool operator() (const char *k1, const char *k2) {
-    return ::memcmp (k1, k2, _columnLength) < 0;
+    return compareColumnValues (_column, k1, k2) < 0;
   }
-  int _columnLength;
+  const FCStoreColumn &_column;
 };
 
 void buildDictionaryFromBTree(FCStoreWriter &context, const FMainMemoryBTree &btree) {
+  // this is to just bulid dictionaries. order doesn't matter.
+  // so, unsorted buffer is enough
+  const char *value = reinterpret_cast<const char *>(btree.getUnsortedBuffer());
+  buildDictionary (context, value + context.column.offset, btree.getDataSize(), btree.size());
+}
+
+// builds the dictionary of the values at values, values + stride, values + 2 * stride, ...
+void buildDictionary(FCStoreWriter &context, const char *values, int stride, int64_t tuples) {
 #ifndef NDEBUG
   StopWatch watch;
   watch.init();
 #endif // NDEBUG
 
-  // at most 2^16 entries. so far.
-  StringHashSet hashset (context.column.maxLength, 16);
+  // the number of distinct values is unknown yet. at most the number of tuples.
+  StringHashSet hashset (context.column.maxLength, getDictionaryHashBits(std::min<int64_t>(tuples, FDB_DICTIONARY_MAX_ENTRIES)));
   assert (context.dictionarySize == 0);
+  assert (context.dictionaryHashmap == NULL);
 
-  // this is to just bulid dictionaries. order doesn't matter.
-  // so, unsorted buffer is enough
-  const char *value = reinterpret_cast<const char *>(btree.getUnsortedBuffer());
-  value += context.column.offset;
-  const int columnLength = context.column.maxLength;
-  const int dataSize = btree.getDataSize();
-  const int64_t tuples = btree.size();
+  const char *value = values;
 
-  for (int64_t i = 0; i < tuples; ++i, value += dataSize) {
+  for (int64_t i = 0; i < tuples; ++i, value += stride) {
     if (hashset.find(value) == NULL) {
       // new value!
-      if (context.dictionarySize >= (1 << 16)) {
-        LOG (ERROR) << "more than 2^16 distinct values. too many for dictionary encoding.";
+      if (context.dictionarySize >= FDB_DICTIONARY_MAX_ENTRIES) {
+        LOG (ERROR) << "more than " << FDB_DICTIONARY_MAX_ENTRIES << " distinct values. too many for dictionary encoding. column=" << context.column.name;
         assert (false);
+        throw std::exception();
       }
       // note that the data resides until we erase the on-memory table.
       // we don't have to copy the data.
@@ -712,7 +1168,8 @@ void buildDictionaryFromBTree(FCStoreWriter &context, const FMainMemoryBTree &bt
 
   // to assure that dictionary is equivalent in comparison (<,>)
   // sort the entries and assign IDs.
-  std::sort (context.dictionaryEntries.begin(), context.dictionaryEntries.end(), CompFunctor(columnLength));
+  std::sort (context.dictionaryEntries.begin(), context.dictionaryEntries.end(), CompFunctor(context.column));
+  context.dictionaryHashmap = new StringHashMap<uint32_t>(context.column.maxLength, getDictionaryHashBits(context.dictionarySize));
   for (int i = 0; i < context.dictionarySize; ++i) {
     context.dictionaryHashmap->insert(context.dictionaryEntries[i], i);
   }
@@ -740,47 +1197,358 @@ void FCStoreWriter::determineDictionaryBits() {
     dictionaryBits = 8;
     leafEntrySize = 1;
     entryPerLeafPage = (FDB_PAGE_SIZE - sizeof (FPageHeader));
-  } else {
-    assert (dictionarySize <= (1 << 16));
+  } else if (dictionarySize <= (1 << 16)) {
     dictionaryBits = 16;
     leafEntrySize = 2;
     entryPerLeafPage = (FDB_PAGE_SIZE - sizeof (FPageHeader)) / 2;
+  } else {
+    assert (dictionarySize <= FDB_DICTIONARY_MAX_ENTRIES);
+    dictionaryBits = 32;
+    leafEntrySize = 4;
+    entryPerLeafPage = (FDB_PAGE_SIZE - sizeof (FPageHeader)) / 4;
+  }
+}
+
+// ========================================
+//  Symbol Compressed Column
+// ========================================
+void FCStoreWriter::addValueSymbol (const char* value) {
+  assert (currentTuple < tupleCount);
+  const int encodedLength = symbolTable.encode (value, column.maxLength, &(symbolEncodeBuffer[0]));
+  // the value and its end offset (placed at the end of the page) have to fit in the page
+  if (currentPageOffset > 0 && currentPageOffset + encodedLength + (int) sizeof(uint16_t) * (entryInCurrentPage + 1) > FDB_PAGE_SIZE) {
+    flipPage();
+  }
+  if (currentPageOffset == 0) {
+    VLOG(2) << "new page!";
+    flushBufferIfNeeded();
+    // count is updated for each value. lastSibling is set in finishWritingSymbol()
+    writeLeafPageHeader(0, false, currentTuple);
+    pageBeginningPositions.push_back (currentTuple);
+    assert ((int) pageBeginningPositions.size() == currentPageId + 1);
   }
+  char *page = buffer + (FDB_PAGE_SIZE * bufferedPages);
+  ::memcpy (page + currentPageOffset, &(symbolEncodeBuffer[0]), encodedLength);
+  currentPageOffset += encodedLength;
+  ++entryInCurrentPage;
+  assert (currentPageOffset < (1 << 16));
+  reinterpret_cast<uint16_t*>(page + FDB_PAGE_SIZE)[-entryInCurrentPage] = (uint16_t) currentPageOffset;
+  reinterpret_cast<FPageHeader*>(page)->count = entryInCurrentPage;
+  symbolEncodedBytes += encodedLength;
+  ++currentTuple;
+}
+void FCStoreWriter::finishWritingSymbol () {
+  if (currentPageOffset == 0) {
+    // no value at all. an empty leaf page
+    assert (tupleCount == 0);
+    flushBufferIfNeeded();
+    writeLeafPageHeader(0, true, 0);
+    pageBeginningPositions.push_back (0);
+  }
+  reinterpret_cast<FPageHeader*>(buffer + (FDB_PAGE_SIZE * bufferedPages))->lastSibling = true;
+  flipPage();
+  flushBuffer();
+  leafPageCount = currentPageId;
+  VLOG(1) << "symbol compressed " << tupleCount << " values into " << symbolEncodedBytes << " bytes (" << (tupleCount * column.maxLength) << " bytes uncompressed)";
+
+  // then, the symbol table page right after leaf pages
+  const int symbolCount = symbolTable.getSymbolCount();
+  assert (symbolCount * FSymbolTable::SERIALIZED_ENTRY_SIZE <= FDB_PAGE_SIZE - (int) sizeof(FPageHeader));
+  writePageHeader(symbolCount, true, 0, 0, false, FSymbolTable::SERIALIZED_ENTRY_SIZE);
+  symbolTable.serialize (buffer + (FDB_PAGE_SIZE * bufferedPages) + currentPageOffset);
+  currentPageOffset += symbolCount * FSymbolTable::SERIALIZED_ENTRY_SIZE;
+  dictionarySize = symbolCount;
+  flipPage();
+  flushBufferIfNeeded();
+
+  writePositionIndex();
 }
 
 // ==========================================================================
 //  CStore temporary table implementation
 // ==========================================================================
-// TODO not implemented so far
-FMainMemoryCStoreImpl::FMainMemoryCStoreImpl (TableType type, int maxTuples)
-  : _type (type), _maxTuples(maxTuples) {
+FMainMemoryCStore::FMainMemoryCStore (TableType type, int64_t maxSize) : _impl (new FMainMemoryCStoreImpl(type, maxSize)) {
+}
+FMainMemoryCStore::~FMainMemoryCStore () {
+  delete _impl;
+}
+bool FMainMemoryCStore::insert (const void *key, const void *data) {
+  return _impl->insert(key, data);
+}
+void FMainMemoryCStore::finishInserts () {
+  _impl->finishInserts();
+}
+bool FMainMemoryCStore::isFinishedInserts () const {
+  return _impl->_finishedInserts;
+}
+int64_t FMainMemoryCStore::size () const {
+  return _impl->_tuples;
+}
+int64_t FMainMemoryCStore::getMaxSize () const {
+  return _impl->_maxTuples;
+}
+int FMainMemoryCStore::getKeySize() const {
+  return _impl->_keySize;
+}
+int FMainMemoryCStore::getDataSize() const {
+  return _impl->_dataSize;
+}
+TableType FMainMemoryCStore::getTableType() const {
+  return _impl->_type;
+}
+const std::vector<FCStoreColumn>& FMainMemoryCStore::getColumns () const {
+  return _impl->_columns;
+}
+const void* FMainMemoryCStore::getBuffer(size_t column) const {
+  return _impl->getBuffer(column);
+}
+FColumnReader* FMainMemoryCStore::getColumnReader(const std::string &colname) {
+  return _impl->getColumnReader(colname);
+}
+FColumnReader* FMainMemoryCStore::getColumnReader(size_t colIndex) {
+  return _impl->getColumnReader(colIndex);
+}
+
+FMainMemoryCStoreImpl::FMainMemoryCStoreImpl (TableType type, int64_t maxTuples)
+  : _type (type), _maxTuples(maxTuples), _tuples(0), _finishedInserts(false) {
+  assert (_maxTuples > 0);
+  _keySize = toKeySize(type);
+  _dataSize = toDataSize(type);
+  _compfunc = toKeyCompareFunc(toKeyCompareFuncType(type));
+  _columns = FCStoreUtil::getPhysicalDesignsOf(type);
+  _keys = new char[_keySize * _maxTuples];
+  for (size_t i = 0; i < _columns.size(); ++i) {
+    _columnArrays.push_back (new char[_columns[i].maxLength * _maxTuples]);
+    _columnReaders.push_back (boost::shared_ptr<FColumnReader>(new FColumnReaderImplMainMemory(this, i)));
+  }
 }
 FMainMemoryCStoreImpl::~FMainMemoryCStoreImpl() {
+  delete[] _keys;
+  for (size_t i = 0; i < _columnArrays.size(); ++i) {
+    delete[] _columnArrays[i];
+  }
+}
+
+bool FMainMemoryCStoreImpl::insert (const void *key, const void *data) {
+  assert (!_finishedInserts);
+  if (_tuples >= _maxTuples) {
+    LOG(ERROR) << "the on-memory CStore is full. maxTuples=" << _maxTuples;
+    throw std::exception();
+  }
+  ::memcpy (_keys + _tuples * _keySize, key, _keySize);
+  const char *tuple = reinterpret_cast<const char*>(data);
+  for (size_t i = 0; i < _columns.size(); ++i) {
+    const FCStoreColumn &column = _columns[i];
+    ::memcpy (_columnArrays[i] + _tuples * column.maxLength, tuple + column.offset, column.maxLength);
+  }
+  ++_tuples;
+  return true;
 }
 
+struct MainMemoryCStoreKeyCompare {
+  MainMemoryCStoreKeyCompare (const char *keys, int keySize, KeyCompareFunc compfunc)
+    : _keys (keys), _keySize (keySize), _compfunc (compfunc) {}
+  bool operator() (int64_t i, int64_t j) const {
+    return _compfunc(_keys + i * _keySize, _keys + j * _keySize) < 0;
+  }
+  const char *_keys;
+  int _keySize;
+  KeyCompareFunc _compfunc;
+};
+
+void FMainMemoryCStoreImpl::finishInserts () {
+  assert (!_finishedInserts);
+#ifndef NDEBUG
+  StopWatch watch;
+  watch.init();
+#endif // NDEBUG
+  // sort only the keys (as a permutation), then gather each column by the permutation.
+  std::vector<int64_t> permutation (_tuples);
+  for (int64_t i = 0; i < _tuples; ++i) {
+    permutation[i] = i;
+  }
+  std::stable_sort (permutation.begin(), permutation.end(), MainMemoryCStoreKeyCompare(_keys, _keySize, _compfunc));
+  // keys are not needed any more.
+  delete[] _keys;
+  _keys = NULL;
+
+  for (size_t i = 0; i < _columns.size(); ++i) {
+    const int length = _columns[i].maxLength;
+    char *sorted = new char[length * _maxTuples];
+    const char *original = _columnArrays[i];
+    for (int64_t j = 0; j < _tuples; ++j) {
+      ::memcpy (sorted + j * length, original + permutation[j] * length, length);
+    }
+    delete[] _columnArrays[i];
+    _columnArrays[i] = sorted;
+  }
+  _finishedInserts = true;
+#ifndef NDEBUG
+  watch.stop();
+  VLOG(1) << "sorted on-memory CStore. " << _tuples << " tuples. " << watch.getElapsed() << " microsec";
+#endif // NDEBUG
+}
+
+const void* FMainMemoryCStoreImpl::getBuffer(size_t column) const {
+  assert (column < _columnArrays.size());
+  return _columnArrays[column];
+}
+
+FColumnReader* FMainMemoryCStoreImpl::getColumnReader(const std::string &colname) {
+  assert (_columnReaders.size() == _columns.size());
+  for (size_t i = 0; i < _columnReaders.size(); ++i) {
+    if (_columns[i].name == colname) {
+      return _columnReaders[i].get();
+    }
+  }
+  LOG(ERROR) << "column " << colname << " not found";
+  assert (false);
+  throw std::exception();
+}
+FColumnReader* FMainMemoryCStoreImpl::getColumnReader(size_t colIndex) {
+  assert (colIndex < _columnReaders.size());
+  return _columnReaders[colIndex].get();
+}
+
+FColumnReaderImplMainMemory::FColumnReaderImplMainMemory(const FMainMemoryCStoreImpl *cstore, size_t columnIndex)
+  : _cstore(cstore), _columnIndex(columnIndex), _searchRangeSet(false) {
+  _column = cstore->_columns[columnIndex];
+  _column.compression = UNCOMPRESSED;
+}
+std::string FColumnReaderImplMainMemory::normalize(const std::string &str) const {
+  assert (str.size() <= (size_t) _column.maxLength);
+  std::string ret (_column.maxLength, '\0');
+  ret.replace (0, str.size(), str);
+  return ret;
+}
+
+std::vector<PositionRange> FColumnReaderImplMainMemory::getScanRanges () const {
+  std::vector<PositionRange> ranges;
+  const int64_t tuples = _cstore->_tuples;
+  if (!_searchRangeSet) {
+    ranges.push_back (PositionRange(0, tuples));
+    return ranges;
+  }
+  for (size_t i = 0; i < _searchRanges.size(); ++i) {
+    PositionRange range = _searchRanges[i];
+    if (range.end > tuples) range.end = tuples;
+    if (range.begin > range.end) range.begin = range.end;
+    ranges.push_back (range);
+  }
+  return ranges;
+}
+
+void FColumnReaderImplMainMemory::getPositionRanges (const SearchCond &cond, std::vector<PositionRange> &positions) {
+  const char *values = _cstore->_columnArrays[_columnIndex];
+  const int length = _column.maxLength;
+  std::vector<PositionRange> ranges = getScanRanges();
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const PositionRange &range = ranges[i];
+    int64_t runBegin = -1;
+    for (int64_t pos = range.begin; pos < range.end; ++pos) {
+      if (match(cond, values + pos * length)) {
+        if (runBegin < 0) runBegin = pos;
+      } else if (runBegin >= 0) {
+        positions.push_back (PositionRange(runBegin, pos));
+        runBegin = -1;
+      }
+    }
+    if (runBegin >= 0) {
+      positions.push_back (PositionRange(runBegin, range.end));
+    }
+  }
+}
+
+void FColumnReaderImplMainMemory::getPositionBitmaps (const SearchCond &cond, std::vector<boost::shared_ptr<PositionBitmap> > &positions) {
+  const char *values = _cstore->_columnArrays[_columnIndex];
+  const int length = _column.maxLength;
+  std::vector<PositionRange> ranges = getScanRanges();
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const PositionRange &range = ranges[i];
+    boost::shared_ptr<PositionBitmap> bitmapPtr = PositionBitmap::newBitmap(range.begin, range.end - range.begin);
+    positions.push_back (bitmapPtr);
+    PositionBitmap *bitmap = bitmapPtr.get();
+    for (int64_t pos = range.begin; pos < range.end; ++pos) {
+      if (match(cond, values + pos * length)) {
+        bitmap->setBit(pos - range.begin);
+        ++(bitmap->matchedCount);
+      }
+    }
+  }
+}
+
+void FColumnReaderImplMainMemory::getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize) {
+  checkSelectionBufferSize (this, selection, bufferSize);
+  const char *values = _cstore->_columnArrays[_columnIndex];
+  const int length = _column.maxLength;
+  char *out = reinterpret_cast<char*>(buffer);
+  FSelection::Iterator it (selection);
+  for (int64_t position; it.next(position);) {
+    assert (position < _cstore->_tuples);
+    ::memcpy (out, values + position * length, length);
+    out += length;
+  }
+}
+
+void FColumnReaderImplMainMemory::getPositionBitmap (const SearchCond &cond, CompressedPositionBitmap &positions) {
+  std::vector<PositionRange> ranges;
+  getPositionRanges (cond, ranges);
+  positions.addRanges (ranges);
+}
+
+void FColumnReaderImplMainMemory::getDecompressedData (const PositionRange &range, void *buffer, size_t bufferSize) {
+  assert (range.begin >= 0);
+  assert (range.begin <= range.end);
+  assert (range.end <= _cstore->_tuples);
+  const size_t bytes = (range.end - range.begin) * _column.maxLength;
+  assert (bufferSize >= bytes);
+  ::memcpy (buffer, _cstore->_columnArrays[_columnIndex] + range.begin * _column.maxLength, bytes);
+}
 
 // ==========================================================================
 //  Read-Only disk-based CStore table implementation
 // ==========================================================================
 
 
-FReadOnlyCStore::FReadOnlyCStore (FBufferPool *bufferpool, TableType type, const FSignatureSet &signatureSet, const std::string &dataFolder, const std::string &filenamePrefix) : _bufferpool (bufferpool), _type(type) {
+FReadOnlyCStore::FReadOnlyCStore (FBufferPool *bufferpool, TableType type, const FSignatureSet &signatureSet, const std::string &dataFolder, const std::string &filenamePrefix, FDictionaryCache *dictionaryCache) : _bufferpool (bufferpool), _type(type) {
   _columns = FCStoreUtil::getPhysicalDesignsOf(type);
-  vector<FFileSignature> signatures = signatureSet.getCStoreFileSignatures(dataFolder, _columns, filenamePrefix);
-  assert (_columns.size() == signatures.size());
+  init (signatureSet.getCStoreFileSignatures(dataFolder, _columns, filenamePrefix), dictionaryCache);
+}
+FReadOnlyCStore::FReadOnlyCStore (FBufferPool *bufferpool, TableType type, const vector<FFileSignature> &signatures, FDictionaryCache *dictionaryCache) : _bufferpool (bufferpool), _type(type) {
+  _columns = FCStoreUtil::getPhysicalDesignsOf(type);
+  init (signatures, dictionaryCache);
+}
+void FReadOnlyCStore::init (const vector<FFileSignature> &signatures, FDictionaryCache *dictionaryCache) {
+  if (_columns.size() != signatures.size()) {
+    LOG(ERROR) << "the number of signatures (" << signatures.size() << ") doesn't match the columns (" << _columns.size() << ")";
+    assert (false);
+    throw std::exception();
+  }
+  FBufferPool *bufferpool = _bufferpool;
+  // an RLE reader of the leading sort column can answer searches by binary search.
+  vector<SortOrder> sortOrders = FCStoreUtil::getSortOrdersOf(_type);
+  int leadingSortColumn = (!sortOrders.empty() && sortOrders[0].second) ? sortOrders[0].first : -1;
   for (size_t i = 0; i < _columns.size(); ++i) {
     const FCStoreColumn &column = _columns[i];
     const FFileSignature &signature = signatures[i];
+    _fileIds.push_back (signature.fileId);
     boost::shared_ptr<FColumnReader> reader;
     switch (column.compression) {
     case UNCOMPRESSED:
-      reader = boost::shared_ptr<FColumnReader>(new FColumnReaderImplUncompressed(bufferpool, column, signature));
+      {
+        int entriesPerPage, valueOffset;
+        FCStoreUtil::getColumnGroupLayout (_columns, i, entriesPerPage, valueOffset);
+        reader = boost::shared_ptr<FColumnReader>(new FColumnReaderImplUncompressed(bufferpool, column, signature, entriesPerPage, valueOffset));
+      }
       break;
     case RLE_COMPRESSED:
-      reader = boost::shared_ptr<FColumnReader>(new FColumnReaderImplRLE(bufferpool, column, signature));
+      reader = boost::shared_ptr<FColumnReader>(new FColumnReaderImplRLE(bufferpool, column, signature, (int) i == leadingSortColumn));
       break;
     case DICTIONARY_COMPRESSED:
-      reader = boost::shared_ptr<FColumnReader>(new FColumnReaderImplDictionary(bufferpool, column, signature));
+      reader = boost::shared_ptr<FColumnReader>(new FColumnReaderImplDictionary(bufferpool, column, signature, dictionaryCache));
+      break;
+    case SYMBOL_COMPRESSED:
+      reader = boost::shared_ptr<FColumnReader>(new FColumnReaderImplSymbol(bufferpool, column, signature));
       break;
     default:
       assert (false);
@@ -790,19 +1558,122 @@ FReadOnlyCStore::FReadOnlyCStore (FBufferPool *bufferpool, TableType type, const
   }
 }
 
-FColumnReader* FReadOnlyCStore::getColumnReader(const std::string &colname) {
-  assert (_columnReaders.size() == _columns.size());
-  for (size_t i = 0; i < _columnReaders.size(); ++i) {
-    if (_columns[i].name == colname) {
-      return _columnReaders[i].get();
-    }
+FColumnReader* FReadOnlyCStore::getColumnReader(const std::string &colname) {
+  assert (_columnReaders.size() == _columns.size());
+  for (size_t i = 0; i < _columnReaders.size(); ++i) {
+    if (_columns[i].name == colname) {
+      return _columnReaders[i].get();
+    }
+  }
+  assert (false);
+  return NULL;
+}
+FColumnReader* FReadOnlyCStore::getColumnReader(size_t colIndex) {
+  assert (colIndex < _columnReaders.size());
+  return _columnReaders[colIndex].get();
+}
+void FReadOnlyCStore::clearSearchRanges () {
+  for (size_t i = 0; i < _columnReaders.size(); ++i) {
+    _columnReaders[i]->clearSearchRanges();
+  }
+}
+
+SharedDictionary FDictionaryCache::get (int fileId) const {
+  boost::mutex::scoped_lock lock(_mutex);
+  std::map<int, SharedDictionary>::const_iterator it = _dictionaries.find(fileId);
+  if (it == _dictionaries.end()) {
+    return SharedDictionary();
+  }
+  return it->second;
+}
+void FDictionaryCache::put (int fileId, SharedDictionary dictionary) {
+  boost::mutex::scoped_lock lock(_mutex);
+  _dictionaries[fileId] = dictionary;
+}
+void FDictionaryCache::erase (int fileId) {
+  boost::mutex::scoped_lock lock(_mutex);
+  _dictionaries.erase (fileId);
+}
+size_t FDictionaryCache::size () const {
+  boost::mutex::scoped_lock lock(_mutex);
+  return _dictionaries.size();
+}
+
+void FColumnReader::getPositionBitmap (const SearchCond &cond, CompressedPositionBitmap &positions) {
+  std::vector<boost::shared_ptr<PositionBitmap> > bitmaps;
+  getPositionBitmaps (cond, bitmaps);
+  for (size_t i = 0; i < bitmaps.size(); ++i) {
+    positions.addBitmap (*bitmaps[i]);
+  }
+}
+
+void FColumnReader::getPositionSelection (const SearchCond &cond, const FSelection &filter, FSelection &result) {
+  std::vector<PositionRange> ranges;
+  // a gap shorter than a block is cheaper to scan than to split the range.
+  filter.getCoveringRanges (ranges, FDB_COLUMN_BLOCK_SIZE);
+  if (ranges.empty()) {
+    result = FSelection();
+    return;
+  }
+  setSearchRanges (ranges);
+  FSelection matched;
+  if (getColumn().compression == RLE_COMPRESSED) {
+    std::vector<PositionRange> matchedRanges;
+    getPositionRanges (cond, matchedRanges);
+    matched = FSelection(matchedRanges);
+  } else {
+    CompressedPositionBitmap matchedBitmap;
+    getPositionBitmap (cond, matchedBitmap);
+    matched = FSelection(matchedBitmap);
+  }
+  clearSearchRanges ();
+  matched.intersectWith (filter);
+  result = matched;
+}
+
+// throws if the buffer can't hold all selected values.
+void checkSelectionBufferSize (const FColumnReader *reader, const FSelection &selection, size_t bufferSize) {
+  if (bufferSize < (size_t) selection.count() * reader->getColumn().maxLength) {
+    LOG(ERROR) << "buffer too small for the selected values of column " << reader->getColumn().name;
+    assert (false);
+    throw std::exception();
   }
-  assert (false);
-  return NULL;
 }
-FColumnReader* FReadOnlyCStore::getColumnReader(size_t colIndex) {
-  assert (colIndex < _columnReaders.size());
-  return _columnReaders[colIndex].get();
+
+void FColumnReader::getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize) {
+  checkSelectionBufferSize (this, selection, bufferSize);
+  const int length = getColumn().maxLength;
+  char *out = reinterpret_cast<char*>(buffer);
+  if (selection.getRepresentation() == FSelection::SELECTION_RANGES) {
+    // every position in the ranges is selected. nothing to pick.
+    std::vector<PositionRange> ranges;
+    selection.getRanges (ranges);
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      size_t bytes = (ranges[i].end - ranges[i].begin) * length;
+      getDecompressedData (ranges[i], out, bytes);
+      out += bytes;
+    }
+    return;
+  }
+
+  // each block begins at a selected position, so unselected gaps longer than a block are never read.
+  boost::scoped_array<char> block (new char[FDB_COLUMN_BLOCK_SIZE * length]);
+  std::vector<int64_t> blockPositions;
+  FSelection::Iterator it (selection);
+  int64_t position;
+  bool hasPosition = it.next(position);
+  while (hasPosition) {
+    const int64_t blockBegin = position;
+    blockPositions.clear();
+    for (; hasPosition && position < blockBegin + FDB_COLUMN_BLOCK_SIZE; hasPosition = it.next(position)) {
+      blockPositions.push_back (position);
+    }
+    getDecompressedData (PositionRange(blockBegin, blockPositions.back() + 1), block.get(), FDB_COLUMN_BLOCK_SIZE * length);
+    for (size_t i = 0; i < blockPositions.size(); ++i) {
+      ::memcpy (out, block.get() + (blockPositions[i] - blockBegin) * length, length);
+      out += length;
+    }
+  }
 }
 
 std::string FColumnReaderImpl::normalize(const std::string &str) const {
@@ -813,7 +1684,7 @@ std::string FColumnReaderImpl::normalize(const std::string &str) const {
 }
 
 FColumnReaderImpl::FColumnReaderImpl(FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature)
-  : _bufferpool(bufferpool), _column(column), _signature(signature), _searchRangeSet(false) {
+  : _bufferpool(bufferpool), _column(column), _signature(signature), _searchRangeSet(false), _sortedInSearchRanges(false) {
 }
 std::string FColumnReaderImpl::toDebugStr (const void *key) const {
   if (_column.type == COLUMN_CHAR) {
@@ -864,13 +1735,68 @@ void FColumnReaderImpl::logSearchCond (const SearchCond &cond) const {
 #endif // NDEBUG
 }
 
+pair<int, int> FColumnReaderImpl::getPageRange (const PositionRange &scanRange) {
+  int beginPageId = findLeafPageByPosition (scanRange.begin); // the first page which has some tuple in scanRange
+  if (beginPageId < 0) {
+    return pair<int, int>(-1, -1);
+  }
+  int endPageId = beginPageId + 1; // the first page after beginPage which has no tuple in scanRange
+  if (scanRange.end > scanRange.begin) {
+    endPageId = std::max (endPageId, findLeafPageByPosition (scanRange.end - 1) + 1);
+  }
+  assert (endPageId <= _signature.leafPageCount);
+  return pair<int, int>(beginPageId, endPageId);
+}
+
+// returns pageId of the last entry beginning at or before the position in a position index page (RLE/Symbol).
+// -1 if every entry begins after the position.
+int searchRLEIndexPage (const char *page, int64_t position) {
+  const FPageHeader *header = reinterpret_cast<const FPageHeader*> (page);
+  const char *entries = page + sizeof(FPageHeader);
+  const size_t entrySize = sizeof(int64_t) + sizeof(int);
+  int low = 0, high = header->count; // the first entry beginning after the position
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (*reinterpret_cast<const int64_t*> (entries + mid * entrySize) <= position) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low == 0) return -1;
+  return *reinterpret_cast<const int*> (entries + (low - 1) * entrySize + sizeof(int64_t));
+}
+
+int FColumnReaderImpl::findLeafPageByPosition (int64_t position) {
+  // root pages are a few (FDB_MAX_ROOT_PAGES at most by default). the last one beginning at or before the position.
+  int pageId = -1;
+  for (int i = _signature.rootPageCount - 1; i >= 0; --i) {
+    const char *page = _bufferpool->readPage(_signature, _signature.rootPageStart + i);
+    const FPageHeader *header = reinterpret_cast<const FPageHeader*> (page);
+    assert (header->root);
+    if (header->beginningPos <= position || i == 0) {
+      pageId = searchRLEIndexPage (page, position);
+      break;
+    }
+  }
+  for (int level = _signature.rootPageLevel - 1; level >= 1 && pageId >= 0; --level) {
+    const char *page = _bufferpool->readPage(_signature, pageId);
+    assert (reinterpret_cast<const FPageHeader*> (page)->level == level);
+    pageId = searchRLEIndexPage (page, position);
+  }
+  assert (pageId < _signature.leafPageCount);
+  return pageId;
+}
+
 // ============================
 //  Uncompressed Columns
 // ============================
 FColumnReaderImplUncompressed::FColumnReaderImplUncompressed(
-  FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature)
-: FColumnReaderImpl(bufferpool, column, signature)  {
-  _entriesPerPage = (FDB_PAGE_SIZE - sizeof(FPageHeader)) / _column.maxLength;
+  FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature, int entriesPerPage, int valueOffset)
+: FColumnReaderImpl(bufferpool, column, signature), _entriesPerPage(entriesPerPage), _valueOffset(valueOffset)  {
+  assert (_entriesPerPage > 0);
+  assert (_entriesPerPage <= (int) ((FDB_PAGE_SIZE - sizeof(FPageHeader)) / _column.maxLength));
+  assert (_valueOffset + _entriesPerPage * _column.maxLength <= FDB_PAGE_SIZE);
 }
 
 int FColumnReaderImplUncompressed::processPageString(const SearchCond &cond, const char *cursor, size_t tuplesToRead, PositionBitmap *bitmap, int64_t bitmapPageOffset) {
@@ -968,7 +1894,7 @@ void FColumnReaderImplUncompressed::getPositionBitmaps (const SearchCond &cond,
       assert (end >= begin);
       if (end == begin) continue;
 
-      const char *cursor = page + sizeof (FPageHeader) + begin * _column.maxLength;
+      const char *cursor = page + _valueOffset + begin * _column.maxLength;
       size_t tupleToRead = end - begin;
       int64_t bitmapPageOffset = tuplePageOffset + begin - range.begin;
       // searching in one page is template-parameterized to boost performance.
@@ -1046,7 +1972,7 @@ void FColumnReaderImplUncompressed::getDecompressedData (const PositionRange &ra
     assert (end >= begin);
     if (end == begin) continue;
 
-    const char *cursor = page + sizeof (FPageHeader) + begin * _column.maxLength;
+    const char *cursor = page + _valueOffset + begin * _column.maxLength;
     size_t bytesToRead = (end - begin) * _column.maxLength;
     ::memcpy (reinterpret_cast<char *>(buffer) + bytesOffset, cursor, bytesToRead);
     bytesOffset += bytesToRead;
@@ -1058,16 +1984,53 @@ void FColumnReaderImplUncompressed::getDecompressedData (const PositionRange &ra
 #endif // NDEBUG
 }
 
+void FColumnReaderImplUncompressed::getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize) {
+  if (selection.getRepresentation() == FSelection::SELECTION_RANGES) {
+    FColumnReader::getDecompressedData (selection, buffer, bufferSize);
+    return;
+  }
+  checkSelectionBufferSize (this, selection, bufferSize);
+#ifndef NDEBUG
+  StopWatch watch;
+  watch.init();
+  int pagesRead = 0;
+#endif // NDEBUG
+  const int length = _column.maxLength;
+  char *out = reinterpret_cast<char*>(buffer);
+  int currentPageId = -1;
+  const char *values = NULL;
+  FSelection::Iterator it (selection);
+  for (int64_t position; it.next(position);) {
+    const int pageId = position / _entriesPerPage;
+    if (pageId != currentPageId) {
+      assert (pageId < _signature.pageCount);
+      const char *page = _bufferpool->readPage(_signature, pageId);
+      values = page + _valueOffset;
+      currentPageId = pageId;
+#ifndef NDEBUG
+      ++pagesRead;
+#endif // NDEBUG
+    }
+    const int64_t index = position - (int64_t) pageId * _entriesPerPage;
+    ::memcpy (out, values + index * length, length);
+    out += length;
+  }
+#ifndef NDEBUG
+  watch.stop();
+  VLOG(2) << "Uncompressed::getDecompressedData(selection) Done. " << selection.count() << " entries read from " << pagesRead << " pages. " << watch.getElapsed() << " microsec";
+#endif // NDEBUG
+}
+
 // ============================
 //  Dictionary Compressed Columns
 // ============================
 FColumnReaderImplDictionary::FColumnReaderImplDictionary(
-  FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature)
-: FColumnReaderImpl(bufferpool, column, signature)  {
+  FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature, FDictionaryCache *dictionaryCache)
+: FColumnReaderImpl(bufferpool, column, signature), _dictionaryCache(dictionaryCache)  {
   _dictionaryBits = signature.dictionaryBits;
   _entriesPerPage = (FDB_PAGE_SIZE - sizeof(FPageHeader)) * 8 / _dictionaryBits;
   _dictionaryEntriesRead = false;
-  _mask = (uint8_t) ((1 << _dictionaryBits) - 1);
+  _mask = (uint8_t) (_dictionaryBits >= 8 ? 0xFF : (1 << _dictionaryBits) - 1);
 }
 
 std::vector<int> FColumnReaderImplDictionary::searchDictionary (const SearchCond &cond) {
@@ -1079,13 +2042,14 @@ std::vector<int> FColumnReaderImplDictionary::searchDictionary (const SearchCond
     getAllDictionaryEntries();
   }
   std::vector<int> matchingIds;
-  for (size_t i = 0; i < _dictionaryEntries.size(); ++i) {
+  const std::vector<std::string> &entries = *_dictionary;
+  for (size_t i = 0; i < entries.size(); ++i) {
     bool matched = false;
-    assert ((int) _dictionaryEntries[i].size() == _column.maxLength);
+    assert ((int) entries[i].size() == _column.maxLength);
     if (_column.type == COLUMN_CHAR) {
-      matched = cond.matchString(_dictionaryEntries[i].data(), _column.maxLength);
+      matched = cond.matchString(entries[i].data(), _column.maxLength);
     } else {
-      matched = cond.matchInts(_dictionaryEntries[i].data(), _column.maxLength);
+      matched = cond.matchInts(entries[i].data(), _column.maxLength);
     }
     if (matched) {
       matchingIds.push_back (i);
@@ -1098,6 +2062,51 @@ std::vector<int> FColumnReaderImplDictionary::searchDictionary (const SearchCond
   return matchingIds;
 }
 
+int FColumnReaderImplDictionary::findDictionaryEntry (const void *value, bool upper) {
+  const std::vector<std::string> &entries = getAllDictionaryEntries();
+  int low = 0, high = entries.size();
+  while (low < high) {
+    const int mid = low + (high - low) / 2;
+    const int cmp = compareColumnValues (_column, entries[mid].data(), value);
+    if (cmp < 0 || (upper && cmp == 0)) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+bool FColumnReaderImplDictionary::searchDictionaryRange (const SearchCond &cond, int &beginId, int &endId) {
+  if (cond.type == SCT_IN) {
+    return false;
+  }
+  const int entryCount = getAllDictionaryEntries().size();
+  beginId = 0;
+  endId = entryCount;
+  switch (cond.type) {
+  case SCT_EQUAL:
+    beginId = findDictionaryEntry (cond.key, false);
+    endId = findDictionaryEntry (cond.key, true);
+    break;
+  case SCT_BETWEEN:
+    beginId = findDictionaryEntry (cond.key, false);
+    endId = findDictionaryEntry (cond.key2, true);
+    break;
+  case SCT_LT: endId = findDictionaryEntry (cond.key, false); break;
+  case SCT_LTEQ: endId = findDictionaryEntry (cond.key, true); break;
+  case SCT_GT: beginId = findDictionaryEntry (cond.key, true); break;
+  case SCT_GTEQ: beginId = findDictionaryEntry (cond.key, false); break;
+  default:
+    assert (false);
+    throw std::exception();
+  }
+  if (endId < beginId) {
+    endId = beginId; // e.g., BETWEEN with from > to
+  }
+  return true;
+}
+
 void FColumnReaderImplDictionary::getPositionBitmaps (const SearchCond &cond, std::vector<boost::shared_ptr<PositionBitmap> > &positions) {
 #ifndef NDEBUG
   logSearchCond (cond);
@@ -1109,8 +2118,18 @@ void FColumnReaderImplDictionary::getPositionBitmaps (const SearchCond &cond, st
     assert (false);
     throw std::runtime_error ("not implemented yet!");
   }
-  std::vector<int> matchingIds = searchDictionary(cond);
-  if (matchingIds.size() == 0) {
+  // conditions other than IN are evaluated on codes as a range. IN compares with each matching ID.
+  int beginId = 0, endId = 0;
+  const bool codeRange = searchDictionaryRange(cond, beginId, endId);
+  std::vector<int> matchingIds;
+  if (!codeRange) {
+    matchingIds = searchDictionary(cond);
+  } else if (_dictionaryBits < 8 || endId - beginId == 1) {
+    // at most 16 entries, or only one entry. the ID list is as fast.
+    for (int id = beginId; id < endId; ++id) matchingIds.push_back (id);
+  }
+  const bool useCodeRange = codeRange && matchingIds.empty() && beginId < endId;
+  if (matchingIds.size() == 0 && !useCodeRange) {
     for (size_t i = 0; i < _searchRanges.size(); ++i) {
       const PositionRange &range = _searchRanges[i];
       size_t tupleCount = range.end - range.begin;
@@ -1162,12 +2181,24 @@ void FColumnReaderImplDictionary::getPositionBitmaps (const SearchCond &cond, st
       size_t tupleToRead = end - begin;
       int64_t bitmapPageOffset = tuplePageOffset + begin - range.begin;
       const char *cursor = page + sizeof (FPageHeader) + begin * _dictionaryBits / 8;
-      if (_dictionaryBits % 8 == 0) {
+      if (useCodeRange) {
+        assert (_dictionaryBits % 8 == 0);
+        if (_dictionaryBits == 8) {
+          matchCount += processPageCodeRange<uint8_t>(beginId, endId, reinterpret_cast<const uint8_t*>(cursor), tupleToRead, bitmap, bitmapPageOffset);
+        } else if (_dictionaryBits == 16) {
+          matchCount += processPageCodeRange<uint16_t>(beginId, endId, reinterpret_cast<const uint16_t*>(cursor), tupleToRead, bitmap, bitmapPageOffset);
+        } else {
+          assert (_dictionaryBits == 32);
+          matchCount += processPageCodeRange<uint32_t>(beginId, endId, reinterpret_cast<const uint32_t*>(cursor), tupleToRead, bitmap, bitmapPageOffset);
+        }
+      } else if (_dictionaryBits % 8 == 0) {
         // no bit offset. simple
         if (_dictionaryBits == 8) {
           matchCount += processPageNoBitOffset<uint8_t>(matchingIds, reinterpret_cast<const uint8_t*>(cursor), tupleToRead, bitmap, bitmapPageOffset);
         } else if (_dictionaryBits == 16) {
           matchCount += processPageNoBitOffset<uint16_t>(matchingIds, reinterpret_cast<const uint16_t*>(cursor), tupleToRead, bitmap, bitmapPageOffset);
+        } else if (_dictionaryBits == 32) {
+          matchCount += processPageNoBitOffset<uint32_t>(matchingIds, reinterpret_cast<const uint32_t*>(cursor), tupleToRead, bitmap, bitmapPageOffset);
         } else {
           assert (false); // not supported
         }
@@ -1233,8 +2264,8 @@ void FColumnReaderImplDictionary::readDecompressDictionaryPageBitOffset(int begi
   uint8_t curByte = *cursor;
   for (int i = begin; i < end; ++i) {
     uint8_t entryId = (curByte >> bitOffset) & _mask;
-    assert (entryId < _dictionaryEntries.size());
-    const std::string &entry = _dictionaryEntries[entryId];
+    assert (entryId < _dictionary->size());
+    const std::string &entry = (*_dictionary)[entryId];
     assert ((int) entry.size() == _column.maxLength);
     ::memcpy(buffer, entry.data(), _column.maxLength);
     buffer += _column.maxLength;
@@ -1294,7 +2325,9 @@ void FColumnReaderImplDictionary::getDecompressedData (const PositionRange &rang
     assert (end >= begin);
     if (end == begin) continue;
 
-    if (_dictionaryBits == 16) {
+    if (_dictionaryBits == 32) {
+      readDecompressDictionaryPageNoBitOffset<uint32_t> (begin, end, page, bufferChar);
+    } else if (_dictionaryBits == 16) {
       readDecompressDictionaryPageNoBitOffset<uint16_t> (begin, end, page, bufferChar);
     } else if (_dictionaryBits == 8) {
       readDecompressDictionaryPageNoBitOffset<uint8_t> (begin, end, page, bufferChar);
@@ -1310,6 +2343,58 @@ void FColumnReaderImplDictionary::getDecompressedData (const PositionRange &rang
 #endif // NDEBUG
 }
 
+uint32_t FColumnReaderImplDictionary::readDictionaryCode (const char *page, int64_t index) const {
+  const char *data = page + sizeof (FPageHeader);
+  switch (_dictionaryBits) {
+  case 32: return reinterpret_cast<const uint32_t*>(data)[index];
+  case 16: return reinterpret_cast<const uint16_t*>(data)[index];
+  case 8: return reinterpret_cast<const uint8_t*>(data)[index];
+  default:
+    {
+      // same bit order as FCStoreWriter (lower bits first).
+      const int64_t bit = index * _dictionaryBits;
+      return (reinterpret_cast<const uint8_t*>(data)[bit / 8] >> (bit % 8)) & _mask;
+    }
+  }
+}
+
+void FColumnReaderImplDictionary::getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize) {
+  if (selection.getRepresentation() == FSelection::SELECTION_RANGES) {
+    FColumnReader::getDecompressedData (selection, buffer, bufferSize);
+    return;
+  }
+  checkSelectionBufferSize (this, selection, bufferSize);
+#ifndef NDEBUG
+  StopWatch watch;
+  watch.init();
+#endif // NDEBUG
+  if (!_dictionaryEntriesRead) {
+    getAllDictionaryEntries();
+  }
+  const std::vector<std::string> &entries = *_dictionary;
+  char *out = reinterpret_cast<char*>(buffer);
+  int currentPageId = -1;
+  const char *page = NULL;
+  FSelection::Iterator it (selection);
+  for (int64_t position; it.next(position);) {
+    const int pageId = position / _entriesPerPage;
+    if (pageId != currentPageId) {
+      page = _bufferpool->readPage(_signature, pageId);
+      currentPageId = pageId;
+    }
+    uint32_t entryId = readDictionaryCode (page, position - (int64_t) pageId * _entriesPerPage);
+    assert (entryId < entries.size());
+    const std::string &entry = entries[entryId];
+    assert ((int) entry.size() == _column.maxLength);
+    ::memcpy (out, entry.data(), _column.maxLength);
+    out += _column.maxLength;
+  }
+#ifndef NDEBUG
+  watch.stop();
+  VLOG(2) << "Dictionary::getDecompressedData(selection) Done. " << selection.count() << " entries read. " << watch.getElapsed() << " microsec";
+#endif // NDEBUG
+}
+
 void FColumnReaderImplDictionary::getDictionaryCompressedData (const PositionRange &range, void *buffer, size_t bufferSize, int &bitOffset) {
 #ifndef NDEBUG
   StopWatch watch;
@@ -1397,12 +2482,22 @@ int FColumnReaderImplDictionary::getDictionaryEntryCount () {
 }
 const std::vector<string>& FColumnReaderImplDictionary::getAllDictionaryEntries () {
   if (_dictionaryEntriesRead) {
-    return _dictionaryEntries;
+    return *_dictionary;
+  }
+  if (_dictionaryCache != NULL) {
+    _dictionary = _dictionaryCache->get(_signature.fileId);
+    if (_dictionary) {
+      VLOG(2) << "dictionary of file " << _signature.fileId << " was found in the cache";
+      _dictionaryEntriesRead = true;
+      return *_dictionary;
+    }
   }
 #ifndef NDEBUG
   StopWatch watch;
   watch.init();
 #endif // NDEBUG
+  boost::shared_ptr<std::vector<std::string> > entries (new std::vector<std::string>());
+  entries->reserve (_signature.dictionaryEntryCount);
   for (int i = 0; i < _signature.rootPageCount; ++i) {
     const int pageId = i + _signature.rootPageStart;
     const char *page = _bufferpool->readPage(_signature, pageId);
@@ -1410,23 +2505,27 @@ const std::vector<string>& FColumnReaderImplDictionary::getAllDictionaryEntries
     assert (header->root);
     for (int j = 0; j < header->count; ++j) {
       const char *cursor = page + sizeof (FPageHeader) + j * _column.maxLength;
-      _dictionaryEntries.push_back (string (cursor, _column.maxLength));
+      entries->push_back (string (cursor, _column.maxLength));
     }
   }
 #ifndef NDEBUG
   watch.stop();
   VLOG(2) << "Done. all dictionary entries copied. " << watch.getElapsed() << " microsec";
 #endif // NDEBUG
+  _dictionary = entries;
+  if (_dictionaryCache != NULL) {
+    _dictionaryCache->put(_signature.fileId, _dictionary);
+  }
   _dictionaryEntriesRead = true;
-  return _dictionaryEntries;
+  return *_dictionary;
 }
 
 // ============================
 //  RLE columns
 // ============================
 
-FColumnReaderImplRLE::FColumnReaderImplRLE (FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature)
-  : FColumnReaderImpl(bufferpool, column, signature)  {
+FColumnReaderImplRLE::FColumnReaderImplRLE (FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature, bool leadingSortColumn)
+  : FColumnReaderImpl(bufferpool, column, signature), _leadingSortColumn(leadingSortColumn)  {
 }
 
 void FColumnReaderImplRLE::getPositionRanges (const SearchCond &cond, std::vector<PositionRange> &positions) {
@@ -1435,7 +2534,15 @@ void FColumnReaderImplRLE::getPositionRanges (const SearchCond &cond, std::vecto
   StopWatch watch;
   watch.init();
 #endif // NDEBUG
-  if (!_searchRangeSet) {
+  if (isSortedInSearchRanges() && cond.type != SCT_IN) {
+    if (!_searchRangeSet) {
+      getPositionRangesSorted (cond, positions, PositionRange(0, _signature.totalTupleCount));
+    } else {
+      for (size_t i = 0; i < _searchRanges.size(); ++i) {
+        getPositionRangesSorted (cond, positions, _searchRanges[i]);
+      }
+    }
+  } else if (!_searchRangeSet) {
     getPositionRangesFullscan (cond, positions);
   } else {
     for (size_t i = 0; i < _searchRanges.size(); ++i) {
@@ -1448,31 +2555,96 @@ void FColumnReaderImplRLE::getPositionRanges (const SearchCond &cond, std::vecto
 #endif // NDEBUG
 }
 
-pair<int, int> FColumnReaderImplRLE::getPageRange (const PositionRange &scanRange) {
-  int beginPageId = -1; // the first page which has some tuple in scanRange
-  int endPageId = -1; // the first page after beginPage which has no tuple in scanRange
-  for (size_t i = 0; i < (size_t) _signature.rootPageCount && endPageId < 0; ++i) {
-    int rootPageId = i + _signature.rootPageStart;
-    const char *page = _bufferpool->readPage(_signature, rootPageId);
-    const FPageHeader *header = reinterpret_cast<const FPageHeader*> (page);
-    assert (header->root);
-    const char *cursor = page + sizeof(FPageHeader);
-    for (int j = 0; j < header->count; ++j, cursor += (sizeof(int64_t) + sizeof(int))) {
-      int64_t beginningPos = *reinterpret_cast<const int64_t*> (cursor);
-      int pageId = *reinterpret_cast<const int*> (cursor + sizeof(int64_t));
-      if (beginningPos <= scanRange.begin) {
-        beginPageId = pageId;
-      } else if (beginningPos >= scanRange.end) {
-        endPageId = pageId;
-        break;
-      }
+int FColumnReaderImplRLE::compareValue (const char *runValue, const void *value) const {
+  return compareColumnValues (_column, runValue, value);
+}
+
+int64_t FColumnReaderImplRLE::findPositionByValue (const void *value, bool inclusive, const PositionRange &scanRange) {
+  pair<int, int> pageRange = getPageRange(scanRange);
+  if (pageRange.first < 0) {
+    return scanRange.end;
+  }
+  // the first leaf page whose first run is after the value. the position is in the page before it.
+  // the first run of beginPage might be out of the scan range (thus not sorted), so it's never compared.
+  int low = pageRange.first + 1, high = pageRange.second;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    const char *page = _bufferpool->readPage(_signature, mid);
+    int cmp = compareValue (page + sizeof(FPageHeader) + sizeof(int), value);
+    if (cmp < 0 || (cmp == 0 && !inclusive)) {
+      low = mid + 1;
+    } else {
+      high = mid;
     }
   }
-  if (beginPageId >= 0 && endPageId < 0) {
-    endPageId = beginPageId + 1;
+  const char *page = _bufferpool->readPage(_signature, low - 1);
+  const FPageHeader *header = reinterpret_cast<const FPageHeader*> (page);
+  const char *cursor = page + sizeof(FPageHeader);
+  int64_t pos = header->beginningPos;
+  for (int j = 0; j < header->count; ++j, cursor += (_column.maxLength + sizeof(int))) {
+    int runLength = *reinterpret_cast<const int*> (cursor);
+    if (pos + runLength <= scanRange.begin) {
+      pos += runLength;
+      continue;
+    }
+    if (pos >= scanRange.end) {
+      return scanRange.end;
+    }
+    int cmp = compareValue (cursor + sizeof(int), value);
+    if (cmp > 0 || (cmp == 0 && inclusive)) return max (pos, scanRange.begin);
+    pos += runLength;
   }
-  return pair<int, int>(beginPageId, endPageId);
+  // all runs in the page are before the value. the next page begins with a run after it.
+  return max (scanRange.begin, min (pos, scanRange.end));
+}
+
+bool FColumnReaderImplRLE::getPositionRangesSorted (const SearchCond &cond, std::vector<PositionRange> &positions, const PositionRange &scanRange) {
+  int64_t begin, end;
+  switch (cond.type) {
+  case SCT_EQUAL:
+    begin = findPositionByValue (cond.key, true, scanRange);
+    end = findPositionByValue (cond.key, false, scanRange);
+    break;
+  case SCT_BETWEEN:
+    begin = findPositionByValue (cond.key, true, scanRange);
+    end = findPositionByValue (cond.key2, false, scanRange);
+    break;
+  case SCT_LT:
+    begin = scanRange.begin;
+    end = findPositionByValue (cond.key, true, scanRange);
+    break;
+  case SCT_LTEQ:
+    begin = scanRange.begin;
+    end = findPositionByValue (cond.key, false, scanRange);
+    break;
+  case SCT_GT:
+    begin = findPositionByValue (cond.key, false, scanRange);
+    end = scanRange.end;
+    break;
+  case SCT_GTEQ:
+    begin = findPositionByValue (cond.key, true, scanRange);
+    end = scanRange.end;
+    break;
+  default:
+    return false;
+  }
+  if (begin >= end) {
+    return true;
+  }
+  if (!positions.empty() && positions.back().end == begin) {
+    positions.back().end = end; // connect to previous range
+  } else {
+    positions.push_back (PositionRange(begin, end));
+  }
+  return true;
+}
+
+void FColumnReaderImplRLE::getPositionBitmap (const SearchCond &cond, CompressedPositionBitmap &positions) {
+  std::vector<PositionRange> ranges;
+  getPositionRanges (cond, ranges);
+  positions.addRanges (ranges);
 }
+
 void FColumnReaderImplRLE::getPositionRangesPartialScan (const SearchCond &cond, std::vector<PositionRange> &positions, const PositionRange &scanRange) {
   // first, we look for ranges of pages where
   // beginPage.beginningPos <= scanRange.begin  AND endPage.beginningPos >= scanRange.end
@@ -1683,7 +2855,7 @@ void FColumnReaderImplRLE::getDecompressedData (const PositionRange &range, void
         assert (pageId == endPageId - 1);
         break;
       }
-      int64_t end = pos + runLength;
+      int64_t end = std::min<int64_t> (pos + runLength, range.end);
       if (pos < range.begin) {
         pos = range.begin;
       }
@@ -1700,6 +2872,206 @@ void FColumnReaderImplRLE::getDecompressedData (const PositionRange &range, void
 #endif // NDEBUG
 }
 
+// ============================
+//  Symbol Compressed Columns
+// ============================
+// returns the byte range [begin, end) of the index-th value in a symbol-compressed leaf page.
+inline void getSymbolEntryBytes (const char *page, int index, int &begin, int &end) {
+  const uint16_t *endOffsets = reinterpret_cast<const uint16_t*>(page + FDB_PAGE_SIZE);
+  begin = (index == 0) ? (int) sizeof(FPageHeader) : (int) endOffsets[-index];
+  end = endOffsets[-index - 1];
+  assert (begin <= end);
+}
+
+FColumnReaderImplSymbol::FColumnReaderImplSymbol(
+  FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature)
+: FColumnReaderImpl(bufferpool, column, signature), _symbolTableRead(false)  {
+  assert (column.type == COLUMN_CHAR);
+}
+
+const FSymbolTable& FColumnReaderImplSymbol::getSymbolTable () {
+  if (!_symbolTableRead) {
+    // the page right after leaf pages
+    const char *page = _bufferpool->readPage(_signature, _signature.leafPageCount);
+    const FPageHeader *header = reinterpret_cast<const FPageHeader*> (page);
+    assert (header->entrySize == FSymbolTable::SERIALIZED_ENTRY_SIZE);
+    _symbolTable.deserialize (page + sizeof (FPageHeader), header->count);
+    _symbolTableRead = true;
+  }
+  return _symbolTable;
+}
+
+int FColumnReaderImplSymbol::processPage(const SearchCond &cond, const std::vector<std::string> &encodedKeys, const char *page, int begin, int end, PositionBitmap *bitmap, int64_t bitmapPageOffset) {
+  int matchCount = 0;
+  if (cond.type == SCT_EQUAL || cond.type == SCT_IN) {
+    // compared without decoding
+    for (int i = begin; i < end; ++i) {
+      int from, to;
+      getSymbolEntryBytes (page, i, from, to);
+      for (size_t k = 0; k < encodedKeys.size(); ++k) {
+        const std::string &key = encodedKeys[k];
+        if ((int) key.size() == to - from && ::memcmp (page + from, key.data(), key.size()) == 0) {
+          bitmap->setBit(i + bitmapPageOffset);
+          ++matchCount;
+          break;
+        }
+      }
+    }
+  } else {
+    const FSymbolTable &symbolTable = getSymbolTable();
+    boost::scoped_array<char> value (new char[_column.maxLength]);
+    for (int i = begin; i < end; ++i) {
+      int from, to;
+      getSymbolEntryBytes (page, i, from, to);
+      symbolTable.decode (reinterpret_cast<const unsigned char*>(page + from), to - from, value.get(), _column.maxLength);
+      if (cond.matchString(value.get(), _column.maxLength)) {
+        bitmap->setBit(i + bitmapPageOffset);
+        ++matchCount;
+      }
+    }
+  }
+  return matchCount;
+}
+
+void FColumnReaderImplSymbol::getPositionBitmaps (const SearchCond &cond, std::vector<boost::shared_ptr<PositionBitmap> > &positions) {
+#ifndef NDEBUG
+  logSearchCond (cond);
+  StopWatch watch;
+  watch.init();
+#endif // NDEBUG
+  if (_searchRangeSet == false) {
+    // this should not happen. very inefficient if happens
+    assert (false);
+    throw std::runtime_error ("not implemented yet!");
+  }
+  const FSymbolTable &symbolTable = getSymbolTable();
+  std::vector<std::string> encodedKeys;
+  if (cond.type == SCT_EQUAL) {
+    encodedKeys.push_back (symbolTable.encode (reinterpret_cast<const char*>(cond.key), _column.maxLength));
+  } else if (cond.type == SCT_IN) {
+    for (size_t i = 0; i < cond.keys.size(); ++i) {
+      encodedKeys.push_back (symbolTable.encode (reinterpret_cast<const char*>(cond.keys[i]), _column.maxLength));
+    }
+  }
+
+  int totalMatchCount = 0;
+  for (size_t i = 0; i < _searchRanges.size(); ++i) {
+    const PositionRange &range = _searchRanges[i];
+    size_t tupleCount = range.end - range.begin;
+    boost::shared_ptr<PositionBitmap> bitmapPtr = PositionBitmap::newBitmap(range.begin, tupleCount);
+    positions.push_back (bitmapPtr);
+    PositionBitmap *bitmap = bitmapPtr.get();
+    if (tupleCount == 0) continue;
+
+    pair<int, int> pageRange = getPageRange(range);
+    int matchCount = 0;
+    for (int pageId = pageRange.first; pageId >= 0 && pageId < pageRange.second; ++pageId) {
+      const char *page = _bufferpool->readPage(_signature, pageId);
+      const FPageHeader *header = reinterpret_cast<const FPageHeader*> (page);
+      const int64_t pageBegin = header->beginningPos;
+      int begin = (int) std::max<int64_t> (0, range.begin - pageBegin);
+      int end = (int) std::min<int64_t> (header->count, range.end - pageBegin);
+      if (begin >= end) continue;
+      matchCount += processPage(cond, encodedKeys, page, begin, end, bitmap, pageBegin - range.begin);
+    }
+    bitmap->matchedCount = matchCount;
+    totalMatchCount += matchCount;
+  }
+#ifndef NDEBUG
+  watch.stop();
+  VLOG(2) << "Symbol::getPositionBitmaps Done. " << totalMatchCount << " entries matched. " << watch.getElapsed() << " microsec";
+#endif // NDEBUG
+}
+
+void FColumnReaderImplSymbol::getDecompressedData (const PositionRange &range, void *buffer, size_t bufferSize) {
+  assert (range.begin >= 0);
+  assert (range.end >= 0);
+  assert (range.begin <= range.end);
+#ifndef NDEBUG
+  StopWatch watch;
+  watch.init();
+#endif // NDEBUG
+  int64_t length = range.end - range.begin;
+  assert ((int64_t) bufferSize >= length * _column.maxLength);
+  if (length == 0) return;
+
+  const FSymbolTable &symbolTable = getSymbolTable();
+  char *out = reinterpret_cast<char*>(buffer);
+  pair<int, int> pageRange = getPageRange(range);
+  for (int pageId = pageRange.first; pageId >= 0 && pageId < pageRange.second; ++pageId) {
+    const char *page = _bufferpool->readPage(_signature, pageId);
+    const FPageHeader *header = reinterpret_cast<const FPageHeader*> (page);
+    const int64_t pageBegin = header->beginningPos;
+    int begin = (int) std::max<int64_t> (0, range.begin - pageBegin);
+    int end = (int) std::min<int64_t> (header->count, range.end - pageBegin);
+    for (int i = begin; i < end; ++i, out += _column.maxLength) {
+      int from, to;
+      getSymbolEntryBytes (page, i, from, to);
+      symbolTable.decode (reinterpret_cast<const unsigned char*>(page + from), to - from, out, _column.maxLength);
+    }
+  }
+  assert (out == reinterpret_cast<char*>(buffer) + length * _column.maxLength);
+
+#ifndef NDEBUG
+  watch.stop();
+  VLOG(2) << "Symbol::getDecompressedData Done. " << length << " entries read. " << watch.getElapsed() << " microsec";
+#endif // NDEBUG
+}
+
+void FColumnReaderImplSymbol::getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize) {
+  if (selection.getRepresentation() == FSelection::SELECTION_RANGES) {
+    FColumnReader::getDecompressedData (selection, buffer, bufferSize);
+    return;
+  }
+  checkSelectionBufferSize (this, selection, bufferSize);
+#ifndef NDEBUG
+  StopWatch watch;
+  watch.init();
+  int pagesRead = 0;
+#endif // NDEBUG
+  const FSymbolTable &symbolTable = getSymbolTable();
+  const int length = _column.maxLength;
+  char *out = reinterpret_cast<char*>(buffer);
+  int currentPageId = -1;
+  const char *page = NULL;
+  int64_t pageBegin = 0, pageEnd = 0;
+  FSelection::Iterator it (selection);
+  for (int64_t position; it.next(position);) {
+    if (position < pageBegin || position >= pageEnd) {
+      // positions are ascending. mostly in the next page
+      int pageId = currentPageId + 1;
+      if (pageId >= _signature.leafPageCount || reinterpret_cast<const FPageHeader*>(_bufferpool->readPage(_signature, pageId))->beginningPos > position) {
+        pageId = findLeafPageByPosition (position);
+      }
+      assert (pageId >= 0);
+      page = _bufferpool->readPage(_signature, pageId);
+      const FPageHeader *header = reinterpret_cast<const FPageHeader*> (page);
+      pageBegin = header->beginningPos;
+      pageEnd = pageBegin + header->count;
+      if (position >= pageEnd) {
+        pageId = findLeafPageByPosition (position);
+        page = _bufferpool->readPage(_signature, pageId);
+        header = reinterpret_cast<const FPageHeader*> (page);
+        pageBegin = header->beginningPos;
+        pageEnd = pageBegin + header->count;
+      }
+      assert (position >= pageBegin && position < pageEnd);
+      currentPageId = pageId;
+#ifndef NDEBUG
+      ++pagesRead;
+#endif // NDEBUG
+    }
+    int from, to;
+    getSymbolEntryBytes (page, position - pageBegin, from, to);
+    symbolTable.decode (reinterpret_cast<const unsigned char*>(page + from), to - from, out, length);
+    out += length;
+  }
+#ifndef NDEBUG
+  watch.stop();
+  VLOG(2) << "Symbol::getDecompressedData(selection) Done. " << selection.count() << " entries read from " << pagesRead << " pages. " << watch.getElapsed() << " microsec";
+#endif // NDEBUG
+}
+
 // ============================
 //  Bitmap operations
 // ============================
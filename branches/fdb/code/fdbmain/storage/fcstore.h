@@ -7,7 +7,9 @@
 #include <vector>
 #include <cassert>
 #include <utility>
+#include <map>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace fdb {
 
@@ -38,50 +40,103 @@ struct FCStoreColumn {
   }
   FCStoreColumn (const std::string &name_, ColumnType type_, int maxLength_, int offset_, CompressionScheme compression_)
     : name(name_), type(type_), maxLength(maxLength_), offset(offset_), compression(compression_) {}
+  // name in the file name (<prefix>.<name>.db). columns in a group share the file of the group.
+  const std::string& getStorageName () const { return group.empty() ? name : group; }
+
   std::string name;
   ColumnType type;
   int maxLength;
   int offset; // byte offset of this column in tuple format. (NOTE: could be different from sum of maxLength of preceeding columns because of C++ memory alignment)
   CompressionScheme compression;
+  // non-empty if this column is stored in a column group (PAX) with other columns of the same group name.
+  // a column group is one file whose pages contain a mini-column for each member (see fpage.h),
+  // so columns always read together (e.g., l_quantity/l_extendedprice/l_discount in Q1.x)
+  // share page fetches. only UNCOMPRESSED columns can be in a group.
+  std::string group;
 };
 
 class FMainMemoryCStoreImpl;
+class FColumnReader;
 // represents a main-memory table (projection) in column store for writing.
 // this class allows only inserting new entries and dumping the entire table
 // to column-oriented files. Compression will be done when the entire table is dumped.
-// This object will be passed as a parameter when flushing to disk (see FSignatureSet::dumpToNewFiles()).
-// Each column will be saved to a file named like <prefix>_columnname.db.
+// This object will be passed as a parameter when flushing to disk (see FSignatureSet::dumpToNewCStoreFiles()).
+// Each column will be saved to a file named like <prefix>.columnname.db (<prefix>.groupname.db for a column group).
+// Each column is kept in its own array of uncompressed values, so the table can be
+// queried (even before finishInserts()) through the same FColumnReader interface
+// as on-disk c-store tables, and dumped without converting rows to columns.
 class FMainMemoryCStore {
 public:
-  FMainMemoryCStore (TableType type, int maxSize);
+  FMainMemoryCStore (TableType type, int64_t maxSize);
+  ~FMainMemoryCStore ();
 
-  // same functions as FMainMemoryBTree
+  // same functions as FMainMemoryBTree.
+  // data is the whole tuple. each column value is copied from data + column.offset.
   bool insert (const void *key, const void *data);
+  // sorts all columns by the key. no more insert is allowed after this.
   void finishInserts ();
+  bool isFinishedInserts () const;
   int64_t size () const;
+  int64_t getMaxSize () const;
   int getKeySize() const;
   int getDataSize() const;
   TableType getTableType() const;
+  const std::vector<FCStoreColumn>& getColumns () const;
+  // array of the column values. column.maxLength bytes for each tuple.
   const void* getBuffer(size_t column) const;
 
+  // readers over the values inserted so far. search ranges are shared between queries
+  // as FReadOnlyCStore, so clear them before using.
+  FColumnReader* getColumnReader(const std::string &colname);
+  FColumnReader* getColumnReader(size_t colIndex);
+
   FMainMemoryCStoreImpl* getImpl () { return _impl; } // only used by testcases
 private:
   FMainMemoryCStoreImpl *_impl;
+  FMainMemoryCStore (const FMainMemoryCStore &); // prohibit copy
 };
 
 struct FFileSignature;
 class FMainMemoryBTree;
 typedef std::pair<size_t, bool> SortOrder; // pair<columnIndex, asc>
+
+// how FCStoreUtil dumps an on-memory table to c-store files.
+// columns are independent files, so they are dumped in parallel.
+struct FCStoreDumpOptions {
+  FCStoreDumpOptions () : threads(FDB_DUMP_THREADS), writeBufferPages(FDB_DUMP_WRITE_BUFFER_PAGES), sharedTraversal(false) {}
+  // number of columns dumped at the same time. 1 to dump columns one by one.
+  int threads;
+  // total size (in pages) of the write buffers of all threads.
+  int writeBufferPages;
+  // if true, a BTree is traversed only once and every column reads the tuples from it
+  // instead of traversing the BTree for each column. costs one pointer per tuple.
+  bool sharedTraversal;
+};
+
 class FCStoreUtil {
 public:
   // returns column designs for given TableType
   static std::vector<FCStoreColumn> getPhysicalDesignsOf(TableType table);
   static std::vector<SortOrder> getSortOrdersOf(TableType table);
 
+  // indexes of the columns stored in the same file as columns[columnIndex] in the physical design order.
+  // the first one (leading column) writes the file. only the column itself if it's not in a group.
+  static std::vector<size_t> getColumnGroupOf(const std::vector<FCStoreColumn> &columns, size_t columnIndex);
+  // values in a page and the byte offset of the values of columns[columnIndex] in a page.
+  // same as an ordinary uncompressed file if the column is not in a group.
+  static void getColumnGroupLayout(const std::vector<FCStoreColumn> &columns, size_t columnIndex, int &entriesPerPage, int &valueOffset);
+  // the column to write the whole group file with FCStoreWriter. a CHAR column of the total length of members.
+  static FCStoreColumn toColumnGroupFileColumn(const std::vector<FCStoreColumn> &columns, size_t columnIndex);
+
   // dumps a main memory BTree to new files in c-store format.
   // properties of signatures will be set in this method.
   // only fileid/filepath should be set before calling this method.
-  static void dumpToNewCStoreFile (std::vector<FFileSignature> &signatures, const FMainMemoryBTree &btree);
+  static void dumpToNewCStoreFile (std::vector<FFileSignature> &signatures, const FMainMemoryBTree &btree, const FCStoreDumpOptions &options = FCStoreDumpOptions());
+
+  // dumps a main memory CStore to new files. finishInserts() must have been called.
+  // as the values are already stored per column, each column array is directly
+  // compressed and written.
+  static void dumpToNewCStoreFile (std::vector<FFileSignature> &signatures, const FMainMemoryCStore &cstore, const FCStoreDumpOptions &options = FCStoreDumpOptions());
 };
 
 struct PositionRange {
@@ -108,29 +163,68 @@ private: // prohibit wrong copying
   PositionBitmap (const PositionBitmap &);
 };
 
+// decoded entries of a dictionary. immutable once decoded, so can be shared
+// by any number of column readers of the same file.
+typedef boost::shared_ptr<const std::vector<std::string> > SharedDictionary;
+
+// decoded dictionaries keyed by file id.
+// dictionary compressed column readers given this cache decode the dictionary
+// (root) pages only when no other reader has decoded them before.
+// thread-safe, as readers of parallel scan threads share one cache.
+class FDictionaryCache {
+public:
+  // returns an empty pointer if not cached.
+  SharedDictionary get (int fileId) const;
+  void put (int fileId, SharedDictionary dictionary);
+  // call this when the file is removed. readers holding the dictionary still can use it.
+  void erase (int fileId);
+  size_t size () const;
+private:
+  mutable boost::mutex _mutex;
+  std::map<int, SharedDictionary> _dictionaries;
+};
+
 class FBufferPool;
 class FReadOnlyCStoreImpl;
-class FColumnReader;
 class FSignatureSet;
 // represents a disk-based read-only table (projection) in column store for reading.
 // An instance of this class holds several file signatures, one for each column.
 // Each column can have very different compression scheme although the sort order is same.
+// Resolving signatures by filepath for each column is not free, so query code should open
+// this through FEngine::getReadOnlyCStore(), which caches the signatures and dictionaries.
+// an instance isn't thread-safe (column readers keep search ranges), so each query or thread uses its own.
 class FReadOnlyCStore {
 public:
-  FReadOnlyCStore (FBufferPool *bufferpool, TableType type, const FSignatureSet &signatureSet, const std::string &dataFolder, const std::string &filenamePrefix);
+  // if dictionaryCache is given, decoded dictionaries are shared through it.
+  FReadOnlyCStore (FBufferPool *bufferpool, TableType type, const FSignatureSet &signatureSet, const std::string &dataFolder, const std::string &filenamePrefix, FDictionaryCache *dictionaryCache = NULL);
+  // opens the column files of the given signatures (one for each column, see FSignatureSet::getCStoreFileSignatures()).
+  // used to read a fracture of a snapshot (see FFamily::acquireSnapshot()) whose signatures might be already
+  // removed from FSignatureSet by a merge.
+  FReadOnlyCStore (FBufferPool *bufferpool, TableType type, const std::vector<FFileSignature> &signatures, FDictionaryCache *dictionaryCache = NULL);
 
   FColumnReader* getColumnReader(const std::string &colname);
   FColumnReader* getColumnReader(size_t colIndex);
 
+  // clears search ranges of all column readers. used when this object is reused by another plan.
+  void clearSearchRanges ();
+
+  // file ids of the column files, in the order of columns.
+  const std::vector<int>& getFileIds () const { return _fileIds; }
+
 private:
+  void init (const std::vector<FFileSignature> &signatures, FDictionaryCache *dictionaryCache);
+
   FBufferPool *_bufferpool;
   TableType _type;
   std::vector<FCStoreColumn> _columns;
+  std::vector<int> _fileIds;
   std::vector<boost::shared_ptr<FColumnReader> > _columnReaders;
 };
 
 // provides read accesses for a column
 struct SearchCond;
+class CompressedPositionBitmap;
+class FSelection;
 class FColumnReader {
 public:
   virtual ~FColumnReader(){}
@@ -145,15 +239,39 @@ public:
   virtual void setSearchRange (const PositionRange &ranges) = 0;
   virtual void setSearchRanges (const std::vector<PositionRange> &ranges) = 0;
   virtual void clearSearchRanges () = 0;
+  // tells that this column is sorted (ascending) within each of the current search ranges,
+  // typically because the ranges are runs of all preceding sort columns (see FCStoreUtil::getSortOrdersOf()).
+  // RLE readers then answer EQUAL/BETWEEN/LT/GT(EQ) by binary search instead of scanning runs.
+  // not needed for the leading sort column, which is always sorted.
+  // reset by setSearchRange(s)/clearSearchRanges(). ignored by other readers.
+  virtual void setSortedInSearchRanges () {}
 
   // search for given condition in this column and puts all found positions (=tupleid)
   // to the vector.
   virtual void getPositionRanges (const SearchCond &cond, std::vector<PositionRange> &positions) = 0;
   virtual void getPositionBitmaps (const SearchCond &cond, std::vector<boost::shared_ptr<PositionBitmap> > &positions) = 0;
+  // same search, but adds all found positions to one compressed bitmap (see fcbitmap.h).
+  // results of several columns can be then combined by AND/OR without materializing
+  // raw bitmaps for each search range.
+  // the default implementation converts the result of getPositionBitmaps().
+  virtual void getPositionBitmap (const SearchCond &cond, CompressedPositionBitmap &positions);
+  // searches only positions selected by filter, and sets result = filter AND matched.
+  // the column is scanned only in the ranges covering filter (see fcselection.h),
+  // and the found positions are kept in the natural representation of this column
+  // (ranges for RLE, bitmap otherwise). filter and result can be the same object.
+  // NOTE: this overwrites and then clears the search ranges of this reader.
+  virtual void getPositionSelection (const SearchCond &cond, const FSelection &filter, FSelection &result);
 
   // put the column data of specified range to given buffer. decompress if needed so that
   // the returned data are original data.
   virtual void getDecompressedData (const PositionRange &range, void *buffer, size_t bufferSize) = 0;
+
+  // put the column data of only selected positions to given buffer, in ascending order of
+  // positions without gaps (selection.count() * maxLength bytes).
+  // pages without selected positions are not read. uncompressed/dictionary columns decode
+  // only the selected values, while the default implementation decompresses each block
+  // (FDB_COLUMN_BLOCK_SIZE positions) containing selected positions and picks them.
+  virtual void getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize);
 };
 
 class FColumnReaderRLE : virtual public FColumnReader {
@@ -190,6 +308,12 @@ public:
   // performance of this function shouldn't matter as dictionary pages are small.
   // so, not much tuning is done.
   virtual std::vector<int> searchDictionary (const SearchCond &cond) = 0;
+
+  // dictionary entries are sorted by value (codes are order-preserving), so entries
+  // matching a non-IN condition are contiguous. returns [beginId, endId) of them by
+  // binary search, so that the condition can be evaluated on codes (beginId <= code < endId).
+  // returns false for IN, whose entries are not contiguous (use searchDictionary()).
+  virtual bool searchDictionaryRange (const SearchCond &cond, int &beginId, int &endId) = 0;
 };
 } // fdb
 #endif // STORAGE_FCSTORE_H
@@ -4,6 +4,7 @@
 #include "ffilesig.h"
 #include "fcstore.h"
 #include "fpage.h"
+#include "fcsymbol.h"
 #include "searchcond.h"
 #include "../util/hashmap.h"
 #include <glog/logging.h>
@@ -23,48 +24,44 @@
 namespace fdb {
 
 // pimpl object for FMainMemoryCStore.
+// each column is stored in a separate array of fixed-length (column.maxLength) values.
+// keys are kept in another array to sort the tuples in finishInserts().
 class FMainMemoryCStoreImpl {
 public:
-  FMainMemoryCStoreImpl (TableType type, int maxTuples);
+  FMainMemoryCStoreImpl (TableType type, int64_t maxTuples);
   ~FMainMemoryCStoreImpl();
 
-  TableType _type;
-  int _maxTuples;
-  std::vector<FCStoreColumn> _columns;
-  KeyCompareFunc *_compfunc;
-/*
   bool insert (const void *key, const void *data);
   void finishInserts ();
-  int64_t size () const { return _tuples; }
-  int getKeySize() const { return _keySize; }
-  int getDataSize() const { return _dataSize; }
-  TableType getTableType() const {return _tableType;}
   const void* getBuffer(size_t column) const;
+  FColumnReader* getColumnReader(const std::string &colname);
+  FColumnReader* getColumnReader(size_t colIndex);
 
-  char *_array;
+  TableType _type;
+  int64_t _maxTuples;
   int64_t _tuples;
+  int _keySize;
+  int _dataSize;
+  bool _finishedInserts;
+  std::vector<FCStoreColumn> _columns;
+  KeyCompareFunc _compfunc;
+  char *_keys; // _keySize * _maxTuples. released after sorting.
+  std::vector<char*> _columnArrays; // column.maxLength * _maxTuples for each column
+  std::vector<boost::shared_ptr<FColumnReader> > _columnReaders;
 
-  struct KeyAndIndex {
-    KeyAndIndex() {}
-    KeyAndIndex(const Key &key, size_t ind) : _key(key), _ind(ind) {}
-    Key _key;
-    size_t _ind;
-    inline bool operator==(const KeyAndIndex &other) const {
-      return _key == other._key;
-    }
-    inline bool operator!=(const KeyAndIndex &other) const {
-      return _key != other._key;
-    }
-    inline bool operator<(const KeyAndIndex &other) const {
-      return _key < other._key;
-    }
-  };
-  KeyAndIndex *_sortedKeys; // sorted only when finishInserts() is called
-*/
+private:
+  FMainMemoryCStoreImpl (const FMainMemoryCStoreImpl &); // prohibit copy
 };
 
 class DirectFileOutputStream;
 
+// compares two values of the column. -1/0/1 for left </==/> right.
+// integers are compared by their values, CHAR by memcmp.
+// dictionaries are sorted in this order so that code order equals value order.
+int compareColumnValues (const FCStoreColumn &column, const char *left, const void *right);
+// hash bits for a StringHashMap/StringHashSet expected to hold the given number of entries.
+int getDictionaryHashBits (int64_t entryCount);
+
 // class to write a column file.
 class FCStoreWriter {
 public:
@@ -93,29 +90,54 @@ public:
   void addValueUncompressed (const char* value);
   void finishWritingUncompressed ();
 
+  // for a column group (PAX) file. column must be FCStoreUtil::toColumnGroupFileColumn().
+  // finished by finishWritingUncompressed().
+  void setColumnGroup (const std::vector<FCStoreColumn> &columns, size_t columnIndex);
+  // adds the values of all members at tuple + member.offset.
+  void addTupleColumnGroup (const char* tuple);
+  // adds values[i] as the value of the i-th member.
+  void addValuesColumnGroup (const char* const* values);
+
   void flushCurrentRun ();
   void addValueRLE (const char* value);
   void finishWritingRLE ();
+  // writes index pages for position search after leaf pages (see pageBeginningPositions).
+  void writePositionIndex ();
 
   // sets leafEntrySize/entryPerLeafPage/dictionaryBits according to dictionarySize
   void determineDictionaryBits();
 
   void flushCurrentPackedByte();
   // before calling these, leafEntrySize/entryPerLeafPage/dictionaryBits/dictionaryHashmap have to be set properly
-  void addValueSmallDictionary (const char* value);
+  void addValueSmallDictionary (const char* value) {
+    addCodeSmallDictionary (dictionaryHashmap->find(value));
+  }
   template <typename INT_TYPE>
   void addValueLargeDictionary (const char* value) {
+    addCodeLargeDictionary<INT_TYPE> (dictionaryHashmap->find(value));
+  }
+  // adds a value by its dictionary code (index in dictionaryEntries) without looking up the hashmap.
+  // used when merging fractures, which translates codes by remap tables instead of hashing values.
+  void addDictionaryCode (uint32_t code);
+  void addCodeSmallDictionary (uint32_t code);
+  template <typename INT_TYPE>
+  void addCodeLargeDictionary (uint32_t code) {
     assert (dictionaryBits >= 8);
     assert (currentTuple < tupleCount);
     assert (sizeof(INT_TYPE) == leafEntrySize);
+    assert (code < (uint32_t) dictionarySize);
     prepareForNewPageUniform();
-    // simply write the current data, but in given length of int
-    INT_TYPE foundIndex = dictionaryHashmap->find(value);
-    writeLeafEntry(reinterpret_cast<char*>(&foundIndex));
+    // simply write the code, but in given length of int
+    INT_TYPE codeInType = (INT_TYPE) code;
+    writeLeafEntry(reinterpret_cast<char*>(&codeInType));
   }
   // before calling this, dictionaryEntries have to be set properly
   void finishWritingDictionary ();
 
+  // before calling these, symbolTable has to be built
+  void addValueSymbol (const char* value);
+  void finishWritingSymbol ();
+
 
   int fileId;
   DirectFileOutputStream *fd;
@@ -138,21 +160,34 @@ public:
   int currentRunCount;
   char *currentRunValue;
   bool currentRunValueSet;
-  std::vector<int64_t> pageBeginningPositions;
+  std::vector<int64_t> pageBeginningPositions; // also for Symbol
+
+  // for Column Group
+  std::vector<FCStoreColumn> groupMembers;
+  std::vector<int> groupValueOffsets; // byte offset of each member's values in a page
+
+  // for Symbol Compression
+  FSymbolTable symbolTable;
+  std::vector<unsigned char> symbolEncodeBuffer;
+  int64_t symbolEncodedBytes;
 
   // for Dictionary Encoding
   int dictionarySize;
   int dictionaryBits;
   unsigned char currentPackedByte;
   int currentBitOffset; // for 1bit-4bit dictionary
-  StringHashMap<uint16_t> *dictionaryHashmap;
-  std::vector<const char*> dictionaryEntries;
+  StringHashMap<uint32_t> *dictionaryHashmap; // not needed if values are added by codes
+  std::vector<const char*> dictionaryEntries; // sorted by compareColumnValues(). code = index
   void writeDictionary ();
 
   // for RLE/Dic
   int rootPageStart;
   int rootPageCount;
   int rootPageLevel;
+  // shape of the position index (RLE/Symbol). FDB_MAX_ROOT_PAGES and a full page of entries by default.
+  // set smaller before finishWriting() to get more levels out of a few leaf pages (for testing).
+  int maxRootPages;
+  int entriesPerIndexPage;
 };
 
 // base implementation of FColumnReader.
@@ -170,30 +205,51 @@ public:
   void setSearchRange (const PositionRange &range) {
     _searchRanges.clear();
     _searchRangeSet = true;
+    _sortedInSearchRanges = false;
     _searchRanges.push_back (range);
   }
   void setSearchRanges (const std::vector<PositionRange> &ranges) {
     _searchRangeSet = true;
+    _sortedInSearchRanges = false;
     _searchRanges = ranges;
   }
   void clearSearchRanges () {
     _searchRangeSet = false;
+    _sortedInSearchRanges = false;
+  }
+  void setSortedInSearchRanges () {
+    assert (_searchRangeSet);
+    _sortedInSearchRanges = true;
   }
 
 protected:
   void logSearchCond (const SearchCond &cond) const;
   std::string toDebugStr (const void *key) const;
 
+  // for files with position index pages (RLE/Symbol), where a leaf page has a variable number of tuples.
+  // return the range of pageid for given scan range
+  // beginPageId: the first page which has some tuple in scanRange
+  // endPageId: the first page after beginPage which has no tuple in scanRange
+  std::pair<int, int> getPageRange (const PositionRange &scanRange);
+
+  // returns the id of the last leaf page beginning at or before the position.
+  // descends the index pages from the root with binary search in each page, so
+  // this reads (rootPageLevel + a few root pages) pages. -1 if no such page.
+  int findLeafPageByPosition (int64_t position);
+
   FBufferPool *_bufferpool;
   FCStoreColumn _column;
   FFileSignature _signature;
   bool _searchRangeSet;
+  bool _sortedInSearchRanges;
   std::vector<PositionRange> _searchRanges;
 };
 
 class FColumnReaderImplUncompressed : public FColumnReaderImpl {
 public:
-  FColumnReaderImplUncompressed(FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature);
+  // entriesPerPage and valueOffset are given by FCStoreUtil::getColumnGroupLayout(),
+  // so that a member of a column group reads its own segment in each page.
+  FColumnReaderImplUncompressed(FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature, int entriesPerPage, int valueOffset);
 
   // getPositionRanges() is not implemented for uncompressed column.
   // this will be very inefficient even if implemented for uncompressed column.
@@ -205,8 +261,10 @@ public:
   void getPositionBitmaps (const SearchCond &cond, std::vector<boost::shared_ptr<PositionBitmap> > &positions);
 
   void getDecompressedData (const PositionRange &range, void *buffer, size_t bufferSize);
+  void getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize);
 private:
   int _entriesPerPage;
+  int _valueOffset; // byte offset of the first value of this column in each page
 
   int processPageString(const SearchCond &cond, const char *cursor, size_t tuplesToRead, PositionBitmap *bitmap, int64_t bitmapPageOffset);
 
@@ -293,7 +351,7 @@ private:
 
 class FColumnReaderImplDictionary : public FColumnReaderImpl, virtual public FColumnReaderDictionary {
 public:
-  FColumnReaderImplDictionary(FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature);
+  FColumnReaderImplDictionary(FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature, FDictionaryCache *dictionaryCache = NULL);
 
   // getPositionRanges() is not implemented for dictionary compressed column that is inefficient for RLE.
   // this will be very inefficient even if implemented for dictionary compressed column.
@@ -306,6 +364,7 @@ public:
   void getPositionBitmaps (const SearchCond &cond, std::vector<boost::shared_ptr<PositionBitmap> > &positions);
 
   void getDecompressedData (const PositionRange &range, void *buffer, size_t bufferSize);
+  void getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize);
 
   void getDictionaryCompressedData (const PositionRange &range, void *buffer, size_t bufferSize, int &bitOffset);
   int getDictionaryEntryId (const void *value);
@@ -313,19 +372,26 @@ public:
   int getDictionaryEntryCount ();
   const std::vector<std::string>& getAllDictionaryEntries ();
   std::vector<int> searchDictionary (const SearchCond &cond);
+  bool searchDictionaryRange (const SearchCond &cond, int &beginId, int &endId);
 
 private:
   int _dictionaryBits;
   int _entriesPerPage;
   uint8_t _mask;
-  bool _dictionaryEntriesRead; // kinda works as cache with _dictionaryEntries
-  std::vector<std::string> _dictionaryEntries;
+  bool _dictionaryEntriesRead; // kinda works as cache with _dictionary
+  SharedDictionary _dictionary; // decoded dictionary entries. possibly shared with other readers.
+  FDictionaryCache *_dictionaryCache; // could be NULL
 
+  // reads one dictionary code (index in the page) from a dictionary page.
+  uint32_t readDictionaryCode (const char *page, int64_t index) const;
 
   // for 1bit-4bits.
   int processPageBitOffset(const std::vector<int> &matchingIds, const uint8_t *cursor, int bitOffset, size_t tuplesToRead, PositionBitmap *bitmap, int64_t bitmapPageOffset);
 
-  // for 8bits/16bits.
+  // returns the ID of the first entry not less than value (upper=false) or greater than value (upper=true).
+  int findDictionaryEntry (const void *value, bool upper);
+
+  // for 8bits/16bits/32bits.
   template <typename T>
   int processPageNoBitOffset(const std::vector<int> &matchingIds, const T *cursor, size_t tuplesToRead, PositionBitmap *bitmap, int64_t bitmapPageOffset) {
     assert (matchingIds.size() > 0);
@@ -343,7 +409,7 @@ private:
       const size_t s = matchingIds.size();
       for (size_t i = 0; i < tuplesToRead; ++i, ++cursor) {
         for (size_t j = 0; j < s; ++j) {
-          if (*cursor == matchingIds[j]) {
+          if (*cursor == static_cast<T>(matchingIds[j])) {
             bitmap->setBit(i + bitmapPageOffset);
             ++matchCount;
             break;
@@ -353,18 +419,33 @@ private:
     }
     return matchCount;
   }
+  // for 8bits/16bits/32bits. matching IDs are [beginId, endId) in an order-preserving dictionary.
+  // one unsigned comparison per value no matter how many entries match.
+  template <typename T>
+  int processPageCodeRange(uint32_t beginId, uint32_t endId, const T *cursor, size_t tuplesToRead, PositionBitmap *bitmap, int64_t bitmapPageOffset) {
+    assert (beginId < endId);
+    const uint32_t width = endId - beginId;
+    int matchCount = 0;
+    for (size_t i = 0; i < tuplesToRead; ++i, ++cursor) {
+      if ((uint32_t) (*cursor - beginId) < width) {
+        bitmap->setBit(i + bitmapPageOffset);
+        ++matchCount;
+      }
+    }
+    return matchCount;
+  }
 
   // for 1bit-4bits.
   void readDecompressDictionaryPageBitOffset(int begin, int end, const char *page, char *buffer);
-  // for 8bits/16bits.
+  // for 8bits/16bits/32bits.
   template <typename INT_TYPE>
   void readDecompressDictionaryPageNoBitOffset(int begin, int end, const char *page, char *buffer) {
     for (int i = begin; i < end; ++i) {
       const INT_TYPE *cursor = reinterpret_cast<const INT_TYPE*>(page + sizeof (FPageHeader) + i * sizeof(INT_TYPE));
-      assert (*cursor < _dictionaryEntries.size());
+      assert (*cursor < _dictionary->size());
       INT_TYPE entryId = *cursor;
-      const std::string &entry = _dictionaryEntries[entryId];
-      assert ((int) entry.data() == _column.maxLength);
+      const std::string &entry = (*_dictionary)[entryId];
+      assert ((int) entry.size() == _column.maxLength);
       ::memcpy(buffer, entry.data(), _column.maxLength);
       buffer += _column.maxLength;
     }
@@ -374,7 +455,8 @@ private:
 
 class FColumnReaderImplRLE : public FColumnReaderImpl, virtual public FColumnReaderRLE {
 public:
-  FColumnReaderImplRLE (FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature);
+  // leadingSortColumn: true if the table is sorted by this column first (in ascending order).
+  FColumnReaderImplRLE (FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature, bool leadingSortColumn = false);
 
   void getPositionRanges (const SearchCond &cond, std::vector<PositionRange> &positions);
 
@@ -383,8 +465,11 @@ public:
     assert (false);
     throw std::runtime_error ("not implemented yet!");
   }
+  // matching runs are added as ranges, which become full bitmap containers for long runs.
+  void getPositionBitmap (const SearchCond &cond, CompressedPositionBitmap &positions);
 
   void getDecompressedData (const PositionRange &range, void *buffer, size_t bufferSize);
+  using FColumnReader::getDecompressedData; // default selection version
 
   void getRLECompressedData (const PositionRange &range, std::vector<std::pair<PositionRange, int8_t> > &result) {
     assert (_column.type == COLUMN_INT8);
@@ -406,16 +491,109 @@ public:
     assert (_column.type == COLUMN_CHAR);
     getRLECompressedData (range, &result);
   }
-private:
+protected:
   void getPositionRangesFullscan (const SearchCond &cond, std::vector<PositionRange> &positions);
   void getPositionRangesPartialScan (const SearchCond &cond, std::vector<PositionRange> &positions, const PositionRange &scanRange);
+  // for a column sorted within the scan range. O(log runs) with binary searches.
+  // returns false (does nothing) if the condition can't be answered so (IN).
+  bool getPositionRangesSorted (const SearchCond &cond, std::vector<PositionRange> &positions, const PositionRange &scanRange);
+  bool isSortedInSearchRanges () const {
+    return _leadingSortColumn || (_searchRangeSet && _sortedInSearchRanges);
+  }
 
-  // return the range of pageid for given scan range
-  // beginPageId: the first page which has some tuple in scanRange
-  // endPageId: the first page after beginPage which has no tuple in scanRange
-  std::pair<int, int> getPageRange (const PositionRange &scanRange);
+  // for a column sorted in ascending order within the scan range, returns the first position
+  // in the range whose value is greater than or equal to (inclusive) or greater than (!inclusive)
+  // the value. scanRange.end if no such position. leaf pages in the range are binary-searched
+  // by their first run, so this reads O(log leafPageCount) pages.
+  int64_t findPositionByValue (const void *value, bool inclusive, const PositionRange &scanRange);
+
+  // compares a run value in a leaf page with the given value as the column type.
+  int compareValue (const char *runValue, const void *value) const;
 
   void getRLECompressedData (const PositionRange &range, void *result);
+
+  bool _leadingSortColumn;
+};
+
+// FColumnReader for a symbol-compressed (SYMBOL_COMPRESSED) CHAR column.
+// values have variable lengths, so leaf pages are found by the position index like RLE.
+// EQUAL/IN conditions compare encoded values, and other conditions decode each value.
+class FColumnReaderImplSymbol : public FColumnReaderImpl {
+public:
+  FColumnReaderImplSymbol(FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature);
+
+  // getPositionRanges() is not implemented as for uncompressed column.
+  void getPositionRanges (const SearchCond &cond, std::vector<PositionRange> &positions) {
+    assert (false);
+    throw std::runtime_error ("not implemented yet!");
+  }
+
+  void getPositionBitmaps (const SearchCond &cond, std::vector<boost::shared_ptr<PositionBitmap> > &positions);
+
+  void getDecompressedData (const PositionRange &range, void *buffer, size_t bufferSize);
+  void getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize);
+
+  // reads the symbol table page at first call.
+  const FSymbolTable& getSymbolTable ();
+
+private:
+  // searches values [begin, end) in a leaf page. encodedKeys are keys of EQUAL/IN encoded by the symbol table.
+  int processPage(const SearchCond &cond, const std::vector<std::string> &encodedKeys, const char *page, int begin, int end, PositionBitmap *bitmap, int64_t bitmapPageOffset);
+
+  bool _symbolTableRead;
+  FSymbolTable _symbolTable;
+};
+
+// FColumnReader for a column of FMainMemoryCStore.
+// the values are an uncompressed array in main memory, so every search simply scans the array.
+// sees the tuples inserted so far, even before finishInserts().
+class FColumnReaderImplMainMemory : virtual public FColumnReader {
+public:
+  FColumnReaderImplMainMemory(const FMainMemoryCStoreImpl *cstore, size_t columnIndex);
+
+  const FCStoreColumn& getColumn() const {
+    return _column;
+  }
+  std::string normalize(const std::string &str) const;
+
+  void setSearchRange (const PositionRange &range) {
+    _searchRanges.clear();
+    _searchRangeSet = true;
+    _searchRanges.push_back (range);
+  }
+  void setSearchRanges (const std::vector<PositionRange> &ranges) {
+    _searchRangeSet = true;
+    _searchRanges = ranges;
+  }
+  void clearSearchRanges () {
+    _searchRangeSet = false;
+  }
+
+  // unlike on-disk uncompressed column, both are implemented by scanning.
+  // adjacent matching positions are merged into one range.
+  void getPositionRanges (const SearchCond &cond, std::vector<PositionRange> &positions);
+  void getPositionBitmaps (const SearchCond &cond, std::vector<boost::shared_ptr<PositionBitmap> > &positions);
+  void getPositionBitmap (const SearchCond &cond, CompressedPositionBitmap &positions);
+
+  void getDecompressedData (const PositionRange &range, void *buffer, size_t bufferSize);
+  void getDecompressedData (const FSelection &selection, void *buffer, size_t bufferSize);
+
+private:
+  // search ranges clipped by the current tuple count. whole table if not set.
+  std::vector<PositionRange> getScanRanges () const;
+  bool match (const SearchCond &cond, const char *value) const {
+    if (_column.type == COLUMN_CHAR) {
+      return cond.matchString(value, _column.maxLength);
+    } else {
+      return cond.matchInts(value, _column.maxLength);
+    }
+  }
+
+  const FMainMemoryCStoreImpl *_cstore;
+  size_t _columnIndex;
+  FCStoreColumn _column; // compression is always UNCOMPRESSED
+  bool _searchRangeSet;
+  std::vector<PositionRange> _searchRanges;
 };
 
 } // fdb
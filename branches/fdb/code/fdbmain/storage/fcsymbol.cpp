@@ -0,0 +1,160 @@
+#include "fcsymbol.h"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <utility>
+
+using namespace std;
+
+namespace fdb {
+
+// length of value without trailing NULs
+int getTrimmedLength (const char *value, int length) {
+  while (length > 0 && value[length - 1] == '\0') --length;
+  return length;
+}
+
+// larger gain first. ties are broken by the symbol itself to make the table deterministic.
+bool isBetterSymbolCandidate (const pair<int64_t, string> &left, const pair<int64_t, string> &right) {
+  if (left.first != right.first) return left.first > right.first;
+  return left.second < right.second;
+}
+
+FSymbolTable::FSymbolTable () {
+}
+
+void FSymbolTable::setSymbols (const std::vector<std::string> &symbols) {
+  assert (symbols.size() <= MAX_SYMBOLS);
+  _symbols.resize (symbols.size());
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    assert (symbols[i].size() > 0);
+    assert (symbols[i].size() <= MAX_SYMBOL_LENGTH);
+    ::memset (_symbols[i].bytes, 0, MAX_SYMBOL_LENGTH);
+    ::memcpy (_symbols[i].bytes, symbols[i].data(), symbols[i].size());
+    _symbols[i].length = symbols[i].size();
+  }
+  for (int b = 0; b < 256; ++b) {
+    _codesByFirstByte[b].clear();
+  }
+  for (int length = MAX_SYMBOL_LENGTH; length >= 1; --length) {
+    for (size_t i = 0; i < _symbols.size(); ++i) {
+      if (_symbols[i].length == length) {
+        _codesByFirstByte[(unsigned char) _symbols[i].bytes[0]].push_back ((uint8_t) i);
+      }
+    }
+  }
+}
+
+int FSymbolTable::findLongestSymbol (const char *value, int length) const {
+  const std::vector<uint8_t> &codes = _codesByFirstByte[(unsigned char) value[0]];
+  for (size_t i = 0; i < codes.size(); ++i) {
+    const Symbol &symbol = _symbols[codes[i]];
+    if (symbol.length <= length && ::memcmp (symbol.bytes, value, symbol.length) == 0) {
+      return codes[i];
+    }
+  }
+  return -1;
+}
+
+void FSymbolTable::build (const char *values, int stride, int64_t tuples, int length) {
+  setSymbols (std::vector<std::string>());
+  std::vector<std::string> samples;
+  const int64_t step = std::max<int64_t> (1, tuples / FDB_SYMBOL_SAMPLE_SIZE);
+  for (int64_t i = 0; i < tuples; i += step) {
+    const char *value = values + i * stride;
+    samples.push_back (std::string (value, getTrimmedLength(value, length)));
+  }
+
+  for (int round = 0; round < FDB_SYMBOL_BUILD_ROUNDS; ++round) {
+    std::map<std::string, int64_t> counts;
+    for (size_t i = 0; i < samples.size(); ++i) {
+      const std::string &sample = samples[i];
+      const int sampleLength = sample.size();
+      std::string previous;
+      for (int pos = 0; pos < sampleLength;) {
+        int code = findLongestSymbol (sample.data() + pos, sampleLength - pos);
+        std::string current = code >= 0 ? std::string (_symbols[code].bytes, _symbols[code].length) : sample.substr(pos, 1);
+        ++counts[current];
+        if (current.size() > 1) {
+          ++counts[sample.substr(pos, 1)]; // single bytes are always candidates
+        }
+        if (!previous.empty() && previous.size() + current.size() <= MAX_SYMBOL_LENGTH) {
+          ++counts[previous + current];
+        }
+        previous = current;
+        pos += current.size();
+      }
+    }
+
+    std::vector<pair<int64_t, std::string> > candidates;
+    for (std::map<std::string, int64_t>::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+      candidates.push_back (pair<int64_t, std::string> (it->second * (int64_t) it->first.size(), it->first));
+    }
+    std::sort (candidates.begin(), candidates.end(), isBetterSymbolCandidate);
+    std::vector<std::string> symbols;
+    for (size_t i = 0; i < candidates.size() && symbols.size() < MAX_SYMBOLS; ++i) {
+      symbols.push_back (candidates[i].second);
+    }
+    setSymbols (symbols);
+  }
+}
+
+int FSymbolTable::encode (const char *value, int length, unsigned char *out) const {
+  length = getTrimmedLength (value, length);
+  int outLength = 0;
+  for (int pos = 0; pos < length;) {
+    int code = findLongestSymbol (value + pos, length - pos);
+    if (code >= 0) {
+      out[outLength++] = (unsigned char) code;
+      pos += _symbols[code].length;
+    } else {
+      out[outLength++] = ESCAPE_CODE;
+      out[outLength++] = (unsigned char) value[pos];
+      ++pos;
+    }
+  }
+  assert (outLength <= getMaxEncodedLength(length));
+  return outLength;
+}
+
+std::string FSymbolTable::encode (const char *value, int length) const {
+  std::vector<unsigned char> buffer (getMaxEncodedLength(length) + 1);
+  int encodedLength = encode (value, length, &(buffer[0]));
+  return std::string (reinterpret_cast<const char*>(&(buffer[0])), encodedLength);
+}
+
+void FSymbolTable::decode (const unsigned char *codes, int codeLength, char *out, int length) const {
+  int pos = 0;
+  for (int i = 0; i < codeLength; ++i) {
+    if (codes[i] == ESCAPE_CODE) {
+      assert (i + 1 < codeLength);
+      assert (pos < length);
+      out[pos++] = (char) codes[++i];
+    } else {
+      assert (codes[i] < _symbols.size());
+      const Symbol &symbol = _symbols[codes[i]];
+      assert (pos + symbol.length <= length);
+      ::memcpy (out + pos, symbol.bytes, symbol.length);
+      pos += symbol.length;
+    }
+  }
+  ::memset (out + pos, 0, length - pos);
+}
+
+void FSymbolTable::serialize (char *out) const {
+  for (size_t i = 0; i < _symbols.size(); ++i, out += SERIALIZED_ENTRY_SIZE) {
+    out[0] = (char) _symbols[i].length;
+    ::memcpy (out + 1, _symbols[i].bytes, MAX_SYMBOL_LENGTH);
+  }
+}
+
+void FSymbolTable::deserialize (const char *in, int symbolCount) {
+  std::vector<std::string> symbols;
+  for (int i = 0; i < symbolCount; ++i, in += SERIALIZED_ENTRY_SIZE) {
+    symbols.push_back (std::string (in + 1, (unsigned char) in[0]));
+  }
+  setSymbols (symbols);
+}
+
+} // fdb
@@ -0,0 +1,66 @@
+#ifndef STORAGE_FCSYMBOL_H
+#define STORAGE_FCSYMBOL_H
+
+#include "../configvalues.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace fdb {
+
+// Symbol table to compress strings of a CHAR column (SYMBOL_COMPRESSED), in the style of FSST.
+// A symbol is a substring of 1-8 bytes. A string is encoded into one-byte codes from the
+// beginning, each replacing the longest symbol matching at the current position.
+// A byte not covered by any symbol is written as ESCAPE_CODE followed by the byte itself.
+// Trailing NULs (the padding of CHAR columns) are not encoded.
+// Unlike dictionary encoding, the number of distinct values is unlimited and a wide column
+// with mostly short or repetitive values shrinks to a few bytes per value.
+// The encoding is deterministic, so two values are equal iff their encoded bytes are equal.
+// EQUAL/IN conditions are thus evaluated without decoding values.
+class FSymbolTable {
+public:
+  enum {
+    MAX_SYMBOLS = 255, // codes 0-254
+    MAX_SYMBOL_LENGTH = 8,
+    ESCAPE_CODE = 255,
+    SERIALIZED_ENTRY_SIZE = 1 + MAX_SYMBOL_LENGTH, // <length><bytes padded to 8>
+  };
+
+  FSymbolTable ();
+
+  // builds the symbol table from a sample of values (length bytes each) at values, values + stride, ...
+  // starting from an empty table, each round encodes the sample with the current table and picks
+  // MAX_SYMBOLS symbols with the largest gain (occurrences * length) among the used symbols,
+  // single bytes and concatenations of two adjacent symbols.
+  void build (const char *values, int stride, int64_t tuples, int length);
+
+  // encodes a value of length bytes. out must have at least getMaxEncodedLength(length) bytes.
+  // returns the byte size of the encoded value.
+  int encode (const char *value, int length, unsigned char *out) const;
+  std::string encode (const char *value, int length) const;
+  static int getMaxEncodedLength (int length) { return length * 2; }
+
+  // decodes codeLength bytes of codes to out, padding NULs up to length bytes.
+  void decode (const unsigned char *codes, int codeLength, char *out, int length) const;
+
+  int getSymbolCount () const { return _symbols.size(); }
+  // SERIALIZED_ENTRY_SIZE bytes for each symbol.
+  void serialize (char *out) const;
+  void deserialize (const char *in, int symbolCount);
+
+private:
+  struct Symbol {
+    char bytes[MAX_SYMBOL_LENGTH];
+    int length;
+  };
+  void setSymbols (const std::vector<std::string> &symbols);
+  // returns the code of the longest symbol that is a prefix of value. -1 if none.
+  int findLongestSymbol (const char *value, int length) const;
+
+  std::vector<Symbol> _symbols; // indexed by code
+  // codes of symbols starting with each byte, longer symbols first.
+  std::vector<uint8_t> _codesByFirstByte[256];
+};
+
+} // fdb
+#endif // STORAGE_FCSYMBOL_H
@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <sstream>
@@ -33,6 +34,7 @@ void FSignatureSet::load (const std::string &filepath) {
   _pathMap.clear();
   _lastFileId = 0;
   _dirty = false;
+  ++_version;
 
   StopWatch watch;
   watch.init();
@@ -131,12 +133,14 @@ void FSignatureSet::removeFileSignature (int fileId) {
   _idMap.erase(signature.fileId);
   _pathMap.erase(signature.getFilepath());
   _dirty = true;
+  ++_version;
 }
 void FSignatureSet::removeFileSignature (const std::string &filepath) {
   const FFileSignature& signature = getFileSignature(filepath);
   _idMap.erase(signature.fileId);
   _pathMap.erase(signature.getFilepath());
   _dirty = true;
+  ++_version;
 }
 void FSignatureSet::addFileSignature (const FFileSignature &signature) {
   assert (signature.signatureVersion > 0);
@@ -161,6 +165,7 @@ void FSignatureSet::addFileSignature (const FFileSignature &signature) {
     assert (signature.columnCompression > 0);
   }
   _dirty = true;
+  ++_version;
   assert (_idMap.find (signature.fileId) == _idMap.end());
   assert (_pathMap.find (signature.getFilepath()) == _pathMap.end());
   _idMap.insert(std::pair<int, FFileSignature>(signature.fileId, signature));
@@ -197,7 +202,7 @@ std::vector<FFileSignature> FSignatureSet::getCStoreFileSignatures (const std::s
   bool addsSl = (folder.size() > 0 && folder[folder.size() - 1] != '/');
   for (size_t i = 0; i < columns.size(); ++i) {
     const FCStoreColumn &column = columns[i];
-    string filepath = folder + (addsSl ? "/" : "") + filenamePrefix + "." + column.name + ".db";
+    string filepath = folder + (addsSl ? "/" : "") + filenamePrefix + "." + column.getStorageName() + ".db";
     if (!existsFile(filepath)) {
       LOG(ERROR) << "the file " << filepath << " wasn't found in the database.";
       assert (false);
@@ -207,11 +212,41 @@ std::vector<FFileSignature> FSignatureSet::getCStoreFileSignatures (const std::s
   }
   return ret;
 }
-std::vector<FFileSignature> FSignatureSet::dumpToNewCStoreFiles (const std::string &folder, const std::string &filenamePrefix, const FMainMemoryBTree &btree) {
+std::vector<std::string> FSignatureSet::getWalNames (const std::string &walNamePrefix) const {
+  std::vector<std::string> ret;
+  for (std::map<int, FFileSignature>::const_iterator iter = _idMap.begin(); iter != _idMap.end(); ++iter) {
+    const std::string walName = iter->second.getWalName();
+    if (walName.empty() || walName.compare (0, walNamePrefix.size(), walNamePrefix) != 0) {
+      continue;
+    }
+    if (std::find (ret.begin(), ret.end(), walName) == ret.end()) {
+      ret.push_back (walName); // all column files of a c-store fracture have the same one
+    }
+  }
+  return ret;
+}
+std::vector<FFileSignature> FSignatureSet::dumpToNewCStoreFiles (const std::string &folder, const std::string &filenamePrefix, const FMainMemoryBTree &btree, const FCStoreDumpOptions &options) {
   std::vector<FFileSignature> signatures = createNewCStoreFileSignatures(folder, filenamePrefix, btree.getTableType());
-  FCStoreUtil::dumpToNewCStoreFile(signatures, btree);
+  std::vector<FCStoreColumn> columns = FCStoreUtil::getPhysicalDesignsOf(btree.getTableType());
+  FCStoreUtil::dumpToNewCStoreFile(signatures, btree, options);
   for (size_t i = 0; i < signatures.size(); ++i) {
     assert (signatures[i].totalTupleCount == btree.size());
+    if (FCStoreUtil::getColumnGroupOf(columns, i)[0] != i) {
+      continue; // a later member of a column group. the file is already added.
+    }
+    addFileSignature(signatures[i]);
+  }
+  return signatures;
+}
+std::vector<FFileSignature> FSignatureSet::dumpToNewCStoreFiles (const std::string &folder, const std::string &filenamePrefix, const FMainMemoryCStore &cstore, const FCStoreDumpOptions &options) {
+  std::vector<FFileSignature> signatures = createNewCStoreFileSignatures(folder, filenamePrefix, cstore.getTableType());
+  std::vector<FCStoreColumn> columns = FCStoreUtil::getPhysicalDesignsOf(cstore.getTableType());
+  FCStoreUtil::dumpToNewCStoreFile(signatures, cstore, options);
+  for (size_t i = 0; i < signatures.size(); ++i) {
+    assert (signatures[i].totalTupleCount == cstore.size());
+    if (FCStoreUtil::getColumnGroupOf(columns, i)[0] != i) {
+      continue; // a later member of a column group. the file is already added.
+    }
     addFileSignature(signatures[i]);
   }
   return signatures;
@@ -224,7 +259,15 @@ std::vector<FFileSignature> FSignatureSet::createNewCStoreFileSignatures (const
   for (size_t i = 0; i < columns.size(); ++i) {
     const FCStoreColumn &column = columns[i];
     assert (column.name.size() > 0);
-    string filepath = folder + (addsSl ? "/" : "") + filenamePrefix + "." + column.name + ".db";
+    if (!column.group.empty()) {
+      std::vector<size_t> members = FCStoreUtil::getColumnGroupOf(columns, i);
+      if (members[0] != i) {
+        // columns in a group share one file
+        signatures.push_back (signatures[members[0]]);
+        continue;
+      }
+    }
+    string filepath = folder + (addsSl ? "/" : "") + filenamePrefix + "." + column.getStorageName() + ".db";
 
     if (_pathMap.find(filepath) != _pathMap.end()) {
       LOG(ERROR) << "the file " << filepath << " already exists in the database.";
@@ -265,6 +308,7 @@ void FSignatureSet::debugout() const {
       << "columnMaxLength=" << signature.columnMaxLength << ","
       << "columnOffset=" << signature.columnOffset << ","
       << "columnCompression=" << toCompressionSchemeName(signature.columnCompression) << ","
+      << "walName=" << signature.getWalName() << ","
       << "signatureVersion=" << signature.signatureVersion << ","
       << endl;
   }
@@ -6,6 +6,7 @@
 #include <map>
 #include <stdint.h>
 #include "../configvalues.h"
+#include "fcstore.h"
 #include "ffilesig.h"
 #include "fpage.h"
 
@@ -15,10 +16,9 @@ class FBufferPool;
 
 // represents a configuration file containing the list of file signatures.
 class FMainMemoryBTree;
-struct FCStoreColumn;
 class FSignatureSet {
 public:
-  FSignatureSet() : _lastFileId(0), _dirty (false) {};
+  FSignatureSet() : _lastFileId(0), _dirty (false), _version (0) {};
   ~FSignatureSet();
   void load (const std::string &folder, const std::string &filename);
   void load (const std::string &filepath);
@@ -27,6 +27,9 @@ public:
 
   size_t size () const { return _idMap.size(); }
   bool isDirty () const { return _dirty; }
+  // incremented whenever a signature is added/removed (or reloaded).
+  // used to check whether objects opened from this set (e.g., cached FReadOnlyCStore) are outdated.
+  int64_t getVersion () const { return _version; }
 
   bool existsFile (int fileId) const;
   bool existsFile (const std::string &filepath) const;
@@ -34,6 +37,9 @@ public:
   const FFileSignature& getFileSignature (int fileId) const;
   const FFileSignature& getFileSignature (const std::string &filepath) const;
   std::vector<FFileSignature> getCStoreFileSignatures (const std::string &folder, const std::vector<FCStoreColumn> &columns, const std::string &filenamePrefix) const;
+  // returns the write-ahead logs whose tuples are in some file (FFileSignature::getWalName()),
+  // only the ones starting with the given prefix. each name appears once.
+  std::vector<std::string> getWalNames (const std::string &walNamePrefix) const;
 
   void removeFileSignature (int fileId);
   void removeFileSignature (const std::string &filepath);
@@ -48,10 +54,13 @@ public:
   // basically same as dumpToNewRowStoreFile, but the table is stored as CStore files
   // whose file name prefix is given in the parameter.
   // this is for temp=rowstore, file=cstore pattern.
-  std::vector<FFileSignature> dumpToNewCStoreFiles (const std::string &folder, const std::string &filenamePrefix, const FMainMemoryBTree &btree);
+  // columns are dumped in parallel as specified in options.
+  std::vector<FFileSignature> dumpToNewCStoreFiles (const std::string &folder, const std::string &filenamePrefix, const FMainMemoryBTree &btree, const FCStoreDumpOptions &options = FCStoreDumpOptions());
   std::vector<FFileSignature> createNewCStoreFileSignatures (const std::string &folder, const std::string &filenamePrefix, TableType type);
 
-  // TODO another method for temp=file=cstore pattern
+  // same as above, but for temp=file=cstore pattern.
+  // the on-memory CStore must be finished (see FMainMemoryCStore::finishInserts()).
+  std::vector<FFileSignature> dumpToNewCStoreFiles (const std::string &folder, const std::string &filenamePrefix, const FMainMemoryCStore &cstore, const FCStoreDumpOptions &options = FCStoreDumpOptions());
 
   // output the content of this file to stdout
   void debugout() const;
@@ -61,6 +70,7 @@ private:
   std::map<std::string, FFileSignature> _pathMap; // map<filepath, sig>
   int _lastFileId;
   bool _dirty;
+  int64_t _version;
 };
 
 
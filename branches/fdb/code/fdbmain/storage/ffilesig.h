@@ -11,14 +11,14 @@ namespace fdb {
 #define FFILE_MAX_FILEPATH 128
 
 // increase this number when you add a new property
-#define FFILE_SIGNATURE_CUR_VER 3
+#define FFILE_SIGNATURE_CUR_VER 4
 // signature of one data file
 struct FFileSignature {
   FFileSignature ()
     : signatureVersion(FFILE_SIGNATURE_CUR_VER), fileId(0), totalTupleCount(0),
     pageCount (0), leafPageCount(0), rootPageStart(0), rootPageCount(0), rootPageLevel(0),
     keyEntrySize(0), keyCompareFuncType(KEY_CMP_INVALID), leafEntrySize(0), tableType(TABLE_TYPE_INVALID),
-    columnFile (false), columnIndex(0), columnType(COLUMN_INVALID), columnMaxLength(0), columnOffset(0), columnCompression(COMPRESSION_INVALID), dictionaryBits(0), dictionaryEntryCount (0)
+    columnFile (false), columnIndex(0), columnType(COLUMN_INVALID), columnMaxLength(0), columnOffset(0), columnCompression(COMPRESSION_INVALID), dictionaryBits(0), dictionaryEntryCount (0), walnamelen(0)
   {}
 
   std::string getFilepath () const {
@@ -29,6 +29,14 @@ struct FFileSignature {
     filepathlen = filepath.size();
     ::memcpy (filepathstr, filepath.data(), filepath.size());
   }
+  std::string getWalName () const {
+    return std::string(walnamestr, walnamelen);
+  }
+  void setWalName (const std::string &walName) {
+    assert (walName.size() <= FFILE_MAX_FILEPATH);
+    walnamelen = walName.size();
+    ::memcpy (walnamestr, walName.data(), walName.size());
+  }
 
   int signatureVersion;
   int filepathlen;
@@ -54,6 +62,10 @@ struct FFileSignature {
   CompressionScheme columnCompression; //the type of compression for this column
   int dictionaryBits; // for dictionary compression
   int dictionaryEntryCount; // for dictionary compression
+
+  // for fractures dumped by a family
+  int walnamelen;
+  char walnamestr[FFILE_MAX_FILEPATH]; // file name of the write-ahead log whose tuples are in this file. empty if not logged
 };
 
 } // fdb
@@ -89,6 +89,15 @@ ExtractKeyFromTupleFunc toExtractKeyFromTupleFunc(TableType type) {
   }
 }
 
+NormalizeKeyFunc toNormalizeKeyFunc(TableType type) {
+  switch (type) {
+    case  MV_PROJECTION:
+      return MVProjection::PKType::normalizeKey;
+    default:
+      return NULL;
+  }
+}
+
 KeyCompareFunc toKeyCompareFunc(KeyCompareFuncType type) {
   switch (type) {
     case  INT32_ASC_NODUP:
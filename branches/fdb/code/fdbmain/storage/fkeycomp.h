@@ -2,6 +2,7 @@
 #define STORAGE_FKEYCOMP_H
 
 #include "../configvalues.h"
+#include <stdint.h>
 
 namespace fdb {
 
@@ -22,11 +23,30 @@ typedef int (*DataDataCompareFunc) (const void *data1, const void *data2);
 
 typedef void (*ExtractKeyFromTupleFunc) (const void *tuple, void *key);
 
+// fixed-width binary encoding of a wide key. two normalized keys compare as their
+// original keys do, but with two integer comparisons instead of comparing the whole keys.
+// the original key is kept for output; this is used only to order keys (e.g., sorting).
+struct FNormalizedKey {
+  uint64_t high;
+  uint64_t low;
+  inline bool operator<(const FNormalizedKey &other) const {
+    return high < other.high || (high == other.high && low < other.low);
+  }
+  inline bool operator==(const FNormalizedKey &other) const {
+    return high == other.high && low == other.low;
+  }
+};
+
+// encodes a key. returns false if the key can't be encoded, then the original keys must be compared.
+typedef bool (*NormalizeKeyFunc) (const void *key, FNormalizedKey &normalized);
+
 // returns appropriate key comparison function for given type
 KeyCompareFunc toKeyCompareFunc(KeyCompareFuncType type);
 KeyDataCompareFunc toKeyDataCompareFunc(TableType type);
 DataDataCompareFunc toDataDataCompareFunc(TableType type);
 ExtractKeyFromTupleFunc toExtractKeyFromTupleFunc(TableType type);
+// NULL if the table type has no normalized keys (e.g., its key is already an integer).
+NormalizeKeyFunc toNormalizeKeyFunc(TableType type);
 int toKeySize(TableType type);
 int toDataSize(TableType type);
 
@@ -0,0 +1,77 @@
+#ifndef STORAGE_FMERGE_H
+#define STORAGE_FMERGE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace fdb {
+
+// Loser tree (tournament tree) for k-way merging of sorted sources, e.g., fractures.
+// finds the source with the smallest current value with log2(k) comparisons per output,
+// instead of comparing the current values of all sources.
+// LESS is a functor: less(i, j) returns true if the current value of source i is smaller
+// than that of source j. it's called only for sources that are not finished, so it can be
+// a typed comparator inlined into the merge loop.
+// ties go to the source with the smaller index, so the merge is stable across sources.
+template <typename LESS>
+class FLoserTree {
+public:
+  // finished[i]: true if the i-th source has no value from the beginning.
+  FLoserTree (const std::vector<bool> &finished, const LESS &less) : _less (less) {
+    _leaves = 1;
+    while (_leaves < finished.size()) _leaves *= 2;
+    _finished.assign (_leaves, true); // padded sources are always finished
+    for (size_t i = 0; i < finished.size(); ++i) _finished[i] = finished[i];
+
+    // play the initial tournament bottom up. each node keeps the loser, and passes the winner up.
+    std::vector<size_t> winners (_leaves * 2);
+    _losers.resize (_leaves);
+    for (size_t i = 0; i < _leaves; ++i) winners[_leaves + i] = i;
+    for (size_t node = _leaves - 1; node >= 1; --node) {
+      size_t left = winners[node * 2], right = winners[node * 2 + 1];
+      if (beats (left, right)) {
+        winners[node] = left;
+        _losers[node] = right;
+      } else {
+        winners[node] = right;
+        _losers[node] = left;
+      }
+    }
+    _winner = _leaves == 1 ? 0 : winners[1];
+  }
+
+  // the source with the smallest current value. -1 if all sources are finished.
+  int top () const { return _finished[_winner] ? -1 : (int) _winner; }
+
+  // call after the current value of top() is consumed and the source moved to its next value.
+  // hasNext: false if the source has no more value.
+  void pop (bool hasNext) {
+    assert (!_finished[_winner]);
+    if (!hasNext) _finished[_winner] = true;
+    // replay the matches from the leaf of the winner to the root
+    size_t winner = _winner;
+    for (size_t node = (_leaves + winner) / 2; node >= 1; node /= 2) {
+      if (beats (_losers[node], winner)) std::swap (_losers[node], winner);
+    }
+    _winner = winner;
+  }
+
+private:
+  // true if source a comes before source b.
+  bool beats (size_t a, size_t b) const {
+    if (_finished[a]) return false;
+    if (_finished[b]) return true;
+    return a < b ? !_less (b, a) : _less (a, b);
+  }
+
+  LESS _less;
+  size_t _leaves; // power of 2
+  std::vector<bool> _finished;
+  std::vector<size_t> _losers; // [node], node 1 is the root. node i has children 2i and 2i+1
+  size_t _winner;
+};
+
+} // fdb
+#endif // STORAGE_FMERGE_H
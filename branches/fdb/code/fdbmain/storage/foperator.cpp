@@ -0,0 +1,814 @@
+#include "foperator.h"
+#include "fcaggregate.h"
+#include "fbtree.h"
+#include "searchcond.h"
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <algorithm>
+#include <glog/logging.h>
+
+using namespace std;
+
+namespace fdb {
+
+// ==========================================================================
+//  Internal helpers
+// ==========================================================================
+bool isIntegerColumnType (ColumnType type) {
+  return type == COLUMN_INT8 || type == COLUMN_INT16 || type == COLUMN_INT32 || type == COLUMN_INT64;
+}
+
+// reads an integer value of width bytes.
+inline int64_t readIntValue (const void *data, int width) {
+  switch (width) {
+  case 1: return *reinterpret_cast<const int8_t*>(data);
+  case 2: return *reinterpret_cast<const int16_t*>(data);
+  case 4: return *reinterpret_cast<const int32_t*>(data);
+  case 8: return *reinterpret_cast<const int64_t*>(data);
+  default:
+    LOG(ERROR) << "invalid integer width:" << width;
+    assert (false);
+    throw std::exception();
+  }
+}
+
+// writes an integer value as width bytes.
+inline void writeIntValue (int64_t value, int width, void *data) {
+  switch (width) {
+  case 1: *reinterpret_cast<int8_t*>(data) = (int8_t) value; break;
+  case 2: *reinterpret_cast<int16_t*>(data) = (int16_t) value; break;
+  case 4: *reinterpret_cast<int32_t*>(data) = (int32_t) value; break;
+  case 8: *reinterpret_cast<int64_t*>(data) = value; break;
+  default:
+    LOG(ERROR) << "invalid integer width:" << width;
+    assert (false);
+    throw std::exception();
+  }
+}
+
+template <typename INT_TYPE>
+void widenValues (const char *buffer, size_t count, int64_t *values) {
+  const INT_TYPE *typed = reinterpret_cast<const INT_TYPE*>(buffer);
+  for (size_t i = 0; i < count; ++i) values[i] = typed[i];
+}
+void widenValues (const char *buffer, size_t count, int width, int64_t *values) {
+  switch (width) {
+  case 1: widenValues<int8_t> (buffer, count, values); break;
+  case 2: widenValues<int16_t> (buffer, count, values); break;
+  case 4: widenValues<int32_t> (buffer, count, values); break;
+  case 8: widenValues<int64_t> (buffer, count, values); break;
+  default:
+    LOG(ERROR) << "invalid integer width:" << width;
+    assert (false);
+    throw std::exception();
+  }
+}
+
+int getBatchColumnIndex (const FBatch &batch, const std::string &name) {
+  int index = batch.getColumnIndex(name);
+  if (index < 0) {
+    LOG(ERROR) << "column not found in the batch:" << name;
+    assert (false);
+    throw std::exception();
+  }
+  return index;
+}
+
+// ==========================================================================
+//  Batches
+// ==========================================================================
+FBatchColumn::FBatchColumn (const FCStoreColumn &column)
+  : name (column.name), isString (!isIntegerColumnType(column.type)), width (column.maxLength), dictionary (NULL) {
+}
+
+int FBatch::getColumnIndex (const std::string &name) const {
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (columns[i].name == name) return i;
+  }
+  return -1;
+}
+
+void FBatch::compact (const std::vector<uint32_t> &indexes) {
+  assert (indexes.size() <= count);
+  for (size_t i = 0; i < columns.size(); ++i) {
+    FBatchColumn &column = columns[i];
+    if (column.hasInts()) {
+      assert (column.ints.size() >= count);
+      for (size_t j = 0; j < indexes.size(); ++j) {
+        column.ints[j] = column.ints[indexes[j]];
+      }
+      column.ints.resize (indexes.size());
+    } else {
+      assert (column.bytes.size() >= count * column.width);
+      for (size_t j = 0; j < indexes.size(); ++j) {
+        ::memmove (&(column.bytes[j * column.width]), &(column.bytes[indexes[j] * column.width]), column.width);
+      }
+      column.bytes.resize (indexes.size() * column.width);
+    }
+  }
+  count = indexes.size();
+}
+
+void FOperatorStats::add (const FOperatorStats &other) {
+  batches += other.batches;
+  tuplesIn += other.tuplesIn;
+  tuplesOut += other.tuplesOut;
+}
+std::string FOperatorStats::toString () const {
+  stringstream str;
+  str << "batches=" << batches << ", in=" << tuplesIn << ", out=" << tuplesOut;
+  return str.str();
+}
+
+// ==========================================================================
+//  Operator base
+// ==========================================================================
+FOperator::FOperator (const std::string &name, FOperator *next) : _name (name), _next (next) {
+}
+
+void FOperator::push (FBatch &batch) {
+  ++_stats.batches;
+  _stats.tuplesIn += batch.count;
+  if (!process (batch) || batch.count == 0) return;
+  _stats.tuplesOut += batch.count;
+  if (_next != NULL) {
+    _next->push (batch);
+  }
+}
+
+void FOperator::finish () {
+  if (_next != NULL) {
+    _next->finish ();
+  }
+}
+
+std::string FOperator::describe () const {
+  stringstream str;
+  for (const FOperator *op = this; op != NULL; op = op->_next) {
+    str << "  " << op->_name << ": " << op->_stats.toString() << endl;
+  }
+  return str.str();
+}
+
+// ==========================================================================
+//  Filter/Project
+// ==========================================================================
+FFilterOperator::FFilterOperator (const FCStoreColumn &column, const SearchCond &cond, FOperator *next)
+  : FOperator ("Filter(" + column.name + " " + toSearchCondOp(cond.type) + ")", next), _column (column), _cond (cond),
+  _from (std::numeric_limits<int64_t>::min()), _to (std::numeric_limits<int64_t>::max()) {
+  if (!isIntegerColumnType(column.type)) return;
+  const int width = column.maxLength;
+  switch (cond.type) {
+  case SCT_EQUAL: _from = _to = readIntValue (cond.key, width); break;
+  case SCT_LT: _to = readIntValue (cond.key, width) - 1; break;
+  case SCT_GT: _from = readIntValue (cond.key, width) + 1; break;
+  case SCT_LTEQ: _to = readIntValue (cond.key, width); break;
+  case SCT_GTEQ: _from = readIntValue (cond.key, width); break;
+  case SCT_BETWEEN:
+    _from = readIntValue (cond.key, width);
+    _to = readIntValue (cond.key2, width);
+    break;
+  case SCT_IN:
+    for (size_t i = 0; i < cond.keys.size(); ++i) {
+      _inValues.push_back (readIntValue (cond.keys[i], width));
+    }
+    break;
+  default:
+    LOG(ERROR) << "unexpected search condition type:" << cond.type;
+    assert (false);
+    throw std::exception();
+  }
+}
+
+bool FFilterOperator::process (FBatch &batch) {
+  const FBatchColumn &column = batch.columns[getBatchColumnIndex(batch, _column.name)];
+  _selected.clear();
+  if (!column.isString) {
+    const int64_t *values = &(column.ints[0]);
+    if (_cond.type == SCT_IN) {
+      for (size_t i = 0; i < batch.count; ++i) {
+        for (size_t j = 0; j < _inValues.size(); ++j) {
+          if (values[i] == _inValues[j]) {
+            _selected.push_back (i);
+            break;
+          }
+        }
+      }
+    } else {
+      for (size_t i = 0; i < batch.count; ++i) {
+        if (values[i] >= _from && values[i] <= _to) _selected.push_back (i);
+      }
+    }
+  } else {
+    if (column.dictionary != NULL) {
+      LOG(ERROR) << "filtering on dictionary codes is not supported. evaluate it in FColumnScan. column=" << column.name;
+      assert (false);
+      throw std::exception();
+    }
+    const char *values = &(column.bytes[0]);
+    for (size_t i = 0; i < batch.count; ++i) {
+      if (_cond.matchString (values + i * column.width, column.width)) _selected.push_back (i);
+    }
+  }
+  if (_selected.size() < batch.count) {
+    batch.compact (_selected);
+  }
+  return true;
+}
+
+std::string toArithmeticString (FArithmetic arithmetic) {
+  switch (arithmetic) {
+  case ARITHMETIC_ADD: return "+";
+  case ARITHMETIC_SUBTRACT: return "-";
+  case ARITHMETIC_MULTIPLY: return "*";
+  default: return "?";
+  }
+}
+FProjectOperator::FProjectOperator (const std::string &name, const std::string &left, FArithmetic arithmetic, const std::string &right, FOperator *next)
+  : FOperator ("Project(" + name + "=" + left + toArithmeticString(arithmetic) + right + ")", next),
+  _columnName (name), _left (left), _arithmetic (arithmetic), _right (right) {
+}
+
+bool FProjectOperator::process (FBatch &batch) {
+  int index = batch.getColumnIndex(_columnName);
+  if (index < 0) {
+    batch.columns.push_back (FBatchColumn (_columnName));
+    index = batch.columns.size() - 1;
+  }
+  const FBatchColumn &left = batch.columns[getBatchColumnIndex(batch, _left)];
+  const FBatchColumn &right = batch.columns[getBatchColumnIndex(batch, _right)];
+  assert (!left.isString && !right.isString);
+  FBatchColumn &result = batch.columns[index];
+  result.ints.resize (batch.count);
+  const int64_t *l = &(left.ints[0]), *r = &(right.ints[0]);
+  int64_t *out = &(result.ints[0]);
+  switch (_arithmetic) {
+  case ARITHMETIC_ADD:
+    for (size_t i = 0; i < batch.count; ++i) out[i] = l[i] + r[i];
+    break;
+  case ARITHMETIC_SUBTRACT:
+    for (size_t i = 0; i < batch.count; ++i) out[i] = l[i] - r[i];
+    break;
+  case ARITHMETIC_MULTIPLY:
+    for (size_t i = 0; i < batch.count; ++i) out[i] = l[i] * r[i];
+    break;
+  default:
+    assert (false);
+  }
+  return true;
+}
+
+// ==========================================================================
+//  Aggregate
+// ==========================================================================
+std::string toAggregateName (const std::vector<std::string> &groupColumns, const std::string &valueColumn) {
+  stringstream str;
+  str << "Aggregate(SUM(" << valueColumn << ")";
+  for (size_t i = 0; i < groupColumns.size(); ++i) {
+    str << (i == 0 ? " GROUP BY " : ",") << groupColumns[i];
+  }
+  str << ")";
+  return str.str();
+}
+FAggregateOperator::FAggregateOperator (const std::vector<std::string> &groupColumns, const std::string &valueColumn)
+  : FOperator (toAggregateName(groupColumns, valueColumn), NULL),
+  _groupColumnNames (groupColumns), _valueColumn (valueColumn), _initialized (false), _keyWidth (0), _total (0),
+  _dense (false), _denseGroupCount (0) {
+}
+
+void FAggregateOperator::setGroupDomain (const std::string &column, int64_t min, int64_t max) {
+  assert (!_initialized);
+  assert (min <= max);
+  _domainHints[column] = std::pair<int64_t, int64_t> (min, max);
+}
+
+void FAggregateOperator::init (const FBatch &batch) {
+  _keyWidth = 0;
+  _dense = !_groupColumnNames.empty();
+  int64_t groups = 1;
+  for (size_t i = 0; i < _groupColumnNames.size(); ++i) {
+    FBatchColumn column = batch.columns[getBatchColumnIndex(batch, _groupColumnNames[i])];
+    column.ints.clear();
+    column.bytes.clear();
+    _groupColumns.push_back (column);
+    _keyOffsets.push_back (_keyWidth);
+    _keyWidth += column.dictionary != NULL ? sizeof(uint32_t) : column.width;
+
+    std::map<std::string, std::pair<int64_t, int64_t> >::const_iterator hint = _domainHints.find (column.name);
+    int64_t min = 0, size = 0; // size 0: unknown domain
+    if (column.dictionary != NULL) {
+      size = column.dictionary->size();
+    } else if (column.isString) {
+    } else if (hint != _domainHints.end()) {
+      min = hint->second.first;
+      size = hint->second.second - hint->second.first + 1;
+    } else if (column.width == 1) {
+      min = -128;
+      size = 256;
+    }
+    if (size <= 0 || size > FDB_DENSE_GROUP_MAX || groups * size > FDB_DENSE_GROUP_MAX) _dense = false;
+    if (_dense) groups *= size;
+    _domainMins.push_back (min);
+    _domainSizes.push_back (size);
+  }
+  if (_dense) {
+    int64_t stride = 1;
+    for (size_t g = 0; g < _groupColumns.size(); ++g) {
+      _strides.push_back (stride);
+      stride *= _domainSizes[g];
+    }
+    _denseSums.assign (groups, 0);
+    _denseUsed.assign (groups, 0);
+  }
+  if (_keyWidth > 0) _hashGroups.reset (_keyWidth);
+  _initialized = true;
+}
+
+bool FAggregateOperator::computeDenseIndexes (const FBatch &batch) {
+  _groupIndexes.assign (batch.count, 0);
+  uint32_t *indexes = &(_groupIndexes[0]);
+  for (size_t g = 0; g < _groupColumns.size(); ++g) {
+    const FBatchColumn &column = batch.columns[getBatchColumnIndex(batch, _groupColumns[g].name)];
+    assert (column.hasInts());
+    const int64_t *ints = &(column.ints[0]);
+    const int64_t min = _domainMins[g];
+    const uint64_t size = _domainSizes[g];
+    const uint32_t stride = _strides[g];
+    for (size_t i = 0; i < batch.count; ++i) {
+      uint64_t ordinal = ints[i] - min;
+      if (ordinal >= size) return false;
+      indexes[i] += ordinal * stride;
+    }
+  }
+  return true;
+}
+
+void FAggregateOperator::packDenseKey (size_t index, char *key) const {
+  for (size_t g = 0; g < _groupColumns.size(); ++g) {
+    int64_t value = _domainMins[g] + (int64_t) ((index / _strides[g]) % _domainSizes[g]);
+    if (_groupColumns[g].dictionary != NULL) {
+      *reinterpret_cast<uint32_t*>(key + _keyOffsets[g]) = (uint32_t) value;
+    } else {
+      writeIntValue (value, _groupColumns[g].width, key + _keyOffsets[g]);
+    }
+  }
+}
+
+void FAggregateOperator::switchToHash () {
+  assert (_dense);
+  VLOG(1) << "a group value out of the domain. moving " << _denseGroupCount << " groups to the hash table: " << _name;
+  std::vector<char> key (_keyWidth);
+  for (size_t i = 0; i < _denseSums.size(); ++i) {
+    if (!_denseUsed[i]) continue;
+    packDenseKey (i, &(key[0]));
+    _hashGroups.get (&(key[0])) += _denseSums[i];
+  }
+  _dense = false;
+  std::vector<int64_t>().swap (_denseSums);
+  std::vector<char>().swap (_denseUsed);
+  _denseGroupCount = 0;
+}
+
+bool FAggregateOperator::process (FBatch &batch) {
+  if (!_initialized) init (batch);
+  const FBatchColumn &valueColumn = batch.columns[getBatchColumnIndex(batch, _valueColumn)];
+  assert (!valueColumn.isString);
+  const int64_t *values = &(valueColumn.ints[0]);
+  if (_groupColumns.empty()) {
+    for (size_t i = 0; i < batch.count; ++i) _total += values[i];
+    return false;
+  }
+  for (size_t g = 0; g < _groupColumns.size(); ++g) {
+    const FBatchColumn &column = batch.columns[getBatchColumnIndex(batch, _groupColumns[g].name)];
+    if (column.dictionary != _groupColumns[g].dictionary) {
+      LOG(ERROR) << "dictionary codes of different dictionaries can't be aggregated together. column=" << column.name;
+      assert (false);
+      throw std::exception();
+    }
+  }
+
+  if (_dense && !computeDenseIndexes (batch)) switchToHash ();
+  if (_dense) {
+    const uint32_t *indexes = &(_groupIndexes[0]);
+    for (size_t i = 0; i < batch.count; ++i) {
+      _total += values[i];
+      _denseSums[indexes[i]] += values[i];
+      if (!_denseUsed[indexes[i]]) {
+        _denseUsed[indexes[i]] = 1;
+        ++_denseGroupCount;
+      }
+    }
+    return false;
+  }
+
+  // pack keys column by column
+  _keyBuffer.resize (batch.count * _keyWidth);
+  char *keys = &(_keyBuffer[0]);
+  for (size_t g = 0; g < _groupColumns.size(); ++g) {
+    const FBatchColumn &column = batch.columns[getBatchColumnIndex(batch, _groupColumns[g].name)];
+    char *key = keys + _keyOffsets[g];
+    if (column.dictionary != NULL) {
+      for (size_t i = 0; i < batch.count; ++i, key += _keyWidth) {
+        *reinterpret_cast<uint32_t*>(key) = (uint32_t) column.ints[i];
+      }
+    } else if (!column.isString) {
+      for (size_t i = 0; i < batch.count; ++i, key += _keyWidth) {
+        writeIntValue (column.ints[i], column.width, key);
+      }
+    } else {
+      for (size_t i = 0; i < batch.count; ++i, key += _keyWidth) {
+        ::memcpy (key, &(column.bytes[i * column.width]), column.width);
+      }
+    }
+  }
+  // group values of RLE sort columns change only at run boundaries, so adjacent tuples
+  // mostly share the key. values are summed per run of equal keys, and the group
+  // is looked up once per run.
+  size_t runBegin = 0;
+  int64_t runSum = 0;
+  for (size_t i = 0; i < batch.count; ++i) {
+    _total += values[i];
+    if (i > runBegin && ::memcmp (keys + i * _keyWidth, keys + runBegin * _keyWidth, _keyWidth) != 0) {
+      _hashGroups.get (keys + runBegin * _keyWidth) += runSum;
+      runBegin = i;
+      runSum = 0;
+    }
+    runSum += values[i];
+  }
+  _hashGroups.get (keys + runBegin * _keyWidth) += runSum;
+  return false;
+}
+
+size_t FAggregateOperator::getGroupCount () const {
+  return _dense ? _denseGroupCount : _hashGroups.size();
+}
+
+void FAggregateOperator::collectGroups (std::vector<char> &packedKeys, std::vector<int64_t> &sums) const {
+  if (_dense) {
+    packedKeys.resize (_denseGroupCount * _keyWidth);
+    for (size_t i = 0; i < _denseSums.size(); ++i) {
+      if (!_denseUsed[i]) continue;
+      packDenseKey (i, &(packedKeys[sums.size() * _keyWidth]));
+      sums.push_back (_denseSums[i]);
+    }
+  } else {
+    for (size_t i = 0; i < _hashGroups.size(); ++i) {
+      packedKeys.insert (packedKeys.end(), _hashGroups.getKey(i), _hashGroups.getKey(i) + _keyWidth);
+      sums.push_back (_hashGroups.getSum(i));
+    }
+  }
+}
+
+std::string FAggregateOperator::decodeGroupValue (size_t group, const char *packed) const {
+  const FBatchColumn &column = _groupColumns[group];
+  const char *value = packed + _keyOffsets[group];
+  if (column.dictionary != NULL) {
+    uint32_t code = *reinterpret_cast<const uint32_t*>(value);
+    assert (code < column.dictionary->size());
+    return (*column.dictionary)[code];
+  }
+  return std::string (value, column.width);
+}
+
+void FAggregateOperator::getGroups (std::vector<std::vector<std::string> > &keys, std::vector<int64_t> &sums) const {
+  std::vector<char> packedKeys;
+  std::vector<int64_t> groupSums;
+  collectGroups (packedKeys, groupSums);
+  for (size_t i = 0; i < groupSums.size(); ++i) {
+    std::vector<std::string> key;
+    for (size_t g = 0; g < _groupColumns.size(); ++g) {
+      key.push_back (decodeGroupValue (g, &(packedKeys[i * _keyWidth])));
+    }
+    keys.push_back (key);
+    sums.push_back (groupSums[i]);
+  }
+}
+
+void FAggregateOperator::emit (FOperator &next) const {
+  std::vector<char> packedKeys;
+  std::vector<int64_t> sums;
+  collectGroups (packedKeys, sums);
+  FBatch batch;
+  for (size_t g = 0; g < _groupColumns.size(); ++g) {
+    FBatchColumn column = _groupColumns[g];
+    column.dictionary = NULL; // decoded
+    batch.columns.push_back (column);
+  }
+  batch.columns.push_back (FBatchColumn (_valueColumn));
+  for (size_t group = 0; group < sums.size();) {
+    batch.count = 0;
+    for (size_t i = 0; i < batch.columns.size(); ++i) {
+      batch.columns[i].ints.clear();
+      batch.columns[i].bytes.clear();
+    }
+    for (; group < sums.size() && batch.count < FDB_VECTOR_SIZE; ++group, ++batch.count) {
+      for (size_t g = 0; g < _groupColumns.size(); ++g) {
+        FBatchColumn &column = batch.columns[g];
+        std::string value = decodeGroupValue (g, &(packedKeys[group * _keyWidth]));
+        if (column.isString) {
+          assert (value.size() == (size_t) column.width);
+          column.bytes.insert (column.bytes.end(), value.begin(), value.end());
+        } else {
+          column.ints.push_back (readIntValue (value.data(), column.width));
+        }
+      }
+      batch.columns.back().ints.push_back (sums[group]);
+    }
+    next.push (batch);
+  }
+  next.finish ();
+}
+
+// ==========================================================================
+//  Sort/Limit
+// ==========================================================================
+std::string toSortLimitName (const std::vector<std::pair<std::string, bool> > &orders, size_t limit) {
+  stringstream str;
+  str << "SortLimit(";
+  for (size_t i = 0; i < orders.size(); ++i) {
+    str << (i == 0 ? "" : ",") << orders[i].first << (orders[i].second ? " ASC" : " DESC");
+  }
+  if (limit > 0) str << " LIMIT " << limit;
+  str << ")";
+  return str.str();
+}
+FSortLimitOperator::FSortLimitOperator (const std::vector<std::pair<std::string, bool> > &orders, size_t limit)
+  : FOperator (toSortLimitName(orders, limit), NULL), _orders (orders), _limit (limit) {
+}
+
+bool FSortLimitOperator::process (FBatch &batch) {
+  if (_result.columns.empty()) {
+    for (size_t i = 0; i < batch.columns.size(); ++i) {
+      FBatchColumn column = batch.columns[i];
+      column.ints.clear();
+      column.bytes.clear();
+      _result.columns.push_back (column);
+    }
+  }
+  assert (_result.columns.size() == batch.columns.size());
+  for (size_t i = 0; i < batch.columns.size(); ++i) {
+    const FBatchColumn &column = batch.columns[i];
+    FBatchColumn &result = _result.columns[i];
+    assert (result.name == column.name);
+    if (column.hasInts()) {
+      result.ints.insert (result.ints.end(), column.ints.begin(), column.ints.begin() + batch.count);
+    } else {
+      result.bytes.insert (result.bytes.end(), column.bytes.begin(), column.bytes.begin() + batch.count * column.width);
+    }
+  }
+  _result.count += batch.count;
+  return false;
+}
+
+// compares two tuples of a batch by the sort columns.
+struct SortLimitComparator {
+  SortLimitComparator (const FBatch &batch_, const std::vector<std::pair<int, bool> > &orders_) : batch(batch_), orders(orders_) {}
+  bool operator() (uint32_t left, uint32_t right) const {
+    for (size_t i = 0; i < orders.size(); ++i) {
+      const FBatchColumn &column = batch.columns[orders[i].first];
+      int cmp;
+      if (column.hasInts()) {
+        cmp = column.ints[left] < column.ints[right] ? -1 : (column.ints[left] > column.ints[right] ? 1 : 0);
+      } else {
+        cmp = ::memcmp (&(column.bytes[left * column.width]), &(column.bytes[right * column.width]), column.width);
+      }
+      if (cmp != 0) return orders[i].second ? cmp < 0 : cmp > 0;
+    }
+    return left < right; // stable
+  }
+  const FBatch &batch;
+  const std::vector<std::pair<int, bool> > &orders;
+};
+
+void FSortLimitOperator::finish () {
+  std::vector<std::pair<int, bool> > orders;
+  for (size_t i = 0; i < _orders.size(); ++i) {
+    int index = getBatchColumnIndex(_result, _orders[i].first);
+    if (_result.columns[index].dictionary != NULL) {
+      LOG(ERROR) << "sorting by dictionary codes is not supported. column=" << _orders[i].first;
+      assert (false);
+      throw std::exception();
+    }
+    orders.push_back (std::pair<int, bool> (index, _orders[i].second));
+  }
+  std::vector<uint32_t> indexes (_result.count);
+  for (size_t i = 0; i < _result.count; ++i) indexes[i] = i;
+  SortLimitComparator comparator (_result, orders);
+  if (_limit > 0 && _limit < indexes.size()) {
+    std::partial_sort (indexes.begin(), indexes.begin() + _limit, indexes.end(), comparator);
+    indexes.resize (_limit);
+  } else {
+    std::sort (indexes.begin(), indexes.end(), comparator);
+  }
+
+  FBatch sorted;
+  for (size_t i = 0; i < _result.columns.size(); ++i) {
+    const FBatchColumn &column = _result.columns[i];
+    FBatchColumn result = column;
+    if (column.hasInts()) {
+      for (size_t j = 0; j < indexes.size(); ++j) result.ints[j] = column.ints[indexes[j]];
+      result.ints.resize (indexes.size());
+    } else {
+      for (size_t j = 0; j < indexes.size(); ++j) {
+        ::memcpy (&(result.bytes[j * column.width]), &(column.bytes[indexes[j] * column.width]), column.width);
+      }
+      result.bytes.resize (indexes.size() * column.width);
+    }
+    sorted.columns.push_back (result);
+  }
+  sorted.count = indexes.size();
+  _result = sorted;
+  _stats.tuplesOut = _result.count;
+}
+
+// ==========================================================================
+//  Sources
+// ==========================================================================
+// reads the values of an RLE column at the positions (all positions of block if empty)
+// from the runs of the block. runs are never expanded.
+template <typename VALUE_TYPE>
+void readRunsAsInts (FColumnReaderRLE *reader, const PositionRange &block, const std::vector<int64_t> &positions, size_t count, std::vector<int64_t> &values) {
+  std::vector<std::pair<PositionRange, VALUE_TYPE> > runs;
+  reader->getRLECompressedData (block, runs);
+  values.resize (count);
+  size_t run = 0;
+  for (size_t j = 0; j < count; ++j) {
+    const int64_t pos = positions.empty() ? block.begin + j : positions[j];
+    while (runs[run].first.end <= pos) ++run;
+    assert (run < runs.size() && runs[run].first.begin <= pos);
+    values[j] = runs[run].second;
+  }
+}
+void readRuns (FColumnReaderRLE *reader, const PositionRange &block, const std::vector<int64_t> &positions, size_t count, FBatchColumn &column) {
+  switch (reader->getColumn().type) {
+  case COLUMN_INT8: readRunsAsInts<int8_t> (reader, block, positions, count, column.ints); return;
+  case COLUMN_INT16: readRunsAsInts<int16_t> (reader, block, positions, count, column.ints); return;
+  case COLUMN_INT32: readRunsAsInts<int32_t> (reader, block, positions, count, column.ints); return;
+  case COLUMN_INT64: readRunsAsInts<int64_t> (reader, block, positions, count, column.ints); return;
+  default: break;
+  }
+  std::vector<std::pair<PositionRange, std::string> > runs;
+  reader->getRLECompressedData (block, runs);
+  column.bytes.resize (count * column.width);
+  size_t run = 0;
+  for (size_t j = 0; j < count; ++j) {
+    const int64_t pos = positions.empty() ? block.begin + j : positions[j];
+    while (runs[run].first.end <= pos) ++run;
+    assert (run < runs.size() && runs[run].first.begin <= pos);
+    assert (runs[run].second.size() == (size_t) column.width);
+    ::memcpy (&(column.bytes[j * column.width]), runs[run].second.data(), column.width);
+  }
+}
+
+FColumnScan::FColumnScan (const std::vector<FColumnReader*> &readers, const std::vector<bool> &asCodes, const std::vector<ColumnPredicate> &predicates)
+  : _readers (readers), _predicates (predicates) {
+  assert (readers.size() == asCodes.size());
+  size_t maxWidth = 0;
+  for (size_t i = 0; i < readers.size(); ++i) {
+    FBatchColumn column (readers[i]->getColumn());
+    FColumnReaderDictionary *codeReader = NULL;
+    if (asCodes[i] && column.isString) {
+      codeReader = dynamic_cast<FColumnReaderDictionary*>(readers[i]);
+    }
+    if (codeReader != NULL) {
+      column.dictionary = &(codeReader->getAllDictionaryEntries());
+    }
+    FColumnReaderRLE *runReader = NULL;
+    if (codeReader == NULL && readers[i]->getColumn().compression == RLE_COMPRESSED) {
+      runReader = dynamic_cast<FColumnReaderRLE*>(readers[i]);
+    }
+    _codeReaders.push_back (codeReader);
+    _runReaders.push_back (runReader);
+    _columns.push_back (column);
+    maxWidth = std::max<size_t> (maxWidth, column.width);
+  }
+  _buffer.resize (FDB_VECTOR_SIZE * maxWidth + 1);
+  _codes.resize (FDB_VECTOR_SIZE);
+}
+
+void FColumnScan::scan (const PositionRange &range, FOperator &next) {
+  for (int64_t begin = range.begin; begin < range.end; begin += FDB_VECTOR_SIZE) {
+    const PositionRange block (begin, std::min<int64_t> (range.end, begin + FDB_VECTOR_SIZE));
+    const size_t length = block.end - block.begin;
+    FSelection selection (block);
+    FSelectionPlanner::applyPredicates (_predicates, selection);
+    const size_t count = selection.count();
+    ++_stats.batches;
+    _stats.tuplesIn += length;
+    _stats.tuplesOut += count;
+    if (count == 0) continue;
+
+    _positions.clear();
+    if (count < length) {
+      selection.getPositions (_positions);
+    }
+    _batch.columns.resize (_columns.size()); // drop columns appended by operators
+    _batch.count = count;
+    for (size_t i = 0; i < _columns.size(); ++i) {
+      FBatchColumn &column = _batch.columns[i];
+      if (column.name != _columns[i].name) {
+        column = _columns[i];
+      }
+      if (_codeReaders[i] != NULL) {
+        FColumnAggregator::readBlockCodes (_codeReaders[i], block, &(_codes[0]));
+        column.ints.resize (count);
+        if (_positions.empty()) {
+          for (size_t j = 0; j < count; ++j) column.ints[j] = _codes[j];
+        } else {
+          for (size_t j = 0; j < count; ++j) column.ints[j] = _codes[_positions[j] - block.begin];
+        }
+        continue;
+      }
+      if (_runReaders[i] != NULL) {
+        readRuns (_runReaders[i], block, _positions, count, column);
+        continue;
+      }
+      const size_t bytes = count * column.width;
+      _readers[i]->getDecompressedData (selection, &(_buffer[0]), bytes);
+      if (column.isString) {
+        column.bytes.assign (_buffer.begin(), _buffer.begin() + bytes);
+      } else {
+        column.ints.resize (count);
+        widenValues (&(_buffer[0]), count, column.width, &(column.ints[0]));
+      }
+    }
+    next.push (_batch);
+  }
+}
+
+FTupleBatcher::FTupleBatcher (const std::vector<FCStoreColumn> &columns, FOperator &next)
+  : _columns (columns), _next (next) {
+  for (size_t i = 0; i < columns.size(); ++i) {
+    _batch.columns.push_back (FBatchColumn (columns[i]));
+  }
+}
+
+void FTupleBatcher::add (const void *tuple) {
+  const char *data = reinterpret_cast<const char*>(tuple);
+  const size_t index = _batch.count;
+  for (size_t i = 0; i < _columns.size(); ++i) {
+    const FCStoreColumn &column = _columns[i];
+    FBatchColumn &batchColumn = _batch.columns[i];
+    if (batchColumn.isString) {
+      batchColumn.bytes.resize ((index + 1) * column.maxLength);
+      ::memcpy (&(batchColumn.bytes[index * column.maxLength]), data + column.offset, column.maxLength);
+    } else {
+      batchColumn.ints.resize (index + 1);
+      batchColumn.ints[index] = readIntValue (data + column.offset, column.maxLength);
+    }
+  }
+  ++_batch.count;
+  ++_stats.tuplesIn;
+  if (_batch.count >= FDB_VECTOR_SIZE) {
+    flush ();
+  }
+}
+
+void FTupleBatcher::flush () {
+  if (_batch.count == 0) return;
+  ++_stats.batches;
+  _stats.tuplesOut += _batch.count;
+  _next.push (_batch);
+  // reuse the buffers for the next batch
+  _batch.count = 0;
+  _batch.columns.resize (_columns.size());
+  for (size_t i = 0; i < _batch.columns.size(); ++i) {
+    _batch.columns[i].ints.clear();
+    _batch.columns[i].bytes.clear();
+  }
+}
+
+struct TupleBatcherPrefixContext {
+  FTupleBatcher *batcher;
+  const void *key;
+  int prefixLength;
+};
+TupleCallbackRet tupleBatcherPrefixCallback (void *context, const void *tuple) {
+  TupleBatcherPrefixContext *con = reinterpret_cast<TupleBatcherPrefixContext*>(context);
+  if (::memcmp (tuple, con->key, con->prefixLength) != 0) {
+    return TUPLE_CALLBACK_QUIT;
+  }
+  con->batcher->add (tuple);
+  return TUPLE_CALLBACK_OK;
+}
+void FTupleBatcher::scanPrefix (FReadOnlyDiskBTree &btree, const void *key, int prefixLength) {
+  TupleBatcherPrefixContext context = {this, key, prefixLength};
+  btree.scanTuplesGreaterEqual (tupleBatcherPrefixCallback, &context, reinterpret_cast<const char*>(key));
+}
+void FTupleBatcher::scanPrefix (const FMainMemoryBTree &btree, const void *key, int prefixLength) {
+  TupleBatcherPrefixContext context = {this, key, prefixLength};
+  btree.scanTuplesGreaterEqual (tupleBatcherPrefixCallback, &context, reinterpret_cast<const char*>(key));
+}
+void FTupleBatcher::scanUnsorted (const FMainMemoryBTree &btree) {
+  assert (!btree.isSortedBuffer());
+  const char *buffer = reinterpret_cast<const char*>(btree.getUnsortedBuffer());
+  const int64_t tuples = btree.size();
+  const int dataSize = btree.getDataSize();
+  for (int64_t i = 0; i < tuples; ++i) {
+    add (buffer + i * dataSize);
+  }
+}
+
+} // fdb
@@ -0,0 +1,282 @@
+#ifndef STORAGE_FOPERATOR_H
+#define STORAGE_FOPERATOR_H
+
+#include "../configvalues.h"
+#include "fcstore.h"
+#include "fcselection.h"
+#include "searchcond.h"
+#include "../util/hashmap.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+namespace fdb {
+
+// Vectorized query operators.
+// Tuples flow from a source to a chain of operators in batches of at most FDB_VECTOR_SIZE
+// tuples. A batch is stored column by column, and each operator processes a batch
+// with a tight loop per column instead of a function call per tuple.
+// Operators are push-based: a source calls push() of the first operator for each batch,
+// and each operator passes the (filtered, projected) batch to the next one.
+//   sources: FColumnScan (c-store, predicates evaluated by column readers),
+//            FTupleBatcher (row-store tuples, e.g., BTree)
+//   operators: FFilterOperator, FProjectOperator
+//   ends of chains: FAggregateOperator (SUM ... GROUP BY), FSortLimitOperator (ORDER BY ... LIMIT)
+// As both kinds of sources produce the same batches, one chain of operators
+// (a query plan) runs over any fracture, c-store or BTree, on-disk or on-memory.
+// A chain is not thread-safe. For a parallel scan, each thread builds its own chain
+// and the results are merged at the end (see fcparallel.h).
+
+// a column of a batch.
+// integer values are widened to int64_t. string values are fixed-width (NULL-padded).
+struct FBatchColumn {
+  FBatchColumn () : isString(false), width(0), dictionary(NULL) {}
+  explicit FBatchColumn (const FCStoreColumn &column);
+  // an integer column computed by an operator
+  explicit FBatchColumn (const std::string &name_) : name(name_), isString(false), width(sizeof(int64_t)), dictionary(NULL) {}
+
+  // true if values are in ints. (integer column, or dictionary codes of a string column)
+  bool hasInts () const { return !isString || dictionary != NULL; }
+
+  std::string name;
+  bool isString;
+  int width; // byte size of a value in the original column
+  // set if this is a string column read as dictionary codes (see FColumnScan).
+  // ints are then the codes, and entries are looked up only when a result is output.
+  const std::vector<std::string> *dictionary;
+  std::vector<int64_t> ints; // count values if hasInts()
+  std::vector<char> bytes; // count * width bytes otherwise
+};
+
+// tuples passed between operators.
+struct FBatch {
+  FBatch () : count(0) {}
+  // returns the index of the column. -1 if not found.
+  int getColumnIndex (const std::string &name) const;
+  // keeps only the tuples at the given indexes (ascending) in all columns.
+  void compact (const std::vector<uint32_t> &indexes);
+
+  size_t count;
+  std::vector<FBatchColumn> columns;
+};
+
+// statistics of an operator, for query profiling.
+struct FOperatorStats {
+  FOperatorStats () : batches(0), tuplesIn(0), tuplesOut(0) {}
+  void add (const FOperatorStats &other);
+  std::string toString () const;
+
+  int64_t batches;
+  int64_t tuplesIn;
+  int64_t tuplesOut; // tuples passed to the next operator (or groups/rows for the end of chain)
+};
+
+class FOperator {
+public:
+  // next is NULL for the end of a chain. not owned by this object.
+  FOperator (const std::string &name, FOperator *next);
+  virtual ~FOperator() {}
+
+  // processes a batch. the batch might be modified (compacted, or given a new column).
+  void push (FBatch &batch);
+  // called after the last batch. passed to the next operator.
+  virtual void finish ();
+
+  const std::string& getName () const { return _name; }
+  FOperator* getNext () const { return _next; }
+  const FOperatorStats& getStats () const { return _stats; }
+  // statistics of this and following operators, one line for each.
+  std::string describe () const;
+
+protected:
+  // returns false not to pass the batch to the next operator.
+  virtual bool process (FBatch &batch) = 0;
+
+  std::string _name;
+  FOperator *_next;
+  FOperatorStats _stats;
+
+private:
+  FOperator (const FOperator &); // prohibit copying
+};
+
+// keeps tuples whose value of the column matches the condition.
+// cond points to values in the column type as for FColumnReader (e.g., int8_t for INT8 column,
+// NULL-padded string for CHAR column), so the same SearchCond can be used for both.
+class FFilterOperator : public FOperator {
+public:
+  FFilterOperator (const FCStoreColumn &column, const SearchCond &cond, FOperator *next);
+protected:
+  bool process (FBatch &batch);
+private:
+  FCStoreColumn _column;
+  SearchCond _cond;
+  // integer conditions other than IN are evaluated as from <= value <= to.
+  int64_t _from, _to;
+  std::vector<int64_t> _inValues; // for IN on integer column
+  std::vector<uint32_t> _selected;
+};
+
+enum FArithmetic {
+  ARITHMETIC_ADD,
+  ARITHMETIC_SUBTRACT,
+  ARITHMETIC_MULTIPLY,
+};
+
+// appends an integer column: left <arithmetic> right, both integer columns of the batch.
+class FProjectOperator : public FOperator {
+public:
+  FProjectOperator (const std::string &name, const std::string &left, FArithmetic arithmetic, const std::string &right, FOperator *next);
+protected:
+  bool process (FBatch &batch);
+private:
+  std::string _columnName;
+  std::string _left;
+  FArithmetic _arithmetic;
+  std::string _right;
+};
+
+// SUM(valueColumn) GROUP BY groupColumns. the end of a chain.
+// group values of a tuple are packed into a fixed-width key (dictionary codes for
+// dictionary columns), so group values are decoded to strings only once per group.
+// when all group columns have small domains (dictionary codes, INT8, or given by setGroupDomain())
+// and there are at most FDB_DENSE_GROUP_MAX possible groups, sums are kept in a dense array
+// indexed by the group values (no hashing nor key comparison). otherwise in FixedKeySumTable.
+// a value out of its domain moves the groups from the array to the hash table.
+class FAggregateOperator : public FOperator {
+public:
+  // no group columns for a single SUM.
+  FAggregateOperator (const std::vector<std::string> &groupColumns, const std::string &valueColumn);
+
+  // tells that values of the integer group column are in [min, max]. call before the first batch.
+  void setGroupDomain (const std::string &column, int64_t min, int64_t max);
+
+  // SUM over all tuples. (without GROUP BY)
+  int64_t getTotal () const { return _total; }
+  size_t getGroupCount () const;
+  // true while groups are in the dense array.
+  bool isDense () const { return _dense; }
+  // group values and sums. a group value is the raw bytes in the column type
+  // (e.g., 2 bytes for INT16, NULL-padded string for CHAR), decoded if it's a dictionary code.
+  void getGroups (std::vector<std::vector<std::string> > &keys, std::vector<int64_t> &sums) const;
+  // pushes groups to the chain as batches of the group columns and the value column.
+  void emit (FOperator &next) const;
+
+protected:
+  bool process (FBatch &batch);
+
+private:
+  void init (const FBatch &batch);
+  // sets _groupIndexes. returns false if a value is out of the domain.
+  bool computeDenseIndexes (const FBatch &batch);
+  void packDenseKey (size_t index, char *key) const;
+  // moves groups from the dense array to the hash table.
+  void switchToHash ();
+  // packed keys and sums of all groups.
+  void collectGroups (std::vector<char> &packedKeys, std::vector<int64_t> &sums) const;
+  std::string decodeGroupValue (size_t group, const char *packed) const;
+
+  std::vector<std::string> _groupColumnNames;
+  std::string _valueColumn;
+  std::map<std::string, std::pair<int64_t, int64_t> > _domainHints; // column -> [min, max]
+  bool _initialized;
+  std::vector<FBatchColumn> _groupColumns; // metadata only
+  std::vector<int> _keyOffsets; // byte offset of each group column in a packed key
+  int _keyWidth;
+  std::vector<char> _keyBuffer; // packed keys of a batch
+  int64_t _total;
+
+  bool _dense;
+  std::vector<int64_t> _domainMins; // for each group column
+  std::vector<int64_t> _domainSizes;
+  std::vector<int64_t> _strides; // index = sum of (value - min) * stride
+  std::vector<uint32_t> _groupIndexes; // of a batch
+  std::vector<int64_t> _denseSums;
+  std::vector<char> _denseUsed; // 1 if the group appeared
+  size_t _denseGroupCount;
+
+  FixedKeySumTable _hashGroups; // packed key -> sum
+};
+
+// ORDER BY columns LIMIT n. collects all tuples, and sorts them on finish(). the end of a chain.
+class FSortLimitOperator : public FOperator {
+public:
+  // orders: <column name, ascending>. limit: 0 for no limit.
+  FSortLimitOperator (const std::vector<std::pair<std::string, bool> > &orders, size_t limit);
+  void finish ();
+  // sorted tuples. valid after finish().
+  const FBatch& getResult () const { return _result; }
+protected:
+  bool process (FBatch &batch);
+private:
+  std::vector<std::pair<std::string, bool> > _orders;
+  size_t _limit;
+  FBatch _result;
+};
+
+// the source of a chain on c-store.
+// reads positions of a range matching all predicates, FDB_VECTOR_SIZE positions at a time,
+// and pushes the values of output columns as batches. predicates are evaluated by
+// column readers (on compressed data if possible, see FColumnReader::getPositionSelection())
+// and only the selected values of output columns are decompressed (late materialization).
+// RLE columns (typically sort columns used for grouping) are read as runs of the batch,
+// so each value is decoded once per run.
+// readers and predicates must be used by one thread (see fcparallel.h).
+class FColumnScan {
+public:
+  // outputs readers[i] as dictionary codes if asCodes[i] and it's dictionary compressed.
+  // dictionaries are decoded here, in the constructing thread.
+  FColumnScan (const std::vector<FColumnReader*> &readers, const std::vector<bool> &asCodes, const std::vector<ColumnPredicate> &predicates);
+
+  void scan (const PositionRange &range, FOperator &next);
+  // tuplesIn: scanned positions, tuplesOut: positions matching predicates
+  const FOperatorStats& getStats () const { return _stats; }
+
+private:
+  std::vector<FColumnReader*> _readers;
+  std::vector<FColumnReaderDictionary*> _codeReaders; // NULL unless read as codes
+  std::vector<FColumnReaderRLE*> _runReaders; // non-NULL for RLE columns, read from runs
+  std::vector<ColumnPredicate> _predicates;
+  std::vector<FBatchColumn> _columns; // metadata of output columns
+  FBatch _batch;
+  std::vector<char> _buffer;
+  std::vector<uint32_t> _codes;
+  std::vector<int64_t> _positions;
+  FOperatorStats _stats;
+};
+
+class FReadOnlyDiskBTree;
+class FMainMemoryBTree;
+// the source of a chain on row-store.
+// copies the values of the columns from each tuple (at column.offset), and pushes
+// a batch when FDB_VECTOR_SIZE tuples are added.
+// the scan functions are for tables whose tuple begins with its key (e.g., MVProjection).
+class FTupleBatcher {
+public:
+  FTupleBatcher (const std::vector<FCStoreColumn> &columns, FOperator &next);
+
+  void add (const void *tuple);
+  // pushes the remaining tuples. call this after the last add().
+  void flush ();
+
+  // adds tuples from the first one whose key >= key, while the first prefixLength bytes equal to key.
+  void scanPrefix (FReadOnlyDiskBTree &btree, const void *key, int prefixLength);
+  // same for a sorted on-memory BTree.
+  void scanPrefix (const FMainMemoryBTree &btree, const void *key, int prefixLength);
+  // adds all tuples of an unsorted on-memory BTree.
+  void scanUnsorted (const FMainMemoryBTree &btree);
+
+  // tuplesIn: added tuples
+  const FOperatorStats& getStats () const { return _stats; }
+
+private:
+  std::vector<FCStoreColumn> _columns;
+  FOperator &_next;
+  FBatch _batch;
+  FOperatorStats _stats;
+};
+
+} // fdb
+#endif // STORAGE_FOPERATOR_H
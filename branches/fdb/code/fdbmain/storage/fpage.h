@@ -11,9 +11,16 @@ namespace fdb {
 // btree non-leaf page (could be multi-level): <page header><firstkey><its pageid><firstkey><its pageid>...
 // cstore uncompressed leaf page: <page header><value><value><value><value>... (no root pages)
 // cstore RLE leaf page: <page header><count><value><count><value>...
-// cstore RLE root page (always one-level): <page header><beginpos><pageid><beginpos><pageid>...
+// cstore RLE index page (could be multi-level. level-1 pages point to leaf pages): <page header><beginpos><pageid><beginpos><pageid>...
 // cstore Dict leaf page: <page header><valueid><valueid><valueid>...
 // cstore Dict root page (always one-level): <page header><value><value><value>...
+// cstore Symbol leaf page: <page header><encoded value><encoded value>...<free space>...<end offset of value[1]><end offset of value[0]>
+//   (end offsets are uint16_t in the page, written from the end of the page)
+// cstore Symbol symbol table page (right after leaf pages): <page header><symbol><symbol>... (see FSymbolTable)
+// cstore Symbol index pages: same as RLE index pages.
+// cstore column group (PAX) leaf page: <page header><values of member 1><values of member 2>... (no root pages)
+//   every member has room for (page size - header) / entrySize values (entrySize = sum of member lengths),
+//   so the values of a member are at a fixed offset in every page. the last page has gaps between members.
 struct FPageHeader {
   int magicNumber; // to check sanity
   int fileId;
@@ -0,0 +1,282 @@
+#ifndef STORAGE_FSORT_H
+#define STORAGE_FSORT_H
+
+#include "fmerge.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+namespace fdb {
+
+// Parallel sorts of fixed-width keys, used to sort on-memory fractures (see FMainMemoryBTree::finishInserts()).
+// each takes data (n elements) and a buffer of n elements, and leaves the sorted elements in data.
+//   parallelRadixSort: LSD radix sort of integer keys, 8 bits per pass. passes where all keys
+//     have the same digit are skipped, so small keys (e.g., order keys) take a few passes.
+//   parallelSampleSort: for wide keys compared with operator< (e.g., memcmp of MVProjection keys).
+//     splits the keys into one bucket per thread by sampled splitters, then sorts the buckets.
+//   parallelMergeRuns: for data consisting of sorted runs (e.g., sorted batches).
+//     splits the key space the same way, then each thread merges its part of the runs.
+
+// radix keys of integer keys in unsigned order. the default is not radix-sortable.
+template <typename Key>
+struct FRadixKey {
+  static const bool RADIX = false;
+  static uint64_t toUnsigned (const Key &) { assert (false); return 0; }
+};
+template <>
+struct FRadixKey<int64_t> {
+  static const bool RADIX = true;
+  static uint64_t toUnsigned (int64_t key) { return ((uint64_t) key) ^ (1ULL << 63); }
+};
+template <>
+struct FRadixKey<int32_t> {
+  static const bool RADIX = true;
+  static uint64_t toUnsigned (int32_t key) { return ((uint32_t) key) ^ (1U << 31); }
+};
+
+// calls job(i) for each i in [0, count) in its own thread. job is copied to each thread.
+template <typename JOB>
+void runParallelJobs (int count, const JOB &job) {
+  if (count == 1) {
+    job (0);
+    return;
+  }
+  boost::thread_group group;
+  for (int i = 0; i < count; ++i) {
+    group.create_thread (boost::bind<void> (job, i));
+  }
+  group.join_all();
+}
+
+const int FSORT_RADIX = 256;
+
+// one pass of LSD radix sort. phase 0 counts digits of each chunk, phase 1 scatters them.
+template <typename E, typename GETKEY>
+struct RadixPassJob {
+  void operator() (int t) const {
+    const int64_t begin = n * t / threads, end = n * (t + 1) / threads;
+    int64_t *count = &(*counts)[t * FSORT_RADIX];
+    if (phase == 0) {
+      for (int64_t i = begin; i < end; ++i) {
+        ++count[(getKey (src[i]) >> shift) & (FSORT_RADIX - 1)];
+      }
+    } else {
+      for (int64_t i = begin; i < end; ++i) {
+        dst[count[(getKey (src[i]) >> shift) & (FSORT_RADIX - 1)]++] = src[i];
+      }
+    }
+  }
+  const E *src;
+  E *dst;
+  int64_t n;
+  int threads;
+  int shift;
+  int phase;
+  GETKEY getKey;
+  std::vector<int64_t> *counts; // [thread * FSORT_RADIX + digit]. offsets in phase 1
+};
+
+// GETKEY returns the radix key (uint64_t) of an element, e.g., by FRadixKey::toUnsigned().
+template <typename E, typename GETKEY>
+void parallelRadixSort (E *data, E *buffer, int64_t n, int threads, int keyBytes, const GETKEY &getKey) {
+  std::vector<int64_t> counts (threads * FSORT_RADIX);
+  RadixPassJob<E, GETKEY> job;
+  job.n = n;
+  job.threads = threads;
+  job.getKey = getKey;
+  job.counts = &counts;
+  E *src = data, *dst = buffer;
+  for (int shift = 0; shift < keyBytes * 8; shift += 8) {
+    std::fill (counts.begin(), counts.end(), 0);
+    job.src = src;
+    job.dst = dst;
+    job.shift = shift;
+    job.phase = 0;
+    runParallelJobs (threads, job);
+    // offsets: digits in order, and chunks in order in each digit (stable)
+    int64_t offset = 0;
+    bool skip = false;
+    for (int digit = 0; digit < FSORT_RADIX; ++digit) {
+      int64_t total = 0;
+      for (int t = 0; t < threads; ++t) {
+        int64_t count = counts[t * FSORT_RADIX + digit];
+        counts[t * FSORT_RADIX + digit] = offset + total;
+        total += count;
+      }
+      if (total == n) {
+        skip = true; // all keys have the same digit
+        break;
+      }
+      offset += total;
+    }
+    if (skip) {
+      continue;
+    }
+    job.phase = 1;
+    runParallelJobs (threads, job);
+    std::swap (src, dst);
+  }
+  if (src != data) {
+    std::copy (src, src + n, data);
+  }
+}
+
+// sample sort. phase 0 counts elements of each chunk per bucket, phase 1 scatters them
+// to buffer, phase 2 sorts each bucket and copies it back to data.
+template <typename E>
+struct SampleSortJob {
+  void operator() (int t) const {
+    if (phase == 2) {
+      const int64_t begin = (*bucketBegins)[t], end = (*bucketBegins)[t + 1];
+      std::sort (buffer + begin, buffer + end);
+      std::copy (buffer + begin, buffer + end, data + begin);
+      return;
+    }
+    const int64_t begin = n * t / threads, end = n * (t + 1) / threads;
+    int64_t *count = &(*counts)[t * threads];
+    for (int64_t i = begin; i < end; ++i) {
+      size_t bucket = std::upper_bound (splitters->begin(), splitters->end(), data[i]) - splitters->begin();
+      if (phase == 0) {
+        ++count[bucket];
+      } else {
+        buffer[count[bucket]++] = data[i];
+      }
+    }
+  }
+  E *data;
+  E *buffer;
+  int64_t n;
+  int threads;
+  int phase;
+  const std::vector<E> *splitters; // threads - 1 keys
+  std::vector<int64_t> *counts; // [thread * threads + bucket]. offsets in phase 1
+  std::vector<int64_t> *bucketBegins; // threads + 1
+};
+
+// picks splitters - 1 keys splitting data into about the same sizes, by sorted samples.
+template <typename E>
+void pickSplitters (const E *data, int64_t n, int parts, int samplesPerPart, std::vector<E> &splitters) {
+  std::vector<E> samples;
+  const int64_t sampleCount = std::min<int64_t> (n, (int64_t) parts * samplesPerPart);
+  for (int64_t i = 0; i < sampleCount; ++i) {
+    samples.push_back (data[i * n / sampleCount]);
+  }
+  std::sort (samples.begin(), samples.end());
+  for (int p = 1; p < parts; ++p) {
+    splitters.push_back (samples[samples.size() * p / parts]);
+  }
+}
+
+template <typename E>
+void parallelSampleSort (E *data, E *buffer, int64_t n, int threads, int samplesPerThread) {
+  if (threads <= 1 || n < threads * 2) {
+    std::sort (data, data + n);
+    return;
+  }
+  std::vector<E> splitters;
+  pickSplitters (data, n, threads, samplesPerThread, splitters);
+  std::vector<int64_t> counts (threads * threads, 0);
+  std::vector<int64_t> bucketBegins (threads + 1, 0);
+  SampleSortJob<E> job;
+  job.data = data;
+  job.buffer = buffer;
+  job.n = n;
+  job.threads = threads;
+  job.splitters = &splitters;
+  job.counts = &counts;
+  job.bucketBegins = &bucketBegins;
+  job.phase = 0;
+  runParallelJobs (threads, job);
+  int64_t offset = 0;
+  for (int bucket = 0; bucket < threads; ++bucket) {
+    bucketBegins[bucket] = offset;
+    for (int t = 0; t < threads; ++t) {
+      int64_t count = counts[t * threads + bucket];
+      counts[t * threads + bucket] = offset;
+      offset += count;
+    }
+  }
+  bucketBegins[threads] = n;
+  job.phase = 1;
+  runParallelJobs (threads, job);
+  job.phase = 2;
+  runParallelJobs (threads, job);
+}
+
+template <typename E>
+struct RunLess {
+  RunLess (const std::vector<const E*> *positions_) : positions(positions_) {}
+  bool operator() (size_t i, size_t j) const {
+    return *(*positions)[i] < *(*positions)[j];
+  }
+  const std::vector<const E*> *positions;
+};
+
+// in phase 0, thread p merges [(*bounds)[p][r], (*bounds)[p + 1][r]) of every run r into buffer.
+// in phase 1, it copies them back to data (other threads read data until phase 0 finishes).
+template <typename E>
+struct MergeRunsJob {
+  void operator() (int p) const {
+    const std::vector<int64_t> &begins = (*bounds)[p], &ends = (*bounds)[p + 1];
+    const size_t runs = begins.size();
+    std::vector<const E*> positions (runs);
+    std::vector<bool> finished (runs);
+    int64_t outBegin = 0, outEnd = 0;
+    for (size_t r = 0; r < runs; ++r) {
+      positions[r] = data + begins[r];
+      finished[r] = begins[r] == ends[r];
+      outBegin += begins[r] - (*runStarts)[r];
+      outEnd += ends[r] - (*runStarts)[r];
+    }
+    if (phase == 1) {
+      std::copy (buffer + outBegin, buffer + outEnd, data + outBegin);
+      return;
+    }
+    FLoserTree<RunLess<E> > tree (finished, RunLess<E> (&positions));
+    E *out = buffer + outBegin;
+    for (int r = tree.top(); r >= 0; r = tree.top()) {
+      *(out++) = *positions[r];
+      ++positions[r];
+      tree.pop (positions[r] != data + ends[r]);
+    }
+    assert (out == buffer + outEnd);
+  }
+  E *data;
+  E *buffer;
+  int phase;
+  const std::vector<int64_t> *runStarts;
+  const std::vector<std::vector<int64_t> > *bounds; // [partition][run]. threads + 1 partitions
+};
+
+// runStarts: the first element of each sorted run, ascending. the first is 0.
+template <typename E>
+void parallelMergeRuns (E *data, E *buffer, int64_t n, const std::vector<int64_t> &runStarts, int threads, int samplesPerThread) {
+  assert (!runStarts.empty() && runStarts[0] == 0);
+  std::vector<E> splitters;
+  pickSplitters (data, n, threads, samplesPerThread, splitters);
+  const size_t runs = runStarts.size();
+  std::vector<std::vector<int64_t> > bounds (threads + 1, std::vector<int64_t> (runs));
+  for (size_t r = 0; r < runs; ++r) {
+    const int64_t runEnd = r + 1 < runs ? runStarts[r + 1] : n;
+    bounds[0][r] = runStarts[r];
+    bounds[threads][r] = runEnd;
+    for (int p = 1; p < threads; ++p) {
+      bounds[p][r] = std::lower_bound (data + runStarts[r], data + runEnd, splitters[p - 1]) - data;
+    }
+  }
+  MergeRunsJob<E> job;
+  job.data = data;
+  job.buffer = buffer;
+  job.runStarts = &runStarts;
+  job.bounds = &bounds;
+  job.phase = 0;
+  runParallelJobs (threads, job);
+  job.phase = 1;
+  runParallelJobs (threads, job);
+}
+
+} // fdb
+#endif // STORAGE_FSORT_H
@@ -11,12 +11,16 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <stdexcept>
 #include <boost/scoped_array.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include "../configvalues.h"
+#include "../engine/fcompaction.h"
 #include "../engine/fengine.h"
 #include "../engine/ffamily.h"
+#include "../io/fis.h"
+#include "../io/fwal.h"
 #include "../ssb/dbgen.h"
 #include "../ssb/ssb.h"
 #include "../ssb/loadssb.h"
@@ -27,7 +31,18 @@
 #include "../storage/fbufferpool.h"
 #include "../storage/fbufferpoolimpl.h"
 #include "../storage/fbtree.h"
+#include "../storage/fbtreeimpl.h"
+#include "../storage/fcaggregate.h"
+#include "../storage/fcbitmap.h"
+#include "../storage/fcparallel.h"
+#include "../storage/fcselection.h"
+#include "../storage/fccursor.h"
 #include "../storage/fcstore.h"
+#include "../storage/fcstoreimpl.h"
+#include "../storage/fcsymbol.h"
+#include "../storage/fmerge.h"
+#include "../storage/fsort.h"
+#include "../storage/foperator.h"
 #include "../storage/searchcond.h"
 #include "../util/hashmap.h"
 #include "testmain.h"
@@ -147,6 +162,7 @@ BOOST_AUTO_TEST_CASE(storage_test_sig) {
   sig2.keyCompareFuncType = INT64_ASC_NODUP;
   sig2.tableType = LINEORDER_PK_SORT;
   sig2.setFilepath("_test.2");
+  sig2.setWalName("_test.wal.3");
   BOOST_CHECK_EQUAL (sig2.fileId, 0);
   sig2.fileId = signatureFile.issueNextFileId();
   BOOST_CHECK_EQUAL (sig2.fileId, 2);
@@ -182,6 +198,7 @@ BOOST_AUTO_TEST_CASE(storage_test_sig) {
   BOOST_CHECK_EQUAL (sig1Loaded.keyCompareFuncType, INT32_ASC_NODUP);
   BOOST_CHECK_EQUAL (sig1Loaded.getFilepath().c_str(), "_test.1");
   BOOST_CHECK_EQUAL (sig1Loaded.fileId, 1);
+  BOOST_CHECK_EQUAL (sig1Loaded.getWalName().c_str(), "");
 
 
   BOOST_REQUIRE (signatureFile2.existsFile("_test.2"));
@@ -196,6 +213,9 @@ BOOST_AUTO_TEST_CASE(storage_test_sig) {
   BOOST_CHECK_EQUAL (sig2Loaded.keyCompareFuncType, INT64_ASC_NODUP);
   BOOST_CHECK_EQUAL (sig2Loaded.getFilepath().c_str(), "_test.2");
   BOOST_CHECK_EQUAL (sig2Loaded.fileId, 2);
+  BOOST_CHECK_EQUAL (sig2Loaded.getWalName().c_str(), "_test.wal.3");
+  BOOST_CHECK_EQUAL (signatureFile2.getWalNames("_test.wal.").size(), 1);
+  BOOST_CHECK_EQUAL (signatureFile2.getWalNames("_other.wal.").size(), 0);
 
   BOOST_TEST_MESSAGE("===Tested FSignatureSet.");
 }
@@ -293,6 +313,253 @@ BOOST_AUTO_TEST_CASE(storage_test_mainmemory_btree) {
   signatureFile.save(TEST_DATA_FOLDER, "_test2.sig");
   BOOST_TEST_MESSAGE("===Tested FMainMemoryBTree.");
 }
+
+struct ConcurrentInsertWriter {
+  ConcurrentInsertWriter (FMainMemoryBTree *btree_, const std::vector<Lineorder> *tuples_, int batchSize_)
+    : btree(btree_), tuples(tuples_), batchSize(batchSize_) {}
+  void operator()() {
+    for (size_t i = 0; i < tuples->size(); i += batchSize) {
+      if (!btree->insertBatch(&(*tuples)[i], std::min<size_t>(batchSize, tuples->size() - i))) {
+        ++failed;
+      }
+    }
+  }
+  FMainMemoryBTree *btree;
+  const std::vector<Lineorder> *tuples;
+  int batchSize;
+  static int failed;
+};
+int ConcurrentInsertWriter::failed = 0;
+
+void countAscendingOrderkeys (void *context, const void */*key*/, const void *data) {
+  int *count = reinterpret_cast<int*>(context);
+  BOOST_CHECK_EQUAL (reinterpret_cast<const Lineorder*>(data)->orderkey, *count + 1);
+  ++(*count);
+}
+
+BOOST_AUTO_TEST_CASE(storage_mainmemory_concurrent_insert) {
+  BOOST_TEST_MESSAGE("===Testing concurrent inserts to FMainMemoryBTree...");
+  const int WRITERS = 4, TUPLES_PER_WRITER = 5000;
+  std::vector<std::vector<Lineorder> > tuples (WRITERS);
+  for (int w = 0; w < WRITERS; ++w) {
+    for (int i = 0; i < TUPLES_PER_WRITER; ++i) {
+      Lineorder l;
+      stringstream line;
+      line << (w * TUPLES_PER_WRITER + i + 1) <<"|1|2020|53077|626|19931213|3-MEDIUM|0|14|1442098|24363867|8|1326730|61804|0|19940130|RAIL";
+      string str = line.str();
+      l.loadDataPiped(str);
+      tuples[w].push_back (l);
+    }
+  }
+  for (int sorted = 0; sorted < 2; ++sorted) {
+    FMainMemoryBTree btree (LINEORDER_PK_SORT, WRITERS * TUPLES_PER_WRITER, sorted != 0);
+    boost::thread_group writers;
+    for (int w = 0; w < WRITERS; ++w) {
+      writers.create_thread (ConcurrentInsertWriter(&btree, &tuples[w], 100));
+    }
+    // a reader sees only completely inserted tuples
+    int64_t previous = 0;
+    int incomplete = 0;
+    while (previous < WRITERS * TUPLES_PER_WRITER) {
+      int64_t size = btree.size();
+      BOOST_REQUIRE (size >= previous);
+      const Lineorder *buffer = reinterpret_cast<const Lineorder*>(btree.getUnsortedBuffer());
+      for (int64_t i = previous; i < size; ++i) {
+        if (buffer[i].orderkey == 0) ++incomplete;
+      }
+      previous = size;
+    }
+    writers.join_all();
+    BOOST_CHECK_EQUAL (incomplete, 0);
+    BOOST_CHECK_EQUAL (ConcurrentInsertWriter::failed, 0);
+    BOOST_CHECK_EQUAL (btree.size(), WRITERS * TUPLES_PER_WRITER);
+    // no more room
+    BOOST_CHECK (!btree.insertBatch(&tuples[0][0], 1));
+    btree.finishInserts();
+
+    int count = 0;
+    btree.traverse(countAscendingOrderkeys, &count);
+    BOOST_CHECK_EQUAL (count, WRITERS * TUPLES_PER_WRITER);
+    for (int w = 0; w < WRITERS; ++w) {
+      Lineorder::PKType pk = tuples[w][TUPLES_PER_WRITER / 2].getPK();
+      const Lineorder *found = reinterpret_cast<const Lineorder*>(btree.getSingleTupleByKey(&pk));
+      BOOST_REQUIRE (found != NULL);
+      BOOST_CHECK_EQUAL (found->getPK(), pk);
+    }
+  }
+  BOOST_TEST_MESSAGE("===Tested concurrent inserts to FMainMemoryBTree.");
+}
+
+struct BatchInserter {
+  void operator()() {
+    *published = btree->insertBatch(tuples, count);
+  }
+  FMainMemoryBTreeImpl *btree;
+  const Lineorder *tuples;
+  int64_t count;
+  bool *published;
+};
+
+template <class Base>
+class AbandoningBTree : public Base {
+public:
+  AbandoningBTree (int64_t maxSize) : Base (LINEORDER_PK_SORT, sizeof(Lineorder), maxSize) {}
+  // reserves a slot, lets the inserter reserve after it, then fails before publishing the slot
+  void failWhileAnotherInserts (BatchInserter inserter) {
+    boost::scoped_ptr<boost::thread> writer;
+    try {
+      typename Base::SlotReservation reservation (this, 1);
+      BOOST_REQUIRE (reservation.begin() >= 0);
+      writer.reset (new boost::thread (inserter));
+      while (getReservedSlots() == reservation.begin() + 1) {
+        boost::this_thread::yield();
+      }
+      throw std::runtime_error("injected failure");
+    } catch (const std::runtime_error &) {
+    }
+    writer->join(); // doesn't wait for the abandoned slot forever
+  }
+  int64_t getReservedSlots () const {
+    boost::mutex::scoped_lock lock (this->_insertMutex);
+    return this->_reserved;
+  }
+};
+
+template <class Base>
+void testAbandonedSlots (const std::vector<Lineorder> &tuples) {
+  AbandoningBTree<Base> btree (tuples.size() + 1);
+  BOOST_REQUIRE (btree.insertBatch(&tuples[0], tuples.size() / 2));
+  bool published = true;
+  BatchInserter inserter = {&btree, &tuples[tuples.size() / 2], (int64_t) (tuples.size() - tuples.size() / 2), &published};
+  btree.failWhileAnotherInserts (inserter);
+  // the later writer's tuples would be after a hole
+  BOOST_CHECK (!published);
+  BOOST_CHECK_EQUAL (btree.size(), tuples.size() / 2);
+  BOOST_CHECK (!btree.insertBatch(&tuples[0], 1));
+  btree.finishInserts();
+  int count = 0;
+  btree.traverse(countAscendingOrderkeys, &count);
+  BOOST_CHECK_EQUAL (count, tuples.size() / 2);
+}
+
+BOOST_AUTO_TEST_CASE(storage_mainmemory_abandoned_slots) {
+  BOOST_TEST_MESSAGE("===Testing abandoned inserts to FMainMemoryBTree...");
+  std::vector<Lineorder> tuples;
+  for (int i = 0; i < 200; ++i) {
+    Lineorder l;
+    stringstream line;
+    line << (i + 1) <<"|1|2020|53077|626|19931213|3-MEDIUM|0|14|1442098|24363867|8|1326730|61804|0|19940130|RAIL";
+    string str = line.str();
+    l.loadDataPiped(str);
+    tuples.push_back (l);
+  }
+  testAbandonedSlots<FMainMemoryBTreeImplUnsorted<Lineorder::PKType> > (tuples);
+  // keys are in the map only after their slots are published
+  testAbandonedSlots<FMainMemoryBTreeImplSorted<Lineorder::PKType> > (tuples);
+  BOOST_TEST_MESSAGE("===Tested abandoned inserts to FMainMemoryBTree.");
+}
+struct Int64RadixKey {
+  uint64_t operator() (int64_t value) const { return FRadixKey<int64_t>::toUnsigned(value); }
+};
+
+// checks keys are traversed in ascending order. context is the previous key and the count.
+template <typename Key>
+struct AscendingKeys {
+  AscendingKeys () : count(0) {}
+  static void callback (void *context, const void *key, const void */*data*/) {
+    AscendingKeys<Key> *self = reinterpret_cast<AscendingKeys<Key>*>(context);
+    const Key &current = *reinterpret_cast<const Key*>(key);
+    if (self->count > 0) {
+      BOOST_CHECK (!(current < self->previous));
+    }
+    self->previous = current;
+    ++self->count;
+  }
+  Key previous;
+  int64_t count;
+};
+
+BOOST_AUTO_TEST_CASE(storage_parallel_sort) {
+  BOOST_TEST_MESSAGE("===Testing parallel sorts...");
+  const int64_t N = FDB_SORT_PARALLEL_MIN * 2;
+  const int THREADS = 4;
+  {
+    BOOST_TEST_MESSAGE("--sorting integers...");
+    std::vector<int64_t> values (N), buffer (N);
+    for (int64_t i = 0; i < N; ++i) {
+      values[i] = (i * 2654435761LL) % 1000003 - 500000; // negative keys too
+    }
+    std::vector<int64_t> expected (values);
+    std::sort (expected.begin(), expected.end());
+
+    std::vector<int64_t> sorted (values);
+    parallelRadixSort (&sorted[0], &buffer[0], N, THREADS, sizeof(int64_t), Int64RadixKey());
+    BOOST_CHECK (sorted == expected);
+
+    sorted = values;
+    parallelSampleSort (&sorted[0], &buffer[0], N, THREADS, FDB_SORT_SAMPLES_PER_THREAD);
+    BOOST_CHECK (sorted == expected);
+
+    sorted = values;
+    std::vector<int64_t> runStarts;
+    for (int64_t begin = 0; begin < N; begin += N / 10) {
+      runStarts.push_back (begin);
+      std::sort (sorted.begin() + begin, sorted.begin() + std::min (N, begin + N / 10));
+    }
+    parallelMergeRuns (&sorted[0], &buffer[0], N, runStarts, THREADS, FDB_SORT_SAMPLES_PER_THREAD);
+    BOOST_CHECK (sorted == expected);
+  }
+
+  std::vector<Lineorder> tuples (N);
+  for (int64_t i = 0; i < N; ++i) {
+    ::memset (static_cast<void*>(&tuples[i]), 0, sizeof(Lineorder));
+    tuples[i].orderkey = i + 1;
+    tuples[i].linenumber = 1;
+  }
+  std::vector<Lineorder> shuffled (tuples);
+  std::random_shuffle (shuffled.begin(), shuffled.end());
+  // 0: ordered batches (one run), 1: unordered batches (runs to merge), 2: unordered tuples (radix sort)
+  for (int pattern = 0; pattern < 3; ++pattern) {
+    BOOST_TEST_MESSAGE("--sorting an on-memory btree. pattern=" << pattern);
+    FMainMemoryBTree btree (LINEORDER_PK_SORT, N, false);
+    if (pattern == 2) {
+      for (int64_t i = 0; i < N; ++i) {
+        Lineorder::PKType pk = shuffled[i].getPK();
+        BOOST_REQUIRE (btree.insert(&pk, &shuffled[i]));
+      }
+    } else {
+      const std::vector<Lineorder> &batches = pattern == 0 ? tuples : shuffled;
+      for (int64_t i = 0; i < N; i += 1000) {
+        BOOST_REQUIRE (btree.insertBatch(&batches[i], std::min<int64_t> (1000, N - i)));
+      }
+    }
+    btree.finishInserts();
+    int count = 0;
+    btree.traverse(countAscendingOrderkeys, &count);
+    BOOST_CHECK_EQUAL (count, N);
+  }
+
+  {
+    BOOST_TEST_MESSAGE("--sorting an on-memory btree of wide keys...");
+    const char* REGIONS[] = {"AFRICA", "AMERICA", "ASIA", "EUROPE", "MIDDLE EAST"};
+    FMainMemoryBTree btree (MV_PROJECTION, N, false);
+    for (int64_t i = 0; i < N; ++i) {
+      MVProjection m;
+      // keys are compared with memcmp(), padding bytes included
+      ::memset (static_cast<void*>(&m), 0, sizeof(MVProjection));
+      int64_t k = (i * 2654435761LL) % N;
+      ::memcpy (m.key.s_region, REGIONS[k % 5], ::strlen(REGIONS[k % 5]));
+      m.key.d_year = 1992 + (k % 7);
+      m.key.l_orderkey = k;
+      BOOST_REQUIRE (btree.insert(&(m.key), &m));
+    }
+    btree.finishInserts();
+    AscendingKeys<MVProjection::PKType> ascending;
+    btree.traverse(AscendingKeys<MVProjection::PKType>::callback, &ascending);
+    BOOST_CHECK_EQUAL (ascending.count, N);
+  }
+  BOOST_TEST_MESSAGE("===Tested parallel sorts.");
+}
 BOOST_AUTO_TEST_CASE(ssb_test_maketiny) {
   BOOST_TEST_MESSAGE("===Testing tiny SSB data generation...");
   makeTinySSB("../../data/tinyssb/", TEST_DATA_FOLDER, 5);
@@ -609,6 +876,42 @@ BOOST_AUTO_TEST_CASE(storage_cstore_dictionary) {
     BOOST_CHECK (std::string(buffer + 4 * sizeof(c.city), sizeof(c.city)) == reader->normalize("INDONESIA1"));
     BOOST_CHECK (std::string(buffer + 5 * sizeof(c.city), sizeof(c.city)) == reader->normalize("JORDAN   9"));
   }
+
+  {
+    // order-preserving dictionary: entries are sorted and range conditions map to contiguous IDs
+    FColumnReaderDictionary *reader = dynamic_cast<FColumnReaderDictionary*>(customer.getColumnReader("city"));
+    BOOST_REQUIRE (reader != NULL);
+    const vector<string> &entries = reader->getAllDictionaryEntries();
+    BOOST_REQUIRE (entries.size() > 2);
+    for (size_t i = 1; i < entries.size(); ++i) {
+      BOOST_CHECK (entries[i - 1] < entries[i]);
+    }
+    const string &middle = entries[entries.size() / 2];
+    string notExisting = reader->normalize("EGYPT    X");
+    vector<SearchCond> conds;
+    conds.push_back (SearchCond(SCT_EQUAL, middle.data()));
+    conds.push_back (SearchCond(SCT_EQUAL, notExisting.data()));
+    conds.push_back (SearchCond(SCT_LT, middle.data()));
+    conds.push_back (SearchCond(SCT_LTEQ, middle.data()));
+    conds.push_back (SearchCond(SCT_GT, notExisting.data()));
+    conds.push_back (SearchCond(SCT_GTEQ, middle.data()));
+    conds.push_back (SearchCond(notExisting.data(), middle.data()));
+    conds.push_back (SearchCond(middle.data(), notExisting.data()));
+    for (size_t i = 0; i < conds.size(); ++i) {
+      vector<int> ids = reader->searchDictionary(conds[i]);
+      int beginId, endId;
+      BOOST_CHECK (reader->searchDictionaryRange(conds[i], beginId, endId));
+      BOOST_CHECK_EQUAL ((int) ids.size(), endId - beginId);
+      if (!ids.empty()) {
+        BOOST_CHECK_EQUAL (ids.front(), beginId);
+        BOOST_CHECK_EQUAL (ids.back(), endId - 1);
+      }
+    }
+    vector<const void*> keys;
+    keys.push_back (middle.data());
+    int beginId, endId;
+    BOOST_CHECK (!reader->searchDictionaryRange(SearchCond(keys), beginId, endId));
+  }
   BOOST_TEST_MESSAGE("===Tested dictionary compressed CStore column.");
 }
 BOOST_AUTO_TEST_CASE(storage_cstore_rle) {
@@ -702,6 +1005,790 @@ BOOST_AUTO_TEST_CASE(storage_cstore_rle) {
   BOOST_TEST_MESSAGE("===Tested RLE CStore column.");
 }
 
+BOOST_AUTO_TEST_CASE(storage_cstore_rle_sorted) {
+  BOOST_TEST_MESSAGE("===Testing binary search on sorted RLE column...");
+  FSignatureSet signatures;
+  signatures.load (TEST_DATA_FOLDER, "_tinyssb.sig");
+  BOOST_REQUIRE (signatures.size() > 0);
+  FBufferPool bufferpool (100);
+
+  // orderkey is the leading sort column, so searches on it are answered by binary search.
+  // compare them with the matches of decompressed values.
+  FReadOnlyCStore lineorder (&bufferpool, LINEORDER_PK_SORT, signatures, TEST_DATA_FOLDER, "lineorder.bin");
+  FColumnReader *reader = lineorder.getColumnReader("orderkey");
+  const int64_t tuples = signatures.getCStoreFileSignatures(TEST_DATA_FOLDER, FCStoreUtil::getPhysicalDesignsOf(LINEORDER_PK_SORT), "lineorder.bin")[0].totalTupleCount;
+  BOOST_REQUIRE (tuples > 10);
+  boost::scoped_array<int32_t> values (new int32_t[tuples]);
+  reader->getDecompressedData(PositionRange (0, tuples), values.get(), tuples * sizeof(int32_t));
+
+  const int32_t lastKey = values[tuples - 1];
+  int32_t keys[] = {0, 1, 2, 5, lastKey / 2, lastKey, lastKey + 1};
+  SearchCondType types[] = {SCT_EQUAL, SCT_LT, SCT_GT, SCT_LTEQ, SCT_GTEQ};
+  PositionRange scanRanges[] = {PositionRange (0, tuples), PositionRange (5, tuples - 5), PositionRange (tuples / 3, tuples - 2)};
+  for (int r = 0; r < 3; ++r) {
+    const PositionRange &scanRange = scanRanges[r];
+    for (int k = 0; k < 7; ++k) {
+      for (int t = 0; t < 6; ++t) {
+        int32_t key2 = keys[k] + 3;
+        SearchCond cond = (t == 5) ? SearchCond(&keys[k], &key2) : SearchCond(types[t], &keys[k]);
+        if (r == 0) {
+          reader->clearSearchRanges();
+        } else {
+          reader->setSearchRange(scanRange);
+        }
+        vector<PositionRange> ret;
+        reader->getPositionRanges(cond, ret);
+        BOOST_REQUIRE (ret.size() <= 1);
+        PositionRange correct (scanRange.end, scanRange.end);
+        for (int64_t i = scanRange.begin; i < scanRange.end; ++i) {
+          if (cond.matchInts<int32_t>(values[i])) {
+            if (correct.begin == scanRange.end) correct.begin = i;
+            correct.end = i + 1;
+          }
+        }
+        if (correct.begin == scanRange.end) {
+          BOOST_CHECK_EQUAL (ret.size(), 0);
+        } else {
+          BOOST_REQUIRE_EQUAL (ret.size(), 1);
+          BOOST_CHECK_EQUAL (ret[0].begin, correct.begin);
+          BOOST_CHECK_EQUAL (ret[0].end, correct.end);
+        }
+      }
+    }
+  }
+  reader->clearSearchRanges();
+
+  BOOST_TEST_MESSAGE("===Tested binary search on sorted RLE column.");
+}
+
+// exposes the position index of an RLE file to compare it with a flat scan.
+class TestRLEReader : public FColumnReaderImplRLE {
+public:
+  TestRLEReader (FBufferPool *bufferpool, const FCStoreColumn &column, const FFileSignature &signature)
+    : FColumnReaderImplRLE (bufferpool, column, signature, true) {}
+  using FColumnReaderImpl::getPageRange;
+  using FColumnReaderImpl::findLeafPageByPosition;
+  using FColumnReaderImplRLE::findPositionByValue;
+};
+
+BOOST_AUTO_TEST_CASE(storage_cstore_rle_levels) {
+  BOOST_TEST_MESSAGE("===Testing multi-level position index of RLE column...");
+  const FCStoreColumn column ("value", COLUMN_INT32, 0, RLE_COMPRESSED);
+  const std::string filepath = string(TEST_DATA_FOLDER) + "_rlelevels.db";
+  const int LEAF_PAGES = 25;
+  const int entriesPerLeafPage = (FDB_PAGE_SIZE - sizeof (FPageHeader)) / (sizeof(int32_t) + sizeof(int));
+  // sorted even values in runs of 1-5 tuples
+  std::vector<int32_t> values;
+  for (int run = 0; run < entriesPerLeafPage * (LEAF_PAGES - 1) + entriesPerLeafPage / 2; ++run) {
+    values.insert (values.end(), 1 + run % 5, run * 2);
+  }
+  const int64_t tuples = values.size();
+
+  // {entries per index page, max root pages, levels}. 25 leaf pages -> 4 -> 1 root, 25 -> 9 -> 3 -> 1 root
+  const int shapes[][3] = {{8, 2, 2}, {3, 2, 3}};
+  for (int s = 0; s < 2; ++s) {
+    BOOST_TEST_MESSAGE("-- " << shapes[s][2] << " levels of index pages");
+    std::remove(filepath.c_str());
+    FFileSignature signature;
+    signature.fileId = 1;
+    signature.setFilepath (filepath);
+    {
+      ScopedMemoryForIO bufferPtr (4 * FDB_PAGE_SIZE, FDB_DIRECT_IO_ALIGNMENT, FDB_USE_DIRECT_IO);
+      DirectFileOutputStream fd (filepath, FDB_USE_DIRECT_IO);
+      FCStoreWriter writer (signature.fileId, &fd, reinterpret_cast<char*>(bufferPtr.get()), 4, column, tuples);
+      writer.entriesPerIndexPage = shapes[s][0];
+      writer.maxRootPages = shapes[s][1];
+      for (int64_t i = 0; i < tuples; ++i) {
+        writer.addValue (reinterpret_cast<const char*>(&values[i]));
+      }
+      writer.finishWriting ();
+      fd.sync ();
+      fd.close ();
+      writer.updateFileSignature (signature, LINEORDER_PK_SORT, 0);
+    }
+    BOOST_REQUIRE_EQUAL (signature.leafPageCount, LEAF_PAGES);
+    BOOST_CHECK_EQUAL (signature.rootPageLevel, shapes[s][2]);
+    BOOST_CHECK (signature.rootPageCount <= shapes[s][1]);
+
+    FBufferPool bufferpool (100);
+    TestRLEReader reader (&bufferpool, column, signature);
+    std::vector<int64_t> pageBegins;
+    for (int pageId = 0; pageId < signature.leafPageCount; ++pageId) {
+      const FPageHeader *header = reinterpret_cast<const FPageHeader*> (bufferpool.readPage (signature, pageId));
+      BOOST_CHECK_EQUAL (header->level, 0);
+      pageBegins.push_back (header->beginningPos);
+    }
+    // page boundaries and their neighbors
+    std::vector<int64_t> positions;
+    positions.push_back (0);
+    for (int pageId = 1; pageId < signature.leafPageCount; ++pageId) {
+      positions.push_back (pageBegins[pageId] - 1);
+      positions.push_back (pageBegins[pageId]);
+      positions.push_back (pageBegins[pageId] + 1);
+    }
+    positions.push_back (tuples - 1);
+    for (size_t i = 0; i < positions.size(); ++i) {
+      int correct = std::upper_bound (pageBegins.begin(), pageBegins.end(), positions[i]) - pageBegins.begin() - 1;
+      BOOST_CHECK_EQUAL (reader.findLeafPageByPosition (positions[i]), correct);
+    }
+
+    for (size_t i = 0; i < positions.size(); i += 7) {
+      for (size_t j = i; j < positions.size(); j += 11) {
+        const PositionRange range (positions[i], positions[j] + 1);
+        pair<int, int> pageRange = reader.getPageRange (range);
+        BOOST_CHECK_EQUAL (pageRange.first, std::upper_bound (pageBegins.begin(), pageBegins.end(), range.begin) - pageBegins.begin() - 1);
+        BOOST_CHECK_EQUAL (pageRange.second, std::lower_bound (pageBegins.begin(), pageBegins.end(), range.end) - pageBegins.begin());
+
+        std::vector<int32_t> buffer (range.end - range.begin);
+        reader.getDecompressedData (range, &buffer[0], buffer.size() * sizeof(int32_t));
+        BOOST_CHECK (std::equal (buffer.begin(), buffer.end(), values.begin() + range.begin));
+
+        const int32_t middle = values[(range.begin + range.end) / 2];
+        int32_t searched[] = {values[range.begin] - 1, values[range.begin], middle, middle + 1, values[range.end - 1], values[range.end - 1] + 1};
+        for (int k = 0; k < 6; ++k) {
+          int64_t inclusive = std::lower_bound (values.begin() + range.begin, values.begin() + range.end, searched[k]) - values.begin();
+          int64_t exclusive = std::upper_bound (values.begin() + range.begin, values.begin() + range.end, searched[k]) - values.begin();
+          BOOST_CHECK_EQUAL (reader.findPositionByValue (&searched[k], true, range), inclusive);
+          BOOST_CHECK_EQUAL (reader.findPositionByValue (&searched[k], false, range), exclusive);
+        }
+      }
+    }
+  }
+  std::remove(filepath.c_str());
+  BOOST_TEST_MESSAGE("===Tested multi-level position index of RLE column.");
+}
+
+BOOST_AUTO_TEST_CASE(storage_cstore_symbol) {
+  BOOST_TEST_MESSAGE("===Testing Symbol compressed CStore column...");
+  {
+    const char values[4][12] = {"STANDARD", "STANDARD TI", "PROMO TIN", ""};
+    FSymbolTable table;
+    table.build (values[0], 12, 4, 12);
+    BOOST_CHECK (table.getSymbolCount() > 0);
+    BOOST_CHECK (table.getSymbolCount() <= FSymbolTable::MAX_SYMBOLS);
+    for (int i = 0; i < 4; ++i) {
+      std::string encoded = table.encode (values[i], 12);
+      BOOST_CHECK (encoded.size() < 12);
+      char decoded[12];
+      table.decode (reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size(), decoded, 12);
+      BOOST_CHECK (::memcmp (decoded, values[i], 12) == 0);
+    }
+    BOOST_CHECK_EQUAL (table.encode (values[3], 12).size(), 0);
+    // bytes not in the table are escaped
+    const char unknown[12] = "xyz";
+    std::string encoded = table.encode (unknown, 12);
+    char decoded[12];
+    table.decode (reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size(), decoded, 12);
+    BOOST_CHECK (::memcmp (decoded, unknown, 12) == 0);
+
+    // serialized table encodes the same
+    std::vector<char> serialized (table.getSymbolCount() * FSymbolTable::SERIALIZED_ENTRY_SIZE);
+    table.serialize (&serialized[0]);
+    FSymbolTable copied;
+    copied.deserialize (&serialized[0], table.getSymbolCount());
+    BOOST_CHECK (copied.encode (values[1], 12) == table.encode (values[1], 12));
+  }
+
+  FSignatureSet signatures;
+  signatures.load (TEST_DATA_FOLDER, "_tinyssb.sig");
+  BOOST_REQUIRE (signatures.size() > 0);
+  FBufferPool bufferpool (100);
+  FReadOnlyCStore part (&bufferpool, PART_PK_SORT, signatures, TEST_DATA_FOLDER, "part.bin");
+  FColumnReader *reader = part.getColumnReader("type");
+  BOOST_REQUIRE (reader->getColumn().compression == SYMBOL_COMPRESSED);
+  const int length = reader->getColumn().maxLength;
+  const int64_t tuples = 20; // all parts in tinyssb
+  boost::scoped_array<char> values (new char[tuples * length]);
+  reader->getDecompressedData(PositionRange (0, tuples), values.get(), tuples * length);
+  for (int64_t i = 0; i < tuples; ++i) {
+    // every value is like "STANDARD POLISHED TIN"
+    BOOST_CHECK (values[i * length] >= 'A' && values[i * length] <= 'Z');
+  }
+  {
+    boost::scoped_array<char> partial (new char[10 * length]);
+    reader->getDecompressedData(PositionRange (5, 15), partial.get(), 10 * length);
+    BOOST_CHECK (::memcmp (partial.get(), values.get() + 5 * length, 10 * length) == 0);
+  }
+
+  // EQUAL compares encoded values. LT decodes them. both agree with decompressed values.
+  reader->setSearchRange (PositionRange (0, tuples));
+  const char *key = values.get() + 7 * length;
+  SearchCondType types[] = {SCT_EQUAL, SCT_LT};
+  for (int t = 0; t < 2; ++t) {
+    SearchCond cond (types[t], key);
+    vector<boost::shared_ptr<PositionBitmap> > ret;
+    reader->getPositionBitmaps(cond, ret);
+    BOOST_REQUIRE_EQUAL (ret.size(), 1);
+    int matched = 0;
+    for (int64_t i = 0; i < tuples; ++i) {
+      bool correct = cond.matchString(values.get() + i * length, length);
+      BOOST_CHECK_EQUAL ((ret[0]->bitmap[i / 8] & (1 << (i % 8))) != 0, correct);
+      if (correct) ++matched;
+    }
+    BOOST_CHECK_EQUAL (ret[0]->matchedCount, matched);
+  }
+  reader->clearSearchRanges();
+
+  // only selected values are decoded
+  std::vector<int64_t> positions;
+  positions.push_back (3);
+  positions.push_back (15);
+  positions.push_back (19);
+  FSelection selection (positions);
+  boost::scoped_array<char> selected (new char[3 * length]);
+  reader->getDecompressedData(selection, selected.get(), 3 * length);
+  for (int i = 0; i < 3; ++i) {
+    BOOST_CHECK (::memcmp (selected.get() + i * length, values.get() + positions[i] * length, length) == 0);
+  }
+
+  BOOST_TEST_MESSAGE("===Tested Symbol compressed CStore column.");
+}
+
+BOOST_AUTO_TEST_CASE(storage_cstore_aggregate) {
+  BOOST_TEST_MESSAGE("===Testing compressed-domain aggregation...");
+  FSignatureSet signatures;
+  signatures.load (TEST_DATA_FOLDER, "_tinyssb.sig");
+  BOOST_REQUIRE (signatures.size() > 0);
+  FBufferPool bufferpool (100);
+
+  FReadOnlyCStore lineorder (&bufferpool, LINEORDER_PK_SORT, signatures, TEST_DATA_FOLDER, "lineorder.bin");
+  FColumnReader *reader = lineorder.getColumnReader("orderkey");
+  BOOST_REQUIRE (reader->getColumn().compression == RLE_COMPRESSED);
+
+  // orderkey: 1 x3, 2 x4, 3 x5, 4 x1, 5 x2, 6 x5.. (see storage_cstore_rle)
+  BOOST_CHECK_EQUAL (FColumnAggregator::sum(reader, PositionRange (0, 20)), 70);
+  BOOST_CHECK_EQUAL (FColumnAggregator::sum(reader, PositionRange (5, 8)), 2 + 2 + 3);
+
+  boost::shared_ptr<PositionBitmap> bitmap = PositionBitmap::newBitmap(0, 20);
+  bitmap->setBit(0);
+  bitmap->setBit(3);
+  bitmap->setBit(19);
+  BOOST_CHECK_EQUAL (FColumnAggregator::sum(reader, PositionRange (0, 20), AggregateFilter(bitmap.get())), 1 + 2 + 6);
+
+  int32_t key = 2;
+  BOOST_CHECK_EQUAL (FColumnAggregator::count(reader, SearchCond(SCT_EQUAL, &key), PositionRange (0, 20)), 4);
+  BOOST_CHECK_EQUAL (FColumnAggregator::count(reader, SearchCond(SCT_GT, &key), PositionRange (0, 20)), 13);
+
+  vector<pair<int64_t, int64_t> > groups;
+  FColumnAggregator::sumGroupByRLE(dynamic_cast<FColumnReaderRLE*>(reader), reader, PositionRange (0, 7), AggregateFilter(), groups);
+  BOOST_REQUIRE_EQUAL (groups.size(), 2);
+  BOOST_CHECK_EQUAL (groups[0].first, 1);
+  BOOST_CHECK_EQUAL (groups[0].second, 3);
+  BOOST_CHECK_EQUAL (groups[1].first, 2);
+  BOOST_CHECK_EQUAL (groups[1].second, 8);
+
+  BOOST_TEST_MESSAGE("===Tested compressed-domain aggregation.");
+}
+
+BOOST_AUTO_TEST_CASE(storage_cstore_cursor) {
+  BOOST_TEST_MESSAGE("===Testing chunked column cursor...");
+  FSignatureSet signatures;
+  signatures.load (TEST_DATA_FOLDER, "_tinyssb.sig");
+  BOOST_REQUIRE (signatures.size() > 0);
+  FBufferPool bufferpool (100);
+
+  FReadOnlyCStore lineorder (&bufferpool, LINEORDER_PK_SORT, signatures, TEST_DATA_FOLDER, "lineorder.bin");
+  FColumnReader *reader = lineorder.getColumnReader("orderkey");
+  int32_t buffer[20];
+  reader->getDecompressedData(PositionRange (0, 20), buffer, 20 * sizeof(int32_t));
+
+  vector<PositionRange> ranges;
+  ranges.push_back (PositionRange (0, 10));
+  ranges.push_back (PositionRange (12, 12));
+  ranges.push_back (PositionRange (12, 15));
+  FColumnCursor cursor (reader, ranges, 4);
+  int64_t expectedBegins[] = {0, 4, 8, 12};
+  int64_t expectedEnds[] = {4, 8, 10, 15};
+  size_t expectedRangeIndexes[] = {0, 0, 0, 2};
+  for (int i = 0; i < 4; ++i) {
+    BOOST_REQUIRE (cursor.next());
+    BOOST_CHECK_EQUAL (cursor.getCurrentRange().begin, expectedBegins[i]);
+    BOOST_CHECK_EQUAL (cursor.getCurrentRange().end, expectedEnds[i]);
+    BOOST_CHECK_EQUAL (cursor.getCurrentRangeIndex(), expectedRangeIndexes[i]);
+    const int32_t *values = cursor.getValues<int32_t>();
+    for (size_t j = 0; j < cursor.getCount(); ++j) {
+      BOOST_CHECK_EQUAL (values[j], buffer[expectedBegins[i] + j]);
+    }
+  }
+  BOOST_CHECK (!cursor.next());
+
+  BOOST_TEST_MESSAGE("===Tested chunked column cursor.");
+}
+
+BOOST_AUTO_TEST_CASE(storage_cstore_bitmap) {
+  BOOST_TEST_MESSAGE("===Testing compressed position bitmap...");
+  // sparse (array container) and dense (bitmap container) positions.
+  CompressedPositionBitmap a;
+  a.add (5);
+  a.add (3);
+  a.add (5);
+  a.add (70000);
+  a.addRange (PositionRange (200000, 210000));
+  BOOST_CHECK_EQUAL (a.count(), 3 + 10000);
+  BOOST_CHECK (a.contains(3));
+  BOOST_CHECK (!a.contains(4));
+  BOOST_CHECK (a.contains(209999));
+  BOOST_CHECK (!a.contains(210000));
+  BOOST_CHECK_EQUAL (a.count(PositionRange (4, 200010)), 1 + 1 + 10);
+
+  vector<PositionRange> ranges;
+  a.toRanges (ranges);
+  BOOST_REQUIRE_EQUAL (ranges.size(), 4);
+  BOOST_CHECK_EQUAL (ranges[0].begin, 3);
+  BOOST_CHECK_EQUAL (ranges[0].end, 4);
+  BOOST_CHECK_EQUAL (ranges[3].begin, 200000);
+  BOOST_CHECK_EQUAL (ranges[3].end, 210000);
+
+  CompressedPositionBitmap b;
+  b.addRange (PositionRange (0, 100));
+  b.addRange (PositionRange (205000, 300000));
+  CompressedPositionBitmap andResult (a);
+  andResult.andWith (b);
+  BOOST_CHECK_EQUAL (andResult.count(), 2 + 5000);
+  CompressedPositionBitmap orResult (a);
+  orResult.orWith (b);
+  BOOST_CHECK_EQUAL (orResult.count(), 100 + 1 + 100000);
+  CompressedPositionBitmap andNotResult (a);
+  andNotResult.andNotWith (b);
+  BOOST_CHECK_EQUAL (andNotResult.count(), 1 + 5000);
+  BOOST_CHECK (andNotResult.contains(70000));
+  BOOST_CHECK (!andNotResult.contains(205000));
+
+  CompressedPositionBitmap::Iterator it (andResult);
+  int64_t pos;
+  BOOST_REQUIRE (it.next(pos));
+  BOOST_CHECK_EQUAL (pos, 3);
+  BOOST_REQUIRE (it.next(pos));
+  BOOST_CHECK_EQUAL (pos, 5);
+  BOOST_REQUIRE (it.next(pos));
+  BOOST_CHECK_EQUAL (pos, 205000);
+
+  uint64_t words[2];
+  a.getWords (PositionRange (2, 70), words);
+  BOOST_CHECK_EQUAL (words[0], (uint64_t) 0xA);
+  BOOST_CHECK_EQUAL (words[1], (uint64_t) 0);
+
+  // same filter as storage_cstore_aggregate, but compressed.
+  FSignatureSet signatures;
+  signatures.load (TEST_DATA_FOLDER, "_tinyssb.sig");
+  BOOST_REQUIRE (signatures.size() > 0);
+  FBufferPool bufferpool (100);
+  FReadOnlyCStore lineorder (&bufferpool, LINEORDER_PK_SORT, signatures, TEST_DATA_FOLDER, "lineorder.bin");
+  FColumnReader *reader = lineorder.getColumnReader("orderkey");
+  CompressedPositionBitmap filter;
+  filter.add (0);
+  filter.add (3);
+  filter.add (19);
+  BOOST_CHECK_EQUAL (FColumnAggregator::sum(reader, PositionRange (0, 20), AggregateFilter(&filter)), 1 + 2 + 6);
+
+  // orderkey=2 is at [3, 7). RLE reader emits it as a range.
+  int32_t key = 2;
+  CompressedPositionBitmap matched;
+  reader->setSearchRange (PositionRange (0, 20));
+  reader->getPositionBitmap (SearchCond(SCT_EQUAL, &key), matched);
+  reader->clearSearchRanges ();
+  BOOST_CHECK_EQUAL (matched.count(), 4);
+  BOOST_CHECK (matched.contains(3));
+  BOOST_CHECK (!matched.contains(7));
+
+  BOOST_TEST_MESSAGE("===Tested compressed position bitmap.");
+}
+
+BOOST_AUTO_TEST_CASE(storage_cstore_selection) {
+  BOOST_TEST_MESSAGE("===Testing selection algebra...");
+  vector<PositionRange> ranges;
+  ranges.push_back (PositionRange (100, 200));
+  ranges.push_back (PositionRange (0, 50));
+  ranges.push_back (PositionRange (40, 60));
+  FSelection clustered (ranges);
+  BOOST_CHECK (clustered.getRepresentation() == FSelection::SELECTION_RANGES);
+  BOOST_CHECK_EQUAL (clustered.count(), 60 + 100);
+  BOOST_CHECK (clustered.contains(59));
+  BOOST_CHECK (!clustered.contains(60));
+
+  CompressedPositionBitmap bitmap;
+  for (int64_t pos = 0; pos < 100000; pos += 2) bitmap.add (pos);
+  FSelection scattered (bitmap);
+  BOOST_CHECK (scattered.getRepresentation() == FSelection::SELECTION_BITMAP);
+
+  // ranges AND bitmap -> small enough to be a position list
+  FSelection intersected (clustered);
+  intersected.intersectWith (scattered);
+  BOOST_CHECK (intersected.getRepresentation() == FSelection::SELECTION_POSITIONS);
+  BOOST_CHECK_EQUAL (intersected.count(), 30 + 50);
+  BOOST_CHECK (intersected.contains(102));
+  BOOST_CHECK (!intersected.contains(103));
+
+  FSelection united (clustered);
+  united.uniteWith (scattered);
+  BOOST_CHECK (united.getRepresentation() == FSelection::SELECTION_BITMAP);
+  BOOST_CHECK_EQUAL (united.count(), 50000 + 30 + 50);
+
+  vector<PositionRange> covering;
+  intersected.getCoveringRanges (covering, 10);
+  BOOST_REQUIRE_EQUAL (covering.size(), 2);
+  BOOST_CHECK_EQUAL (covering[0].begin, 0);
+  BOOST_CHECK_EQUAL (covering[0].end, 59);
+  BOOST_CHECK_EQUAL (covering[1].begin, 100);
+  BOOST_CHECK_EQUAL (covering[1].end, 199);
+
+  // orderkey: 1 x3, 2 x4, 3 x5, 4 x1, 5 x2, 6 x5.. (see storage_cstore_rle)
+  FSignatureSet signatures;
+  signatures.load (TEST_DATA_FOLDER, "_tinyssb.sig");
+  BOOST_REQUIRE (signatures.size() > 0);
+  FBufferPool bufferpool (100);
+  FReadOnlyCStore lineorder (&bufferpool, LINEORDER_PK_SORT, signatures, TEST_DATA_FOLDER, "lineorder.bin");
+  FColumnReader *reader = lineorder.getColumnReader("orderkey");
+  vector<int64_t> filterPositions;
+  filterPositions.push_back (2);
+  filterPositions.push_back (4);
+  filterPositions.push_back (8);
+  FSelection selection (filterPositions);
+  int32_t key = 1;
+  reader->getPositionSelection (SearchCond(SCT_GT, &key), selection, selection);
+  BOOST_CHECK_EQUAL (selection.count(), 2);
+  BOOST_CHECK (!selection.contains(2));
+  BOOST_CHECK (selection.contains(4));
+  BOOST_CHECK (selection.contains(8));
+
+  BOOST_TEST_MESSAGE("===Tested selection algebra.");
+}
+
+BOOST_AUTO_TEST_CASE(storage_cstore_late_materialization) {
+  BOOST_TEST_MESSAGE("===Testing reading selected positions...");
+  FSignatureSet signatures;
+  signatures.load (TEST_DATA_FOLDER, "_tinyssb.sig");
+  BOOST_REQUIRE (signatures.size() > 0);
+  FBufferPool bufferpool (100);
+  FReadOnlyCStore lineorder (&bufferpool, LINEORDER_PK_SORT, signatures, TEST_DATA_FOLDER, "lineorder.bin");
+
+  vector<int64_t> positions;
+  positions.push_back (1);
+  positions.push_back (5);
+  positions.push_back (6);
+  positions.push_back (19);
+  FSelection selection (positions);
+  BOOST_REQUIRE (selection.getRepresentation() == FSelection::SELECTION_POSITIONS);
+
+  // uncompressed, dictionary (4bit) and RLE (default implementation)
+  const char* columns[] = {"revenue", "orderpriority", "orderkey"};
+  for (int c = 0; c < 3; ++c) {
+    FColumnReader *reader = lineorder.getColumnReader(columns[c]);
+    const int length = reader->getColumn().maxLength;
+    boost::scoped_array<char> all (new char[20 * length]);
+    reader->getDecompressedData (PositionRange (0, 20), all.get(), 20 * length);
+    boost::scoped_array<char> selected (new char[5 * length]); // >= positions.size()
+    reader->getDecompressedData (selection, selected.get(), positions.size() * length);
+    for (size_t i = 0; i < positions.size(); ++i) {
+      BOOST_CHECK (::memcmp (selected.get() + i * length, all.get() + positions[i] * length, length) == 0);
+    }
+    // ranges are read as they are
+    FSelection rangeSelection (PositionRange (3, 8));
+    reader->getDecompressedData (rangeSelection, selected.get(), 5 * length);
+    BOOST_CHECK (::memcmp (selected.get(), all.get() + 3 * length, 5 * length) == 0);
+  }
+
+  // a predicate matching nothing comes first
+  int32_t noRevenue = -1;
+  int32_t anyKey = 0;
+  vector<ColumnPredicate> predicates;
+  predicates.push_back (ColumnPredicate (lineorder.getColumnReader("orderkey"), SearchCond(SCT_GT, &anyKey)));
+  predicates.push_back (ColumnPredicate (lineorder.getColumnReader("revenue"), SearchCond(SCT_EQUAL, &noRevenue)));
+  FSelection all (PositionRange (0, 20));
+  FSelectionPlanner::orderBySelectivity (predicates, all);
+  BOOST_CHECK_EQUAL (predicates[0].reader->getColumn().name, "revenue");
+  BOOST_CHECK_EQUAL (predicates[0].selectivity, 0);
+  BOOST_CHECK_EQUAL (predicates[1].selectivity, 1);
+  FSelectionPlanner::applyPredicates (predicates, all);
+  BOOST_CHECK (all.empty());
+
+  BOOST_TEST_MESSAGE("===Tested reading selected positions.");
+}
+
+BOOST_AUTO_TEST_CASE(storage_cstore_parallel_scan) {
+  BOOST_TEST_MESSAGE("===Testing parallel scan by morsels...");
+  vector<PositionRange> ranges;
+  ranges.push_back (PositionRange (5, 25));
+  ranges.push_back (PositionRange (30, 40));
+  vector<PositionRange> morsels;
+  FParallelScan::splitIntoMorsels (ranges, morsels, 10);
+  BOOST_REQUIRE_EQUAL (morsels.size(), 4);
+  BOOST_CHECK_EQUAL (morsels[0].begin, 5);
+  BOOST_CHECK_EQUAL (morsels[0].end, 10);
+  BOOST_CHECK_EQUAL (morsels[2].begin, 20);
+  BOOST_CHECK_EQUAL (morsels[2].end, 25);
+  BOOST_CHECK_EQUAL (morsels[3].begin, 30);
+  BOOST_CHECK_EQUAL (morsels[3].end, 40);
+
+  FSignatureSet signatures;
+  signatures.load (TEST_DATA_FOLDER, "_tinyssb.sig");
+  BOOST_REQUIRE (signatures.size() > 0);
+  FBufferPool bufferpool (100);
+  FDictionaryCache dictionaryCache;
+  // one projection (column readers) for each thread
+  vector<boost::shared_ptr<FReadOnlyCStore> > lineorders;
+  for (int i = 0; i < 4; ++i) {
+    lineorders.push_back (boost::shared_ptr<FReadOnlyCStore> (new FReadOnlyCStore (&bufferpool, LINEORDER_PK_SORT, signatures, TEST_DATA_FOLDER, "lineorder.bin", &dictionaryCache)));
+  }
+  const int64_t tuples = signatures.getCStoreFileSignatures(TEST_DATA_FOLDER, FCStoreUtil::getPhysicalDesignsOf(LINEORDER_PK_SORT), "lineorder.bin")[0].totalTupleCount;
+
+  // uncompressed, dictionary and RLE
+  const char* columns[] = {"revenue", "orderpriority", "orderkey"};
+  for (int c = 0; c < 3; ++c) {
+    vector<FColumnReader*> readers;
+    for (size_t i = 0; i < lineorders.size(); ++i) {
+      readers.push_back (lineorders[i]->getColumnReader(columns[c]));
+    }
+    const int length = readers[0]->getColumn().maxLength;
+    boost::scoped_array<char> sequential (new char[tuples * length]);
+    boost::scoped_array<char> parallel (new char[tuples * length]);
+    readers[0]->getDecompressedData (PositionRange (0, tuples), sequential.get(), tuples * length);
+    FParallelScan::getDecompressedData (readers, PositionRange (0, tuples), parallel.get(), tuples * length, 100);
+    BOOST_CHECK_MESSAGE (::memcmp (sequential.get(), parallel.get(), tuples * length) == 0, "column " << columns[c]);
+  }
+
+  vector<FColumnReader*> readers;
+  for (size_t i = 0; i < lineorders.size(); ++i) {
+    readers.push_back (lineorders[i]->getColumnReader("revenue"));
+  }
+  int32_t revenue = 3000000;
+  SearchCond cond (SCT_GT, &revenue);
+  vector<boost::shared_ptr<PositionBitmap> > sequentialBitmaps, parallelBitmaps;
+  readers[0]->setSearchRange (PositionRange (0, tuples));
+  readers[0]->getPositionBitmaps (cond, sequentialBitmaps);
+  readers[0]->clearSearchRanges ();
+  FParallelScan::getPositionBitmaps (readers, cond, vector<PositionRange> (1, PositionRange (0, tuples)), parallelBitmaps, 100);
+  int64_t sequentialCount = 0, parallelCount = 0;
+  for (size_t i = 0; i < sequentialBitmaps.size(); ++i) sequentialCount += sequentialBitmaps[i]->matchedCount;
+  for (size_t i = 0; i < parallelBitmaps.size(); ++i) {
+    parallelCount += parallelBitmaps[i]->matchedCount;
+    if (i > 0) BOOST_CHECK (parallelBitmaps[i - 1]->beginPosition < parallelBitmaps[i]->beginPosition);
+  }
+  BOOST_CHECK (sequentialCount > 0);
+  BOOST_CHECK_EQUAL (sequentialCount, parallelCount);
+  BOOST_TEST_MESSAGE("===Tested parallel scan by morsels.");
+}
+
+struct OperatorTestTuple {
+  int32_t value;
+  int8_t factor;
+  char name[4];
+};
+BOOST_AUTO_TEST_CASE(storage_operator_pipeline) {
+  BOOST_TEST_MESSAGE("===Testing vectorized operators...");
+  // SELECT name, SUM(value*factor) AS product WHERE value >= 1000 GROUP BY name
+  vector<FCStoreColumn> columns;
+  columns.push_back (FCStoreColumn ("value", COLUMN_INT32, offsetof(OperatorTestTuple, value), UNCOMPRESSED));
+  columns.push_back (FCStoreColumn ("factor", COLUMN_INT8, offsetof(OperatorTestTuple, factor), UNCOMPRESSED));
+  columns.push_back (FCStoreColumn ("name", COLUMN_CHAR, 4, offsetof(OperatorTestTuple, name), UNCOMPRESSED));
+  FAggregateOperator aggregate (vector<string> (1, "name"), "product");
+  FProjectOperator project ("product", "value", ARITHMETIC_MULTIPLY, "factor", &aggregate);
+  int32_t minValue = 1000;
+  FFilterOperator filter (columns[0], SearchCond (SCT_GTEQ, &minValue), &project);
+  FTupleBatcher batcher (columns, filter);
+  map<string, int64_t> expected;
+  const int tuples = FDB_VECTOR_SIZE * 2 + 100; // partial last batch
+  for (int i = 0; i < tuples; ++i) {
+    OperatorTestTuple tuple;
+    ::memset (&tuple, 0, sizeof(tuple));
+    tuple.value = i;
+    tuple.factor = i % 3;
+    tuple.name[0] = 'G';
+    tuple.name[1] = '0' + i % 4;
+    batcher.add (&tuple);
+    if (i >= minValue) expected[string (tuple.name, 4)] += i * (i % 3);
+  }
+  batcher.flush ();
+  filter.finish ();
+  BOOST_CHECK_EQUAL (batcher.getStats().tuplesIn, tuples);
+  BOOST_CHECK_EQUAL (filter.getStats().tuplesOut, tuples - minValue);
+  BOOST_CHECK_EQUAL (filter.getStats().batches, 3);
+  vector<vector<string> > keys;
+  vector<int64_t> sums;
+  aggregate.getGroups (keys, sums);
+  BOOST_REQUIRE_EQUAL (keys.size(), 4);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    BOOST_REQUIRE_EQUAL (keys[i].size(), 1);
+    BOOST_CHECK_EQUAL (sums[i], expected[keys[i][0]]);
+  }
+
+  // ORDER BY product DESC LIMIT 2
+  vector<pair<string, bool> > orders (1, pair<string, bool> ("product", false));
+  FSortLimitOperator sortLimit (orders, 2);
+  aggregate.emit (sortLimit);
+  const FBatch &result = sortLimit.getResult();
+  BOOST_REQUIRE_EQUAL (result.count, 2);
+  const FBatchColumn &products = result.columns[result.getColumnIndex("product")];
+  vector<int64_t> expectedSums;
+  for (map<string, int64_t>::const_iterator it = expected.begin(); it != expected.end(); ++it) expectedSums.push_back (it->second);
+  std::sort (expectedSums.rbegin(), expectedSums.rend());
+  BOOST_CHECK_EQUAL (products.ints[0], expectedSums[0]);
+  BOOST_CHECK_EQUAL (products.ints[1], expectedSums[1]);
+
+  // c-store source: same sums as FColumnAggregator, grouped on dictionary codes
+  FSignatureSet signatures;
+  signatures.load (TEST_DATA_FOLDER, "_tinyssb.sig");
+  BOOST_REQUIRE (signatures.size() > 0);
+  FBufferPool bufferpool (100);
+  FReadOnlyCStore lineorder (&bufferpool, LINEORDER_PK_SORT, signatures, TEST_DATA_FOLDER, "lineorder.bin");
+  const int64_t lineorderTuples = signatures.getCStoreFileSignatures(TEST_DATA_FOLDER, FCStoreUtil::getPhysicalDesignsOf(LINEORDER_PK_SORT), "lineorder.bin")[0].totalTupleCount;
+  vector<FColumnReader*> readers;
+  readers.push_back (lineorder.getColumnReader("orderpriority"));
+  readers.push_back (lineorder.getColumnReader("revenue"));
+  vector<bool> asCodes;
+  asCodes.push_back (true);
+  asCodes.push_back (false);
+  FAggregateOperator priorityAggregate (vector<string> (1, "orderpriority"), "revenue");
+  FColumnScan scan (readers, asCodes, vector<ColumnPredicate>());
+  scan.scan (PositionRange (0, lineorderTuples), priorityAggregate);
+  priorityAggregate.finish ();
+  BOOST_CHECK_EQUAL (scan.getStats().tuplesOut, lineorderTuples);
+  keys.clear();
+  sums.clear();
+  priorityAggregate.getGroups (keys, sums);
+  BOOST_CHECK (keys.size() > 1);
+  int64_t total = 0;
+  for (size_t i = 0; i < sums.size(); ++i) total += sums[i];
+  BOOST_CHECK_EQUAL (total, FColumnAggregator::sum (lineorder.getColumnReader("revenue"), PositionRange (0, lineorderTuples)));
+  BOOST_TEST_MESSAGE("===Tested vectorized operators.");
+}
+
+BOOST_AUTO_TEST_CASE(storage_aggregate_dense_hash) {
+  BOOST_TEST_MESSAGE("===Testing dense/hash aggregation...");
+  // SELECT value, SUM(factor) GROUP BY value, value in [0, 1024) only in the first batch
+  vector<FCStoreColumn> columns;
+  columns.push_back (FCStoreColumn ("value", COLUMN_INT32, offsetof(OperatorTestTuple, value), UNCOMPRESSED));
+  columns.push_back (FCStoreColumn ("factor", COLUMN_INT8, offsetof(OperatorTestTuple, factor), UNCOMPRESSED));
+  FAggregateOperator aggregate (vector<string> (1, "value"), "factor");
+  aggregate.setGroupDomain ("value", 0, FDB_VECTOR_SIZE / 4 - 1);
+  FAggregateOperator factorAggregate (vector<string> (1, "factor"), "value"); // INT8 is always dense
+  FTupleBatcher batcher (columns, aggregate);
+  FTupleBatcher factorBatcher (columns, factorAggregate);
+  map<int32_t, int64_t> expected;
+  map<int8_t, int64_t> expectedFactors;
+  const int tuples = FDB_VECTOR_SIZE * 3;
+  for (int i = 0; i < tuples; ++i) {
+    if (i == FDB_VECTOR_SIZE) {
+      BOOST_CHECK (aggregate.isDense());
+      BOOST_CHECK_EQUAL (aggregate.getGroupCount(), FDB_VECTOR_SIZE / 4);
+    }
+    OperatorTestTuple tuple;
+    ::memset (&tuple, 0, sizeof(tuple));
+    tuple.value = i / 4;
+    tuple.factor = i % 3 - 1;
+    batcher.add (&tuple);
+    factorBatcher.add (&tuple);
+    expected[tuple.value] += tuple.factor;
+    expectedFactors[tuple.factor] += tuple.value;
+  }
+  batcher.flush ();
+  factorBatcher.flush ();
+  BOOST_CHECK (!aggregate.isDense());
+  BOOST_CHECK (factorAggregate.isDense());
+
+  vector<vector<string> > keys;
+  vector<int64_t> sums;
+  aggregate.getGroups (keys, sums);
+  BOOST_REQUIRE_EQUAL (keys.size(), expected.size());
+  BOOST_CHECK_EQUAL (aggregate.getGroupCount(), expected.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    BOOST_REQUIRE_EQUAL (keys[i][0].size(), sizeof(int32_t));
+    int32_t value = *reinterpret_cast<const int32_t*>(keys[i][0].data());
+    BOOST_CHECK_EQUAL (sums[i], expected[value]);
+  }
+  keys.clear();
+  sums.clear();
+  factorAggregate.getGroups (keys, sums);
+  BOOST_REQUIRE_EQUAL (keys.size(), 3);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    BOOST_REQUIRE_EQUAL (keys[i][0].size(), sizeof(int8_t));
+    BOOST_CHECK_EQUAL (sums[i], expectedFactors[keys[i][0][0]]);
+  }
+}
+
+// LESS of FLoserTree on the heads of sorted int vectors
+struct LoserTreeTestLess {
+  LoserTreeTestLess (const vector<vector<int> > &sources_, const vector<size_t> &heads_) : sources(&sources_), heads(&heads_) {}
+  bool operator() (size_t a, size_t b) const { return (*sources)[a][(*heads)[a]] < (*sources)[b][(*heads)[b]]; }
+  const vector<vector<int> > *sources;
+  const vector<size_t> *heads;
+};
+BOOST_AUTO_TEST_CASE(storage_loser_tree) {
+  BOOST_TEST_MESSAGE("===Testing loser tree merge...");
+  for (size_t k = 1; k <= 11; ++k) {
+    vector<vector<int> > sources (k);
+    vector<pair<int, size_t> > expected; // <value, source>. ties go to the earlier source
+    vector<bool> finished;
+    for (size_t i = 0; i < k; ++i) {
+      size_t count = (i % 4 == 2) ? 0 : 10 + i * 3; // some sources are empty
+      for (size_t j = 0; j < count; ++j) sources[i].push_back ((int) ((j * 7 + i * 3) % 20));
+      std::sort (sources[i].begin(), sources[i].end());
+      for (size_t j = 0; j < count; ++j) expected.push_back (pair<int, size_t> (sources[i][j], i));
+      finished.push_back (count == 0);
+    }
+    std::sort (expected.begin(), expected.end());
+    vector<size_t> heads (k, 0);
+    FLoserTree<LoserTreeTestLess> tree (finished, LoserTreeTestLess (sources, heads));
+    size_t merged = 0;
+    for (int i = tree.top(); i >= 0; i = tree.top(), ++merged) {
+      BOOST_REQUIRE (merged < expected.size());
+      BOOST_CHECK_EQUAL (sources[i][heads[i]], expected[merged].first);
+      BOOST_CHECK_EQUAL ((size_t) i, expected[merged].second);
+      ++heads[i];
+      tree.pop (heads[i] < sources[i].size());
+    }
+    BOOST_CHECK_EQUAL (merged, expected.size());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(engine_cstore_catalog) {
+  BOOST_TEST_MESSAGE("===Testing c-store catalog in FEngine...");
+  FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_tinyssb.sig", 100);
+  boost::shared_ptr<FReadOnlyCStore> customer = engine.getReadOnlyCStore(CUSTOMER_PK_SORT, "customer.bin");
+  BOOST_REQUIRE (customer);
+  // each caller gets its own projection of the same files
+  boost::shared_ptr<FReadOnlyCStore> customer2 = engine.getReadOnlyCStore(CUSTOMER_PK_SORT, "customer.bin");
+  BOOST_CHECK (customer2 != customer);
+  BOOST_CHECK (customer2->getFileIds() == customer->getFileIds());
+
+  FColumnReaderDictionary *reader = dynamic_cast<FColumnReaderDictionary*>(customer->getColumnReader("nation"));
+  BOOST_REQUIRE (reader != NULL);
+  BOOST_CHECK_EQUAL (engine.getDictionaryCache().size(), 0);
+  const vector<string> &entries = reader->getAllDictionaryEntries();
+  BOOST_CHECK_EQUAL (engine.getDictionaryCache().size(), 1);
+
+  // other projection objects share the decoded dictionary
+  FColumnReaderDictionary *reader2 = dynamic_cast<FColumnReaderDictionary*>(customer2->getColumnReader("nation"));
+  BOOST_CHECK (&(reader2->getAllDictionaryEntries()) == &entries);
+  FReadOnlyCStore another (engine.getBufferPool(), CUSTOMER_PK_SORT, engine.getSignatureSet(), TEST_DATA_FOLDER, "customer.bin", &engine.getDictionaryCache());
+  FColumnReaderDictionary *anotherReader = dynamic_cast<FColumnReaderDictionary*>(another.getColumnReader("nation"));
+  BOOST_CHECK (&(anotherReader->getAllDictionaryEntries()) == &entries);
+
+  // search ranges of one caller don't restrict another's, so the RLE column is scanned fully
+  boost::shared_ptr<FReadOnlyCStore> lineorder = engine.getReadOnlyCStore(LINEORDER_PK_SORT, "lineorder.bin");
+  BOOST_REQUIRE (lineorder);
+  lineorder->getColumnReader("orderkey")->setSearchRange(PositionRange (0, 1));
+  boost::shared_ptr<FReadOnlyCStore> lineorder2 = engine.getReadOnlyCStore(LINEORDER_PK_SORT, "lineorder.bin");
+  vector<PositionRange> positions;
+  int32_t anyKey = 0;
+  lineorder2->getColumnReader("orderkey")->getPositionRanges(SearchCond(SCT_GT, &anyKey), positions);
+  BOOST_REQUIRE_EQUAL (positions.size(), 1);
+  BOOST_CHECK_EQUAL (positions[0].begin, 0);
+  BOOST_CHECK (positions[0].end > 1);
+  positions.clear();
+  lineorder->getColumnReader("orderkey")->getPositionRanges(SearchCond(SCT_GT, &anyKey), positions);
+  BOOST_REQUIRE_EQUAL (positions.size(), 1);
+  BOOST_CHECK_EQUAL (positions[0].end, 1);
+
+  BOOST_CHECK (engine.invalidateReadOnlyCStore("customer.bin"));
+  BOOST_CHECK (!engine.invalidateReadOnlyCStore("customer.bin"));
+  BOOST_CHECK_EQUAL (engine.getDictionaryCache().size(), 0);
+  // projections opened before invalidated stay readable
+  BOOST_CHECK (&(reader->getAllDictionaryEntries()) == &entries);
+  BOOST_CHECK (customer->getColumnReader("nation")->getColumn().name == "nation");
+  BOOST_TEST_MESSAGE("===Tested c-store catalog in FEngine.");
+}
+
 struct TestTupleSearchContext {
   int searchingFrom; // -1 if no restriction
   int searchingTo; // -1 if no restriction
@@ -930,6 +2017,7 @@ BOOST_AUTO_TEST_CASE(ssb_query) {
   family[1] = engine.createNewFractureFamily(BTREE_MV_FAMILY, MV_PROJECTION, false);
   FMainMemoryBTree fractureSorted (MV_PROJECTION, 10, true);
   FMainMemoryBTree fractureUnsorted (MV_PROJECTION, 10, false);
+  FMainMemoryCStore fractureCStore (MV_PROJECTION, 10);
   const char* REGIONS[] = {"AFRICA", "MIDDLE EAST", "ASIA", "ASIA", "MIDDLE EAST"};
   const char* CATEGORIES[] = {"MFGR#12", "MFGR#15", "MFGR#12", "MFGR#22", "MFGR#25"};
   const char* BRANDS[] = {"MFGR#3330", "MFGR#220", "MFGR#225", "MFGR#320", "MFGR#3332"};
@@ -954,6 +2042,7 @@ BOOST_AUTO_TEST_CASE(ssb_query) {
     DISC[i] = m.l_discount;
     fractureSorted.insert(&(m.key), &m);
     fractureUnsorted.insert(&(m.key), &m);
+    fractureCStore.insert(&(m.key), &m);
   }
 
   {
@@ -977,6 +2066,22 @@ BOOST_AUTO_TEST_CASE(ssb_query) {
         BOOST_CHECK_EQUAL (res->singleIntResult, 13456484 + (DISC[3] * PRI[3])); // i=3 hits
       }
     }
+
+    BOOST_TEST_MESSAGE("-- cstore with on-memory cstore fracture");
+    family[0]->setCurrentFracture(NULL);
+    family[0]->setCurrentCStoreFracture(&fractureCStore);
+    SSBQueryParam param;
+    param.ints.push_back (1996);
+    param.ints.push_back (1);
+    param.ints.push_back (5);
+    param.ints.push_back (30);
+    for (int sorted = 0; sorted < 2; ++sorted) {
+      if (sorted == 1) fractureCStore.finishInserts();
+      boost::shared_ptr<SSBQueryResult> res = exec.query(11, true, param);
+      BOOST_TEST_MESSAGE("  result:" << res->toString());
+      BOOST_CHECK_EQUAL (res->singleIntResult, 13456484 + (DISC[3] * PRI[3])); // i=3 hits
+    }
+    family[0]->setCurrentCStoreFracture(NULL);
   }
 
   {
@@ -1112,6 +2217,20 @@ BOOST_AUTO_TEST_CASE(ssb_query) {
         }
       }
     }
+
+    BOOST_TEST_MESSAGE("-- cstore with on-memory cstore fracture");
+    SSBQueryParam param;
+    param.strings.push_back ("MFGR#12");
+    param.strings.push_back ("ASIA");
+    family[0]->setCurrentFracture(&fractureSorted);
+    boost::shared_ptr<SSBQueryResult> expected = exec.query(21, true, param);
+    family[0]->setCurrentFracture(NULL);
+    family[0]->setCurrentCStoreFracture(&fractureCStore);
+    boost::shared_ptr<SSBQueryResult> res = exec.query(21, true, param);
+    BOOST_TEST_MESSAGE("  result:" << res->toString());
+    BOOST_CHECK_EQUAL (res->groupedResults.size(), 3);
+    BOOST_CHECK (res->groupedResults == expected->groupedResults);
+    family[0]->setCurrentCStoreFracture(NULL);
   }
 
   {
@@ -1305,6 +2424,74 @@ BOOST_AUTO_TEST_CASE(ssb_dbgen) {
   BOOST_TEST_MESSAGE("===Tested SSB customized dbgen.");
 }
 
+int compareNormalizedKeys (const FNormalizedKey &a, const FNormalizedKey &b) {
+  if (a < b) return -1;
+  return a == b ? 0 : 1;
+}
+int signOf (int value) {
+  return value < 0 ? -1 : (value > 0 ? 1 : 0);
+}
+
+BOOST_AUTO_TEST_CASE(ssb_mv_normalized_key) {
+  BOOST_TEST_MESSAGE("===Testing normalized keys of MVProjection...");
+  std::vector<MVProjection> tuples;
+  {
+    DBGen gen ("../../data/tinyssb/", 100);
+    for (int i = 0; i < 3; ++i) {
+      gen.generateNextBatch();
+      tuples.insert (tuples.end(), gen.getMVBuffer(), gen.getMVBuffer() + gen.getCurrentBatchSize());
+    }
+  }
+  MVProjection empty;
+  // normalize() refuses keys with non-zero padding, as memcmp() would order by it
+  ::memset (static_cast<void*>(&empty), 0, sizeof(MVProjection));
+  tuples.push_back (empty);
+  // keys sharing a prefix with others, different in the later columns
+  for (size_t i = 0; i < 10; ++i) {
+    MVProjection m = tuples[i];
+    m.key.d_year = tuples[i].key.d_year + 256; // differs in the second byte of d_year
+    tuples.push_back (m);
+    m.key.l_orderkey = tuples[i].key.l_orderkey + 1;
+    tuples.push_back (m);
+  }
+  NormalizeKeyFunc normalizeFunc = toNormalizeKeyFunc (MV_PROJECTION);
+  BOOST_REQUIRE (normalizeFunc != NULL);
+  BOOST_CHECK (toNormalizeKeyFunc (LINEORDER_PK_SORT) == NULL);
+  std::vector<FNormalizedKey> normalized (tuples.size());
+  for (size_t i = 0; i < tuples.size(); ++i) {
+    BOOST_REQUIRE (normalizeFunc (&(tuples[i].key), normalized[i]));
+  }
+  for (size_t i = 0; i < tuples.size(); ++i) {
+    for (size_t j = 0; j < tuples.size(); ++j) {
+      BOOST_CHECK_EQUAL (compareNormalizedKeys (normalized[i], normalized[j]), signOf (tuples[i].key.compare(tuples[j].key)));
+    }
+  }
+
+  // values out of the SSB domains are not normalized. such keys are compared as they are
+  MVProjection unknown = tuples[0];
+  ::memcpy (unknown.key.s_region, "ANTARCTICA", ::strlen("ANTARCTICA"));
+  FNormalizedKey dummy;
+  BOOST_CHECK (!normalizeFunc (&(unknown.key), dummy));
+  MVProjection padded = tuples[0];
+  reinterpret_cast<char*>(&padded.key)[offsetof(MVProjection::PKType, l_orderkey) - 1] = 1;
+  BOOST_CHECK (!normalizeFunc (&(padded.key), dummy));
+
+  for (int withUnknown = 0; withUnknown < 2; ++withUnknown) {
+    FMainMemoryBTree btree (MV_PROJECTION, tuples.size() + 1, false);
+    for (size_t i = tuples.size(); i > 0; --i) {
+      BOOST_REQUIRE (btree.insert(&(tuples[i - 1].key), &tuples[i - 1]));
+    }
+    if (withUnknown != 0) {
+      BOOST_REQUIRE (btree.insert(&(unknown.key), &unknown));
+    }
+    btree.finishInserts();
+    AscendingKeys<MVProjection::PKType> ascending;
+    btree.traverse(AscendingKeys<MVProjection::PKType>::callback, &ascending);
+    BOOST_CHECK_EQUAL (ascending.count, (int64_t) tuples.size() + withUnknown);
+  }
+  BOOST_TEST_MESSAGE("===Tested normalized keys of MVProjection.");
+}
+
 BOOST_AUTO_TEST_CASE(ssb_random_query) {
   BOOST_TEST_MESSAGE("===Testing SSB Random Queries...");
   FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_tinyssb.sig", 100);
@@ -1313,8 +2500,8 @@ BOOST_AUTO_TEST_CASE(ssb_random_query) {
   int seed = 1223345;
   SSBQueryParam param;
   map<int, int> m;
-  for (int i = 0; i < 50; ++i) {
-    int query = generateRandomQuery(seed);
+  for (int i = 0; i < 80; ++i) {
+    int query = generateRandomQuery(seed, true);
     map<int, int>::iterator it = m.find(query);
     if (it == m.end()) m[query] = 1;
     else ++(it->second);
@@ -1322,7 +2509,21 @@ BOOST_AUTO_TEST_CASE(ssb_random_query) {
     param.generateRandomParam(query, seed);
     boost::shared_ptr<SSBQueryResult> res = exec.query(query, false, param);
     BOOST_TEST_MESSAGE("  result:" << res->toString());
+
+    // c-store plans give the same result with any number of threads and morsels
+    exec.setParallelism (1);
+    boost::shared_ptr<SSBQueryResult> single = exec.query(query, true, param);
+    exec.setParallelism (4, 200);
+    boost::shared_ptr<SSBQueryResult> parallel = exec.query(query, true, param);
+    BOOST_CHECK_EQUAL (single->singleIntResult, parallel->singleIntResult);
+    BOOST_CHECK (single->groupedResults == parallel->groupedResults);
+    // BTree and c-store plans are the same plan on different sources
+    BOOST_CHECK_EQUAL (res->singleIntResult, single->singleIntResult);
+    BOOST_CHECK_MESSAGE (res->groupedResults == single->groupedResults, "Q" << query);
   }
+  // all flights are covered
+  BOOST_CHECK (m.find(31) != m.end());
+  BOOST_CHECK (m.find(43) != m.end());
   for (map<int, int>::const_iterator it = m.begin(); it != m.end(); ++it) {
     BOOST_TEST_MESSAGE("Q" << it->first << ":" << it->second);
   }
@@ -1387,8 +2588,8 @@ BOOST_AUTO_TEST_CASE(engine_family_merge_btree) {
       newNames.push_back (newName);
     }
     BOOST_CHECK_EQUAL (family->getOnDiskFractures().size(), 3);
-    BOOST_TEST_MESSAGE("-going to do 3 way merge");
-    std::string newName = family->mergeFractures(&engine, newNames, false, 1 << 21);
+    BOOST_TEST_MESSAGE("-going to do 3 way merge in 3 key ranges");
+    std::string newName = family->mergeFractures(&engine, newNames, false, 1 << 21, 3);
     const FFileSignature &sig = engine.getSignatureSet().getFileSignature(newName);
     BOOST_CHECK_EQUAL (family->getOnDiskFractures().size(), 1);
     BOOST_CHECK_EQUAL (sig.totalTupleCount, totalCount);
@@ -1396,6 +2597,8 @@ BOOST_AUTO_TEST_CASE(engine_family_merge_btree) {
     BOOST_TEST_MESSAGE("-reading the merged btree..");
     FReadOnlyDiskBTree merged (engine.getBufferPool(), sig);
     int finalCount = 0;
+    int unsorted = 0;
+    MVProjection previous;
     int64_t totalRev2 = 0;
     std::map<int32_t, int> yearmonthNumMap2;
     std::map<std::string, int> sRegionMap2;
@@ -1408,9 +2611,12 @@ BOOST_AUTO_TEST_CASE(engine_family_merge_btree) {
       countDistinctString (sRegionMap2, m.key.s_region, sizeof(m.key.s_region));
       countDistinctString (cCityMap2, m.key.c_city, sizeof(m.key.c_city));
       countDistinctString (pMfgrMap2, m.p_mfgr, sizeof(m.p_mfgr));
+      if (finalCount > 0 && MVProjection::compareTuple (&previous, &m) > 0) ++unsorted;
+      previous = m;
       ++finalCount;
     }
     BOOST_CHECK_EQUAL (finalCount, totalCount);
+    BOOST_CHECK_EQUAL (unsorted, 0);
     BOOST_CHECK_EQUAL (totalRev2, totalRev);
     BOOST_CHECK (yearmonthNumMap2 == yearmonthNumMap);
     BOOST_CHECK (sRegionMap2 == sRegionMap);
@@ -1533,3 +2739,752 @@ BOOST_AUTO_TEST_CASE(engine_family_merge_cstore) {
 
   BOOST_TEST_MESSAGE("===Tested Fracture Family Merging for CStore.");
 }
+
+FFractureStat makeFractureStat (const std::string &name, int64_t bytes, int64_t createdAt) {
+  FFractureStat stat;
+  stat.name = name;
+  stat.bytes = bytes;
+  stat.createdAt = createdAt;
+  return stat;
+}
+
+// dumps a BTree fracture of the next batch of gen, and adds it to the family.
+int addTestFracture (FEngine &engine, FFamily *family, DBGen &gen, const std::string &name) {
+  gen.generateNextBatch();
+  size_t batchSize = gen.getCurrentBatchSize();
+  FMainMemoryBTree fracture (MV_PROJECTION, 200, false);
+  MVProjection *mb = gen.getMVBuffer();
+  for (size_t j = 0; j < batchSize; ++j) {
+    fracture.insert(&(mb[j].key), &mb[j]);
+  }
+  fracture.finishInserts();
+  boost::recursive_mutex::scoped_lock catalogLock (engine.getCatalogMutex());
+  FFileSignature sig = engine.getSignatureSet().dumpToNewRowStoreFile(TEST_DATA_FOLDER, name, fracture);
+  family->addOnDiskFracture(sig.getFilepath());
+  return batchSize;
+}
+
+BOOST_AUTO_TEST_CASE(engine_compaction) {
+  BOOST_TEST_MESSAGE("===Testing background compaction...");
+  {
+    BOOST_TEST_MESSAGE("-policies");
+    std::vector<FFractureStat> fractures;
+    fractures.push_back (makeFractureStat ("big", 1000, 100));
+    fractures.push_back (makeFractureStat ("a", 10, 100));
+    fractures.push_back (makeFractureStat ("b", 15, 200));
+    fractures.push_back (makeFractureStat ("c", 12, 250));
+    std::vector<std::string> picked;
+    BOOST_CHECK (!FTieredCompactionPolicy (4, 8, 2.0).pick (fractures, 300, picked));
+    BOOST_CHECK (FTieredCompactionPolicy (3, 8, 2.0).pick (fractures, 300, picked));
+    BOOST_CHECK_EQUAL (picked.size(), 3);
+    BOOST_CHECK (std::find (picked.begin(), picked.end(), "big") == picked.end());
+
+    // levels: 0 (<= 20), 1 (<= 200), 2 (<= 2000)
+    FLeveledCompactionPolicy leveled (20, 10, 3);
+    BOOST_CHECK_EQUAL (leveled.getLevel (1000), 2);
+    picked.clear();
+    BOOST_CHECK (leveled.pick (fractures, 300, picked));
+    BOOST_CHECK_EQUAL (picked.size(), 3);
+    fractures.push_back (makeFractureStat ("big2", 1500, 300));
+    picked.clear();
+    BOOST_CHECK (FLeveledCompactionPolicy (20, 10, 4).pick (fractures, 300, picked));
+    BOOST_CHECK_EQUAL (picked.size(), 2); // big and big2 in level 2
+
+    // windows of 100 seconds: [100, 200), [200, 300), [300, ..)
+    FTimeWindowCompactionPolicy windowed (100, 3);
+    picked.clear();
+    BOOST_CHECK (windowed.pick (fractures, 300, picked));
+    BOOST_CHECK_EQUAL (picked.size(), 2); // the oldest closed window
+    BOOST_CHECK_EQUAL (picked[0], "big");
+    BOOST_CHECK_EQUAL (picked[1], "a");
+    picked.clear();
+    BOOST_CHECK (!windowed.pick (fractures, 150, picked)); // fewer than 3 in the current window
+  }
+  {
+    std::remove((TEST_DATA_FOLDER + string("_compaction.sig")).c_str());
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_compaction.sig", 100);
+    FFamily *family = engine.createNewFractureFamily("test_compaction_family", MV_PROJECTION, false);
+    FCompactionScheduler &scheduler = engine.getCompactionScheduler();
+    DBGen gen ("../../data/tinyssb/", 100);
+
+    BOOST_TEST_MESSAGE("-compaction in the calling thread");
+    int totalCount = 0;
+    for (int i = 0; i < 4; ++i) {
+      stringstream str;
+      str << "btree_forcompaction_" << i << ".db";
+      totalCount += addTestFracture (engine, family, gen, str.str());
+    }
+    BOOST_CHECK_EQUAL (scheduler.runOnce(), 0); // no policy
+    scheduler.setPolicy ("test_compaction_family", boost::shared_ptr<FCompactionPolicy>(new FTieredCompactionPolicy(4, 8, 100.0)));
+    BOOST_CHECK_EQUAL (scheduler.runOnce(), 1);
+    BOOST_REQUIRE_EQUAL (family->getOnDiskFractures().size(), 1);
+    BOOST_CHECK_EQUAL (engine.getSignatureSet().getFileSignature(family->getOnDiskFractures()[0]).totalTupleCount, totalCount);
+    BOOST_CHECK (family->getOnDiskFractureTime(family->getOnDiskFractures()[0]) > 0);
+    BOOST_CHECK_EQUAL (scheduler.runOnce(), 0);
+    FCompactionStats stats = scheduler.getStats("test_compaction_family");
+    BOOST_CHECK_EQUAL (stats.merges, 1);
+    BOOST_CHECK_EQUAL (stats.mergedFractures, 4);
+    BOOST_CHECK_EQUAL (stats.fractureCount, 1);
+    BOOST_CHECK (stats.bytesIngested > 0);
+    BOOST_CHECK_EQUAL (stats.bytesRead, stats.bytesIngested);
+    BOOST_CHECK (stats.getWriteAmplification() > 1.0);
+
+    BOOST_TEST_MESSAGE("-compaction in background");
+    scheduler.setPolicy ("test_compaction_family", boost::shared_ptr<FCompactionPolicy>(new FTieredCompactionPolicy(2, 8, 100.0)));
+    scheduler.setBytesPerSecond (1LL << 30);
+    scheduler.start (10);
+    BOOST_CHECK (scheduler.isRunning());
+    totalCount += addTestFracture (engine, family, gen, "btree_forcompaction_4.db");
+    for (int i = 0; i < 1000 && scheduler.getStats("test_compaction_family").merges < 2; ++i) {
+      boost::this_thread::sleep (boost::posix_time::milliseconds(10));
+    }
+    scheduler.stop();
+    BOOST_CHECK (!scheduler.isRunning());
+    BOOST_CHECK_EQUAL (scheduler.getStats("test_compaction_family").merges, 2);
+    BOOST_REQUIRE_EQUAL (family->getOnDiskFractures().size(), 1);
+    BOOST_CHECK_EQUAL (engine.getSignatureSet().getFileSignature(family->getOnDiskFractures()[0]).totalTupleCount, totalCount);
+  }
+  BOOST_TEST_MESSAGE("===Tested background compaction.");
+}
+
+bool existsTestFile (const std::string &filepath) {
+  std::ifstream file (filepath.c_str());
+  return file.good();
+}
+
+BOOST_AUTO_TEST_CASE(engine_fracture_snapshot) {
+  BOOST_TEST_MESSAGE("===Testing fracture snapshots...");
+  {
+    std::remove((TEST_DATA_FOLDER + string("_snapshot.sig")).c_str());
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_snapshot.sig", 100);
+    FFamily *family = engine.createNewFractureFamily("test_snapshot_family", MV_PROJECTION, false);
+    DBGen gen ("../../data/tinyssb/", 100);
+    BOOST_CHECK_EQUAL (family->acquireSnapshot()->fractures.size(), 0);
+
+    int totalCount = 0;
+    for (int i = 0; i < 3; ++i) {
+      stringstream str;
+      str << "btree_forsnapshot_" << i << ".db";
+      totalCount += addTestFracture (engine, family, gen, str.str());
+    }
+    FFractureSnapshotPtr snapshot = family->acquireSnapshot();
+    BOOST_REQUIRE_EQUAL (snapshot->fractures.size(), 3);
+    BOOST_CHECK_EQUAL (snapshot->version, 3);
+    std::vector<std::string> names = family->getOnDiskFractures();
+
+    BOOST_TEST_MESSAGE("-merging while a snapshot is held");
+    std::string mergedName = family->mergeFractures(&engine, names, true, 1 << 20);
+    FFractureSnapshotPtr latest = family->acquireSnapshot();
+    BOOST_CHECK_EQUAL (latest->version, 4);
+    BOOST_REQUIRE_EQUAL (latest->fractures.size(), 1);
+    BOOST_CHECK_EQUAL (latest->fractures[0]->getName(), mergedName);
+    BOOST_CHECK_EQUAL (latest->fractures[0]->getSignatures()[0].totalTupleCount, totalCount);
+
+    // the old fractures are still readable through the snapshot
+    int snapshotCount = 0;
+    for (size_t i = 0; i < snapshot->fractures.size(); ++i) {
+      BOOST_CHECK (existsTestFile (names[i]));
+      BOOST_CHECK (!engine.getSignatureSet().existsFile(names[i]));
+      FReadOnlyDiskBTree btree (engine.getBufferPool(), snapshot->fractures[i]->getSignatures()[0]);
+      for (FReadOnlyDiskBTree::LeafPageIterator iter = btree.scanLeafPages(); iter.hasCurrent(); ++iter) {
+        ++snapshotCount;
+      }
+    }
+    BOOST_CHECK_EQUAL (snapshotCount, totalCount);
+
+    BOOST_TEST_MESSAGE("-releasing the snapshot");
+    snapshot.reset();
+    for (size_t i = 0; i < names.size(); ++i) {
+      BOOST_CHECK (!existsTestFile (names[i]));
+    }
+    BOOST_CHECK (existsTestFile (mergedName));
+
+    // erasing without deleteFiles keeps the file
+    BOOST_CHECK (family->eraseOnDiskFracture(mergedName));
+    latest.reset();
+    BOOST_CHECK_EQUAL (family->acquireSnapshot()->fractures.size(), 0);
+    BOOST_CHECK (existsTestFile (mergedName));
+  }
+  BOOST_TEST_MESSAGE("===Tested fracture snapshots.");
+}
+
+BOOST_AUTO_TEST_CASE(engine_family_ingest) {
+  BOOST_TEST_MESSAGE("===Testing automatic flush of current fractures...");
+  for (int cstore = 0; cstore < 2; ++cstore) {
+    BOOST_TEST_MESSAGE("-" << (cstore ? "c-store" : "btree") << " family");
+    std::remove((TEST_DATA_FOLDER + string("_ingest.sig")).c_str());
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_ingest.sig", 100);
+    FFamily *family = engine.createNewFractureFamily(cstore ? "test_ingest_cstore" : "test_ingest_btree", MV_PROJECTION, cstore);
+    DBGen gen ("../../data/tinyssb/", 100);
+    const int MAX_TUPLES = 64;
+    family->startIngest (MAX_TUPLES);
+    BOOST_CHECK (family->isIngesting());
+    int totalCount = 0;
+    for (int i = 0; i < 3; ++i) {
+      gen.generateNextBatch();
+      MVProjection *mb = gen.getMVBuffer();
+      for (size_t j = 0; j < gen.getCurrentBatchSize(); ++j) {
+        BOOST_CHECK (family->insert(&(mb[j].key), &mb[j]));
+        ++totalCount;
+      }
+    }
+    // sealed fractures are never larger than the limit
+    int64_t current = cstore ? family->getCurrentCStoreFracture()->size() : family->getCurrentFracture()->size();
+    BOOST_CHECK (current < MAX_TUPLES);
+    BOOST_CHECK_EQUAL (family->getIngestStats().sealedFractures, totalCount / MAX_TUPLES);
+    family->flush();
+    BOOST_CHECK_EQUAL (family->getSealedFractureCount(), 0);
+    FIngestStats stats = family->getIngestStats();
+    BOOST_CHECK_EQUAL (stats.sealedFractures, (totalCount + MAX_TUPLES - 1) / MAX_TUPLES);
+    BOOST_CHECK_EQUAL (stats.dumpedFractures, stats.sealedFractures);
+    BOOST_CHECK_EQUAL (stats.failedDumps, 0);
+    BOOST_CHECK_EQUAL (stats.dumpedTuples, totalCount);
+
+    FFractureSnapshotPtr snapshot = family->acquireSnapshot();
+    BOOST_REQUIRE_EQUAL ((int64_t) snapshot->fractures.size(), stats.dumpedFractures);
+    int64_t dumpedCount = 0;
+    for (size_t i = 0; i < snapshot->fractures.size(); ++i) {
+      dumpedCount += snapshot->fractures[i]->getSignatures()[0].totalTupleCount;
+    }
+    BOOST_CHECK_EQUAL (dumpedCount, totalCount);
+    if (cstore) {
+      FReadOnlyCStore cs (engine.getBufferPool(), MV_PROJECTION, snapshot->fractures.back()->getSignatures());
+      BOOST_CHECK_EQUAL (cs.getFileIds().size(), snapshot->fractures.back()->getSignatures().size());
+    } else {
+      FReadOnlyDiskBTree btree (engine.getBufferPool(), snapshot->fractures[0]->getSignatures()[0]);
+      int unsorted = 0, count = 0;
+      MVProjection previous;
+      for (FReadOnlyDiskBTree::LeafPageIterator iter = btree.scanLeafPages(); iter.hasCurrent(); ++iter) {
+        const MVProjection &m = *reinterpret_cast<const MVProjection *> (*iter);
+        if (count > 0 && MVProjection::compareTuple (&previous, &m) > 0) ++unsorted;
+        previous = m;
+        ++count;
+      }
+      BOOST_CHECK_EQUAL (count, MAX_TUPLES);
+      BOOST_CHECK_EQUAL (unsorted, 0);
+    }
+  }
+  BOOST_TEST_MESSAGE("===Tested automatic flush of current fractures.");
+}
+
+// runs a query of each flight on both MV projections. the parameters are the same in every call.
+void runIngestQueries (SSBQueryExecutor &exec, std::vector<boost::shared_ptr<SSBQueryResult> > &results) {
+  const int QUERIES[] = {11, 12, 13, 21, 22, 23, 31, 32, 33, 34, 41, 42, 43};
+  int seed = 98765;
+  SSBQueryParam param;
+  for (size_t i = 0; i < sizeof(QUERIES) / sizeof(int); ++i) {
+    param.generateRandomParam(QUERIES[i], seed);
+    for (int cstore = 0; cstore < 2; ++cstore) {
+      results.push_back (exec.query(QUERIES[i], cstore == 1, param));
+    }
+  }
+}
+bool isSameResult (const SSBQueryResult &left, const SSBQueryResult &right) {
+  return left.singleIntResult == right.singleIntResult && left.groupedResults == right.groupedResults;
+}
+
+BOOST_AUTO_TEST_CASE(engine_family_ingest_query) {
+  BOOST_TEST_MESSAGE("===Testing queries on families while ingesting...");
+  // a copy of the catalog, as dumped fractures are added to it
+  const std::string sigFile = string(TEST_DATA_FOLDER) + "_ingestquery.sig";
+  {
+    std::ifstream in ((string(TEST_DATA_FOLDER) + "_tinyssb.sig").c_str(), ios::binary);
+    std::ofstream out (sigFile.c_str(), ios::binary | ios::trunc);
+    out << in.rdbuf();
+  }
+  std::vector<MVProjection> tuples;
+  {
+    DBGen gen ("../../data/tinyssb/", 100);
+    for (int i = 0; i < 3; ++i) {
+      gen.generateNextBatch();
+      tuples.insert (tuples.end(), gen.getMVBuffer(), gen.getMVBuffer() + gen.getCurrentBatchSize());
+    }
+  }
+  const int64_t N = tuples.size();
+  // two sealed fractures and a current one
+  const int64_t MAX_TUPLES = N / 3 + 1;
+  BOOST_REQUIRE (FDB_MAX_SEALED_FRACTURES >= 2);
+  {
+    FEngine engine (TEST_DATA_FOLDER, sigFile, 100);
+    SSBQueryExecutor exec(&engine);
+    FFamily *families[2];
+    families[0] = engine.createNewFractureFamily(CSTORE_MV_FAMILY, MV_PROJECTION, true);
+    families[1] = engine.createNewFractureFamily(BTREE_MV_FAMILY, MV_PROJECTION, false);
+    std::vector<boost::shared_ptr<SSBQueryResult> > base, expected;
+    runIngestQueries (exec, base);
+
+    BOOST_TEST_MESSAGE("-the tuples in current fractures, never sealed");
+    {
+      FMainMemoryCStore currentCStore (MV_PROJECTION, N);
+      FMainMemoryBTree current (MV_PROJECTION, N, false);
+      for (int64_t i = 0; i < N; ++i) {
+        BOOST_REQUIRE (currentCStore.insert (&(tuples[i].key), &tuples[i]));
+        BOOST_REQUIRE (current.insert (&(tuples[i].key), &tuples[i]));
+      }
+      families[0]->setCurrentCStoreFracture (&currentCStore);
+      families[1]->setCurrentFracture (&current);
+      runIngestQueries (exec, expected);
+      families[0]->setCurrentCStoreFracture (NULL);
+      families[1]->setCurrentFracture (NULL);
+    }
+    int changed = 0;
+    for (size_t i = 0; i < base.size(); ++i) {
+      if (!isSameResult (*base[i], *expected[i])) ++changed;
+    }
+    BOOST_CHECK (changed > 0);
+
+    for (int dumped = 0; dumped < 2; ++dumped) {
+      std::vector<boost::shared_ptr<SSBQueryResult> > results;
+      if (dumped == 0) {
+        BOOST_TEST_MESSAGE("-the tuples in sealed fractures waiting for the dumper");
+        // the dumper can't add fractures to the catalog while this thread locks it
+        boost::recursive_mutex::scoped_lock catalogLock (engine.getCatalogMutex());
+        for (int f = 0; f < 2; ++f) {
+          families[f]->startIngest (MAX_TUPLES);
+          for (int64_t i = 0; i < N; ++i) {
+            BOOST_REQUIRE (families[f]->insert(&(tuples[i].key), &tuples[i]));
+          }
+          BOOST_CHECK_EQUAL (families[f]->getSealedFractureCount(), 2);
+          BOOST_CHECK_EQUAL (families[f]->acquireSnapshot()->sealed.size(), 2);
+          BOOST_CHECK_EQUAL (families[f]->acquireSnapshot()->fractures.size(), 0);
+        }
+        runIngestQueries (exec, results);
+      } else {
+        BOOST_TEST_MESSAGE("-the tuples dumped to on-disk fractures");
+        for (int f = 0; f < 2; ++f) {
+          families[f]->flush();
+          BOOST_CHECK_EQUAL (families[f]->acquireSnapshot()->sealed.size(), 0);
+          BOOST_CHECK_EQUAL (families[f]->acquireSnapshot()->fractures.size(), 3);
+        }
+        runIngestQueries (exec, results);
+      }
+      BOOST_REQUIRE_EQUAL (results.size(), expected.size());
+      for (size_t i = 0; i < results.size(); ++i) {
+        BOOST_CHECK_EQUAL (results[i]->singleIntResult, expected[i]->singleIntResult);
+        BOOST_CHECK_MESSAGE (isSameResult (*results[i], *expected[i]), "query " << i);
+      }
+    }
+
+    for (int f = 0; f < 2; ++f) {
+      boost::recursive_mutex::scoped_lock catalogLock (engine.getCatalogMutex());
+      std::vector<std::string> names = families[f]->getOnDiskFractures();
+      for (size_t i = 0; i < names.size(); ++i) {
+        BOOST_CHECK (families[f]->eraseOnDiskFracture (names[i], true));
+      }
+    }
+  }
+  std::remove (sigFile.c_str());
+  BOOST_TEST_MESSAGE("===Tested queries on families while ingesting.");
+}
+
+BOOST_AUTO_TEST_CASE(engine_family_dump_retry) {
+  BOOST_TEST_MESSAGE("===Testing retries of failed dumps...");
+  std::remove((TEST_DATA_FOLDER + string("_dumpretry.sig")).c_str());
+  // a non-empty directory takes the first name issued to a sealed fracture, so its dump fails once
+  const std::string blocker = string(TEST_DATA_FOLDER) + "test_dumpretry.s0";
+  makeTestDirectory (blocker);
+  std::ofstream ((blocker + "/file").c_str()) << "not removable";
+  {
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_dumpretry.sig", 100);
+    FFamily *family = engine.createNewFractureFamily("test_dumpretry", MV_PROJECTION, false);
+    DBGen gen ("../../data/tinyssb/", 100);
+    gen.generateNextBatch();
+    const int64_t count = gen.getCurrentBatchSize();
+    family->startIngest (count + 1);
+    MVProjection *mb = gen.getMVBuffer();
+    for (int64_t i = 0; i < count; ++i) {
+      BOOST_REQUIRE (family->insert(&(mb[i].key), &mb[i]));
+    }
+    family->flush(); // waits for the retry
+    FIngestStats stats = family->getIngestStats();
+    BOOST_CHECK_EQUAL (stats.failedDumps, 1);
+    BOOST_CHECK_EQUAL (stats.dumpedFractures, 1);
+    BOOST_CHECK_EQUAL (stats.dumpedTuples, count);
+    FFractureSnapshotPtr snapshot = family->acquireSnapshot();
+    BOOST_CHECK_EQUAL (snapshot->sealed.size(), 0);
+    BOOST_REQUIRE_EQUAL (snapshot->fractures.size(), 1);
+    BOOST_CHECK (snapshot->fractures[0]->getName() != blocker);
+    BOOST_CHECK_EQUAL (snapshot->fractures[0]->getSignatures()[0].totalTupleCount, count);
+    const std::string dumped = snapshot->fractures[0]->getSignatures()[0].getFilepath();
+    snapshot.reset();
+    BOOST_CHECK (existsTestFile (dumped));
+    boost::recursive_mutex::scoped_lock catalogLock (engine.getCatalogMutex());
+    // the name refers to the erased element itself
+    BOOST_CHECK (family->eraseOnDiskFracture (family->getOnDiskFractures()[0], true));
+    BOOST_CHECK (!existsTestFile (dumped));
+  }
+  std::remove ((blocker + "/file").c_str());
+  removeTestDirectory (blocker);
+  std::remove((TEST_DATA_FOLDER + string("_dumpretry.sig")).c_str());
+  BOOST_TEST_MESSAGE("===Tested retries of failed dumps.");
+}
+
+struct FamilyBatchWriter {
+  void operator()() {
+    *succeeded = 1;
+    for (int64_t i = begin; i < end; i += 100) {
+      if (!family->insertBatch(tuples + i, std::min<int64_t> (100, end - i))) {
+        *succeeded = 0;
+      }
+    }
+  }
+  FFamily *family;
+  const MVProjection *tuples;
+  int64_t begin, end;
+  char *succeeded;
+};
+
+BOOST_AUTO_TEST_CASE(engine_family_concurrent_ingest) {
+  BOOST_TEST_MESSAGE("===Testing concurrent ingest to a family...");
+  std::remove((TEST_DATA_FOLDER + string("_concurrent.sig")).c_str());
+  const int WRITERS = 4;
+  {
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_concurrent.sig", 100);
+    FFamily *family = engine.createNewFractureFamily("test_concurrent", MV_PROJECTION, false);
+    DBGen gen ("../../data/tinyssb/", 100);
+    gen.generateNextBatch();
+    const int64_t count = gen.getCurrentBatchSize();
+    family->startIngest (count / 3 + 1, 0, false, true);
+    const MVProjection *mb = gen.getMVBuffer();
+    std::vector<char> succeeded (WRITERS, 0);
+    boost::thread_group writers;
+    for (int w = 0; w < WRITERS; ++w) {
+      FamilyBatchWriter writer = {family, mb, count * w / WRITERS, count * (w + 1) / WRITERS, &succeeded[w]};
+      writers.create_thread (writer);
+    }
+    writers.join_all();
+    family->commit ();
+    family->flush ();
+    BOOST_CHECK_EQUAL (std::count (succeeded.begin(), succeeded.end(), 1), WRITERS);
+    FIngestStats stats = family->getIngestStats();
+    BOOST_CHECK_EQUAL (stats.dumpedTuples, count);
+    BOOST_CHECK (stats.dumpedFractures >= 3);
+    FFractureSnapshotPtr snapshot = family->acquireSnapshot();
+    int64_t total = 0;
+    for (size_t i = 0; i < snapshot->fractures.size(); ++i) {
+      total += snapshot->fractures[i]->getSignatures()[0].totalTupleCount;
+    }
+    BOOST_CHECK_EQUAL (total, count);
+    snapshot.reset();
+    // only the log of the new current fracture remains
+    BOOST_CHECK_EQUAL (FWriteAheadLog::listFiles (TEST_DATA_FOLDER, "test_concurrent.wal.").size(), 1);
+    boost::recursive_mutex::scoped_lock catalogLock (engine.getCatalogMutex());
+    while (!family->getOnDiskFractures().empty()) {
+      family->eraseOnDiskFracture (family->getOnDiskFractures()[0], true);
+    }
+  }
+  std::vector<std::string> logs = FWriteAheadLog::listFiles (TEST_DATA_FOLDER, "test_concurrent.wal.");
+  for (size_t i = 0; i < logs.size(); ++i) {
+    std::remove ((TEST_DATA_FOLDER + logs[i]).c_str());
+  }
+  std::remove((TEST_DATA_FOLDER + string("_concurrent.sig")).c_str());
+  BOOST_TEST_MESSAGE("===Tested concurrent ingest to a family.");
+}
+
+void countReplayedRecord (void *context, const void *record, int size) {
+  std::vector<int> *records = reinterpret_cast<std::vector<int>*>(context);
+  BOOST_CHECK_EQUAL (size, (int) ((records->size() % 100) + 1) * (int) sizeof(int));
+  records->push_back (*reinterpret_cast<const int*>(record));
+}
+
+BOOST_AUTO_TEST_CASE(io_write_ahead_log) {
+  BOOST_TEST_MESSAGE("===Testing write-ahead log...");
+  const std::string filepath = string(TEST_DATA_FOLDER) + "_test.wal";
+  const int RECORDS = 5000;
+  {
+    FWriteAheadLog wal (filepath, FDB_USE_DIRECT_IO, 1 << 16);
+    std::vector<int> record (100);
+    for (int i = 0; i < RECORDS; ++i) {
+      // records of various sizes crossing blocks
+      std::fill (record.begin(), record.end(), i);
+      BOOST_CHECK_EQUAL (wal.append (&record[0], ((i % 100) + 1) * sizeof(int)), i + 1);
+      if (i % 1000 == 999) {
+        wal.commit ();
+        BOOST_CHECK_EQUAL (wal.getDurableLsn(), i + 1);
+      }
+    }
+    BOOST_CHECK_EQUAL (wal.getLastLsn(), RECORDS);
+    // many records per fsync
+    BOOST_CHECK (wal.getCommitCount() < RECORDS / 50);
+  }
+  std::vector<int> records;
+  BOOST_CHECK_EQUAL (FWriteAheadLog::replay (filepath, countReplayedRecord, &records), RECORDS);
+  BOOST_REQUIRE_EQUAL (records.size(), RECORDS);
+  for (int i = 0; i < RECORDS; ++i) {
+    BOOST_CHECK_EQUAL (records[i], i);
+  }
+
+  BOOST_TEST_MESSAGE("-replaying a corrupted log");
+  {
+    std::fstream file (filepath.c_str(), ios::in | ios::out | ios::binary);
+    file.seekp (50000);
+    file.write ("broken", 6);
+  }
+  records.clear();
+  int64_t replayed = FWriteAheadLog::replay (filepath, countReplayedRecord, &records);
+  BOOST_CHECK (replayed > 0);
+  BOOST_CHECK (replayed < RECORDS);
+  BOOST_CHECK_EQUAL (FWriteAheadLog::listFiles (TEST_DATA_FOLDER, "_test.wa").size(), 1);
+  std::remove (filepath.c_str());
+  BOOST_TEST_MESSAGE("===Tested write-ahead log.");
+}
+
+// fails the failAt-th write (1, 2, ...) without writing anything
+class FailingOutputStream : public DirectFileOutputStream {
+public:
+  FailingOutputStream (const std::string &name, int failAt) : DirectFileOutputStream (name, false), _writes(0), _failAt(failAt) {}
+  virtual int64_t write (const void *buffer, int64_t size) {
+    if (++_writes == _failAt) {
+      throw std::runtime_error("injected failure");
+    }
+    return DirectFileOutputStream::write (buffer, size);
+  }
+private:
+  int _writes;
+  int _failAt;
+};
+
+BOOST_AUTO_TEST_CASE(io_write_ahead_log_failure) {
+  BOOST_TEST_MESSAGE("===Testing failures of write-ahead log...");
+  const std::string filepath = string(TEST_DATA_FOLDER) + "_failing.wal";
+  std::remove (filepath.c_str());
+  std::vector<int> record (100);
+  {
+    FWriteAheadLog wal (new FailingOutputStream (filepath, 2), filepath, false, 1 << 16);
+    for (int i = 0; i < 20; ++i) {
+      std::fill (record.begin(), record.end(), i);
+      wal.append (&record[0], ((i % 100) + 1) * sizeof(int));
+      if (i == 9) {
+        wal.commit ();
+        BOOST_CHECK_EQUAL (wal.getDurableLsn(), 10);
+      }
+    }
+    BOOST_CHECK_THROW (wal.commit (), std::exception);
+    BOOST_CHECK (wal.isFailed ());
+    // a later commit must not make records after the lost blocks durable
+    BOOST_CHECK_THROW (wal.commit (), std::exception);
+    BOOST_CHECK_THROW (wal.append (&record[0], sizeof(int)), std::exception);
+    BOOST_CHECK_EQUAL (wal.getDurableLsn(), 10);
+    BOOST_CHECK_EQUAL (wal.getCommitCount(), 1);
+  }
+  std::vector<int> records;
+  BOOST_CHECK_EQUAL (FWriteAheadLog::replay (filepath, countReplayedRecord, &records), 10);
+  BOOST_REQUIRE_EQUAL (records.size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    BOOST_CHECK_EQUAL (records[i], i);
+  }
+  std::remove (filepath.c_str());
+  BOOST_TEST_MESSAGE("===Tested failures of write-ahead log.");
+}
+
+std::string readTestFile (const std::string &filepath) {
+  std::ifstream file (filepath.c_str(), ios::in | ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+BOOST_AUTO_TEST_CASE(io_write_ahead_log_torn_commit) {
+  BOOST_TEST_MESSAGE("===Testing torn commits of write-ahead log...");
+  const std::string filepath = string(TEST_DATA_FOLDER) + "_torn.wal";
+  std::vector<int> record (100);
+  int64_t committedBytes;
+  {
+    FWriteAheadLog wal (filepath, false, 1 << 16);
+    // commits of partial blocks
+    for (int i = 0; i < 30; ++i) {
+      std::fill (record.begin(), record.end(), i);
+      wal.append (&record[0], ((i % 100) + 1) * sizeof(int));
+      if (i == 9 || i == 19) {
+        wal.commit ();
+      }
+    }
+    const std::string committed = readTestFile (filepath);
+    committedBytes = committed.size();
+    BOOST_CHECK (committedBytes % FDB_DIRECT_IO_ALIGNMENT == 0);
+    wal.commit ();
+    // the last commit wrote only new blocks
+    const std::string content = readTestFile (filepath);
+    BOOST_CHECK ((int64_t) content.size() > committedBytes);
+    BOOST_CHECK (content.compare (0, committedBytes, committed) == 0);
+  }
+  std::vector<int> records;
+  BOOST_CHECK_EQUAL (FWriteAheadLog::replay (filepath, countReplayedRecord, &records), 30);
+
+  BOOST_TEST_MESSAGE("-tearing the last commit");
+  {
+    // as if the crash tore the first block the last commit wrote
+    std::fstream file (filepath.c_str(), ios::in | ios::out | ios::binary);
+    file.seekp (committedBytes);
+    std::vector<char> garbage (FDB_DIRECT_IO_ALIGNMENT / 2, 'x');
+    file.write (&garbage[0], garbage.size());
+  }
+  records.clear();
+  BOOST_CHECK_EQUAL (FWriteAheadLog::replay (filepath, countReplayedRecord, &records), 20);
+  BOOST_REQUIRE_EQUAL (records.size(), 20);
+  for (int i = 0; i < 20; ++i) {
+    BOOST_CHECK_EQUAL (records[i], i);
+  }
+  std::remove (filepath.c_str());
+  BOOST_TEST_MESSAGE("===Tested torn commits of write-ahead log.");
+}
+
+BOOST_AUTO_TEST_CASE(engine_family_recovery) {
+  BOOST_TEST_MESSAGE("===Testing recovery of current fractures from write-ahead logs...");
+  std::remove((TEST_DATA_FOLDER + string("_recovery.sig")).c_str());
+  const int MAX_TUPLES = 64;
+  int totalCount = 0;
+  int64_t loggedCount = 0;
+  {
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_recovery.sig", 100);
+    FFamily *family = engine.createNewFractureFamily("test_recovery", MV_PROJECTION, false);
+    family->startIngest (MAX_TUPLES, 0, false, true);
+    DBGen gen ("../../data/tinyssb/", 100);
+    gen.generateNextBatch();
+    MVProjection *mb = gen.getMVBuffer();
+    for (size_t j = 0; j < gen.getCurrentBatchSize(); ++j) {
+      family->insert(&(mb[j].key), &mb[j]);
+      ++totalCount;
+    }
+    family->commit ();
+    loggedCount = family->getCurrentFracture()->size();
+    BOOST_CHECK (loggedCount > 0);
+    // the engine is closed without flushing the current fracture
+  }
+  {
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_recovery.sig", 100);
+    FFamily *family = engine.createNewFractureFamily("test_recovery", MV_PROJECTION, false);
+    family->startIngest (MAX_TUPLES, 0, false, true);
+    BOOST_CHECK_EQUAL (family->getIngestStats().replayedTuples, loggedCount);
+    BOOST_CHECK_EQUAL (family->getCurrentFracture()->size(), loggedCount);
+    // only the log of the new current fracture remains
+    BOOST_CHECK_EQUAL (FWriteAheadLog::listFiles (TEST_DATA_FOLDER, "test_recovery.wal.").size(), 1);
+    family->flush ();
+  }
+  {
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_recovery.sig", 100);
+    FFamily *family = engine.createNewFractureFamily("test_recovery", MV_PROJECTION, false);
+    family->startIngest (MAX_TUPLES, 0, false, true);
+    BOOST_CHECK_EQUAL (family->getIngestStats().replayedTuples, 0);
+    BOOST_CHECK_EQUAL (engine.getSignatureSet().existsFile(string(TEST_DATA_FOLDER) + "test_recovery.s0"), true);
+  }
+  BOOST_TEST_MESSAGE("===Tested recovery of current fractures from write-ahead logs.");
+}
+
+BOOST_AUTO_TEST_CASE(engine_family_recovery_dumped) {
+  BOOST_TEST_MESSAGE("===Testing recovery from write-ahead logs of dumped fractures...");
+  std::remove((TEST_DATA_FOLDER + string("_recoverydumped.sig")).c_str());
+  std::vector<std::string> oldLogs = FWriteAheadLog::listFiles (TEST_DATA_FOLDER, "test_recoverydumped.wal.");
+  for (size_t i = 0; i < oldLogs.size(); ++i) {
+    std::remove((TEST_DATA_FOLDER + oldLogs[i]).c_str());
+  }
+  const std::string walFilepath = string(TEST_DATA_FOLDER) + "test_recoverydumped.wal.0";
+  int totalCount = 0;
+  {
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_recoverydumped.sig", 100);
+    FFamily *family = engine.createNewFractureFamily("test_recoverydumped", MV_PROJECTION, false);
+    family->startIngest (1000, 0, false, true);
+    DBGen gen ("../../data/tinyssb/", 100);
+    gen.generateNextBatch();
+    MVProjection *mb = gen.getMVBuffer();
+    for (size_t j = 0; j < gen.getCurrentBatchSize(); ++j) {
+      family->insert(&(mb[j].key), &mb[j]);
+      ++totalCount;
+    }
+    family->commit ();
+    const std::string logged = readTestFile (walFilepath);
+    family->flush ();
+    BOOST_CHECK_EQUAL (engine.getSignatureSet().getFileSignature(string(TEST_DATA_FOLDER) + "test_recoverydumped.s0").getWalName(), "test_recoverydumped.wal.0");
+    // as if the run crashed after saving the signature set, but before deleting the log
+    BOOST_CHECK (readTestFile (walFilepath).empty());
+    std::ofstream file (walFilepath.c_str(), ios::out | ios::binary | ios::trunc);
+    file.write (logged.data(), logged.size());
+  }
+  {
+    FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_recoverydumped.sig", 100);
+    FFamily *family = engine.createNewFractureFamily("test_recoverydumped", MV_PROJECTION, false);
+    family->startIngest (1000, 0, false, true);
+    // the tuples are in the dumped fracture only once
+    BOOST_CHECK_EQUAL (family->getIngestStats().replayedTuples, 0);
+    BOOST_CHECK_EQUAL (family->getCurrentFracture()->size(), 0);
+    BOOST_CHECK_EQUAL (engine.getSignatureSet().getFileSignature(string(TEST_DATA_FOLDER) + "test_recoverydumped.s0").totalTupleCount, totalCount);
+    // the dumped log is deleted, and its id is not reused
+    std::vector<std::string> logs = FWriteAheadLog::listFiles (TEST_DATA_FOLDER, "test_recoverydumped.wal.");
+    BOOST_CHECK_EQUAL (logs.size(), 1);
+    BOOST_CHECK (std::find (logs.begin(), logs.end(), "test_recoverydumped.wal.0") == logs.end());
+    family->flush ();
+  }
+  BOOST_TEST_MESSAGE("===Tested recovery from write-ahead logs of dumped fractures.");
+}
+
+BOOST_AUTO_TEST_CASE(storage_cstore_mainmemory) {
+  BOOST_TEST_MESSAGE("===Testing on-memory CStore...");
+  std::remove((TEST_DATA_FOLDER + string("_cstoremainmemory.sig")).c_str());
+  FEngine engine (TEST_DATA_FOLDER, string(TEST_DATA_FOLDER) + "_cstoremainmemory.sig", 100);
+
+  DBGen gen ("../../data/tinyssb/", 50);
+  gen.generateNextBatch();
+  size_t batchSize = gen.getCurrentBatchSize();
+  FMainMemoryBTree btree (MV_PROJECTION, 100, false);
+  FMainMemoryCStore cstore (MV_PROJECTION, 100);
+  MVProjection *mb = gen.getMVBuffer();
+  int64_t totalRev = 0;
+  for (size_t j = 0; j < batchSize; ++j) {
+    const MVProjection &m = mb[j];
+    btree.insert(&(m.key), &m);
+    cstore.insert(&(m.key), &m);
+    totalRev += m.l_revenue;
+  }
+  BOOST_CHECK_EQUAL (cstore.size(), batchSize);
+
+  // readers work before sorting
+  FColumnReader *revReader = cstore.getColumnReader("l_revenue");
+  BOOST_CHECK_EQUAL (revReader->getColumn().compression, UNCOMPRESSED);
+  BOOST_CHECK_EQUAL (FColumnAggregator::sum(revReader, PositionRange(0, batchSize)), totalRev);
+  int16_t year = mb[0].key.d_year;
+  vector<PositionRange> ranges;
+  cstore.getColumnReader("d_year")->getPositionRanges(SearchCond(SCT_EQUAL, &year), ranges);
+  BOOST_CHECK (ranges.size() > 0);
+
+  btree.finishInserts();
+  cstore.finishInserts();
+  BOOST_CHECK (cstore.isFinishedInserts());
+  BOOST_CHECK_EQUAL (FColumnAggregator::sum(revReader, PositionRange(0, batchSize)), totalRev);
+
+  // dumps both and compares. the files must have the same contents.
+  std::vector<FFileSignature> btreeSignatures = engine.getSignatureSet().dumpToNewCStoreFiles(TEST_DATA_FOLDER, "cstore_mainmemory_btree", btree);
+  std::vector<FFileSignature> cstoreSignatures = engine.getSignatureSet().dumpToNewCStoreFiles(TEST_DATA_FOLDER, "cstore_mainmemory_cstore", cstore);
+  // single traversal, small write buffers and more threads than needed
+  FCStoreDumpOptions options;
+  options.threads = 3;
+  options.writeBufferPages = 2;
+  options.sharedTraversal = true;
+  std::vector<FFileSignature> sharedSignatures = engine.getSignatureSet().dumpToNewCStoreFiles(TEST_DATA_FOLDER, "cstore_mainmemory_shared", btree, options);
+  BOOST_REQUIRE_EQUAL (btreeSignatures.size(), cstoreSignatures.size());
+  BOOST_REQUIRE_EQUAL (btreeSignatures.size(), sharedSignatures.size());
+  for (size_t i = 0; i < cstoreSignatures.size(); ++i) {
+    BOOST_CHECK_EQUAL (cstoreSignatures[i].totalTupleCount, batchSize);
+    BOOST_CHECK_EQUAL (cstoreSignatures[i].pageCount, btreeSignatures[i].pageCount);
+    BOOST_CHECK_EQUAL (sharedSignatures[i].pageCount, btreeSignatures[i].pageCount);
+    // columns in a column group share one file
+    std::vector<size_t> members = FCStoreUtil::getColumnGroupOf(cstore.getColumns(), i);
+    BOOST_CHECK_EQUAL (cstoreSignatures[i].fileId, cstoreSignatures[members[0]].fileId);
+  }
+  FReadOnlyCStore fromBtree (engine.getBufferPool(), MV_PROJECTION, engine.getSignatureSet(), TEST_DATA_FOLDER, "cstore_mainmemory_btree");
+  FReadOnlyCStore fromCStore (engine.getBufferPool(), MV_PROJECTION, engine.getSignatureSet(), TEST_DATA_FOLDER, "cstore_mainmemory_cstore");
+  FReadOnlyCStore fromShared (engine.getBufferPool(), MV_PROJECTION, engine.getSignatureSet(), TEST_DATA_FOLDER, "cstore_mainmemory_shared");
+  const std::vector<FCStoreColumn> &columns = cstore.getColumns();
+  char *buffer1 = new char[batchSize * 40];
+  char *buffer2 = new char[batchSize * 40];
+  for (size_t i = 0; i < columns.size(); ++i) {
+    fromBtree.getColumnReader(i)->getDecompressedData (PositionRange (0, batchSize), buffer1, batchSize * 40);
+    fromCStore.getColumnReader(i)->getDecompressedData (PositionRange (0, batchSize), buffer2, batchSize * 40);
+    BOOST_CHECK_MESSAGE (::memcmp (buffer1, buffer2, batchSize * columns[i].maxLength) == 0, "column " << columns[i].name);
+    BOOST_CHECK (::memcmp (buffer2, cstore.getBuffer(i), batchSize * columns[i].maxLength) == 0);
+    fromShared.getColumnReader(i)->getDecompressedData (PositionRange (0, batchSize), buffer2, batchSize * 40);
+    BOOST_CHECK_MESSAGE (::memcmp (buffer1, buffer2, batchSize * columns[i].maxLength) == 0, "column " << columns[i].name);
+  }
+  delete[] buffer1;
+  delete[] buffer2;
+  BOOST_TEST_MESSAGE("===Tested on-memory CStore.");
+}
@@ -8,10 +8,24 @@
   void sleepSec (int sec) {
     ::Sleep (sec * 1000);
   }
+  void makeTestDirectory (const std::string &path) {
+    ::CreateDirectoryA (path.c_str(), NULL);
+  }
+  void removeTestDirectory (const std::string &path) {
+    ::RemoveDirectoryA (path.c_str());
+  }
 #else //WIN32
+  #include <sys/stat.h>
+  #include <unistd.h>
   void sleepSec (int sec) {
     ::sleep (sec);
   }
+  void makeTestDirectory (const std::string &path) {
+    ::mkdir (path.c_str(), S_IRWXU);
+  }
+  void removeTestDirectory (const std::string &path) {
+    ::rmdir (path.c_str());
+  }
 #endif //WIN32
 
 #define TEST_DATA_FOLDER "../../data/test/"
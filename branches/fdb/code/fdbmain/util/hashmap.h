@@ -19,7 +19,9 @@
 // 5. no erase(). just find() and insert().
 
 #include <string.h>
+#include <stdint.h>
 #include <cassert>
+#include <vector>
 
 const size_t BIT_MASKS[] = {
   0x0000, 0x0001, 0x0003, 0x0007,
@@ -92,13 +94,13 @@ public:
   }
   T find (const char *key) const {
     size_t h = hash (key);
-    if (_hashtable[h] == NULL) return NULL;
+    if (_hashtable[h] == NULL) return T(); // NULL for pointers, 0 for codes
     for (size_t i = 0; i < _hashtable[h]->size(); ++i) {
       const Entry &entry = (*_hashtable[h])[i];
       if (equal (key, entry.key)) return entry.data;
     }
     assert (false);
-    return NULL;
+    return T();
   }
   void insert (const char *key, T data) {
     size_t h = hash (key);
@@ -126,4 +128,78 @@ private:
   size_t _stringLength;
   size_t _hashbits; // the length of hash bits used, and the size of the table is 2^_hashbits
 };
+
+// Open addressing (linear probing) hash table from fixed-length keys to int64_t sums,
+// for aggregations with many groups. Unlike the classes above,
+// 1. keys are copied into one flat buffer, so no allocation nor pointer chasing per key.
+// 2. the table doubles when it's half full.
+// 3. entries are kept in insertion order, and can be iterated by index.
+class FixedKeySumTable {
+public:
+  explicit FixedKeySumTable (size_t keyLength = 0) { reset (keyLength); }
+  // removes all entries.
+  void reset (size_t keyLength) {
+    _keyLength = keyLength;
+    _keys.clear();
+    _sums.clear();
+    _slots.assign (INITIAL_SLOTS, 0);
+  }
+  // returns the sum of the key, inserting the key with 0 if not found.
+  int64_t& get (const char *key) {
+    assert (_keyLength > 0);
+    size_t mask = _slots.size() - 1;
+    for (size_t slot = hash (key) & mask; ; slot = (slot + 1) & mask) {
+      uint32_t entry = _slots[slot];
+      if (entry == 0) {
+        if ((_sums.size() + 1) * 2 > _slots.size()) {
+          grow ();
+          return get (key);
+        }
+        _keys.insert (_keys.end(), key, key + _keyLength);
+        _sums.push_back (0);
+        _slots[slot] = _sums.size(); // index + 1
+        return _sums.back();
+      }
+      if (::memcmp (&_keys[(entry - 1) * _keyLength], key, _keyLength) == 0) return _sums[entry - 1];
+    }
+  }
+  size_t size () const { return _sums.size(); }
+  const char* getKey (size_t index) const { return &_keys[index * _keyLength]; }
+  int64_t getSum (size_t index) const { return _sums[index]; }
+
+  // mixes 8 bytes at a time, as keys are often a few integers packed together.
+  size_t hash (const char *key) const {
+    uint64_t ret = 0x9e3779b97f4a7c15ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= _keyLength; i += sizeof(uint64_t)) {
+      uint64_t word;
+      ::memcpy (&word, key + i, sizeof(uint64_t));
+      ret = (ret ^ word) * 0xff51afd7ed558ccdULL;
+      ret ^= ret >> 32;
+    }
+    if (i < _keyLength) {
+      uint64_t word = 0;
+      ::memcpy (&word, key + i, _keyLength - i);
+      ret = (ret ^ word) * 0xff51afd7ed558ccdULL;
+    }
+    ret ^= ret >> 29;
+    return (size_t) ret;
+  }
+private:
+  enum { INITIAL_SLOTS = 1 << 10 };
+  void grow () {
+    _slots.assign (_slots.size() * 2, 0);
+    size_t mask = _slots.size() - 1;
+    for (size_t i = 0; i < _sums.size(); ++i) {
+      size_t slot = hash (getKey(i)) & mask;
+      while (_slots[slot] != 0) slot = (slot + 1) & mask;
+      _slots[slot] = i + 1;
+    }
+  }
+
+  size_t _keyLength;
+  std::vector<char> _keys; // size() * _keyLength bytes
+  std::vector<int64_t> _sums;
+  std::vector<uint32_t> _slots; // index + 1 of the entry. 0 for empty. size is a power of 2.
+};
 #endif// UTIL_HASHMAP_H